@@ -300,6 +300,7 @@ extern "C"
   extern uint32_t JTAG_ReadIDCode(void);
   extern void JTAG_WriteAbort(uint32_t data);
   extern uint8_t JTAG_Transfer(uint32_t request, uint32_t *data);
+  extern uint8_t JTAG_TransferBlock(uint32_t request, uint8_t *data, uint32_t count, uint32_t *done);
   extern uint8_t SWD_Transfer(uint32_t request, uint32_t *data);
 
   extern void Delayms(uint32_t delay);
@@ -311,6 +312,7 @@ extern "C"
   extern uint32_t SWO_Status(uint8_t *response);
   extern uint32_t SWO_ExtendedStatus(const uint8_t *request, uint8_t *response);
   extern uint32_t SWO_Data(const uint8_t *request, uint8_t *response);
+  extern uint32_t SWO_BufferSize(void);
 
   extern void SWO_QueueTransfer(uint8_t *buf, uint32_t num);
   extern void SWO_AbortTransfer(void);
@@ -0,0 +1,98 @@
+/**
+ * @file    DAP_break.h
+ * @brief   FPB/DWT breakpoint and watchpoint manager with cached state
+ *
+ * The manager keeps two copies of every comparator: the state the debugger
+ * asked for and the state last written to the target. SET/CLEAR only change
+ * the requested state; COMMIT writes the comparators that differ. A debugger
+ * that removes all breakpoints on halt and inserts them again on resume
+ * therefore costs no SWD writes unless the set actually changed.
+ *
+ * Vendor command sub-commands, little endian:
+ *
+ *   INFO                       ->  status(1) fpb_rev(1) num_code(1) num_dwt(1)
+ *                                  bp_map(1) wp_map(1)
+ *   SET_BP      addr(4)        ->  status(1)
+ *   CLEAR_BP    addr(4)        ->  status(1)
+ *   SET_WP      addr(4) size(1) type(1)  ->  status(1)
+ *   CLEAR_WP    addr(4) size(1) type(1)  ->  status(1)
+ *   COMMIT                     ->  status(1) writes(1)
+ *   CLEAR_ALL                  ->  status(1)
+ *   HIT                        ->  status(1) hit(1) addr(4) type(1)
+ *   INVALIDATE                 ->  status(1)
+ *
+ * bp_map/wp_map are bitmaps of the requested comparators. HIT reports the
+ * watchpoint whose DWT comparator matched (reading clears MATCHED).
+ * HIT answers DAP_ERROR when a comparator cannot be read.
+ * INVALIDATE forgets the discovered units and all state, use it after the
+ * target was power cycled or the comparators were written by other means.
+ * All sub-commands except INVALIDATE need the SWD port connected.
+ *
+ * Side effect on the host's DP/AP state: the sub-commands access the target
+ * through AP0, which moves DP SELECT and the AP0 CSW and TAR. Like the other
+ * AP-touching vendor commands they are wrapped in swd_host_save and
+ * swd_host_restore: AP0 CSW/TAR are written back after each sub-command,
+ * SELECT with the last value the host wrote through DAP_Transfer or
+ * DAP_TransferBlock (left as is if it wrote none). A status of DAP_ERROR
+ * may leave them changed; the host should then rewrite SELECT, CSW and TAR
+ * before its next AP access. DRW/BDx reads and sticky flags are not kept.
+ *
+ * The state is shared with the on-probe GDB server and is forgotten when
+ * the host connects (DAP_Connect) and whenever the owner changes between
+ * the host and the GDB server (BRK_Claim). A target reset marks the
+ * programmed comparators unknown (BRK_Reapply): DAP_ResetTarget at once,
+ * any other reset (e.g. SYSRESETREQ written through DAP_Transfer) at the
+ * next COMMIT, when it cleared FP_CTRL.ENABLE or DEMCR.TRCENA.
+ */
+#ifndef DAP_BREAK_H
+#define DAP_BREAK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BRK_FPB_MAX             8U      // Code comparators managed
+#define BRK_DWT_MAX             4U      // DWT comparators managed
+
+// Vendor command sub-commands
+#define DAP_BRK_CMD_INFO        0x00U
+#define DAP_BRK_CMD_SET_BP      0x01U
+#define DAP_BRK_CMD_CLEAR_BP    0x02U
+#define DAP_BRK_CMD_SET_WP      0x03U
+#define DAP_BRK_CMD_CLEAR_WP    0x04U
+#define DAP_BRK_CMD_COMMIT      0x05U
+#define DAP_BRK_CMD_CLEAR_ALL   0x06U
+#define DAP_BRK_CMD_HIT         0x07U
+#define DAP_BRK_CMD_INVALIDATE  0x08U
+
+// Comparator owners, see BRK_Claim
+#define BRK_OWNER_NONE          0U
+#define BRK_OWNER_HOST          1U
+#define BRK_OWNER_GDB           2U
+
+// Watchpoint types
+#define BRK_WATCH_WRITE         1U
+#define BRK_WATCH_READ          2U
+#define BRK_WATCH_ACCESS        3U
+
+uint8_t  BRK_Init(void);
+void     BRK_Invalidate(void);
+void     BRK_Reapply(void);
+uint8_t  BRK_Claim(uint8_t owner);
+uint8_t  BRK_Commit(uint32_t *writes);
+uint8_t  BRK_ClearAll(void);
+uint8_t  BRK_SetBreakpoint(uint32_t addr);
+uint8_t  BRK_ClearBreakpoint(uint32_t addr);
+uint8_t  BRK_IsBreakpoint(uint32_t addr);
+uint8_t  BRK_SetWatchpoint(uint32_t addr, uint32_t size, uint8_t type);
+uint8_t  BRK_ClearWatchpoint(uint32_t addr, uint32_t size, uint8_t type);
+uint8_t  BRK_WatchHit(uint8_t *hit, uint32_t *addr, uint8_t *type);
+uint32_t DAP_BRK_Command(const uint8_t *request, uint8_t *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,12 +37,14 @@
  - 关于连接的目标设备的可选信息(用于评估板)。
 */
 
+#include "sdkconfig.h"
 #include "esp32s3/rom/gpio.h"
 #include "driver/gpio.h"
 #include "hal/gpio_ll.h"
 #include "soc/gpio_struct.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 
 #if defined(__GNUC__) && !defined(__STATIC_FORCEINLINE)
 #define __STATIC_FORCEINLINE static inline __attribute__((always_inline))
@@ -52,6 +54,10 @@
 #define __STATIC_INLINE static inline
 #endif
 
+#if defined(__GNUC__) && !defined(__weak)
+#define __weak __attribute__((weak))
+#endif
+
 /// 调试单元中使用的 Cortex-M MCU 的处理器时钟。
 /// 此值用于计算 SWD/JTAG 时钟速度。
 #define CPU_CLOCK               240000000U        ///< 指定 CPU 时钟(Hz)
@@ -71,7 +77,7 @@
 /// 指示调试端口是否支持 JTAG 通信模式。
 /// 此信息作为<b>功能</b>的一部分由命令 \ref DAP_Info 返回。
 #ifndef DAP_JTAG
-#define DAP_JTAG                0               ///< JTAG 模式: 1 = 可用, 0 = 不可用
+#define DAP_JTAG                1               ///< JTAG 模式: 1 = 可用, 0 = 不可用
 #endif
 
 /// 配置连接到调试访问端口的扫描链上的最大 JTAG 设备数。
@@ -106,44 +112,61 @@
 
 /// 指示是否支持 UART 串行线输出(SWO)跟踪。
 /// 此信息作为<b>功能</b>的一部分由命令 \ref DAP_Info 返回。
-#define SWO_UART                0               ///< SWO UART: 1 = 可用, 0 = 不可用
+#define SWO_UART                1               ///< SWO UART: 1 = 可用, 0 = 不可用
 
-/// UART SWO 的 USART 驱动程序实例号。
-#define SWO_UART_DRIVER         0               ///< USART 驱动程序实例号(Driver_USART#)
+/// UART SWO 使用的 ESP32-S3 UART 端口(UART0 留给控制台)。
+#define SWO_UART_PORT           1               ///< UART 端口号(UART_NUM_1)
 
-/// 最大 SWO UART 波特率
-#define SWO_UART_MAX_BAUDRATE   10000000U       ///< SWO UART 最大波特率(Hz)
+/// 最大 SWO UART 波特率(ESP32-S3 UART 在 80MHz APB 时钟下最高 5Mbps)
+#define SWO_UART_MAX_BAUDRATE   5000000U        ///< SWO UART 最大波特率(Hz)
 
 /// 指示是否支持曼彻斯特编码串行线输出(SWO)跟踪。
 /// 此信息作为<b>功能</b>的一部分由命令 \ref DAP_Info 返回。
-#define SWO_MANCHESTER          0               ///< SWO 曼彻斯特: 1 = 可用, 0 = 不可用
+#define SWO_MANCHESTER          1               ///< SWO 曼彻斯特: 1 = 可用, 0 = 不可用
+
+/// 最大 SWO 曼彻斯特波特率(RMT 以 80MHz 分辨率采样边沿,半位至少需要 4 个采样点)
+#define SWO_MANCHESTER_MAX_BAUDRATE 10000000U   ///< SWO 曼彻斯特最大波特率(Hz)
 
 /// SWO 跟踪缓冲区大小。
+/// 内部 RAM 缓冲区,未焊接 PSRAM 或 PSRAM 分配失败时使用。
 #define SWO_BUFFER_SIZE         8192U           ///< SWO 跟踪缓冲区大小(字节,必须为 2^n)
 
-/// SWO 流式跟踪。
-#define SWO_STREAM              0               ///< SWO 流式跟踪: 1 = 可用, 0 = 不可用
+/// PSRAM 中的 SWO 跟踪缓冲区大小(0 = 不使用 PSRAM)。
+/// 分配失败时逐次减半重试,直到不大于 \ref SWO_BUFFER_SIZE 为止。
+#define SWO_PSRAM_BUFFER_SIZE   (4U*1024U*1024U) ///< PSRAM 跟踪缓冲区大小(字节,必须为 2^n)
+
+/// SWO 跟踪缓冲区水位线(占缓冲区大小的百分比),通过 SWO_ExtendedStatus 报告。
+#define SWO_WATERMARK_HIGH      75U             ///< 高水位线(%)
+#define SWO_WATERMARK_LOW       25U             ///< 低水位线(%)
+
+/// SWO 流式跟踪(CMSIS-DAP v2 接口的第三个端点,Bulk IN 0x82)。
+#define SWO_STREAM              1               ///< SWO 流式跟踪: 1 = 可用, 0 = 不可用
 
 /// 测试域定时器的时钟频率。定时器值通过 \ref TIMESTAMP_GET 返回。
-#define TIMESTAMP_CLOCK         240000000U      ///< 时间戳时钟(Hz)(0 = 不支持时间戳)
+#define TIMESTAMP_CLOCK         1000000U        ///< 时间戳时钟(Hz)(0 = 不支持时间戳), esp_timer 微秒计数
 // DAPLink: 禁用,因为我们使用 DWT 进行时间戳,而 M0 没有 DWT。
 
 /// 指示是否支持 UART 通信端口。
 /// 此信息作为<b>功能</b>的一部分由命令 \ref DAP_Info 返回。
-#define DAP_UART                0               ///< DAP UART: 1 = 可用, 0 = 不可用
+#define DAP_UART                1               ///< DAP UART: 1 = 可用, 0 = 不可用
 
-/// UART 通信端口的 USART 驱动程序实例号。
-#define DAP_UART_DRIVER         1               ///< USART 驱动程序实例号(Driver_USART#)
+/// UART 通信端口使用的 ESP32-S3 UART 端口(UART0 留给控制台,UART1 用于 SWO)。
+#define DAP_UART_PORT           2               ///< UART 端口号(UART_NUM_2)
 
 /// UART 接收缓冲区大小。
-#define DAP_UART_RX_BUFFER_SIZE 1024U           ///< UART 接收缓冲区大小(字节,必须为 2^n)
+#define DAP_UART_RX_BUFFER_SIZE 4096U           ///< UART 接收缓冲区大小(字节,必须为 2^n)
 
 /// UART 发送缓冲区大小。
-#define DAP_UART_TX_BUFFER_SIZE 1024U           ///< UART 发送缓冲区大小(字节,必须为 2^n)
+#define DAP_UART_TX_BUFFER_SIZE 4096U           ///< UART 发送缓冲区大小(字节,必须为 2^n)
 
 /// 指示是否支持通过 USB COM 端口的 UART 通信。
 /// 此信息作为<b>功能</b>的一部分由命令 \ref DAP_Info 返回。
+/// CDC 端口配置为 GDB 服务器(CONFIG_XN_GDB_CDC)时不可用。
+#if defined(CONFIG_XN_GDB_CDC) && CONFIG_XN_GDB_CDC
+#define DAP_UART_USB_COM_PORT   0               ///< USB COM 端口: 1 = 可用, 0 = 不可用
+#else
 #define DAP_UART_USB_COM_PORT   1               ///< USB COM 端口: 1 = 可用, 0 = 不可用
+#endif
 
 /// 调试单元是否连接到固定目标设备。
 /// 调试单元可能是评估板的一部分,始终连接到已知设备。
@@ -151,6 +174,14 @@
 /// 调试器或 IDE 可以使用这些字符串来配置设备参数。
 #define TARGET_FIXED            0               ///< 目标: 1 = 已知, 0 = 未知
 
+/// DAP_ResetTarget 软件复位后目标完成复位所需的时间。
+#define DAP_RESET_SETTLE_MS     100U            ///< 复位等待时间(毫秒)
+
+/// DAP_ResetTarget 是否延迟完成。
+/// 为 1 时立即返回响应,等待推迟到下一条访问目标的命令执行前,
+/// 期间 DAP_Info、SWO 等不访问目标的命令可以立即处理。
+#define DAP_RESET_DEFERRED      1               ///< 延迟完成: 1 = 启用, 0 = 阻塞等待
+
 ///@}
 
 //**************************************************************************************************
@@ -191,6 +222,12 @@ DAP 硬件 I/O 引脚访问函数
 #define PIN_SWDIO GPIO_NUM_8
 #define PIN_SWCLK GPIO_NUM_9
 #define PIN_nRESET GPIO_NUM_10
+#define PIN_TDI GPIO_NUM_11
+#define PIN_TDO GPIO_NUM_12
+#define PIN_nTRST GPIO_NUM_13
+#define PIN_SWO PIN_TDO     // SWO 与 TDO 共用引脚(标准 Cortex 调试接口)
+#define PIN_UART_TXD GPIO_NUM_15  // 目标 UART: 探针 TX -> 目标 RX
+#define PIN_UART_RXD GPIO_NUM_16  // 目标 UART: 目标 TX -> 探针 RX
 #define PIN_LED_CONNECTED GPIO_NUM_17
 #define PIN_LED_RUNNING GPIO_NUM_18
 
@@ -201,6 +238,22 @@ DAP 硬件 I/O 引脚访问函数
 */
 __STATIC_INLINE void PORT_JTAG_SETUP(void)
 {
+	gpio_pad_select_gpio(PIN_SWCLK);
+	gpio_set_direction(PIN_SWCLK, GPIO_MODE_INPUT_OUTPUT);
+	gpio_pad_select_gpio(PIN_SWDIO);
+	gpio_set_direction(PIN_SWDIO, GPIO_MODE_INPUT_OUTPUT);
+	gpio_pad_select_gpio(PIN_TDI);
+	gpio_set_direction(PIN_TDI, GPIO_MODE_INPUT_OUTPUT);
+	gpio_pad_select_gpio(PIN_TDO);
+	gpio_set_direction(PIN_TDO, GPIO_MODE_INPUT);
+	gpio_pad_select_gpio(PIN_nTRST);
+	gpio_set_direction(PIN_nTRST, GPIO_MODE_INPUT_OUTPUT_OD);
+	gpio_set_pull_mode(PIN_nTRST, GPIO_PULLUP_ONLY);
+
+	gpio_set_level(PIN_SWCLK, 1);
+	gpio_set_level(PIN_SWDIO, 1);
+	gpio_set_level(PIN_TDI, 1);
+	gpio_set_level(PIN_nTRST, 1);
 }
 
 /** 设置 SWD I/O 引脚: SWCLK, SWDIO 和 nRESET。
@@ -217,6 +270,10 @@ __STATIC_INLINE void PORT_SWD_SETUP(void)
 
 	gpio_set_level(PIN_SWCLK, 1);
 	gpio_set_level(PIN_SWDIO, 1);
+
+	// SWD 模式下 TDI/nTRST 不使用,保持高阻态
+	gpio_set_direction(PIN_TDI, GPIO_MODE_INPUT);
+	gpio_set_direction(PIN_nTRST, GPIO_MODE_INPUT);
 }
 
 /** 禁用 JTAG/SWD I/O 引脚。
@@ -231,6 +288,9 @@ __STATIC_INLINE void PORT_OFF(void)
 	gpio_pad_select_gpio(PIN_SWDIO);
 	gpio_set_direction(PIN_SWDIO, GPIO_MODE_INPUT);
 	gpio_set_level(PIN_SWDIO, 0);
+	gpio_set_direction(PIN_TDI, GPIO_MODE_INPUT);
+	gpio_set_direction(PIN_TDO, GPIO_MODE_INPUT);
+	gpio_set_direction(PIN_nTRST, GPIO_MODE_INPUT);
 }
 
 
@@ -336,7 +396,7 @@ __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_DISABLE(void)
 */
 __STATIC_FORCEINLINE uint32_t PIN_TDI_IN(void)
 {
-	return (0);   // 不可用
+	return (READ_PERI_REG(GPIO_IN_REG) >> PIN_TDI) & 1U;
 }
 
 /** TDI I/O 引脚: 设置输出。
@@ -344,7 +404,14 @@ __STATIC_FORCEINLINE uint32_t PIN_TDI_IN(void)
 */
 __STATIC_FORCEINLINE void     PIN_TDI_OUT(uint32_t bit)
 {
-	(void)bit;   // 不可用
+	if (bit & 1U)
+	{
+		WRITE_PERI_REG(GPIO_OUT_W1TS_REG, (0x1 << PIN_TDI));
+	}
+	else
+	{
+		WRITE_PERI_REG(GPIO_OUT_W1TC_REG, (0x1 << PIN_TDI));
+	}
 }
 
 
@@ -355,7 +422,8 @@ __STATIC_FORCEINLINE void     PIN_TDI_OUT(uint32_t bit)
 */
 __STATIC_FORCEINLINE uint32_t PIN_TDO_IN(void)
 {
-	return (0);   // 不可用
+	// 直接读输入寄存器,gpio_get_level() 在每个 TCK 周期上开销太大
+	return (READ_PERI_REG(GPIO_IN_REG) >> PIN_TDO) & 1U;
 }
 
 
@@ -366,7 +434,7 @@ __STATIC_FORCEINLINE uint32_t PIN_TDO_IN(void)
 */
 __STATIC_FORCEINLINE uint32_t PIN_nTRST_IN(void)
 {
-    return (0);   // 不可用
+	return (READ_PERI_REG(GPIO_IN_REG) >> PIN_nTRST) & 1U;
 }
 
 /** nTRST I/O 引脚: 设置输出。
@@ -376,7 +444,14 @@ __STATIC_FORCEINLINE uint32_t PIN_nTRST_IN(void)
 */
 __STATIC_FORCEINLINE void     PIN_nTRST_OUT(uint32_t bit)
 {
-    (void)bit;   // 不可用
+	if (bit)
+	{
+		WRITE_PERI_REG(GPIO_OUT_W1TS_REG, (0x1 << PIN_nTRST));
+	}
+	else
+	{
+		WRITE_PERI_REG(GPIO_OUT_W1TC_REG, (0x1 << PIN_nTRST));
+	}
 }
 
 // nRESET 引脚 I/O------------------------------------------
@@ -468,7 +543,7 @@ __STATIC_INLINE void LED_RUNNING_OUT(uint32_t bit)
 测试域定时器的访问函数。
 
 调试单元中测试域定时器的值由函数 \ref TIMESTAMP_GET 返回。
-默认情况下使用 DWT 定时器。此定时器的频率通过 \ref TIMESTAMP_CLOCK 配置。
+这里使用 esp_timer 的微秒计数(两个核心一致),频率通过 \ref TIMESTAMP_CLOCK 配置。
 
 */
 
@@ -476,7 +551,7 @@ __STATIC_INLINE void LED_RUNNING_OUT(uint32_t bit)
 \return 当前时间戳值。
 */
 __STATIC_INLINE uint32_t TIMESTAMP_GET (void) {
-  return xTaskGetTickCount();
+  return ((uint32_t)esp_timer_get_time());
 }
 
 ///@}
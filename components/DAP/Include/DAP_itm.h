@@ -0,0 +1,43 @@
+/**
+ * @file    DAP_itm.h
+ * @brief   ITM/DWT packet filter between SWO capture and TraceBuf
+ *
+ * Vendor command sub-commands, little endian:
+ *
+ *   CONFIG  flags(1) sw_mask(4) hw_mask(4)  ->  status(1)
+ *   STATS                                   ->  status(1) kept(4) dropped(4)
+ *
+ * sw_mask selects ITM stimulus ports 0..31, hw_mask selects DWT hardware
+ * source discriminators 0..31. STATS returns packet counts since the last
+ * STATS and clears them.
+ */
+#ifndef DAP_ITM_H
+#define DAP_ITM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vendor command sub-commands
+#define DAP_ITM_CMD_CONFIG      0x00U
+#define DAP_ITM_CMD_STATS       0x01U
+
+// CONFIG flags
+#define DAP_ITM_FILTER          0x01U   // Parse and filter the trace stream
+#define DAP_ITM_ABS_TIMESTAMP   0x02U   // Replace local timestamps with global ones
+
+// Longest output of ITM_FilterByte (GTS1 + GTS2)
+#define ITM_FILTER_MAX_OUT      16U
+
+void     ITM_FilterReset(void);
+uint32_t ITM_FilterEnabled(void);
+uint32_t ITM_FilterByte(uint8_t data, uint8_t *out);
+uint32_t DAP_ITM_Command(const uint8_t *request, uint8_t *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * @file    DAP_jtagscan.h
+ * @brief   On-probe JTAG scan chain discovery
+ *
+ * SCAN response, little endian:
+ *
+ *   status    1  DAP_OK / DAP_ERROR
+ *   flags     1  DAP_JTAG_SCAN_xxx
+ *   count     1  devices in the chain (BYPASS flush)
+ *   ir_total  2  sum of all IR lengths
+ *   then per device, index 0 = device at TDO:
+ *   ir_length 1  0 when it couldn't be told apart from its neighbours
+ *   idcode    4  0 for a device without IDCODE
+ */
+#ifndef DAP_JTAGSCAN_H
+#define DAP_JTAGSCAN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vendor command sub-commands
+#define DAP_JTAG_SCAN_CMD_SCAN      0x00U
+
+// SCAN flags
+#define DAP_JTAG_SCAN_IR_OK         0x01U   // IR lengths resolved, jtag_dev configured
+#define DAP_JTAG_SCAN_ID_MISMATCH   0x02U   // IDCODE walk and BYPASS count disagree
+
+uint32_t DAP_JTAG_ScanCommand(const uint8_t *request, uint8_t *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
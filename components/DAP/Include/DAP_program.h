@@ -0,0 +1,85 @@
+/**
+ * @file    DAP_program.h
+ * @brief   On-probe micro-program interpreter for looped SWD transfer sequences
+ *
+ * A program is a byte stream of instructions operating on 8 general purpose
+ * 32-bit registers. Multi-byte operands are little endian, branch targets are
+ * absolute byte offsets into the program buffer.
+ *
+ *   END                         0x00
+ *   XFER_READ   req rd          0x01  rd = DP/AP register (req as in DAP_Transfer)
+ *   XFER_WRITE  req rs          0x02  DP/AP register = rs
+ *   XFER_WRITEI req imm32       0x03  DP/AP register = imm32
+ *   LOADI       rd imm32        0x04  rd = imm32
+ *   MOV         rd rs           0x05  rd = rs
+ *   ANDI        rd imm32        0x06  rd &= imm32
+ *   ORI         rd imm32        0x07  rd |= imm32
+ *   ADDI        rd imm32        0x08  rd += imm32
+ *   JMP         tgt16           0x09
+ *   BEQ         rs mask32 val32 tgt16  0x0A  if ((rs & mask) == val) jump
+ *   BNE         rs mask32 val32 tgt16  0x0B  if ((rs & mask) != val) jump
+ *   DJNZ        rd tgt16        0x0C  if (--rd != 0) jump
+ *   DELAY       us16            0x0D  busy wait
+ *   APPEND      rs              0x0E  append rs to the result buffer
+ *   FAIL        code8           0x0F  stop with a program defined error code
+ *
+ * A run ends after DAP_PROGRAM_MAX_STEPS instructions or when it has taken
+ * DAP_PROGRAM_TIME_US, whichever comes first.
+ */
+#ifndef DAP_PROGRAM_H
+#define DAP_PROGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DAP_PROGRAM_SIZE        1024U   // Program buffer size in bytes
+#define DAP_PROGRAM_RESULT_SIZE 1024U   // Result buffer size in bytes
+#define DAP_PROGRAM_REGS        8U
+#define DAP_PROGRAM_MAX_STEPS   1000000U
+#define DAP_PROGRAM_TIME_US     500000U // Wall-clock limit for one RUN, the DAP lock is held
+
+// Opcodes
+#define DAP_PROG_END            0x00U
+#define DAP_PROG_XFER_READ      0x01U
+#define DAP_PROG_XFER_WRITE     0x02U
+#define DAP_PROG_XFER_WRITEI    0x03U
+#define DAP_PROG_LOADI          0x04U
+#define DAP_PROG_MOV            0x05U
+#define DAP_PROG_ANDI           0x06U
+#define DAP_PROG_ORI            0x07U
+#define DAP_PROG_ADDI           0x08U
+#define DAP_PROG_JMP            0x09U
+#define DAP_PROG_BEQ            0x0AU
+#define DAP_PROG_BNE            0x0BU
+#define DAP_PROG_DJNZ           0x0CU
+#define DAP_PROG_DELAY          0x0DU
+#define DAP_PROG_APPEND         0x0EU
+#define DAP_PROG_FAIL           0x0FU
+
+// Run status
+#define DAP_PROG_OK             0x00U   // Reached END
+#define DAP_PROG_ERR_XFER       0x01U   // SWD transfer returned no OK ack
+#define DAP_PROG_ERR_OPCODE     0x02U   // Unknown opcode or bad operand
+#define DAP_PROG_ERR_BOUNDS     0x03U   // PC or branch target outside the program
+#define DAP_PROG_ERR_STEPS      0x04U   // Step limit exceeded
+#define DAP_PROG_ERR_ABORT      0x05U   // DAP_TransferAbort set by host
+#define DAP_PROG_ERR_RESULT     0x06U   // Result buffer full
+#define DAP_PROG_ERR_PORT       0x07U   // SWD port not connected
+#define DAP_PROG_ERR_TIME       0x08U   // Time budget exceeded
+#define DAP_PROG_ERR_USER       0x80U   // FAIL instruction, code in low 7 bits
+
+// Vendor command sub-commands
+#define DAP_PROG_CMD_LOAD       0x00U
+#define DAP_PROG_CMD_RUN        0x01U
+#define DAP_PROG_CMD_RESULT     0x02U
+
+uint32_t DAP_Program(const uint8_t *request, uint8_t *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file    DAP_retry.h
+ * @brief   Adaptive WAIT retry engine for SWD transfers
+ */
+#ifndef DAP_RETRY_H
+#define DAP_RETRY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DAP_RETRY_TIME_BUDGET_US  100000U   // Default WAIT budget per transfer
+#define DAP_RETRY_MAX_LEVEL       10U       // Backoff cap: 1 << 10 idle cycles
+#define DAP_RETRY_AP_PROFILES     8U        // Number of learned AP profiles
+
+// Vendor command sub-commands
+#define DAP_RETRY_CMD_STATS       0x00U
+#define DAP_RETRY_CMD_PROFILES    0x01U
+#define DAP_RETRY_CMD_RESET       0x02U
+#define DAP_RETRY_CMD_CONFIG      0x03U
+#define DAP_RETRY_CMD_SYSCALL     0x04U   // Flash algorithm call timing
+
+typedef struct {
+  uint32_t wait_events;     // Transfers that received at least one WAIT
+  uint32_t wait_acks;       // Total WAIT responses
+  uint32_t timeouts;        // Transfers abandoned with WAIT
+  uint32_t max_wait_us;     // Longest time spent in a WAIT sequence
+} DAP_RetryStats_t;
+
+uint8_t  SWD_TransferRetry(uint32_t request, uint32_t *data);
+void     DAP_RetryReset(void);
+void     DAP_RetryGetStats(DAP_RetryStats_t *stats);
+void     DAP_RetryHostSelect(uint32_t request, uint32_t data);
+uint8_t  DAP_RetryLastSelect(uint32_t *select);
+uint32_t DAP_RetryCommand(const uint8_t *request, uint8_t *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file    DAP_romtable.h
+ * @brief   On-probe ROM table walk and CoreSight component table
+ *
+ * Each component is reported as a 16 byte record, little endian:
+ *
+ *   base      4  component base address
+ *   pidr      4  PIDR3..PIDR0 (low byte of each register)
+ *   devarch   4  DEVARCH, CIDR class 0x9 only
+ *   apsel     1  AP the component was found behind
+ *   class     1  CIDR1[7:4], 0x1 = ROM table, 0x9 = CoreSight
+ *   devtype   1  DEVTYPE, CIDR class 0x9 only
+ *   pidr4     1  PIDR4 (JEP106 continuation code, 4KB count)
+ *
+ * SCAN leaves the host's DP SELECT and the CSW/TAR of each MEM-AP as it
+ * found them: they are saved before the walk changes them and written back
+ * afterwards (swd_host_save). Only the first 8 MEM-APs can be saved, APs
+ * beyond that are not walked. On DAP_ERROR the host must rewrite SELECT,
+ * CSW and TAR before its next AP access.
+ */
+#ifndef DAP_ROMTABLE_H
+#define DAP_ROMTABLE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DAP_ROM_MAX_COMPONENTS  64U     // Component table size
+#define DAP_ROM_MAX_DEPTH       4U      // Nested ROM table limit
+#define DAP_ROM_RECORD_SIZE     16U
+
+// Vendor command sub-commands
+#define DAP_ROM_CMD_SCAN        0x00U
+#define DAP_ROM_CMD_READ        0x01U
+#define DAP_ROM_CMD_FORGET      0x02U
+
+// SCAN flags
+#define DAP_ROM_SCAN_NO_CACHE   0x01U   // Ignore the NVS cache and walk again
+
+// SCAN result source
+#define DAP_ROM_SRC_WALK        0x00U
+#define DAP_ROM_SRC_CACHE       0x01U
+
+typedef struct {
+  uint32_t base;
+  uint32_t pidr;
+  uint32_t devarch;
+  uint8_t  apsel;
+  uint8_t  cclass;
+  uint8_t  devtype;
+  uint8_t  pidr4;
+} DAP_RomComponent_t;
+
+uint32_t DAP_RomTableCommand(const uint8_t *request, uint8_t *response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -279,6 +279,30 @@ extern "C" {
 #define DBGCID2         (DEBUG_REGSITER_BASE +  (1022 * 4))   // Debug Component ID
 #define DBGCID3         (DEBUG_REGSITER_BASE +  (1023 * 4))   // Debug Component ID
 
+// Debug Status and Control Register definitions
+#define DSCR_HALTED     0x00000001  // Processor halted
+#define DSCR_RESTARTED  0x00000002  // Processor restarted
+#define DSCR_SDABORT_L  0x00000040  // Sticky synchronous data abort
+#define DSCR_ADABORT_L  0x00000080  // Sticky asynchronous data abort
+#define DSCR_UND_L      0x00000100  // Sticky undefined instruction
+#define DSCR_ITREN      0x00002000  // Execute instruction enable
+#define DSCR_HDBGEN     0x00004000  // Halting debug-mode enable
+#define DSCR_EXTDCC     0x00300000  // External DCC access mode mask
+#define DSCR_EXTDCC_NB  0x00000000  // External DCC mode: non-blocking
+#define DSCR_EXTDCC_ST  0x00100000  // External DCC mode: stall
+#define DSCR_EXTDCC_FA  0x00200000  // External DCC mode: fast
+#define DSCR_INSTRCOMPL 0x01000000  // Instruction complete
+#define DSCR_TXFULL_L   0x20000000  // DBGDTRTX full, latched
+#define DSCR_RXFULL_L   0x40000000  // DBGDTRRX full, latched
+
+// Debug Run Control Register definitions
+#define DRCR_HRQ        0x00000001  // Halt request
+#define DRCR_RRQ        0x00000002  // Restart request
+#define DRCR_CSE        0x00000004  // Clear sticky exceptions
+
+// Lock Access Register key
+#define DBGLAR_KEY      0xC5ACCE55
+
 #ifdef __cplusplus
 }
 #endif
@@ -49,6 +49,7 @@
 #define AP_BD1         0x14        // Banked Data 1
 #define AP_BD2         0x18        // Banked Data 2
 #define AP_BD3         0x1C        // Banked Data 3
+#define AP_CFG         0xF4        // Configuration
 #define AP_ROM         0xF8        // Debug ROM Address
 #define AP_IDR         0xFC        // Identification Register
 
@@ -68,6 +69,25 @@
 #define CSW_MSTRCORE   0x00000000  // Master Type: Core
 #define CSW_MSTRDBG    0x20000000  // Master Type: Debug
 #define CSW_RESERVED   0x01000000  // Reserved Value
+#define CSW_HNONSEC    0x40000000  // Non-secure Transfer Request
+
+// AP Configuration Register definitions
+#define CFG_BE         0x00000001  // Big-endian
+#define CFG_LA         0x00000002  // Large Address (64-bit TAR)
+#define CFG_LD         0x00000004  // Large Data
+#define CFG_TARINC     0x000F0000  // TAR Incrementer Size (ADIv6)
+
+// AP Identification Register definitions
+#define IDR_TYPE       0x0000000F  // AP Type Mask
+#define IDR_TYPE_AXI   0x00000004  // AMBA AXI3/AXI4
+#define IDR_TYPE_AXI5  0x00000007  // AMBA AXI5
+#define IDR_CLASS      0x0001E000  // AP Class Mask
+#define IDR_CLASS_MEM  0x00010000  // AP Class: Memory Access Port
+
+// AP Debug Base Address definitions
+#define ROM_PRESENT    0x00000001  // Debug entry present
+#define ROM_FORMAT     0x00000002  // ADIv5 format
+#define ROM_ADDR       0xFFFFF000  // Base Address Mask
 
 // Core Debug Register Address Offsets
 #define DBG_OFS        0x0DF0      // Debug Register Offset inside NVIC
@@ -0,0 +1,37 @@
+/**
+ * @file    rtt.h
+ * @brief   SEGGER RTT compatible control block access through swd_host
+ */
+#ifndef RTT_H
+#define RTT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Default search window for the RTT control block (Cortex-M SRAM region)
+#define RTT_DEFAULT_SEARCH_START    (0x20000000)
+#define RTT_DEFAULT_SEARCH_SIZE     (0x00010000)
+
+// rtt_scan() results
+#define RTT_SCAN_ERROR      0   // SWD access failed
+#define RTT_SCAN_BUSY       1   // Chunk scanned, control block not found yet
+#define RTT_SCAN_FOUND      2   // Control block located and validated
+#define RTT_SCAN_NOT_FOUND  3   // Whole search window scanned without a match
+
+void rtt_configure(uint32_t start, uint32_t size);
+void rtt_enable(uint8_t enable);
+uint8_t rtt_is_enabled(void);
+void rtt_reset(void);
+uint8_t rtt_scan(void);
+uint32_t rtt_get_control_block(void);
+uint8_t rtt_read_up(uint32_t channel, uint8_t *data, uint32_t size, uint32_t *count);
+uint8_t rtt_write_down(uint32_t channel, const uint8_t *data, uint32_t size, uint32_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -36,20 +36,49 @@ typedef enum
     FLASHALGO_RETURN_POINTER
 } flash_algo_return_t;
 
+typedef struct
+{
+    uint32_t calls;       // Flash algorithm calls started
+    uint32_t timeouts;    // Calls that didn't halt within the budget
+    uint32_t last_us;     // Run time of the last completed call
+    uint32_t max_us;      // Longest completed call
+    uint64_t total_us;    // Sum of all completed calls
+} swd_syscall_stats_t;
+
 uint8_t swd_init(void);
 uint8_t swd_off(void);
 uint8_t swd_init_debug(void);
+void swd_invalidate_state(void);
+void swd_host_save(void);
+uint8_t swd_host_save_ap(uint32_t ap);
+uint8_t swd_host_restore(void);
 uint8_t swd_read_dp(uint8_t adr, uint32_t *val);
 uint8_t swd_write_dp(uint8_t adr, uint32_t val);
 uint8_t swd_read_ap(uint32_t adr, uint32_t *val);
+uint8_t swd_read_ap_multiple(const uint32_t *adr, uint32_t *val, uint32_t count);
+uint8_t swd_probe_ap(uint8_t apsel);
 uint8_t swd_write_ap(uint32_t adr, uint32_t val);
 uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size);
 uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size);
+uint8_t swd_read_memory_sized(uint32_t address, uint8_t *data, uint32_t size, uint8_t width);
+uint8_t swd_write_memory_sized(uint32_t address, uint8_t *data, uint32_t size, uint8_t width);
 uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4);
+void swd_get_syscall_stats(swd_syscall_stats_t *stats);
 void swd_set_target_reset(uint8_t asserted);
 uint8_t swd_set_target_state_hw(target_state_t state);
 uint8_t swd_set_target_state_sw(target_state_t state);
+uint8_t swd_read_word(uint32_t addr, uint32_t *val);
 uint8_t swd_write_word(uint32_t addr, uint32_t val);
+uint8_t swd_read_core_register(uint32_t n, uint32_t *val);
+uint8_t swd_write_core_register(uint32_t n, uint32_t val);
+uint8_t swd_wait_until_halted(uint32_t timeout_us);
+void swd_queue_reset(void);
+void swd_queue_read_dp(uint8_t adr, uint32_t *val);
+void swd_queue_write_dp(uint8_t adr, uint32_t val);
+void swd_queue_read_ap(uint32_t adr, uint32_t *val);
+void swd_queue_write_ap(uint32_t adr, uint32_t val);
+uint8_t swd_queue_flush(void);
+void swd_queue_error(uint32_t *index, uint8_t *ack);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,37 @@
+/**
+ * @file    swd_host_ca.h
+ * @brief   Host driver for Cortex-A/R cores behind an APB-AP
+ *
+ * The driver rewrites the APB-AP CSW/TAR and DP SELECT freely. The vendor
+ * command (0x85) wraps every sub-command in swd_host_save/swd_host_restore,
+ * so the host finds its SELECT and APB-AP CSW/TAR unchanged after a
+ * DAP_OK. After DAP_ERROR the host must write them again.
+ */
+#ifndef SWDHOST_CA_H
+#define SWDHOST_CA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Core register numbers for ca_read_core_register/ca_write_core_register
+#define CA_REG_PC       15U     // Restart address
+#define CA_REG_CPSR     16U
+
+uint8_t ca_attach(uint8_t apsel, uint32_t debug_base, uint32_t *didr);
+uint8_t ca_halt(void);
+uint8_t ca_resume(void);
+uint8_t ca_is_halted(uint8_t *halted);
+uint8_t ca_exec(uint32_t opcode);
+uint8_t ca_read_core_register(uint32_t n, uint32_t *val);
+uint8_t ca_write_core_register(uint32_t n, uint32_t val);
+uint8_t ca_read_memory(uint32_t address, uint8_t *data, uint32_t size);
+uint8_t ca_write_memory(uint32_t address, const uint8_t *data, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,6 +35,10 @@
 #include "DAP.h"
 #include "dap_strings.h"
 #include "swd_host.h"
+#include "DAP_retry.h"
+#include "DAP_break.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 
 #if (DAP_PACKET_SIZE < 64U)
 #error "Minimum Packet Size is 64!"
@@ -70,6 +74,9 @@ static const char DAP_FW_Ver [] = DAP_FW_VER;
 //   return:  number of bytes in info data
 static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
   uint8_t length = 0U;
+#if ((SWO_UART != 0) || (SWO_MANCHESTER != 0))
+  uint32_t n;
+#endif
 
   switch (id) {
     case DAP_ID_VENDOR:
@@ -145,10 +152,11 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
       break;
     case DAP_ID_SWO_BUFFER_SIZE:
 #if ((SWO_UART != 0) || (SWO_MANCHESTER != 0))
-      info[0] = (uint8_t)(SWO_BUFFER_SIZE >>  0);
-      info[1] = (uint8_t)(SWO_BUFFER_SIZE >>  8);
-      info[2] = (uint8_t)(SWO_BUFFER_SIZE >> 16);
-      info[3] = (uint8_t)(SWO_BUFFER_SIZE >> 24);
+      n = SWO_BufferSize();
+      info[0] = (uint8_t)(n >>  0);
+      info[1] = (uint8_t)(n >>  8);
+      info[2] = (uint8_t)(n >> 16);
+      info[3] = (uint8_t)(n >> 24);
       length = 4U;
 #endif
       break;
@@ -171,12 +179,54 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
 
 // Delay for specified time
 //    delay:  delay time in ms
+// Blocks only the calling task when the scheduler allows it, so USB and
+// background tasks keep running. vTaskDelay may return up to one tick early,
+// hence the extra tick. Sub-tick delays, ISRs and critical sections busy-wait.
 void Delayms(uint32_t delay) {
-  delay *= ((CPU_CLOCK/1000U) + (DELAY_SLOW_CYCLES-1U)) / DELAY_SLOW_CYCLES;
-  PIN_DELAY_SLOW(delay);
+  if ((delay >= portTICK_PERIOD_MS) &&
+      (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) &&
+      !xPortInIsrContext() && xPortCanYield()) {
+    vTaskDelay(pdMS_TO_TICKS(delay) + 1U);
+    return;
+  }
+  esp_rom_delay_us(delay * 1000U);
 }
 
 
+#if (DAP_RESET_DEFERRED != 0)
+static int64_t DAP_ResetPending;        // time the deferred reset settles, 0 = none
+
+// Finish a deferred DAP_ResetTarget before the target is accessed again
+static void DAP_ResetComplete(void) {
+  int64_t remaining;
+
+  remaining = DAP_ResetPending - esp_timer_get_time();
+  DAP_ResetPending = 0;
+  if (remaining > 0) {
+    Delayms((uint32_t)((remaining + 999) / 1000));
+  }
+}
+
+// Commands that can run while a deferred reset settles
+static uint32_t DAP_ResetIndependent(uint8_t id) {
+  switch (id) {
+    case ID_DAP_Info:
+    case ID_DAP_HostStatus:
+    case ID_DAP_SWO_Transport:
+    case ID_DAP_SWO_Mode:
+    case ID_DAP_SWO_Baudrate:
+    case ID_DAP_SWO_Control:
+    case ID_DAP_SWO_Status:
+    case ID_DAP_SWO_ExtendedStatus:
+    case ID_DAP_SWO_Data:
+      return (1U);
+    default:
+      return (0U);
+  }
+}
+#endif
+
+
 // Process Delay command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -252,6 +302,15 @@ static uint32_t DAP_Connect(const uint8_t *request, uint8_t *response) {
       break;
   }
 
+  // The host takes the port over, possibly on another target: comparator
+  // state and the SELECT/CSW/TAR cached by swd_host for the on-probe users
+  // (GDB server, RTT bridge) are no longer trusted
+  if (port != DAP_PORT_DISABLED) {
+    BRK_Claim(BRK_OWNER_HOST);
+    BRK_Invalidate();
+    swd_invalidate_state();
+  }
+
   *response = (uint8_t)port;
   return ((1U << 16) | 1U);
 }
@@ -266,6 +325,10 @@ static uint32_t DAP_Disconnect(uint8_t *response) {
   DAP_Data.debug_port = DAP_PORT_DISABLED;
   PORT_OFF();
 
+  // The host may have rewritten SELECT/CSW/TAR since it connected: the next
+  // on-probe user of swd_host starts cold
+  swd_invalidate_state();
+
   *response = DAP_OK;
   return (1U);
 }
@@ -300,11 +363,18 @@ static uint32_t DAP_ResetTarget(uint8_t *response) {
       Delayms(2);
       req = DAP_TRANSFER_APnDP | 0 | DAP_TRANSFER_A2 | DAP_TRANSFER_A3;
       SWD_Transfer(req, &AIRCR_RESET_VAL);
-      Delayms(100);  // 等待复位完成
+#if (DAP_RESET_DEFERRED != 0)
+      // 不在此等待，下一条访问目标的命令执行前再等待复位完成
+      DAP_ResetPending = esp_timer_get_time() + (DAP_RESET_SETTLE_MS * 1000);
+#else
+      Delayms(DAP_RESET_SETTLE_MS);  // 等待复位完成
+#endif
     }
   }
   *(response+1) = RESET_TARGET();
   *(response+0) = DAP_OK;
+  // The reset may have cleared DEMCR and the comparators
+  BRK_Reapply();
   return (2U);
 }
 
@@ -721,6 +791,8 @@ static uint32_t DAP_TransferConfigure(const uint8_t *request, uint8_t *response)
 static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   const
   uint8_t  *request_head;
+  const
+  uint8_t  *request_item;
   uint32_t  request_count;
   uint32_t  request_value;
   uint8_t  *response_head;
@@ -730,7 +802,6 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   uint32_t  check_write;
   uint32_t  match_value;
   uint32_t  match_retry;
-  uint32_t  retry;
   uint32_t  data;
 #if (TIMESTAMP_CLOCK != 0U)
   uint32_t  timestamp;
@@ -753,22 +824,18 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   request_count = *request++;
 
   for (; request_count != 0U; request_count--) {
+    request_item  = request;
     request_value = *request++;
     if ((request_value & DAP_TRANSFER_RnW) != 0U) {
       // Read register
       if (post_read) {
         // Read was posted before
-        retry = DAP_Data.transfer.retry_count;
         if ((request_value & (DAP_TRANSFER_APnDP | DAP_TRANSFER_MATCH_VALUE)) == DAP_TRANSFER_APnDP) {
           // Read previous AP data and post next AP read
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
         } else {
           // Read previous AP data
-          do {
-            response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
           post_read = 0U;
         }
         if (response_value != DAP_TRANSFER_OK) {
@@ -802,20 +869,14 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         match_retry = DAP_Data.transfer.match_retry;
         if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
           // Post AP read
-          retry = DAP_Data.transfer.retry_count;
-          do {
-            response_value = SWD_Transfer(request_value, NULL);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, NULL);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
         }
         do {
           // Read register until its value matches or retry counter expires
-          retry = DAP_Data.transfer.retry_count;
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
@@ -828,14 +889,11 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         }
       } else {
         // Normal read
-        retry = DAP_Data.transfer.retry_count;
         if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
           // Read AP register
           if (post_read == 0U) {
             // Post AP read
-            do {
-              response_value = SWD_Transfer(request_value, NULL);
-            } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+            response_value = SWD_TransferRetry(request_value, NULL);
             if (response_value != DAP_TRANSFER_OK) {
               break;
             }
@@ -853,9 +911,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
           }
         } else {
           // Read DP register
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
@@ -881,10 +937,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
       // Write register
       if (post_read) {
         // Read previous data
-        retry = DAP_Data.transfer.retry_count;
-        do {
-          response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-        } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+        response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
         if (response_value != DAP_TRANSFER_OK) {
           break;
         }
@@ -907,13 +960,11 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         response_value = DAP_TRANSFER_OK;
       } else {
         // Write DP/AP register
-        retry = DAP_Data.transfer.retry_count;
-        do {
-          response_value = SWD_Transfer(request_value, &data);
-        } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+        response_value = SWD_TransferRetry(request_value, &data);
         if (response_value != DAP_TRANSFER_OK) {
           break;
         }
+        DAP_RetryHostSelect(request_value, data);
 #if (TIMESTAMP_CLOCK != 0U)
         // Store Timestamp
         if ((request_value & DAP_TRANSFER_TIMESTAMP) != 0U) {
@@ -933,6 +984,12 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
     }
   }
 
+  // The request that stopped the loop is not counted off yet and may be
+  // partly consumed: skip it again from its first byte
+  if (request_count != 0U) {
+    request = request_item;
+  }
+
   for (; request_count != 0U; request_count--) {
     // Process canceled requests
     request_value = *request++;
@@ -951,10 +1008,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   if (response_value == DAP_TRANSFER_OK) {
     if (post_read) {
       // Read previous data
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
@@ -965,10 +1019,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
       *response++ = (uint8_t)(data >> 24);
     } else if (check_write) {
       // Check last write
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
     }
   }
 
@@ -990,6 +1041,8 @@ end:
 static uint32_t DAP_JTAG_Transfer(const uint8_t *request, uint8_t *response) {
   const
   uint8_t  *request_head;
+  const
+  uint8_t  *request_item;
   uint32_t  request_count;
   uint32_t  request_value;
   uint32_t  request_ir;
@@ -1020,13 +1073,14 @@ static uint32_t DAP_JTAG_Transfer(const uint8_t *request, uint8_t *response) {
 
   // Device index (JTAP TAP)
   DAP_Data.jtag_dev.index = *request++;
+  request_count = *request++;
   if (DAP_Data.jtag_dev.index >= DAP_Data.jtag_dev.count) {
-    goto end;
+    // Skip all requests so that the request length is still right
+    goto cancel;
   }
 
-  request_count = *request++;
-
   for (; request_count != 0U; request_count--) {
+    request_item  = request;
     request_value = *request++;
     request_ir = (request_value & DAP_TRANSFER_APnDP) ? JTAG_APACC : JTAG_DPACC;
     if ((request_value & DAP_TRANSFER_RnW) != 0U) {
@@ -1203,6 +1257,13 @@ static uint32_t DAP_JTAG_Transfer(const uint8_t *request, uint8_t *response) {
     }
   }
 
+  // The request that stopped the loop is not counted off yet and may be
+  // partly consumed: skip it again from its first byte
+  if (request_count != 0U) {
+    request = request_item;
+  }
+
+cancel:
   for (; request_count != 0U; request_count--) {
     // Process canceled requests
     request_value = *request++;
@@ -1334,7 +1395,6 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
   uint32_t  response_count;
   uint32_t  response_value;
   uint8_t  *response_head;
-  uint32_t  retry;
   uint32_t  data;
 
   response_count = 0U;
@@ -1358,10 +1418,7 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
     // Read register block
     if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
       // Post AP read
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, NULL);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(request_value, NULL);
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
@@ -1372,10 +1429,7 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
         // Last AP read
         request_value = DP_RDBUFF | DAP_TRANSFER_RnW;
       }
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(request_value, &data);
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
@@ -1396,20 +1450,15 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
              (uint32_t)(*(request+3) << 24);
       request += 4;
       // Write DP/AP register
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(request_value, &data);
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
+      DAP_RetryHostSelect(request_value, data);
       response_count++;
     }
     // Check last write
-    retry = DAP_Data.transfer.retry_count;
-    do {
-      response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
-    } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+    response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
   }
 
 end:
@@ -1422,6 +1471,46 @@ end:
 #endif
 
 
+// Run a JTAG transfer block, retrying the word that got a WAIT response
+//   request: A[3:2] RnW APnDP
+//   data:    little endian data block (read or write)
+//   count:   number of transfers
+//   done:    number of transfers completed with ACK OK
+//   return:  ACK of the last transfer
+#if (DAP_JTAG != 0)
+static uint8_t DAP_JTAG_TransferRun(uint32_t request, uint8_t *data, uint32_t count, uint32_t *done) {
+  uint32_t retry;
+  uint32_t n;
+  uint8_t  ack;
+
+  *done = 0U;
+  ack   = DAP_TRANSFER_OK;
+
+  while (count != 0U) {
+    ack = JTAG_TransferBlock(request, data, count, &n);
+    data   += n * 4U;
+    count  -= n;
+    *done  += n;
+    if (ack != DAP_TRANSFER_WAIT) {
+      break;
+    }
+    retry = DAP_Data.transfer.retry_count;
+    do {
+      ack = JTAG_TransferBlock(request, data, 1U, &n);
+    } while ((ack == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+    if (ack != DAP_TRANSFER_OK) {
+      break;
+    }
+    data  += 4U;
+    count -= 1U;
+    *done += 1U;
+  }
+
+  return (ack);
+}
+#endif
+
+
 // Process JTAG Transfer Block command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -1435,6 +1524,7 @@ static uint32_t DAP_JTAG_TransferBlock(const uint8_t *request, uint8_t *response
   uint8_t  *response_head;
   uint32_t  retry;
   uint32_t  data;
+  uint32_t  done;
   uint32_t  ir;
 
   response_count = 0U;
@@ -1472,48 +1562,36 @@ static uint32_t DAP_JTAG_TransferBlock(const uint8_t *request, uint8_t *response
     if (response_value != DAP_TRANSFER_OK) {
       goto end;
     }
-    // Read register block
-    while (request_count--) {
-      // Read DP/AP register
-      if (request_count == 0U) {
-        // Last read
-        if (ir != JTAG_DPACC) {
-          JTAG_IR(JTAG_DPACC);
-        }
-        request_value = DP_RDBUFF | DAP_TRANSFER_RnW;
-      }
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = JTAG_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-      if (response_value != DAP_TRANSFER_OK) {
-        goto end;
-      }
-      // Store data
-      *response++ = (uint8_t) data;
-      *response++ = (uint8_t)(data >>  8);
-      *response++ = (uint8_t)(data >> 16);
-      *response++ = (uint8_t)(data >> 24);
-      response_count++;
+    // Read register block, each scan returns the previous read
+    response_value = DAP_JTAG_TransferRun(request_value, response, request_count - 1U, &done);
+    response       += done * 4U;
+    response_count += done;
+    if (response_value != DAP_TRANSFER_OK) {
+      goto end;
+    }
+    // Last read
+    if (ir != JTAG_DPACC) {
+      JTAG_IR(JTAG_DPACC);
     }
+    retry = DAP_Data.transfer.retry_count;
+    do {
+      response_value = JTAG_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
+    } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+    if (response_value != DAP_TRANSFER_OK) {
+      goto end;
+    }
+    // Store data
+    *response++ = (uint8_t) data;
+    *response++ = (uint8_t)(data >>  8);
+    *response++ = (uint8_t)(data >> 16);
+    *response++ = (uint8_t)(data >> 24);
+    response_count++;
   } else {
     // Write register block
-    while (request_count--) {
-      // Load data
-      data = (uint32_t)(*(request+0) <<  0) |
-             (uint32_t)(*(request+1) <<  8) |
-             (uint32_t)(*(request+2) << 16) |
-             (uint32_t)(*(request+3) << 24);
-      request += 4;
-      // Write DP/AP register
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = JTAG_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-      if (response_value != DAP_TRANSFER_OK) {
-        goto end;
-      }
-      response_count++;
+    response_value = DAP_JTAG_TransferRun(request_value, (uint8_t *)request, request_count, &done);
+    response_count = done;
+    if (response_value != DAP_TRANSFER_OK) {
+      goto end;
     }
     // Check last write
     if (ir != JTAG_DPACC) {
@@ -1689,6 +1767,12 @@ __WEAK uint32_t DAP_ProcessVendorCommandEx(const uint8_t *request, uint8_t *resp
 uint32_t DAP_ProcessCommand(const uint8_t *request, uint8_t *response) {
   uint32_t num;
 
+#if (DAP_RESET_DEFERRED != 0)
+  if (DAP_ResetPending && !DAP_ResetIndependent(*request)) {
+    DAP_ResetComplete();
+  }
+#endif
+
   if ((*request >= ID_DAP_Vendor0) && (*request <= ID_DAP_Vendor31)) {
     return DAP_ProcessVendorCommand(request, response);
   }
@@ -0,0 +1,583 @@
+/**
+ * @file    DAP_break.c
+ * @brief   FPB/DWT breakpoint and watchpoint manager with cached state
+ *
+ * The FPB and DWT are discovered once (FP_CTRL, DWT_CTRL, DWT_DEVARCH) and
+ * every comparator is tracked twice: requested and programmed. BRK_Commit
+ * writes only the comparators whose requested value differs from the
+ * programmed one, so resume latency depends on how many breakpoints changed,
+ * not on how many exist.
+ *
+ * Breakpoints use FPB code comparators (FPBv1 remap encoding for the code
+ * region, FPBv2 for any address). Watchpoints use DWT data address
+ * comparators with the ARMv7-M (MASK + FUNCTION) or ARMv8-M (MATCH +
+ * DATAVSIZE) encoding.
+ *
+ * BRK_Reapply marks the programmed state unknown, e.g. after a reset that
+ * cleared DEMCR; the next commit then rewrites every comparator once. A
+ * reset the manager did not issue (SYSRESETREQ written through DAP_Transfer,
+ * a power cycle) is caught at commit: it clears the FPB enable or TRCENA
+ * that an earlier commit set.
+ *
+ * The state is shared by the host (vendor command) and the GDB server.
+ * BRK_Claim forgets it whenever the other side takes over.
+ */
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "swd_host.h"
+#include "debug_cm.h"
+#include "DAP_break.h"
+
+// FPB registers
+#define FP_CTRL         0xE0002000U
+#define FP_COMP0        0xE0002008U
+#define FP_CTRL_KEY     0x00000002U
+#define FP_CTRL_ENABLE  0x00000001U
+
+// DWT registers, comparator n at DWT_COMP0 + 16 * n
+#define DWT_CTRL        0xE0001000U
+#define DWT_COMP0       0xE0001020U
+#define DWT_MASK_OFS    0x04U
+#define DWT_FUNC_OFS    0x08U
+#define DWT_DEVARCH     0xE0001FBCU
+#define DWT_ARCH_V8M    0x1A02U
+#define DWT_MATCHED     0x01000000U
+#define DWT_MASK_MAX    15U
+
+// DEMCR, TRCENA enables the DWT
+#define DEMCR           0xE000EDFCU
+#define DEMCR_TRCENA    0x01000000U
+
+// Programmed value not known, always rewritten by the next commit
+#define BRK_UNKNOWN     0xFFFFFFFFU
+
+typedef struct {
+  uint32_t comp;
+  uint32_t mask;
+  uint32_t func;        // 0 = comparator disabled
+} BRK_Dwt_t;
+
+static struct {
+  uint8_t   valid;      // Units discovered
+  uint8_t   fpb_rev;    // FP_CTRL.REV, 0 = FPBv1
+  uint8_t   num_code;
+  uint8_t   num_dwt;
+  uint8_t   dwt_v8;     // ARMv8-M DWT encoding
+  uint8_t   fpb_on;     // FP_CTRL.ENABLE written since the last reapply
+  uint8_t   trc_on;     // DEMCR.TRCENA written since the last reapply
+  uint32_t  bp_want[BRK_FPB_MAX];       // Requested FP_COMP, 0 = free
+  uint32_t  bp_prog[BRK_FPB_MAX];       // Programmed FP_COMP
+  BRK_Dwt_t wp_want[BRK_DWT_MAX];
+  BRK_Dwt_t wp_prog[BRK_DWT_MAX];
+  uint8_t   wp_type[BRK_DWT_MAX];
+} BRK;
+
+static uint8_t BRK_Owner;       // BRK_OWNER_xxx, kept across BRK_Init
+
+static uint32_t get_u32(const uint8_t *buf) {
+  return ((uint32_t)buf[0] <<  0) | ((uint32_t)buf[1] <<  8) |
+         ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void put_u32(uint8_t *buf, uint32_t val) {
+  buf[0] = (uint8_t)(val >>  0);
+  buf[1] = (uint8_t)(val >>  8);
+  buf[2] = (uint8_t)(val >> 16);
+  buf[3] = (uint8_t)(val >> 24);
+}
+
+// FP_COMP value for a breakpoint address
+//   return: comparator value, 0 if the address cannot be matched
+static uint32_t BRK_FpComp(uint32_t addr) {
+  if (BRK.fpb_rev == 0U) {
+    if (addr >= 0x20000000U) {
+      return (0U);
+    }
+    return ((addr & 0x1FFFFFFCU) | ((addr & 2U) ? 0x80000000U : 0x40000000U) | 1U);
+  }
+  return ((addr & ~1U) | 1U);
+}
+
+// DWT comparator setting for a watchpoint
+//   return: 1 = ok, 0 = size/alignment not supported
+static uint32_t BRK_DwtValue(uint32_t addr, uint32_t size, uint8_t type, BRK_Dwt_t *dwt) {
+  uint32_t bits = 0U;
+
+  if ((size == 0U) || ((size & (size - 1U)) != 0U) || ((addr & (size - 1U)) != 0U) ||
+      (type < BRK_WATCH_WRITE) || (type > BRK_WATCH_ACCESS)) {
+    return (0U);
+  }
+  while ((1U << bits) < size) {
+    bits++;
+  }
+
+  dwt->comp = addr;
+  if (BRK.dwt_v8) {
+    // ACTION = debug event, MATCH = data address (RW 0100, W 0101, R 0110)
+    if (bits > 2U) {
+      return (0U);
+    }
+    dwt->mask = 0U;
+    dwt->func = (1U << 4) | (bits << 10) |
+                ((type == BRK_WATCH_WRITE) ? 0x5U : (type == BRK_WATCH_READ) ? 0x6U : 0x4U);
+  } else {
+    // FUNCTION: 0101 read, 0110 write, 0111 read/write
+    if (bits > DWT_MASK_MAX) {
+      return (0U);
+    }
+    dwt->mask = bits;
+    dwt->func = (type == BRK_WATCH_WRITE) ? 0x6U : (type == BRK_WATCH_READ) ? 0x5U : 0x7U;
+  }
+  return (1U);
+}
+
+// Discover the FPB and DWT once
+//   return: 1 = ok, 0 = SWD error
+uint8_t BRK_Init(void) {
+  uint32_t fp_ctrl, dwt_ctrl, devarch;
+
+  if (BRK.valid) {
+    return (1U);
+  }
+  if (!swd_read_word(FP_CTRL, &fp_ctrl) || !swd_read_word(DWT_CTRL, &dwt_ctrl) ||
+      !swd_read_word(DWT_DEVARCH, &devarch)) {
+    return (0U);
+  }
+
+  memset(&BRK, 0, sizeof(BRK));
+  BRK.fpb_rev  = (uint8_t)(fp_ctrl >> 28);
+  BRK.num_code = (uint8_t)(((fp_ctrl >> 8) & 0x70U) | ((fp_ctrl >> 4) & 0x0FU));
+  BRK.num_dwt  = (uint8_t)(dwt_ctrl >> 28);
+  BRK.dwt_v8   = ((devarch & 0xFFFFU) == DWT_ARCH_V8M) ? 1U : 0U;
+  if (BRK.num_code > BRK_FPB_MAX) {
+    BRK.num_code = BRK_FPB_MAX;
+  }
+  if (BRK.num_dwt > BRK_DWT_MAX) {
+    BRK.num_dwt = BRK_DWT_MAX;
+  }
+  BRK_Reapply();
+  BRK.valid = 1U;
+  return (1U);
+}
+
+// Forget the discovered units and all comparator state
+void BRK_Invalidate(void) {
+  BRK.valid = 0U;
+}
+
+// Take the comparators for the host or the GDB server. The requests of the
+// previous owner are not ours to keep, so a new owner starts from scratch.
+//   return: 1 = already owned, 0 = owner changed and all state forgotten
+uint8_t BRK_Claim(uint8_t owner) {
+  if (BRK_Owner == owner) {
+    return (1U);
+  }
+  BRK_Owner = owner;
+  BRK_Invalidate();
+  return (0U);
+}
+
+// Mark the programmed state unknown, requested state is kept
+void BRK_Reapply(void) {
+  uint32_t n;
+
+  for (n = 0U; n < BRK_FPB_MAX; n++) {
+    BRK.bp_prog[n] = BRK_UNKNOWN;
+  }
+  for (n = 0U; n < BRK_DWT_MAX; n++) {
+    BRK.wp_prog[n].comp = BRK_UNKNOWN;
+    BRK.wp_prog[n].mask = BRK_UNKNOWN;
+    BRK.wp_prog[n].func = BRK_UNKNOWN;
+  }
+  BRK.fpb_on = 0U;
+  BRK.trc_on = 0U;
+}
+
+// Check that the enables written by an earlier commit survived. A reset
+// that clears them also leaves the comparators UNKNOWN.
+//   return: 1 = ok, 0 = SWD error
+static uint8_t BRK_CheckReset(void) {
+  uint32_t val;
+
+  if (BRK.fpb_on) {
+    if (!swd_read_word(FP_CTRL, &val)) {
+      return (0U);
+    }
+    if ((val & FP_CTRL_ENABLE) == 0U) {
+      BRK_Reapply();
+      return (1U);
+    }
+  }
+  if (BRK.trc_on) {
+    if (!swd_read_word(DEMCR, &val)) {
+      return (0U);
+    }
+    if ((val & DEMCR_TRCENA) == 0U) {
+      BRK_Reapply();
+    }
+  }
+  return (1U);
+}
+
+// Write the comparators whose requested value differs from the programmed one
+//   writes: number of register writes issued (may be NULL)
+//   return: 1 = ok, 0 = SWD error
+uint8_t BRK_Commit(uint32_t *writes) {
+  uint32_t n, cnt = 0U, demcr;
+  uint32_t base;
+  BRK_Dwt_t *want, *prog;
+  uint8_t  ok = 0U;
+
+  if (!BRK.valid || !BRK_CheckReset()) {
+    goto done;
+  }
+
+  for (n = 0U; n < BRK.num_code; n++) {
+    if (BRK.bp_want[n] != BRK.bp_prog[n]) {
+      if (!swd_write_word(FP_COMP0 + 4U * n, BRK.bp_want[n])) {
+        goto done;
+      }
+      BRK.bp_prog[n] = BRK.bp_want[n];
+      cnt++;
+    }
+    if ((BRK.bp_want[n] != 0U) && !BRK.fpb_on) {
+      if (!swd_write_word(FP_CTRL, FP_CTRL_KEY | FP_CTRL_ENABLE)) {
+        goto done;
+      }
+      BRK.fpb_on = 1U;
+      cnt++;
+    }
+  }
+
+  for (n = 0U; n < BRK.num_dwt; n++) {
+    want = &BRK.wp_want[n];
+    prog = &BRK.wp_prog[n];
+    if ((want->func != 0U) && !BRK.trc_on) {
+      if (!swd_read_word(DEMCR, &demcr) || !swd_write_word(DEMCR, demcr | DEMCR_TRCENA)) {
+        goto done;
+      }
+      BRK.trc_on = 1U;
+      cnt++;
+    }
+    if (memcmp(want, prog, sizeof(BRK_Dwt_t)) == 0) {
+      continue;
+    }
+    base = DWT_COMP0 + 16U * n;
+    // Disable before changing address or mask
+    if (prog->func != 0U) {
+      if (!swd_write_word(base + DWT_FUNC_OFS, 0U)) {
+        goto done;
+      }
+      cnt++;
+    }
+    if (want->func != 0U) {
+      if (!swd_write_word(base, want->comp) ||
+          (!BRK.dwt_v8 && !swd_write_word(base + DWT_MASK_OFS, want->mask)) ||
+          !swd_write_word(base + DWT_FUNC_OFS, want->func)) {
+        prog->func = BRK_UNKNOWN;
+        goto done;
+      }
+      cnt += BRK.dwt_v8 ? 2U : 3U;
+    }
+    *prog = *want;
+  }
+  ok = 1U;
+
+done:
+  if (writes != NULL) {
+    *writes = cnt;
+  }
+  return (ok);
+}
+
+// Remove every breakpoint and watchpoint and disable the FPB
+//   return: 1 = ok, 0 = SWD error
+uint8_t BRK_ClearAll(void) {
+  if (!BRK.valid) {
+    return (1U);
+  }
+  memset(BRK.bp_want, 0, sizeof(BRK.bp_want));
+  memset(BRK.wp_want, 0, sizeof(BRK.wp_want));
+  if (!BRK_Commit(NULL)) {
+    return (0U);
+  }
+  if (BRK.fpb_on) {
+    if (!swd_write_word(FP_CTRL, FP_CTRL_KEY)) {
+      return (0U);
+    }
+    BRK.fpb_on = 0U;
+  }
+  return (1U);
+}
+
+// Request a breakpoint, written by the next commit
+//   return: 1 = ok, 0 = address not supported or no free comparator
+uint8_t BRK_SetBreakpoint(uint32_t addr) {
+  uint32_t comp = BRK_FpComp(addr);
+  uint32_t n, slot = BRK_FPB_MAX;
+
+  if (!BRK.valid || (comp == 0U)) {
+    return (0U);
+  }
+  for (n = 0U; n < BRK.num_code; n++) {
+    if (BRK.bp_want[n] == comp) {
+      return (1U);
+    }
+  }
+  // Prefer a comparator that still holds this address, then an idle one
+  for (n = 0U; n < BRK.num_code; n++) {
+    if (BRK.bp_want[n] != 0U) {
+      continue;
+    }
+    if (BRK.bp_prog[n] == comp) {
+      slot = n;
+      break;
+    }
+    if ((slot == BRK_FPB_MAX) || ((BRK.bp_prog[n] == 0U) && (BRK.bp_prog[slot] != 0U))) {
+      slot = n;
+    }
+  }
+  if (slot == BRK_FPB_MAX) {
+    return (0U);
+  }
+  BRK.bp_want[slot] = comp;
+  return (1U);
+}
+
+// Drop a breakpoint request, the comparator is cleared by the next commit
+uint8_t BRK_ClearBreakpoint(uint32_t addr) {
+  uint32_t comp = BRK_FpComp(addr);
+  uint32_t n;
+
+  for (n = 0U; n < BRK.num_code; n++) {
+    if ((comp != 0U) && (BRK.bp_want[n] == comp)) {
+      BRK.bp_want[n] = 0U;
+    }
+  }
+  return (1U);
+}
+
+// Check if a breakpoint is requested at an address
+uint8_t BRK_IsBreakpoint(uint32_t addr) {
+  uint32_t comp = BRK_FpComp(addr);
+  uint32_t n;
+
+  for (n = 0U; n < BRK.num_code; n++) {
+    if ((comp != 0U) && (BRK.bp_want[n] == comp)) {
+      return (1U);
+    }
+  }
+  return (0U);
+}
+
+// Request a watchpoint, written by the next commit
+//   size:   power of two, address aligned to it
+//   type:   BRK_WATCH_xxx
+//   return: 1 = ok, 0 = not supported or no free comparator
+uint8_t BRK_SetWatchpoint(uint32_t addr, uint32_t size, uint8_t type) {
+  BRK_Dwt_t dwt;
+  uint32_t n, slot = BRK_DWT_MAX;
+
+  if (!BRK.valid || !BRK_DwtValue(addr, size, type, &dwt)) {
+    return (0U);
+  }
+  for (n = 0U; n < BRK.num_dwt; n++) {
+    if (memcmp(&BRK.wp_want[n], &dwt, sizeof(dwt)) == 0) {
+      return (1U);
+    }
+  }
+  for (n = 0U; n < BRK.num_dwt; n++) {
+    if (BRK.wp_want[n].func != 0U) {
+      continue;
+    }
+    if (memcmp(&BRK.wp_prog[n], &dwt, sizeof(dwt)) == 0) {
+      slot = n;
+      break;
+    }
+    if (slot == BRK_DWT_MAX) {
+      slot = n;
+    }
+  }
+  if (slot == BRK_DWT_MAX) {
+    return (0U);
+  }
+  BRK.wp_want[slot] = dwt;
+  BRK.wp_type[slot] = type;
+  return (1U);
+}
+
+// Drop a watchpoint request, the comparator is disabled by the next commit
+uint8_t BRK_ClearWatchpoint(uint32_t addr, uint32_t size, uint8_t type) {
+  BRK_Dwt_t dwt;
+  uint32_t n;
+
+  if (!BRK.valid || !BRK_DwtValue(addr, size, type, &dwt)) {
+    return (1U);
+  }
+  for (n = 0U; n < BRK.num_dwt; n++) {
+    if (memcmp(&BRK.wp_want[n], &dwt, sizeof(dwt)) == 0) {
+      memset(&BRK.wp_want[n], 0, sizeof(BRK_Dwt_t));
+    }
+  }
+  return (1U);
+}
+
+// Find the watchpoint that matched, reading FUNCTION clears MATCHED
+//   hit:    1 = a comparator matched
+//   addr:   watched address
+//   type:   BRK_WATCH_xxx
+//   return: 1 = ok, 0 = SWD error
+uint8_t BRK_WatchHit(uint8_t *hit, uint32_t *addr, uint8_t *type) {
+  uint32_t n, func;
+
+  *hit = 0U;
+  if (!BRK.valid) {
+    return (1U);
+  }
+  for (n = 0U; n < BRK.num_dwt; n++) {
+    if ((BRK.wp_prog[n].func == 0U) || (BRK.wp_prog[n].func == BRK_UNKNOWN)) {
+      continue;
+    }
+    if (!swd_read_word(DWT_COMP0 + 16U * n + DWT_FUNC_OFS, &func)) {
+      return (0U);
+    }
+    if (func & DWT_MATCHED) {
+      *hit  = 1U;
+      *addr = BRK.wp_prog[n].comp;
+      *type = BRK.wp_type[n];
+      return (1U);
+    }
+  }
+  return (1U);
+}
+
+// Prepare target access for a host vendor command. The host owns the SWD
+// port and caches SELECT and the AP CSW/TAR itself: swd_host_save keeps
+// what this command is about to change, BRK_HostDone puts it back.
+//   return: 1 = ready, 0 = port not SWD, SWD error or units not found
+static uint8_t BRK_HostReady(void) {
+  if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    return (0U);
+  }
+  BRK_Claim(BRK_OWNER_HOST);
+  swd_host_save();
+  if (!swd_host_save_ap(0U)) {
+    return (0U);
+  }
+  return (BRK_Init());
+}
+
+// Restore the host's SELECT and AP0 CSW/TAR after a vendor command
+//   return: 1 = ok, 0 = SWD error
+static uint8_t BRK_HostDone(void) {
+  return (swd_host_restore());
+}
+
+// Build a bitmap of requested comparators
+static uint8_t BRK_BpMap(void) {
+  uint32_t n;
+  uint8_t  map = 0U;
+
+  for (n = 0U; n < BRK.num_code; n++) {
+    if (BRK.bp_want[n] != 0U) {
+      map |= (uint8_t)(1U << n);
+    }
+  }
+  return (map);
+}
+
+static uint8_t BRK_WpMap(void) {
+  uint32_t n;
+  uint8_t  map = 0U;
+
+  for (n = 0U; n < BRK.num_dwt; n++) {
+    if (BRK.wp_want[n].func != 0U) {
+      map |= (uint8_t)(1U << n);
+    }
+  }
+  return (map);
+}
+
+// Process breakpoint manager vendor command and prepare response
+//   request:  pointer to request data (sub-command first)
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_BRK_Command(const uint8_t *request, uint8_t *response) {
+  uint32_t req_len, resp_len = 1U;
+  uint32_t addr, writes;
+  uint8_t  ok = 0U, type, hit;
+
+  switch (*request) {
+    case DAP_BRK_CMD_SET_BP:
+    case DAP_BRK_CMD_CLEAR_BP:
+      req_len = 5U;
+      break;
+    case DAP_BRK_CMD_SET_WP:
+    case DAP_BRK_CMD_CLEAR_WP:
+      req_len = 7U;
+      break;
+    default:
+      req_len = 1U;
+      break;
+  }
+
+  if (*request == DAP_BRK_CMD_INVALIDATE) {
+    BRK_Invalidate();
+    *response = DAP_OK;
+    return ((req_len << 16) | 1U);
+  }
+
+  if (BRK_HostReady()) {
+    switch (*request) {
+      case DAP_BRK_CMD_INFO:
+        response[1] = BRK.fpb_rev;
+        response[2] = BRK.num_code;
+        response[3] = BRK.num_dwt;
+        response[4] = BRK_BpMap();
+        response[5] = BRK_WpMap();
+        resp_len = 6U;
+        ok = 1U;
+        break;
+      case DAP_BRK_CMD_SET_BP:
+        ok = BRK_SetBreakpoint(get_u32(request + 1));
+        break;
+      case DAP_BRK_CMD_CLEAR_BP:
+        ok = BRK_ClearBreakpoint(get_u32(request + 1));
+        break;
+      case DAP_BRK_CMD_SET_WP:
+        ok = BRK_SetWatchpoint(get_u32(request + 1), *(request + 5), *(request + 6));
+        break;
+      case DAP_BRK_CMD_CLEAR_WP:
+        ok = BRK_ClearWatchpoint(get_u32(request + 1), *(request + 5), *(request + 6));
+        break;
+      case DAP_BRK_CMD_COMMIT:
+        ok = BRK_Commit(&writes);
+        response[1] = (uint8_t)writes;
+        resp_len = 2U;
+        break;
+      case DAP_BRK_CMD_CLEAR_ALL:
+        ok = BRK_ClearAll();
+        break;
+      case DAP_BRK_CMD_HIT:
+        addr = 0U;
+        type = 0U;
+        ok = BRK_WatchHit(&hit, &addr, &type);
+        response[1] = hit;
+        put_u32(response + 2, addr);
+        response[6] = type;
+        resp_len = 7U;
+        break;
+      default:
+        break;
+    }
+  }
+  if (!BRK_HostDone()) {
+    ok = 0U;
+  }
+
+  *response = ok ? DAP_OK : DAP_ERROR;
+  return ((req_len << 16) | resp_len);
+}
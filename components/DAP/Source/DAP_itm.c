@@ -0,0 +1,248 @@
+/**
+ * @file    DAP_itm.c
+ * @brief   ITM/DWT packet filter between SWO capture and TraceBuf
+ *
+ * Most trace overruns are caused by stimulus ports the host is not
+ * looking at. With the filter enabled, the SWO capture paths feed every
+ * received byte through ITM_FilterByte before it reaches TraceBuf. The
+ * parser reassembles the ARMv7-M ITM protocol packets:
+ *
+ *  - synchronization (at least 47 zero bits then a 1), forwarded as one
+ *    canonical sync packet,
+ *  - overflow, extension and reserved headers, forwarded unchanged,
+ *  - software (ITM) and hardware (DWT) source packets, kept or dropped
+ *    per stimulus port / discriminator mask,
+ *  - local timestamps, either forwarded or accumulated into an absolute
+ *    time that is sent as GTS1 (and GTS2 when the high bits change),
+ *  - global timestamps, forwarded unchanged.
+ *
+ * The stream is assumed to start on a packet boundary (capture is started
+ * before the target enables the ITM); a sync packet re-aligns the parser.
+ */
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_itm.h"
+
+#define ITM_PKT_MAX     7U      // Header and up to 6 payload bytes
+
+// Packet classes
+#define ITM_PKT_PASS    0U
+#define ITM_PKT_SW      1U
+#define ITM_PKT_HW      2U
+#define ITM_PKT_LTS     3U
+#define ITM_PKT_SYNC    4U
+
+// Host configuration
+static volatile uint8_t  ITM_Flags;
+static volatile uint32_t ITM_SwMask = 0xFFFFFFFFU;
+static volatile uint32_t ITM_HwMask = 0xFFFFFFFFU;
+
+// Statistics
+static volatile uint32_t ITM_Kept;
+static volatile uint32_t ITM_Dropped;
+
+// Parser state
+static struct {
+  uint8_t  pkt[ITM_PKT_MAX];
+  uint8_t  len;         // Bytes collected, 0 = waiting for a header
+  uint8_t  need;        // Total length, 0 = ends on a byte without continuation
+  uint8_t  type;
+  uint8_t  zeros;       // Zero bytes of a sync packet
+  uint64_t time;        // Accumulated local timestamp
+  uint32_t time_hi;     // High bits last sent in GTS2
+} ITM_State;
+
+
+static uint32_t get_u32(const uint8_t *buf) {
+  return ((uint32_t)buf[0] <<  0) | ((uint32_t)buf[1] <<  8) |
+         ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void put_u32(uint8_t *buf, uint32_t val) {
+  buf[0] = (uint8_t)(val >>  0);
+  buf[1] = (uint8_t)(val >>  8);
+  buf[2] = (uint8_t)(val >> 16);
+  buf[3] = (uint8_t)(val >> 24);
+}
+
+// Encode the accumulated time as GTS1 (bits [25:0]) and, when the high
+// bits changed, GTS2 (bits [47:26])
+//   return: number of bytes written to out
+static uint32_t ITM_GlobalTime(uint8_t *out) {
+  uint32_t lo = (uint32_t)(ITM_State.time & 0x03FFFFFFU);
+  uint32_t hi = (uint32_t)(ITM_State.time >> 26) & 0x003FFFFFU;
+  uint32_t wrap = (hi != ITM_State.time_hi) ? 1U : 0U;
+  uint32_t n = 0U;
+
+  out[n++] = 0x94U;
+  out[n++] = (uint8_t)(0x80U | ((lo >>  0) & 0x7FU));
+  out[n++] = (uint8_t)(0x80U | ((lo >>  7) & 0x7FU));
+  out[n++] = (uint8_t)(0x80U | ((lo >> 14) & 0x7FU));
+  out[n++] = (uint8_t)(((lo >> 21) & 0x1FU) | (wrap << 6));
+
+  if (wrap) {
+    ITM_State.time_hi = hi;
+    out[n++] = 0xB4U;
+    out[n++] = (uint8_t)(0x80U | ((hi >>  0) & 0x7FU));
+    out[n++] = (uint8_t)(0x80U | ((hi >>  7) & 0x7FU));
+    // GTS2 is defined with 4 (48-bit) or 6 (64-bit) payload bytes only and
+    // decoders tell the forms apart by length: always send the 48-bit form
+    out[n++] = (uint8_t)(0x80U | ((hi >> 14) & 0x7FU));
+    out[n++] = (uint8_t)((hi >> 21) & 0x01U);     // TS[47]
+  }
+  return (n);
+}
+
+// Decide what to forward for a complete packet
+//   return: number of bytes written to out
+static uint32_t ITM_Packet(uint8_t *out) {
+  uint8_t  h = ITM_State.pkt[0];
+  uint32_t delta, n;
+
+  switch (ITM_State.type) {
+    case ITM_PKT_SW:
+      if (((ITM_SwMask >> (h >> 3)) & 1U) == 0U) {
+        ITM_Dropped++;
+        return (0U);
+      }
+      break;
+    case ITM_PKT_HW:
+      if (((ITM_HwMask >> (h >> 3)) & 1U) == 0U) {
+        ITM_Dropped++;
+        return (0U);
+      }
+      break;
+    case ITM_PKT_LTS:
+      if ((ITM_Flags & DAP_ITM_ABS_TIMESTAMP) == 0U) {
+        break;
+      }
+      if ((h & 0x80U) == 0U) {
+        delta = (h >> 4) & 0x07U;           // Format 2, value in the header
+      } else {
+        delta = 0U;                         // Format 1, 7 bits per payload byte
+        for (n = 1U; n < ITM_State.len; n++) {
+          delta |= (uint32_t)(ITM_State.pkt[n] & 0x7FU) << (7U * (n - 1U));
+        }
+      }
+      ITM_State.time += delta;
+      ITM_Kept++;
+      return (ITM_GlobalTime(out));
+    default:
+      break;
+  }
+
+  ITM_Kept++;
+  memcpy(out, ITM_State.pkt, ITM_State.len);
+  return (ITM_State.len);
+}
+
+// Reset the parser to a packet boundary, configuration is kept
+void ITM_FilterReset(void) {
+  memset(&ITM_State, 0, sizeof(ITM_State));
+}
+
+// Check if the capture paths have to feed the filter
+uint32_t ITM_FilterEnabled(void) {
+  return ((ITM_Flags & DAP_ITM_FILTER) ? 1U : 0U);
+}
+
+// Feed one trace byte through the filter
+//   data:   received byte
+//   out:    buffer for at least ITM_FILTER_MAX_OUT bytes
+//   return: number of bytes to store in TraceBuf
+uint32_t ITM_FilterByte(uint8_t data, uint8_t *out) {
+  uint32_t n;
+
+  if (ITM_State.len == 0U) {
+    // Synchronization: zero bytes, then a byte with only bit 7 set
+    if (data == 0x00U) {
+      if (ITM_State.zeros < 0xFFU) {
+        ITM_State.zeros++;
+      }
+      return (0U);
+    }
+    if (ITM_State.zeros != 0U) {
+      n = ITM_State.zeros;
+      ITM_State.zeros = 0U;
+      if ((data == 0x80U) && (n >= 5U)) {
+        memset(out, 0, 5U);
+        out[5] = 0x80U;
+        ITM_Kept++;
+        return (6U);
+      }
+      // Stray zeros are idle fill; treat this byte as a header
+    }
+
+    ITM_State.pkt[0] = data;
+    ITM_State.len  = 1U;
+    ITM_State.need = 1U;
+    ITM_State.type = ITM_PKT_PASS;
+
+    if ((data & 0x03U) != 0U) {
+      // Source packet, 1/2/4 payload bytes
+      ITM_State.type = (data & 0x04U) ? ITM_PKT_HW : ITM_PKT_SW;
+      ITM_State.need = (uint8_t)(1U + (((data & 0x03U) == 3U) ? 4U : (data & 0x03U)));
+    } else if ((data & 0x0FU) == 0x00U) {
+      if (data == 0x70U) {
+        // Overflow
+      } else if ((data & 0x80U) == 0U) {
+        ITM_State.type = ITM_PKT_LTS;       // Local timestamp format 2
+      } else if ((data & 0x40U) != 0U) {
+        ITM_State.type = ITM_PKT_LTS;       // Local timestamp format 1
+        ITM_State.need = 0U;
+      }
+    } else if (((data & 0x0BU) == 0x08U) || ((data & 0xDFU) == 0x94U)) {
+      // Extension or global timestamp, continuation bit in the header
+      if (data & 0x80U) {
+        ITM_State.need = 0U;
+      }
+    }
+  } else {
+    ITM_State.pkt[ITM_State.len++] = data;
+  }
+
+  if (ITM_State.need != 0U) {
+    if (ITM_State.len < ITM_State.need) {
+      return (0U);
+    }
+  } else if ((ITM_State.len == 1U) || ((data & 0x80U) && (ITM_State.len < ITM_PKT_MAX))) {
+    return (0U);
+  }
+
+  n = ITM_Packet(out);
+  ITM_State.len = 0U;
+  return (n);
+}
+
+// Process ITM filter vendor command and prepare response
+//   request:  pointer to request data (sub-command first)
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_ITM_Command(const uint8_t *request, uint8_t *response) {
+
+  switch (*request) {
+    case DAP_ITM_CMD_CONFIG:
+      ITM_SwMask = get_u32(request + 2);
+      ITM_HwMask = get_u32(request + 6);
+      ITM_Flags  = *(request + 1);
+      *response = DAP_OK;
+      return ((10U << 16) | 1U);
+
+    case DAP_ITM_CMD_STATS:
+      *response = DAP_OK;
+      put_u32(response + 1, ITM_Kept);
+      put_u32(response + 5, ITM_Dropped);
+      ITM_Kept    = 0U;
+      ITM_Dropped = 0U;
+      return ((1U << 16) | 9U);
+
+    default:
+      break;
+  }
+
+  *response = DAP_ERROR;
+  return ((1U << 16) | 1U);
+}
@@ -0,0 +1,282 @@
+/**
+ * @file    DAP_jtagscan.c
+ * @brief   On-probe JTAG scan chain discovery
+ *
+ * Hosts otherwise have to know the chain layout up front for
+ * DAP_JTAG_Configure, or work it out with dozens of DAP_JTAG_Sequence
+ * round trips. Here the probe resets the TAPs and:
+ *
+ *  - walks the DR chain after reset, where each TAP selects IDCODE (LSB 1,
+ *    32 bits) or BYPASS (a single 0),
+ *  - shifts zeros then ones through IR: the first ir_total bits out are the
+ *    captured IR values, the position of the first 1 gives ir_total, and
+ *    every TAP is left in BYPASS,
+ *  - shifts zeros then ones through the BYPASS DR chain to count TAPs.
+ *
+ * IEEE 1149.1 only fixes the two low bits of the captured IR (01), so the
+ * per-device IR lengths are split at "1 then 0" boundaries. They are only
+ * applied to jtag_dev when the number of boundaries matches the device
+ * count; otherwise the host must still send DAP_JTAG_Configure.
+ */
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_jtagscan.h"
+
+#if (DAP_JTAG != 0)
+
+#define JTAG_SCAN_BITS   (DAP_JTAG_DEV_CNT * 32U)   // Flush length, longest chain we describe
+#define JTAG_SCAN_BYTES  ((2U * JTAG_SCAN_BITS + 32U + 7U) / 8U)
+
+static uint8_t  JTAG_ScanTDI[JTAG_SCAN_BYTES];
+static uint8_t  JTAG_ScanTDO[JTAG_SCAN_BYTES];
+static uint32_t JTAG_ScanID[DAP_JTAG_DEV_CNT];
+static uint8_t  JTAG_ScanIR[DAP_JTAG_DEV_CNT];
+
+
+static uint32_t get_bit(const uint8_t *buf, uint32_t n) {
+  return (buf[n >> 3] >> (n & 7U)) & 1U;
+}
+
+// Clock TMS bits (LSB first) with TDI high
+static void JTAG_ScanTMS(uint32_t tms, uint32_t count) {
+  uint8_t tdi = 0xFFU;
+
+  while (count--) {
+    JTAG_Sequence(1U | ((tms & 1U) ? JTAG_SEQUENCE_TMS : 0U), &tdi, NULL);
+    tms >>= 1;
+  }
+}
+
+// Shift count bits in Shift-DR/IR; the last bit moves the TAP to Exit1
+static void JTAG_ScanShift(const uint8_t *tdi, uint8_t *tdo, uint32_t count) {
+  uint32_t n;
+  uint8_t  last_tdi, last_tdo;
+
+  // Body in 64 bit sequences (a sequence of 0 means 64), whole bytes each
+  for (n = 0U; (n + 64U) < count; n += 64U) {
+    JTAG_Sequence(JTAG_SEQUENCE_TDO, tdi + (n / 8U), tdo + (n / 8U));
+  }
+  for (; (n + 8U) < count; n += 8U) {
+    JTAG_Sequence(8U | JTAG_SEQUENCE_TDO, tdi + (n / 8U), tdo + (n / 8U));
+  }
+  if ((count - n) > 1U) {
+    JTAG_Sequence((count - n - 1U) | JTAG_SEQUENCE_TDO, tdi + (n / 8U), tdo + (n / 8U));
+  }
+
+  // Last bit with TMS high
+  n = count - 1U;
+  last_tdi = (uint8_t)get_bit(tdi, n);
+  JTAG_Sequence(1U | JTAG_SEQUENCE_TMS | JTAG_SEQUENCE_TDO, &last_tdi, &last_tdo);
+  tdo[n >> 3] = (uint8_t)((tdo[n >> 3] & ~(1U << (n & 7U))) | ((last_tdo & 1U) << (n & 7U)));
+}
+
+// Fill TDI with count zeros followed by count ones
+static void JTAG_ScanPattern(uint32_t count) {
+  memset(JTAG_ScanTDI, 0x00U, count / 8U);
+  memset(JTAG_ScanTDI + (count / 8U), 0xFFU, sizeof(JTAG_ScanTDI) - (count / 8U));
+  memset(JTAG_ScanTDO, 0x00U, sizeof(JTAG_ScanTDO));
+}
+
+// Position of the first 1 in the second half of a zeros-then-ones shift
+static uint32_t JTAG_ScanLength(uint32_t count) {
+  uint32_t n;
+
+  for (n = 0U; n < count; n++) {
+    if (get_bit(JTAG_ScanTDO, count + n)) {
+      break;
+    }
+  }
+  return (n);
+}
+
+
+// Walk the reset DR chain: IDCODE (32 bits, LSB 1) or BYPASS (one 0)
+//   return: number of TAPs seen, at most DAP_JTAG_DEV_CNT + 1
+static uint32_t JTAG_ScanIDCodes(void) {
+  uint32_t bits, pos, devs, id, n;
+
+  bits = JTAG_SCAN_BITS + 32U;
+  memset(JTAG_ScanTDI, 0xFFU, sizeof(JTAG_ScanTDI));
+  memset(JTAG_ScanTDO, 0x00U, sizeof(JTAG_ScanTDO));
+
+  JTAG_ScanTMS(0x1U, 3U);                   // Select-DR, Capture-DR, Shift-DR
+  JTAG_ScanShift(JTAG_ScanTDI, JTAG_ScanTDO, bits);
+  JTAG_ScanTMS(0x1U, 2U);                   // Update-DR, Idle
+
+  pos  = 0U;
+  devs = 0U;
+  while ((pos < bits) && (devs <= DAP_JTAG_DEV_CNT)) {
+    if (get_bit(JTAG_ScanTDO, pos) == 0U) {
+      id = 0U;                              // BYPASS
+      pos += 1U;
+    } else {
+      if ((pos + 32U) > bits) {
+        break;
+      }
+      id = 0U;
+      for (n = 0U; n < 32U; n++) {
+        id |= get_bit(JTAG_ScanTDO, pos + n) << n;
+      }
+      if (id == 0xFFFFFFFFU) {
+        break;                              // Our own ones, end of chain
+      }
+      pos += 32U;
+    }
+    if (devs < DAP_JTAG_DEV_CNT) {
+      JTAG_ScanID[devs] = id;
+    }
+    devs++;
+  }
+
+  return (devs);
+}
+
+// Capture IR, measure its total length and load BYPASS everywhere
+//   return: total IR length, JTAG_SCAN_BITS when the chain is longer
+static uint32_t JTAG_ScanIRChain(void) {
+  uint32_t total;
+
+  JTAG_ScanPattern(JTAG_SCAN_BITS);
+  JTAG_ScanTMS(0x3U, 4U);                   // Select-DR, Select-IR, Capture-IR, Shift-IR
+  JTAG_ScanShift(JTAG_ScanTDI, JTAG_ScanTDO, 2U * JTAG_SCAN_BITS);
+  JTAG_ScanTMS(0x1U, 2U);                   // Update-IR, Idle
+
+  total = JTAG_ScanLength(JTAG_SCAN_BITS);
+  return (total);
+}
+
+// Count TAPs in BYPASS
+static uint32_t JTAG_ScanBypass(void) {
+  JTAG_ScanPattern(JTAG_SCAN_BITS);
+  JTAG_ScanTMS(0x1U, 3U);                   // Select-DR, Capture-DR, Shift-DR
+  JTAG_ScanShift(JTAG_ScanTDI, JTAG_ScanTDO, 2U * JTAG_SCAN_BITS);
+  JTAG_ScanTMS(0x1U, 2U);                   // Update-DR, Idle
+
+  return (JTAG_ScanLength(JTAG_SCAN_BITS));
+}
+
+// Split the captured IR (still in the first half of JTAG_ScanTDO) at
+// "1 then 0" boundaries
+//   return: 1 when the split yields exactly count devices
+static uint32_t JTAG_ScanSplitIR(const uint8_t *captured, uint32_t total, uint32_t count) {
+  uint32_t start[DAP_JTAG_DEV_CNT];
+  uint32_t found, n;
+
+  if ((count == 0U) || (total < (2U * count))) {
+    return (0U);
+  }
+  if (count == 1U) {
+    JTAG_ScanIR[0] = (uint8_t)total;
+    return ((total <= 255U) ? 1U : 0U);
+  }
+
+  found = 0U;
+  for (n = 0U; (n + 1U) < total; n++) {
+    if (get_bit(captured, n) && !get_bit(captured, n + 1U)) {
+      if (found == count) {
+        return (0U);
+      }
+      start[found++] = n;
+    }
+  }
+  if ((found != count) || (start[0] != 0U)) {
+    return (0U);
+  }
+
+  for (n = 0U; n < count; n++) {
+    JTAG_ScanIR[n] = (uint8_t)((((n + 1U) < count) ? start[n + 1U] : total) - start[n]);
+  }
+  return (1U);
+}
+
+
+// Process JTAG scan chain vendor command and prepare response
+//   request:  pointer to request data
+//     SCAN:   sub-command
+//   response: pointer to response data, see DAP_jtagscan.h
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_JTAG_ScanCommand(const uint8_t *request, uint8_t *response) {
+  uint8_t  captured[(JTAG_SCAN_BITS + 7U) / 8U];
+  uint32_t ids, total, count, bits, n;
+  uint8_t  flags;
+
+  if ((*request != DAP_JTAG_SCAN_CMD_SCAN) || (DAP_Data.debug_port != DAP_PORT_JTAG)) {
+    *response = DAP_ERROR;
+    return ((1U << 16) | 1U);
+  }
+
+  memset(JTAG_ScanID, 0, sizeof(JTAG_ScanID));
+  memset(JTAG_ScanIR, 0, sizeof(JTAG_ScanIR));
+
+  JTAG_ScanTMS(0x3FU, 6U);                  // Test-Logic-Reset
+  JTAG_ScanTMS(0x0U, 1U);                   // Idle
+
+  ids   = JTAG_ScanIDCodes();
+  total = JTAG_ScanIRChain();
+  memcpy(captured, JTAG_ScanTDO, sizeof(captured));
+  count = JTAG_ScanBypass();
+
+  if ((count == 0U) || (count > DAP_JTAG_DEV_CNT) || (total >= JTAG_SCAN_BITS)) {
+    // Nothing attached (TDO stuck) or a chain longer than we can describe
+    *(response+0) = DAP_ERROR;
+    *(response+1) = 0U;
+    *(response+2) = (uint8_t)((count > 255U) ? 255U : count);
+    *(response+3) = (uint8_t) total;
+    *(response+4) = (uint8_t)(total >> 8);
+    return ((1U << 16) | 5U);
+  }
+
+  flags = 0U;
+  if (ids != count) {
+    flags |= DAP_JTAG_SCAN_ID_MISMATCH;
+  }
+
+  if (JTAG_ScanSplitIR(captured, total, count)) {
+    flags |= DAP_JTAG_SCAN_IR_OK;
+
+    // Same layout as DAP_JTAG_Configure
+    DAP_Data.jtag_dev.count = (uint8_t)count;
+    DAP_Data.jtag_dev.index = 0U;
+    bits = 0U;
+    for (n = 0U; n < count; n++) {
+      DAP_Data.jtag_dev.ir_length[n] = JTAG_ScanIR[n];
+      DAP_Data.jtag_dev.ir_before[n] = (uint16_t)bits;
+      bits += JTAG_ScanIR[n];
+    }
+    for (n = 0U; n < count; n++) {
+      bits -= DAP_Data.jtag_dev.ir_length[n];
+      DAP_Data.jtag_dev.ir_after[n] = (uint16_t)bits;
+    }
+  } else {
+    memset(JTAG_ScanIR, 0, sizeof(JTAG_ScanIR));
+  }
+
+  *(response+0) = DAP_OK;
+  *(response+1) = flags;
+  *(response+2) = (uint8_t)count;
+  *(response+3) = (uint8_t) total;
+  *(response+4) = (uint8_t)(total >> 8);
+  response += 5;
+  for (n = 0U; n < count; n++) {
+    *response++ = JTAG_ScanIR[n];
+    *response++ = (uint8_t)(JTAG_ScanID[n] >>  0);
+    *response++ = (uint8_t)(JTAG_ScanID[n] >>  8);
+    *response++ = (uint8_t)(JTAG_ScanID[n] >> 16);
+    *response++ = (uint8_t)(JTAG_ScanID[n] >> 24);
+  }
+
+  return ((1U << 16) | (5U + (count * 5U)));
+}
+
+#else
+
+uint32_t DAP_JTAG_ScanCommand(const uint8_t *request, uint8_t *response) {
+  (void)request;
+  *response = DAP_ERROR;
+  return ((1U << 16) | 1U);
+}
+
+#endif
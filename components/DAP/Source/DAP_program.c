@@ -0,0 +1,327 @@
+/**
+ * @file    DAP_program.c
+ * @brief   On-probe micro-program interpreter for looped SWD transfer sequences
+ *
+ * Polling loops, block reads and unlock/erase sequences otherwise cost one
+ * USB round trip per DAP_Transfer. The host uploads a small program once and
+ * runs it here against SWD_Transfer, then collects the result buffer.
+ */
+
+#include <string.h>
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_program.h"
+#include "DAP_retry.h"
+
+static uint8_t  DAP_ProgramBuf[DAP_PROGRAM_SIZE];
+static uint8_t  DAP_ProgramResult[DAP_PROGRAM_RESULT_SIZE];
+static uint32_t DAP_ProgramResultCount;
+
+
+// Get little endian value from program/request stream
+static uint32_t get_u32(const uint8_t *p) {
+  return ((uint32_t)(*(p+0) <<  0) |
+          (uint32_t)(*(p+1) <<  8) |
+          (uint32_t)(*(p+2) << 16) |
+          (uint32_t)(*(p+3) << 24));
+}
+
+static uint32_t get_u16(const uint8_t *p) {
+  return ((uint32_t)(*(p+0) << 0) |
+          (uint32_t)(*(p+1) << 8));
+}
+
+
+// Execute one DP/AP register access through the WAIT retry engine
+//   request: transfer request (APnDP, RnW, A2, A3)
+//   data:    pointer to data (read or write)
+//   return:  ACK value
+static uint8_t DAP_ProgramTransfer(uint32_t request, uint32_t *data) {
+  uint8_t  ack;
+
+  request &= (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+
+  ack = SWD_TransferRetry(request, data);
+
+  if ((ack != DAP_TRANSFER_OK) ||
+      ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW)) != (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW))) {
+    return (ack);
+  }
+
+  // AP reads are posted, collect the value from RDBUFF
+  return (SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, data));
+}
+
+
+// Run program from the start of the program buffer
+//   arg:    initial value of r0
+//   pc_out: pointer to PC at termination
+//   ack:    pointer to last transfer ACK
+//   return: run status (DAP_PROG_OK or DAP_PROG_ERR_xxx)
+static uint8_t DAP_ProgramRun(uint32_t arg, uint32_t *pc_out, uint8_t *ack) {
+  uint32_t reg[DAP_PROGRAM_REGS];
+  uint32_t pc, steps, len;
+  uint32_t mask, value, target;
+  int64_t  start;
+  const uint8_t *ins;
+  uint8_t  status;
+
+  memset(reg, 0, sizeof(reg));
+  reg[0] = arg;
+  pc     = 0U;
+  steps  = 0U;
+  *ack   = DAP_TRANSFER_OK;
+  DAP_ProgramResultCount = 0U;
+
+  DAP_TransferAbort = 0U;
+
+  if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    *pc_out = pc;
+    return (DAP_PROG_ERR_PORT);
+  }
+
+  status = DAP_PROG_OK;
+  start  = esp_timer_get_time();
+
+  while (1) {
+    if (pc >= DAP_PROGRAM_SIZE) {
+      status = DAP_PROG_ERR_BOUNDS;
+      break;
+    }
+    if (++steps > DAP_PROGRAM_MAX_STEPS) {
+      status = DAP_PROG_ERR_STEPS;
+      break;
+    }
+    if (DAP_TransferAbort) {
+      status = DAP_PROG_ERR_ABORT;
+      break;
+    }
+    // The DAP lock is held for the whole run
+    if ((esp_timer_get_time() - start) >= DAP_PROGRAM_TIME_US) {
+      status = DAP_PROG_ERR_TIME;
+      break;
+    }
+
+    ins = &DAP_ProgramBuf[pc];
+
+    // Instruction length including opcode
+    switch (ins[0]) {
+      case DAP_PROG_END:         len = 1U;  break;
+      case DAP_PROG_XFER_READ:
+      case DAP_PROG_XFER_WRITE:
+      case DAP_PROG_MOV:         len = 3U;  break;
+      case DAP_PROG_XFER_WRITEI:
+      case DAP_PROG_LOADI:
+      case DAP_PROG_ANDI:
+      case DAP_PROG_ORI:
+      case DAP_PROG_ADDI:        len = 6U;  break;
+      case DAP_PROG_JMP:
+      case DAP_PROG_DELAY:       len = 3U;  break;
+      case DAP_PROG_BEQ:
+      case DAP_PROG_BNE:         len = 12U; break;
+      case DAP_PROG_DJNZ:        len = 4U;  break;
+      case DAP_PROG_APPEND:
+      case DAP_PROG_FAIL:        len = 2U;  break;
+      default:                   len = 0U;  break;
+    }
+    if (len == 0U) {
+      status = DAP_PROG_ERR_OPCODE;
+      break;
+    }
+    if ((pc + len) > DAP_PROGRAM_SIZE) {
+      status = DAP_PROG_ERR_BOUNDS;
+      break;
+    }
+
+    // Register operands
+    switch (ins[0]) {
+      case DAP_PROG_XFER_READ:
+      case DAP_PROG_XFER_WRITE:
+        if (ins[2] >= DAP_PROGRAM_REGS) {
+          status = DAP_PROG_ERR_OPCODE;
+        }
+        break;
+      case DAP_PROG_MOV:
+        if ((ins[1] >= DAP_PROGRAM_REGS) || (ins[2] >= DAP_PROGRAM_REGS)) {
+          status = DAP_PROG_ERR_OPCODE;
+        }
+        break;
+      case DAP_PROG_LOADI:
+      case DAP_PROG_ANDI:
+      case DAP_PROG_ORI:
+      case DAP_PROG_ADDI:
+      case DAP_PROG_BEQ:
+      case DAP_PROG_BNE:
+      case DAP_PROG_DJNZ:
+      case DAP_PROG_APPEND:
+        if (ins[1] >= DAP_PROGRAM_REGS) {
+          status = DAP_PROG_ERR_OPCODE;
+        }
+        break;
+      default:
+        break;
+    }
+    if (status != DAP_PROG_OK) {
+      break;
+    }
+
+    pc += len;
+
+    switch (ins[0]) {
+      case DAP_PROG_END:
+        pc -= len;
+        *pc_out = pc;
+        return (DAP_PROG_OK);
+
+      case DAP_PROG_XFER_READ:
+        *ack = DAP_ProgramTransfer(ins[1] | DAP_TRANSFER_RnW, &reg[ins[2]]);
+        break;
+
+      case DAP_PROG_XFER_WRITE:
+        value = reg[ins[2]];
+        *ack = DAP_ProgramTransfer(ins[1] & ~DAP_TRANSFER_RnW, &value);
+        break;
+
+      case DAP_PROG_XFER_WRITEI:
+        value = get_u32(&ins[2]);
+        *ack = DAP_ProgramTransfer(ins[1] & ~DAP_TRANSFER_RnW, &value);
+        break;
+
+      case DAP_PROG_LOADI:
+        reg[ins[1]] = get_u32(&ins[2]);
+        break;
+
+      case DAP_PROG_MOV:
+        reg[ins[1]] = reg[ins[2]];
+        break;
+
+      case DAP_PROG_ANDI:
+        reg[ins[1]] &= get_u32(&ins[2]);
+        break;
+
+      case DAP_PROG_ORI:
+        reg[ins[1]] |= get_u32(&ins[2]);
+        break;
+
+      case DAP_PROG_ADDI:
+        reg[ins[1]] += get_u32(&ins[2]);
+        break;
+
+      case DAP_PROG_JMP:
+        pc = get_u16(&ins[1]);
+        break;
+
+      case DAP_PROG_BEQ:
+      case DAP_PROG_BNE:
+        mask   = get_u32(&ins[2]);
+        value  = get_u32(&ins[6]);
+        target = get_u16(&ins[10]);
+        if (((reg[ins[1]] & mask) == value) == (ins[0] == DAP_PROG_BEQ)) {
+          pc = target;
+        }
+        break;
+
+      case DAP_PROG_DJNZ:
+        if (--reg[ins[1]] != 0U) {
+          pc = get_u16(&ins[2]);
+        }
+        break;
+
+      case DAP_PROG_DELAY:
+        esp_rom_delay_us(get_u16(&ins[1]));
+        break;
+
+      case DAP_PROG_APPEND:
+        if ((DAP_ProgramResultCount + 4U) > DAP_PROGRAM_RESULT_SIZE) {
+          status = DAP_PROG_ERR_RESULT;
+          break;
+        }
+        value = reg[ins[1]];
+        DAP_ProgramResult[DAP_ProgramResultCount++] = (uint8_t) value;
+        DAP_ProgramResult[DAP_ProgramResultCount++] = (uint8_t)(value >>  8);
+        DAP_ProgramResult[DAP_ProgramResultCount++] = (uint8_t)(value >> 16);
+        DAP_ProgramResult[DAP_ProgramResultCount++] = (uint8_t)(value >> 24);
+        break;
+
+      case DAP_PROG_FAIL:
+        status = DAP_PROG_ERR_USER | (ins[1] & 0x7FU);
+        break;
+    }
+
+    if (*ack != DAP_TRANSFER_OK) {
+      status = DAP_PROG_ERR_XFER;
+    }
+    if (status != DAP_PROG_OK) {
+      pc -= len;
+      break;
+    }
+  }
+
+  *pc_out = pc;
+  return (status);
+}
+
+
+// Process micro-program vendor command and prepare response
+//   request:  pointer to request data
+//     LOAD:   sub-command, offset (2 bytes), count (1 byte), program bytes
+//     RUN:    sub-command, initial r0 (4 bytes)
+//     RESULT: sub-command, offset (2 bytes), count (1 byte)
+//   response: pointer to response data
+//     LOAD:   status
+//     RUN:    status, run status, last ACK, PC (2 bytes), result count (2 bytes)
+//     RESULT: status, count, result bytes
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_Program(const uint8_t *request, uint8_t *response) {
+  uint32_t offset, count, pc;
+  uint8_t  status, ack;
+
+  switch (*request) {
+    case DAP_PROG_CMD_LOAD:
+      offset = get_u16(request+1);
+      count  = *(request+3);
+      if (((offset + count) > DAP_PROGRAM_SIZE) || ((count + 5U) > DAP_PACKET_SIZE)) {
+        // The program bytes are consumed either way, the next command follows them
+        *response = DAP_ERROR;
+        return (((4U + count) << 16) | 1U);
+      }
+      memcpy(&DAP_ProgramBuf[offset], request+4, count);
+      *response = DAP_OK;
+      return (((4U + count) << 16) | 1U);
+
+    case DAP_PROG_CMD_RUN:
+      status = DAP_ProgramRun(get_u32(request+1), &pc, &ack);
+      *(response+0) = DAP_OK;
+      *(response+1) = status;
+      *(response+2) = ack;
+      *(response+3) = (uint8_t) pc;
+      *(response+4) = (uint8_t)(pc >> 8);
+      *(response+5) = (uint8_t) DAP_ProgramResultCount;
+      *(response+6) = (uint8_t)(DAP_ProgramResultCount >> 8);
+      return ((5U << 16) | 7U);
+
+    case DAP_PROG_CMD_RESULT:
+      offset = get_u16(request+1);
+      count  = *(request+3);
+      if (count > (DAP_PACKET_SIZE - 3U)) {
+        count = DAP_PACKET_SIZE - 3U;
+      }
+      if (offset >= DAP_ProgramResultCount) {
+        offset = 0U;
+        count  = 0U;
+      } else if ((offset + count) > DAP_ProgramResultCount) {
+        count = DAP_ProgramResultCount - offset;
+      }
+      *(response+0) = DAP_OK;
+      *(response+1) = (uint8_t)count;
+      memcpy(response+2, &DAP_ProgramResult[offset], count);
+      return ((4U << 16) | (2U + count));
+
+    default:
+      *response = DAP_ERROR;
+      return ((1U << 16) | 1U);
+  }
+}
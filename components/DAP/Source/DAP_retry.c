@@ -0,0 +1,259 @@
+/**
+ * @file    DAP_retry.c
+ * @brief   Adaptive WAIT retry engine for SWD transfers
+ *
+ * A WAIT response used to be retried immediately up to retry_count times,
+ * re-clocking a full packet header each time. Slow flash and low-power
+ * targets answer such storms with more WAITs. Here every retry is preceded
+ * by a growing number of idle cycles, the sequence is bounded by both
+ * retry_count and a time budget, and the backoff level that finally
+ * succeeded is remembered per AP (APSEL snooped from DP SELECT writes) so
+ * the next WAIT on that AP starts close to the right spacing.
+ */
+
+#include <string.h>
+#include "esp_timer.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_retry.h"
+#include "swd_host.h"
+
+#define DP_SELECT_WRITE   DAP_TRANSFER_A3   // DP SELECT (A[3:2] = 2), write
+
+typedef struct {
+  uint8_t  apsel;           // AP number
+  uint8_t  level;           // Learned initial backoff level
+  uint8_t  valid;
+  uint32_t wait_acks;       // WAIT responses seen on this AP
+} DAP_RetryProfile_t;
+
+static DAP_RetryStats_t   DAP_RetryStats;
+static DAP_RetryProfile_t DAP_RetryProfiles[DAP_RETRY_AP_PROFILES];
+static uint32_t           DAP_RetryBudget = DAP_RETRY_TIME_BUDGET_US;
+static uint8_t            DAP_RetryMaxLevel = DAP_RETRY_MAX_LEVEL;
+static uint8_t            DAP_RetryApsel;
+static uint32_t           DAP_RetrySelect;      // Last DP SELECT written by the host
+static uint8_t            DAP_RetrySelectValid;
+
+
+// Get profile for an AP, replacing the slot with the same low bits on miss
+static DAP_RetryProfile_t *DAP_RetryProfile(uint8_t apsel) {
+  DAP_RetryProfile_t *profile;
+
+  profile = &DAP_RetryProfiles[apsel % DAP_RETRY_AP_PROFILES];
+  if (!profile->valid || (profile->apsel != apsel)) {
+    profile->apsel     = apsel;
+    profile->level     = 0U;
+    profile->valid     = 1U;
+    profile->wait_acks = 0U;
+  }
+  return (profile);
+}
+
+
+// Clock idle cycles (SWDIO low) between retries
+static void SWD_IdleCycles(uint32_t cycles) {
+  static const uint8_t zero[8] = { 0U };
+  uint32_t n;
+
+  while (cycles != 0U) {
+    n = (cycles > 64U) ? 64U : cycles;
+    SWJ_Sequence(n, zero);
+    cycles -= n;
+  }
+}
+
+
+// SWD Transfer with adaptive WAIT handling
+//   request: A[3:2] RnW APnDP (other bits ignored)
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+uint8_t SWD_TransferRetry(uint32_t request, uint32_t *data) {
+  DAP_RetryProfile_t *profile;
+  uint32_t retry;
+  uint32_t level;
+  uint32_t waits;
+  uint32_t elapsed;
+  int64_t  start;
+  uint8_t  ack;
+
+  ack = SWD_Transfer(request, data);
+
+  if (ack == DAP_TRANSFER_OK) {
+    if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DP_SELECT_WRITE) {
+      DAP_RetryApsel = ((const uint8_t *)data)[3];
+    }
+    return (ack);
+  }
+  if (ack != DAP_TRANSFER_WAIT) {
+    return (ack);
+  }
+
+  // Slow path: target is busy
+  profile = DAP_RetryProfile(DAP_RetryApsel);
+  level   = (profile->level < DAP_RetryMaxLevel) ? profile->level : DAP_RetryMaxLevel;
+  retry   = DAP_Data.transfer.retry_count;
+  waits   = 1U;
+  start   = esp_timer_get_time();
+  elapsed = 0U;
+
+  while (retry-- && !DAP_TransferAbort) {
+    SWD_IdleCycles(1U << level);
+    ack = SWD_Transfer(request, data);
+    if (ack != DAP_TRANSFER_WAIT) {
+      break;
+    }
+    waits++;
+    if (level < DAP_RetryMaxLevel) {
+      level++;
+    }
+    elapsed = (uint32_t)(esp_timer_get_time() - start);
+    if (elapsed >= DAP_RetryBudget) {
+      break;
+    }
+  }
+
+  elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+  // Learn: move the starting level halfway towards the level that worked
+  if (ack == DAP_TRANSFER_OK) {
+    if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DP_SELECT_WRITE) {
+      DAP_RetryApsel = ((const uint8_t *)data)[3];
+    }
+    profile->level = (uint8_t)((profile->level + level) / 2U);
+  } else if (ack == DAP_TRANSFER_WAIT) {
+    DAP_RetryStats.timeouts++;
+  }
+
+  profile->wait_acks += waits;
+  DAP_RetryStats.wait_events++;
+  DAP_RetryStats.wait_acks += waits;
+  if (elapsed > DAP_RetryStats.max_wait_us) {
+    DAP_RetryStats.max_wait_us = elapsed;
+  }
+
+  return (ack);
+}
+
+
+// Reset statistics and learned profiles
+void DAP_RetryReset(void) {
+  memset(&DAP_RetryStats, 0, sizeof(DAP_RetryStats));
+  memset(DAP_RetryProfiles, 0, sizeof(DAP_RetryProfiles));
+}
+
+
+// Get WAIT statistics
+void DAP_RetryGetStats(DAP_RetryStats_t *stats) {
+  *stats = DAP_RetryStats;
+}
+
+
+// Record a DP SELECT write made by the host (DAP_Transfer, DAP_TransferBlock).
+// Writes made by swd_host on behalf of the probe are not recorded, so the
+// value is the one the host expects to find in SELECT.
+//   request: A[3:2] RnW APnDP of a completed transfer
+//   data:    DATA[31:0] written
+void DAP_RetryHostSelect(uint32_t request, uint32_t data) {
+  if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DP_SELECT_WRITE) {
+    DAP_RetrySelect = data;
+    DAP_RetrySelectValid = 1U;
+  }
+}
+
+
+// Get the last DP SELECT value written by the host (SELECT is write-only)
+//   return: 1 = known, 0 = no SELECT write by the host seen yet
+uint8_t DAP_RetryLastSelect(uint32_t *select) {
+  *select = DAP_RetrySelect;
+  return (DAP_RetrySelectValid);
+}
+
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  *p++ = (uint8_t) v;
+  *p++ = (uint8_t)(v >>  8);
+  *p++ = (uint8_t)(v >> 16);
+  *p++ = (uint8_t)(v >> 24);
+  return (p);
+}
+
+
+// Process retry engine vendor command and prepare response
+//   request:  pointer to request data
+//     STATS/PROFILES/RESET/SYSCALL: sub-command
+//     CONFIG:   sub-command, time budget in us (4 bytes), max backoff level (1 byte)
+//   response: pointer to response data
+//     STATS:    status, wait events, WAIT acks, timeouts, max wait us (4 bytes each)
+//     PROFILES: status, count, count x (APSEL, level, WAIT acks (4 bytes))
+//     SYSCALL:  status, flash algorithm calls, timeouts, last us, max us,
+//               total us (8 bytes), 4 bytes each otherwise
+//     RESET/CONFIG: status
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_RetryCommand(const uint8_t *request, uint8_t *response) {
+  swd_syscall_stats_t stats;
+  uint8_t *p;
+  uint32_t n, i;
+
+  switch (*request) {
+    case DAP_RETRY_CMD_STATS:
+      p = response;
+      *p++ = DAP_OK;
+      p = put_u32(p, DAP_RetryStats.wait_events);
+      p = put_u32(p, DAP_RetryStats.wait_acks);
+      p = put_u32(p, DAP_RetryStats.timeouts);
+      p = put_u32(p, DAP_RetryStats.max_wait_us);
+      return ((1U << 16) | (uint32_t)(p - response));
+
+    case DAP_RETRY_CMD_PROFILES:
+      p = response + 2;
+      n = 0U;
+      for (i = 0U; i < DAP_RETRY_AP_PROFILES; i++) {
+        if (DAP_RetryProfiles[i].valid) {
+          *p++ = DAP_RetryProfiles[i].apsel;
+          *p++ = DAP_RetryProfiles[i].level;
+          p = put_u32(p, DAP_RetryProfiles[i].wait_acks);
+          n++;
+        }
+      }
+      *(response+0) = DAP_OK;
+      *(response+1) = (uint8_t)n;
+      return ((1U << 16) | (uint32_t)(p - response));
+
+    case DAP_RETRY_CMD_RESET:
+      DAP_RetryReset();
+      *response = DAP_OK;
+      return ((1U << 16) | 1U);
+
+    case DAP_RETRY_CMD_CONFIG:
+      n = (uint32_t)(*(request+1) <<  0) |
+          (uint32_t)(*(request+2) <<  8) |
+          (uint32_t)(*(request+3) << 16) |
+          (uint32_t)(*(request+4) << 24);
+      if ((n == 0U) || (*(request+5) > 16U)) {
+        *response = DAP_ERROR;
+      } else {
+        DAP_RetryBudget   = n;
+        DAP_RetryMaxLevel = *(request+5);
+        *response = DAP_OK;
+      }
+      return ((6U << 16) | 1U);
+
+    case DAP_RETRY_CMD_SYSCALL:
+      swd_get_syscall_stats(&stats);
+      p = response;
+      *p++ = DAP_OK;
+      p = put_u32(p, stats.calls);
+      p = put_u32(p, stats.timeouts);
+      p = put_u32(p, stats.last_us);
+      p = put_u32(p, stats.max_us);
+      p = put_u32(p, (uint32_t)stats.total_us);
+      p = put_u32(p, (uint32_t)(stats.total_us >> 32));
+      return ((1U << 16) | (uint32_t)(p - response));
+
+    default:
+      *response = DAP_ERROR;
+      return ((1U << 16) | 1U);
+  }
+}
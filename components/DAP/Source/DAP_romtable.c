@@ -0,0 +1,392 @@
+/**
+ * @file    DAP_romtable.c
+ * @brief   On-probe ROM table walk and CoreSight component table
+ *
+ * Host tools walk ROM tables one DAP_Transfer at a time on every connect.
+ * Here the probe walks the ROM tables of all MEM-APs itself through the
+ * banked data registers (four pipelined reads per TAR write) and keeps the
+ * result in NVS, keyed by DP IDCODE. Many parts share a DP IDCODE, so a
+ * cached table is only used when AP 0's IDR, BASE and ROM table PIDR still
+ * match the ones recorded with it.
+ *
+ * The walk moves DP SELECT and the CSW/TAR of every MEM-AP it reads from.
+ * They are saved on first use and written back when the scan ends
+ * (swd_host_save), so the host's own SELECT/CSW/TAR cache stays valid.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include "nvs.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "debug_cm.h"
+#include "swd_host.h"
+#include "DAP_romtable.h"
+
+#define DAP_ROM_NVS_NAMESPACE   "dap_rom"
+#define DAP_ROM_CACHE_VERSION   1U
+
+#define CIDR_CLASS_ROM          0x1U    // ADIv5 ROM table
+#define CIDR_CLASS_CORESIGHT    0x9U    // CoreSight component
+
+#define DEVARCH_ROM_MASK        0x0010FFFFU   // PRESENT and ARCHID
+#define DEVARCH_ROM             0x00100AF7U   // CoreSight ROM table
+
+typedef struct {
+  uint8_t  version;
+  uint8_t  count;
+  uint8_t  truncated;           // table full before the walk finished
+  uint8_t  reserved;
+  uint32_t fingerprint[3];      // AP 0 IDR, BASE, ROM table PIDR
+  DAP_RomComponent_t comp[DAP_ROM_MAX_COMPONENTS];
+} DAP_RomTable_t;
+
+static DAP_RomTable_t DAP_Rom;
+
+
+// Clear sticky errors left by a faulting component access
+static void DAP_RomClearError(void) {
+  swd_write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR);
+}
+
+
+// Read four words from a 16 byte aligned address through the banked data registers
+static uint8_t DAP_RomRead4(uint32_t ap, uint32_t addr, uint32_t *val) {
+  uint32_t adr[4];
+
+  adr[0] = ap | AP_BD0;
+  adr[1] = ap | AP_BD1;
+  adr[2] = ap | AP_BD2;
+  adr[3] = ap | AP_BD3;
+
+  if (!swd_write_ap(ap | AP_TAR, addr)) {
+    return (0U);
+  }
+  return (swd_read_ap_multiple(adr, val, 4U));
+}
+
+
+// Read component identification
+//   return: 1 = component found, 0 = no component or access failed
+static uint8_t DAP_RomReadId(uint32_t ap, uint32_t base, DAP_RomComponent_t *comp) {
+  uint32_t v[4];
+
+  if (!DAP_RomRead4(ap, base + 0xFF0U, v)) {
+    DAP_RomClearError();
+    return (0U);
+  }
+  // CIDR preamble
+  if (((v[0] & 0xFFU) != 0x0DU) || ((v[1] & 0x0FU) != 0x00U) ||
+      ((v[2] & 0xFFU) != 0x05U) || ((v[3] & 0xFFU) != 0xB1U)) {
+    return (0U);
+  }
+
+  memset(comp, 0, sizeof(*comp));
+  comp->base   = base;
+  comp->apsel  = (uint8_t)(ap >> 24);
+  comp->cclass = (uint8_t)((v[1] >> 4) & 0x0FU);
+
+  if (!DAP_RomRead4(ap, base + 0xFE0U, v)) {
+    DAP_RomClearError();
+    return (0U);
+  }
+  comp->pidr = ((v[0] & 0xFFU) <<  0) |
+               ((v[1] & 0xFFU) <<  8) |
+               ((v[2] & 0xFFU) << 16) |
+               ((v[3] & 0xFFU) << 24);
+
+  if (!DAP_RomRead4(ap, base + 0xFD0U, v)) {
+    DAP_RomClearError();
+    return (0U);
+  }
+  comp->pidr4 = (uint8_t)v[0];
+
+  if (comp->cclass == CIDR_CLASS_CORESIGHT) {
+    if (!DAP_RomRead4(ap, base + 0xFB0U, v)) {
+      DAP_RomClearError();
+      return (0U);
+    }
+    comp->devarch = v[3];
+    if (!DAP_RomRead4(ap, base + 0xFC0U, v)) {
+      DAP_RomClearError();
+      return (0U);
+    }
+    comp->devtype = (uint8_t)v[3];
+  }
+
+  return (1U);
+}
+
+
+// Add a component and, if it is a ROM table, everything below it
+static void DAP_RomWalk(uint32_t ap, uint32_t base, uint32_t depth) {
+  DAP_RomComponent_t comp;
+  uint32_t v[4];
+  uint32_t off, end, i;
+
+  if (!DAP_RomReadId(ap, base, &comp)) {
+    return;
+  }
+  if (DAP_Rom.count >= DAP_ROM_MAX_COMPONENTS) {
+    DAP_Rom.truncated = 1U;
+    return;
+  }
+  DAP_Rom.comp[DAP_Rom.count++] = comp;
+
+  if (comp.cclass == CIDR_CLASS_ROM) {
+    end = 0xF00U;               // 960 entries, zero terminated
+  } else if ((comp.cclass == CIDR_CLASS_CORESIGHT) &&
+             ((comp.devarch & DEVARCH_ROM_MASK) == DEVARCH_ROM)) {
+    end = 0x800U;               // 512 entries
+  } else {
+    return;
+  }
+  if (depth >= DAP_ROM_MAX_DEPTH) {
+    return;
+  }
+
+  for (off = 0U; off < end; off += 16U) {
+    if (!DAP_RomRead4(ap, base + off, v)) {
+      DAP_RomClearError();
+      return;
+    }
+    for (i = 0U; i < 4U; i++) {
+      if ((v[i] == 0U) && (comp.cclass == CIDR_CLASS_ROM)) {
+        return;
+      }
+      if ((v[i] & (ROM_PRESENT | ROM_FORMAT)) != (ROM_PRESENT | ROM_FORMAT)) {
+        continue;
+      }
+      // Entry offset is signed, wrap-around addition does the right thing
+      DAP_RomWalk(ap, base + (v[i] & ROM_ADDR), depth + 1U);
+      if (DAP_Rom.truncated) {
+        return;
+      }
+    }
+  }
+}
+
+
+// Set up 32-bit accesses on an AP, keeping its other CSW bits
+static uint8_t DAP_RomSetupAP(uint32_t ap) {
+  uint32_t csw;
+
+  if (!swd_host_save_ap(ap) || !swd_read_ap(ap | AP_CSW, &csw)) {
+    return (0U);
+  }
+  return (swd_write_ap(ap | AP_CSW, (csw & ~CSW_SIZE) | CSW_SIZE32));
+}
+
+
+// Identify the target beyond its DP IDCODE
+static uint8_t DAP_RomFingerprint(uint32_t *fp) {
+  DAP_RomComponent_t comp;
+  uint32_t adr[2];
+
+  adr[0] = AP_IDR;
+  adr[1] = AP_ROM;
+  if (!swd_read_ap_multiple(adr, fp, 2U)) {
+    return (0U);
+  }
+
+  fp[2] = 0U;
+  if (((fp[0] & IDR_CLASS) == IDR_CLASS_MEM) &&
+      ((fp[1] & (ROM_PRESENT | ROM_FORMAT)) == (ROM_PRESENT | ROM_FORMAT))) {
+    if (!DAP_RomSetupAP(0U)) {
+      return (0U);
+    }
+    if (DAP_RomReadId(0U, fp[1] & ROM_ADDR, &comp)) {
+      fp[2] = comp.pidr;
+    }
+  }
+  return (1U);
+}
+
+
+// Walk the ROM tables of all APs, stopping at the first unimplemented AP
+static void DAP_RomWalkAll(void) {
+  uint32_t apsel, ap, idr, rom;
+
+  DAP_Rom.count     = 0U;
+  DAP_Rom.truncated = 0U;
+
+  for (apsel = 0U; apsel < 256U; apsel++) {
+    ap = apsel << 24;
+    if (!swd_read_ap(ap | AP_IDR, &idr)) {
+      DAP_RomClearError();
+      break;
+    }
+    if (idr == 0U) {
+      break;
+    }
+    if ((idr & IDR_CLASS) != IDR_CLASS_MEM) {
+      continue;
+    }
+    if (!swd_read_ap(ap | AP_ROM, &rom) || !DAP_RomSetupAP(ap)) {
+      DAP_RomClearError();
+      continue;
+    }
+    if ((rom & (ROM_PRESENT | ROM_FORMAT)) != (ROM_PRESENT | ROM_FORMAT)) {
+      continue;
+    }
+    DAP_RomWalk(ap, rom & ROM_ADDR, 0U);
+    if (DAP_Rom.truncated) {
+      break;
+    }
+  }
+}
+
+
+static void DAP_RomKey(char *key, uint32_t idcode) {
+  snprintf(key, 9, "%08" PRIx32, idcode);
+}
+
+
+// Load the component table cached for this target
+static uint8_t DAP_RomLoad(uint32_t idcode, const uint32_t *fp) {
+  nvs_handle_t handle;
+  char key[9];
+  size_t len;
+  esp_err_t err;
+
+  if (nvs_open(DAP_ROM_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return (0U);
+  }
+  DAP_RomKey(key, idcode);
+  len = sizeof(DAP_Rom);
+  err = nvs_get_blob(handle, key, &DAP_Rom, &len);
+  nvs_close(handle);
+
+  if ((err != ESP_OK) ||
+      (len < offsetof(DAP_RomTable_t, comp)) ||
+      (DAP_Rom.version != DAP_ROM_CACHE_VERSION) ||
+      (DAP_Rom.count > DAP_ROM_MAX_COMPONENTS) ||
+      (len != (offsetof(DAP_RomTable_t, comp) + (DAP_Rom.count * sizeof(DAP_RomComponent_t)))) ||
+      (memcmp(DAP_Rom.fingerprint, fp, sizeof(DAP_Rom.fingerprint)) != 0)) {
+    DAP_Rom.count = 0U;
+    return (0U);
+  }
+  return (1U);
+}
+
+
+// Store the component table, only the used records
+static void DAP_RomStore(uint32_t idcode, const uint32_t *fp) {
+  nvs_handle_t handle;
+  char key[9];
+
+  DAP_Rom.version = DAP_ROM_CACHE_VERSION;
+  memcpy(DAP_Rom.fingerprint, fp, sizeof(DAP_Rom.fingerprint));
+
+  if (nvs_open(DAP_ROM_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+    return;
+  }
+  DAP_RomKey(key, idcode);
+  if (nvs_set_blob(handle, key, &DAP_Rom,
+                   offsetof(DAP_RomTable_t, comp) + (DAP_Rom.count * sizeof(DAP_RomComponent_t))) == ESP_OK) {
+    nvs_commit(handle);
+  }
+  nvs_close(handle);
+}
+
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  *p++ = (uint8_t) v;
+  *p++ = (uint8_t)(v >>  8);
+  *p++ = (uint8_t)(v >> 16);
+  *p++ = (uint8_t)(v >> 24);
+  return (p);
+}
+
+
+// Process ROM table vendor command and prepare response
+//   request:  pointer to request data
+//     SCAN:   sub-command, flags (1 byte)
+//     READ:   sub-command, first record index (1 byte)
+//     FORGET: sub-command
+//   response: pointer to response data
+//     SCAN:   status, source, record count, truncated, DP IDCODE (4 bytes)
+//     READ:   status, count, count x record (DAP_ROM_RECORD_SIZE bytes)
+//     FORGET: status
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_RomTableCommand(const uint8_t *request, uint8_t *response) {
+  const DAP_RomComponent_t *comp;
+  nvs_handle_t handle;
+  uint32_t idcode, fp[3];
+  uint32_t index, n, i;
+  uint8_t  source;
+  uint8_t *p;
+
+  switch (*request) {
+    case DAP_ROM_CMD_SCAN:
+      if (DAP_Data.debug_port != DAP_PORT_SWD) {
+        *response = DAP_ERROR;
+        return ((2U << 16) | 1U);
+      }
+      swd_host_save();
+      if (!swd_read_dp(DP_IDCODE, &idcode) || !DAP_RomFingerprint(fp)) {
+        swd_host_restore();
+        DAP_Rom.count = 0U;
+        *response = DAP_ERROR;
+        return ((2U << 16) | 1U);
+      }
+      if (!(*(request+1) & DAP_ROM_SCAN_NO_CACHE) && DAP_RomLoad(idcode, fp)) {
+        source = DAP_ROM_SRC_CACHE;
+      } else {
+        DAP_RomWalkAll();
+        DAP_RomStore(idcode, fp);
+        source = DAP_ROM_SRC_WALK;
+      }
+      if (!swd_host_restore()) {
+        *response = DAP_ERROR;
+        return ((2U << 16) | 1U);
+      }
+      p = response;
+      *p++ = DAP_OK;
+      *p++ = source;
+      *p++ = DAP_Rom.count;
+      *p++ = DAP_Rom.truncated;
+      p = put_u32(p, idcode);
+      return ((2U << 16) | (uint32_t)(p - response));
+
+    case DAP_ROM_CMD_READ:
+      index = *(request+1);
+      n = (DAP_PACKET_SIZE - 3U) / DAP_ROM_RECORD_SIZE;
+      if (index >= DAP_Rom.count) {
+        n = 0U;
+      } else if ((index + n) > DAP_Rom.count) {
+        n = DAP_Rom.count - index;
+      }
+      p = response + 2;
+      for (i = 0U; i < n; i++) {
+        comp = &DAP_Rom.comp[index + i];
+        p = put_u32(p, comp->base);
+        p = put_u32(p, comp->pidr);
+        p = put_u32(p, comp->devarch);
+        *p++ = comp->apsel;
+        *p++ = comp->cclass;
+        *p++ = comp->devtype;
+        *p++ = comp->pidr4;
+      }
+      *(response+0) = DAP_OK;
+      *(response+1) = (uint8_t)n;
+      return ((2U << 16) | (uint32_t)(p - response));
+
+    case DAP_ROM_CMD_FORGET:
+      DAP_Rom.count = 0U;
+      if (nvs_open(DAP_ROM_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_all(handle);
+        nvs_commit(handle);
+        nvs_close(handle);
+      }
+      *response = DAP_OK;
+      return ((1U << 16) | 1U);
+
+    default:
+      *response = DAP_ERROR;
+      return ((1U << 16) | 1U);
+  }
+}
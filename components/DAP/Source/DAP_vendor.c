@@ -22,6 +22,15 @@
 
 #include "DAP_config.h"
 #include "DAP.h"
+#include "rtt.h"
+#include "DAP_program.h"
+#include "DAP_retry.h"
+#include "DAP_romtable.h"
+#include "DAP_jtagscan.h"
+#include "DAP_itm.h"
+#include "DAP_break.h"
+#include "swd_host.h"
+#include "swd_host_ca.h"
 
 //**************************************************************************************************
 /** 
@@ -34,6 +43,239 @@ Vendor Commands. Copy this file to the project folder of the Debug Unit and add
 file to the MDK-ARM project under the file group Configuration.
 */
 
+/*
+Vendor command allocation:
+  ID_DAP_Vendor1  (0x81): RTT bridge control
+  ID_DAP_Vendor2  (0x82): micro-program load/run/result (DAP_program.c)
+  ID_DAP_Vendor3  (0x83): WAIT retry statistics and configuration, flash algorithm timing (DAP_retry.c)
+  ID_DAP_Vendor4  (0x84): ROM table walk and component table (DAP_romtable.c)
+  ID_DAP_Vendor5  (0x85): Cortex-A/R halt, registers and memory over APB-AP (swd_host_ca.c)
+  ID_DAP_Vendor6  (0x86): JTAG scan chain discovery (DAP_jtagscan.c)
+  ID_DAP_Vendor7  (0x87): SWO ITM/DWT packet filter (DAP_itm.c)
+  ID_DAP_Vendor8  (0x88): FPB/DWT breakpoint and watchpoint manager (DAP_break.c)
+
+0x84 SCAN, 0x85 and 0x88 drive swd_host on the host's SWD connection. They
+all keep the same contract: the CSW and TAR of every AP they touch and DP
+SELECT (the last value the host wrote through DAP_Transfer/TransferBlock)
+are saved before and written back after the command (swd_host_save,
+swd_host_restore). DRW/BDx reads and sticky flags are not kept. After a
+DAP_ERROR status the host must rewrite SELECT, CSW and TAR itself.
+*/
+
+// RTT bridge control sub-commands
+#define RTT_CTRL_STOP   0U
+#define RTT_CTRL_START  1U
+#define RTT_CTRL_STATUS 2U
+
+// Process RTT bridge control command and prepare response
+//   request:  pointer to request data
+//     sub-command (1 byte)
+//     START: search address (4 bytes), search size (4 bytes, 0 = default window)
+//   response: pointer to response data
+//     status (1 byte)
+//     STATUS: enabled (1 byte), control block address (4 bytes, 0 = not found)
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_RTT_Control(const uint8_t *request, uint8_t *response)
+{
+	uint32_t addr, size, cb;
+
+	switch (*request)
+	{
+	case RTT_CTRL_STOP:
+		rtt_enable(0U);
+		*response = DAP_OK;
+		return ((1U << 16) | 1U);
+
+	case RTT_CTRL_START:
+		addr = (uint32_t)(*(request + 1) << 0) |
+			   (uint32_t)(*(request + 2) << 8) |
+			   (uint32_t)(*(request + 3) << 16) |
+			   (uint32_t)(*(request + 4) << 24);
+		size = (uint32_t)(*(request + 5) << 0) |
+			   (uint32_t)(*(request + 6) << 8) |
+			   (uint32_t)(*(request + 7) << 16) |
+			   (uint32_t)(*(request + 8) << 24);
+		if (size == 0U)
+		{
+			addr = RTT_DEFAULT_SEARCH_START;
+			size = RTT_DEFAULT_SEARCH_SIZE;
+		}
+		rtt_configure(addr, size);
+		rtt_enable(1U);
+		*response = DAP_OK;
+		return ((9U << 16) | 1U);
+
+	case RTT_CTRL_STATUS:
+		cb = rtt_get_control_block();
+		*(response + 0) = DAP_OK;
+		*(response + 1) = rtt_is_enabled();
+		*(response + 2) = (uint8_t)(cb >> 0);
+		*(response + 3) = (uint8_t)(cb >> 8);
+		*(response + 4) = (uint8_t)(cb >> 16);
+		*(response + 5) = (uint8_t)(cb >> 24);
+		return ((1U << 16) | 6U);
+
+	default:
+		*response = DAP_ERROR;
+		return ((1U << 16) | 1U);
+	}
+}
+
+// Cortex-A/R sub-commands
+#define CA_CMD_ATTACH    0U
+#define CA_CMD_HALT      1U
+#define CA_CMD_RESUME    2U
+#define CA_CMD_STATUS    3U
+#define CA_CMD_READ_REG  4U
+#define CA_CMD_WRITE_REG 5U
+#define CA_CMD_READ_MEM  6U
+#define CA_CMD_WRITE_MEM 7U
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return (uint32_t)(*(p + 0) << 0) |
+		   (uint32_t)(*(p + 1) << 8) |
+		   (uint32_t)(*(p + 2) << 16) |
+		   (uint32_t)(*(p + 3) << 24);
+}
+
+static uint8_t CA_Apsel; // APB-AP given with the last ATTACH
+
+static void put_u32(uint8_t *p, uint32_t val)
+{
+	*(p + 0) = (uint8_t)(val >> 0);
+	*(p + 1) = (uint8_t)(val >> 8);
+	*(p + 2) = (uint8_t)(val >> 16);
+	*(p + 3) = (uint8_t)(val >> 24);
+}
+
+// Process Cortex-A/R debug command and prepare response
+//   request:  pointer to request data
+//     sub-command (1 byte)
+//     ATTACH:    APSEL of the APB-AP (1 byte), debug register base (4 bytes)
+//     READ_REG:  register (1 byte, 0..14, 15 = PC, 16 = CPSR)
+//     WRITE_REG: register (1 byte), value (4 bytes)
+//     READ_MEM:  address (4 bytes), count (1 byte)
+//     WRITE_MEM: address (4 bytes), count (1 byte), data
+//   response: pointer to response data
+//     status (1 byte), then
+//     ATTACH:   DBGDIDR (4 bytes)
+//     STATUS:   halted (1 byte)
+//     READ_REG: value (4 bytes)
+//     READ_MEM: data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_CortexA_Command(const uint8_t *request, uint8_t *response)
+{
+	uint32_t val = 0U, count;
+	uint32_t req_len, resp_len = 1U;
+	uint8_t ok, halted = 0U;
+
+	switch (*request)
+	{
+	case CA_CMD_ATTACH:
+		req_len = 6U;
+		break;
+	case CA_CMD_HALT:
+	case CA_CMD_RESUME:
+	case CA_CMD_STATUS:
+		req_len = 1U;
+		break;
+	case CA_CMD_READ_REG:
+		req_len = 2U;
+		break;
+	case CA_CMD_WRITE_REG:
+		req_len = 6U;
+		break;
+	case CA_CMD_READ_MEM:
+		req_len = 6U;
+		break;
+	case CA_CMD_WRITE_MEM:
+		req_len = 6U + *(request + 5);
+		break;
+	default:
+		*response = DAP_ERROR;
+		return ((1U << 16) | 1U);
+	}
+
+	if (DAP_Data.debug_port != DAP_PORT_SWD)
+	{
+		*response = DAP_ERROR;
+		return ((req_len << 16) | 1U);
+	}
+
+	// Keep the host's SELECT and APB-AP CSW/TAR, see the contract above
+	if (*request == CA_CMD_ATTACH)
+	{
+		CA_Apsel = *(request + 1);
+	}
+	swd_host_save();
+	if (!swd_host_save_ap((uint32_t)CA_Apsel << 24))
+	{
+		swd_host_restore();
+		*response = DAP_ERROR;
+		return ((req_len << 16) | 1U);
+	}
+
+	switch (*request)
+	{
+	case CA_CMD_ATTACH:
+		ok = ca_attach(CA_Apsel, get_u32(request + 2), &val);
+		put_u32(response + 1, val);
+		resp_len = 5U;
+		break;
+
+	case CA_CMD_HALT:
+		ok = ca_halt();
+		break;
+
+	case CA_CMD_RESUME:
+		ok = ca_resume();
+		break;
+
+	case CA_CMD_STATUS:
+		ok = ca_is_halted(&halted);
+		*(response + 1) = halted;
+		resp_len = 2U;
+		break;
+
+	case CA_CMD_READ_REG:
+		ok = ca_read_core_register(*(request + 1), &val);
+		put_u32(response + 1, val);
+		resp_len = 5U;
+		break;
+
+	case CA_CMD_WRITE_REG:
+		ok = ca_write_core_register(*(request + 1), get_u32(request + 2));
+		break;
+
+	case CA_CMD_READ_MEM:
+		count = *(request + 5);
+		if (count > (DAP_PACKET_SIZE - 2U))
+		{
+			count = DAP_PACKET_SIZE - 2U;
+		}
+		ok = ca_read_memory(get_u32(request + 1), response + 1, count);
+		resp_len = ok ? (1U + count) : 1U;
+		break;
+
+	default: // CA_CMD_WRITE_MEM
+		count = *(request + 5);
+		ok = ((count + 7U) <= DAP_PACKET_SIZE) &&
+			 ca_write_memory(get_u32(request + 1), request + 6, count);
+		break;
+	}
+
+	if (!swd_host_restore())
+	{
+		ok = 0U;
+	}
+
+	*response = ok ? DAP_OK : DAP_ERROR;
+	return ((req_len << 16) | resp_len);
+}
+
 /** Process DAP Vendor Command and prepare Response Data
 \param request   pointer to request data
 \param response  pointer to response data
@@ -59,20 +301,28 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response)
 		break;
 
 	case ID_DAP_Vendor1:
+		num += DAP_RTT_Control(request, response);
 		break;
 	case ID_DAP_Vendor2:
+		num += DAP_Program(request, response);
 		break;
 	case ID_DAP_Vendor3:
+		num += DAP_RetryCommand(request, response);
 		break;
 	case ID_DAP_Vendor4:
+		num += DAP_RomTableCommand(request, response);
 		break;
 	case ID_DAP_Vendor5:
+		num += DAP_CortexA_Command(request, response);
 		break;
 	case ID_DAP_Vendor6:
+		num += DAP_JTAG_ScanCommand(request, response);
 		break;
 	case ID_DAP_Vendor7:
+		num += DAP_ITM_Command(request, response);
 		break;
 	case ID_DAP_Vendor8:
+		num += DAP_BRK_Command(request, response);
 		break;
 	case ID_DAP_Vendor9:
 		break;
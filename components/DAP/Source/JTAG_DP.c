@@ -251,15 +251,135 @@ exit:
 }
 
 
+// JTAG Transfer Block I/O
+//   Back-to-back DR scans with the same request. Without idle cycles the
+//   TAP goes Update-DR -> Select-DR-Scan directly instead of through
+//   Run-Test/Idle, and the scan loop stays inside one function.
+//   request: A[3:2] RnW APnDP
+//   data:    little endian data block (read or write)
+//   count:   number of transfers
+//   done:    number of transfers completed with ACK OK
+//   return:  ACK[2:0] of the last transfer
+#define JTAG_TransferBlockFunction(speed)   /**/                                \
+static uint8_t JTAG_TransferBlock##speed (uint32_t request, uint8_t *data,      \
+                                          uint32_t count, uint32_t *done) {     \
+  uint32_t ack;                                                                 \
+  uint32_t bit;                                                                 \
+  uint32_t val;                                                                 \
+  uint32_t n;                                                                   \
+  uint32_t i;                                                                   \
+  uint32_t after;                                                               \
+  uint32_t idle;                                                                \
+                                                                                \
+  ack   = DAP_TRANSFER_OK;                                                      \
+  after = DAP_Data.jtag_dev.count - DAP_Data.jtag_dev.index - 1U;               \
+  idle  = DAP_Data.transfer.idle_cycles;                                        \
+                                                                                \
+  PIN_TMS_SET();                                                                \
+  for (i = 0U; i < count; i++) {                                                \
+    JTAG_CYCLE_TCK();                       /* Select-DR-Scan */                \
+    PIN_TMS_CLR();                                                              \
+    JTAG_CYCLE_TCK();                       /* Capture-DR */                    \
+    JTAG_CYCLE_TCK();                       /* Shift-DR */                      \
+                                                                                \
+    for (n = DAP_Data.jtag_dev.index; n; n--) {                                 \
+      JTAG_CYCLE_TCK();                     /* Bypass before data */            \
+    }                                                                           \
+                                                                                \
+    JTAG_CYCLE_TDIO(request >> 1, bit);     /* Set RnW, Get ACK.0 */            \
+    ack  = bit << 1;                                                            \
+    JTAG_CYCLE_TDIO(request >> 2, bit);     /* Set A2,  Get ACK.1 */            \
+    ack |= bit << 0;                                                            \
+    JTAG_CYCLE_TDIO(request >> 3, bit);     /* Set A3,  Get ACK.2 */            \
+    ack |= bit << 2;                                                            \
+                                                                                \
+    if (ack != DAP_TRANSFER_OK) {                                               \
+      /* Exit on error */                                                       \
+      PIN_TMS_SET();                                                            \
+      JTAG_CYCLE_TCK();                     /* Exit1-DR */                      \
+      JTAG_CYCLE_TCK();                     /* Update-DR */                     \
+      break;                                                                    \
+    }                                                                           \
+                                                                                \
+    if (request & DAP_TRANSFER_RnW) {                                           \
+      /* Read Transfer */                                                       \
+      val = 0U;                                                                 \
+      for (n = 31U; n; n--) {                                                   \
+        JTAG_CYCLE_TDO(bit);                /* Get D0..D30 */                   \
+        val  |= bit << 31;                                                      \
+        val >>= 1;                                                              \
+      }                                                                         \
+      if (after) {                                                              \
+        JTAG_CYCLE_TDO(bit);                /* Get D31 */                       \
+        for (n = after - 1U; n; n--) {                                          \
+          JTAG_CYCLE_TCK();                 /* Bypass after data */             \
+        }                                                                       \
+        PIN_TMS_SET();                                                          \
+        JTAG_CYCLE_TCK();                   /* Bypass & Exit1-DR */             \
+      } else {                                                                  \
+        PIN_TMS_SET();                                                          \
+        JTAG_CYCLE_TDO(bit);                /* Get D31 & Exit1-DR */            \
+      }                                                                         \
+      val |= bit << 31;                                                         \
+      *(data+0) = (uint8_t) val;                                                \
+      *(data+1) = (uint8_t)(val >>  8);                                         \
+      *(data+2) = (uint8_t)(val >> 16);                                         \
+      *(data+3) = (uint8_t)(val >> 24);                                         \
+    } else {                                                                    \
+      /* Write Transfer */                                                      \
+      val = (uint32_t)(*(data+0) <<  0) |                                       \
+            (uint32_t)(*(data+1) <<  8) |                                       \
+            (uint32_t)(*(data+2) << 16) |                                       \
+            (uint32_t)(*(data+3) << 24);                                        \
+      for (n = 31U; n; n--) {                                                   \
+        JTAG_CYCLE_TDI(val);                /* Set D0..D30 */                   \
+        val >>= 1;                                                              \
+      }                                                                         \
+      if (after) {                                                              \
+        JTAG_CYCLE_TDI(val);                /* Set D31 */                       \
+        for (n = after - 1U; n; n--) {                                          \
+          JTAG_CYCLE_TCK();                 /* Bypass after data */             \
+        }                                                                       \
+        PIN_TMS_SET();                                                          \
+        JTAG_CYCLE_TCK();                   /* Bypass & Exit1-DR */             \
+      } else {                                                                  \
+        PIN_TMS_SET();                                                          \
+        JTAG_CYCLE_TDI(val);                /* Set D31 & Exit1-DR */            \
+      }                                                                         \
+    }                                                                           \
+    data += 4;                                                                  \
+                                                                                \
+    JTAG_CYCLE_TCK();                       /* Update-DR */                     \
+    if (idle) {                                                                 \
+      PIN_TMS_CLR();                                                            \
+      JTAG_CYCLE_TCK();                     /* Idle */                          \
+      for (n = idle; n; n--) {                                                  \
+        JTAG_CYCLE_TCK();                   /* Idle */                          \
+      }                                                                         \
+      PIN_TMS_SET();                                                            \
+    }                                                                           \
+  }                                                                             \
+                                                                                \
+  PIN_TMS_CLR();                                                                \
+  JTAG_CYCLE_TCK();                         /* Idle */                          \
+  PIN_TDI_OUT(1U);                                                              \
+                                                                                \
+  *done = i;                                                                    \
+  return ((uint8_t)ack);                                                        \
+}
+
+
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_FAST()
 JTAG_IR_Function(Fast)
 JTAG_TransferFunction(Fast)
+JTAG_TransferBlockFunction(Fast)
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
 JTAG_IR_Function(Slow)
 JTAG_TransferFunction(Slow)
+JTAG_TransferBlockFunction(Slow)
 
 
 // JTAG Read IDCODE register
@@ -367,4 +487,19 @@ uint8_t  JTAG_Transfer(uint32_t request, uint32_t *data) {
 }
 
 
+// JTAG Transfer Block I/O
+//   request: A[3:2] RnW APnDP
+//   data:    little endian data block (read or write)
+//   count:   number of transfers
+//   done:    number of transfers completed with ACK OK
+//   return:  ACK[2:0] of the last transfer
+uint8_t  JTAG_TransferBlock(uint32_t request, uint8_t *data, uint32_t count, uint32_t *done) {
+  if (DAP_Data.fast_clock) {
+    return JTAG_TransferBlockFast(request, data, count, done);
+  } else {
+    return JTAG_TransferBlockSlow(request, data, count, done);
+  }
+}
+
+
 #endif  /* (DAP_JTAG != 0) */
@@ -20,82 +20,250 @@
  *
  ******************************************************************************/
 
+#include <string.h>
 #include "DAP_config.h"
 #include "DAP.h"
+#include "DAP_itm.h"
+#if (SWO_PSRAM_BUFFER_SIZE != 0U)
+#include "esp_heap_caps.h"
+#endif
 #if (SWO_UART != 0)
-#include "Driver_USART.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#endif
+#if (SWO_MANCHESTER != 0)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/rmt_rx.h"
+#include "esp_attr.h"
+#endif
+#if (SWO_STREAM != 0)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #endif
 
 #if (SWO_UART != 0)
 
-#ifndef USART_PORT
-#define USART_PORT 0 /* USART Port Number */
-#endif
-
-// USART Driver
-#define _USART_Driver_(n) Driver_USART##n
-#define USART_Driver_(n) _USART_Driver_(n)
-extern ARM_DRIVER_USART USART_Driver_(USART_PORT);
-#define pUSART (&USART_Driver_(USART_PORT))
+#define SWO_UART_RX_BUF_SIZE 4096U /* Driver ring buffer behind the RX FIFO */
+#define SWO_UART_EVT_QUEUE 8U      /* Driver event queue length */
+#define SWO_UART_POLL_MS 5U        /* Longest wait before partial data is committed */
+#define SWO_UART_STAGE_SIZE 256U   /* Staging buffer in front of the ITM filter */
+#define SWO_UART_TASK_STACK 3072U
+#define SWO_UART_TASK_PRIO 5U
+#define SWO_UART_TASK_CORE 0       /* The DAP task keeps core 1 busy */
 
 static uint8_t USART_Ready;
+static uint8_t UART_SWO_Stage[SWO_UART_STAGE_SIZE];
+static QueueHandle_t UART_SWO_Events;
+static TaskHandle_t UART_SWO_TaskHandle;
+static SemaphoreHandle_t UART_SWO_Parked;
+static volatile uint8_t UART_SWO_Run;
 
 #endif /* (SWO_UART != 0) */
 
+#if (SWO_MANCHESTER != 0)
+
+#define SWO_RMT_RESOLUTION 80000000U  /* Edge timestamp resolution (Hz) */
+#define SWO_RMT_SYMBOLS 2048U         /* Symbols (two edges each) per capture buffer */
+#define SWO_RMT_BUFFERS 2U            /* Capture buffers, refilled while the other is decoded */
+#define SWO_RMT_MAX_IDLE_NS 400000U   /* Idle threshold limit (15-bit tick counter) */
+#define SWO_RMT_MAX_FILTER_NS 3180U   /* Glitch filter limit (8-bit, 80 MHz group clock) */
+#define SWO_RMT_PARK SWO_RMT_BUFFERS  /* Frame index that asks the task to report parked */
+#define SWO_RMT_PARK_MS 100U
+#define SWO_RMT_TASK_STACK 3072U
+#define SWO_RMT_TASK_PRIO 5U
+#define SWO_RMT_TASK_CORE 0           /* The DAP task keeps core 1 busy */
+
+typedef struct
+{
+  uint8_t index;  /* Capture buffer index */
+  uint32_t count; /* Number of received symbols */
+} Manchester_Frame_t;
+
+static rmt_channel_handle_t RMT_SWO_Channel;
+static rmt_receive_config_t RMT_SWO_Config;
+static rmt_symbol_word_t RMT_SWO_Buf[SWO_RMT_BUFFERS][SWO_RMT_SYMBOLS] __attribute__((aligned(4)));
+static volatile uint8_t RMT_SWO_Busy[SWO_RMT_BUFFERS]; /* Buffer waits for the decoder */
+static volatile uint8_t RMT_SWO_Armed;                  /* Receiver owns a buffer */
+static volatile uint8_t RMT_SWO_Next;                   /* Buffer the receiver fills */
+static volatile uint8_t RMT_SWO_Run;
+static QueueHandle_t RMT_SWO_Frames;
+static SemaphoreHandle_t RMT_SWO_Parked;
+static TaskHandle_t RMT_SWO_TaskHandle;
+static portMUX_TYPE RMT_SWO_Lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t Manchester_Baudrate;
+
+#endif /* (SWO_MANCHESTER != 0) */
+
+#if (SWO_STREAM != 0)
+
+#define SWO_STREAM_BLOCK 64U        /* USB bulk packet size */
+#define SWO_STREAM_TIMEOUT_MS 50U   /* Flush partial blocks after this idle time */
+#define SWO_STREAM_TASK_STACK 2048U
+#define SWO_STREAM_TASK_PRIO 5U
+#define SWO_STREAM_TASK_CORE 0
+#define SWO_STREAM_STAGE 1024U      /* Internal RAM copy of PSRAM chunks */
+
+static TaskHandle_t SWO_StreamTaskHandle;
+static volatile uint8_t TransferBusy = 0U; /* Transfer Busy Flag */
+static uint32_t TransferSize;              /* Current Transfer Size */
+static uint8_t SWO_StreamStage[SWO_STREAM_STAGE] __attribute__((aligned(4)));
+
+#endif /* (SWO_STREAM != 0) */
+
 #if ((SWO_UART != 0) || (SWO_MANCHESTER != 0))
 
 // Trace State
 static uint8_t TraceTransport = 0U;      /* Trace Transport */
 static uint8_t TraceMode = 0U;           /* Trace Mode */
-static uint8_t TraceStatus = 0U;         /* Trace Status without Errors */
+static volatile uint8_t TraceStatus = 0U; /* Trace Status without Errors */
 static uint8_t TraceError[2] = {0U, 0U}; /* Trace Error flags (banked) */
 static uint8_t TraceError_n = 0U;        /* Active Trace Error bank */
 
 // Trace Buffer
-static uint8_t TraceBuf[SWO_BUFFER_SIZE];   /* Trace Buffer (must be 2^n) */
+static uint8_t TraceBufInternal[SWO_BUFFER_SIZE] __attribute__((aligned(4)));
+static uint8_t *TraceBuf = TraceBufInternal;  /* Trace Buffer (must be 2^n) */
+static uint32_t TraceSize = SWO_BUFFER_SIZE;  /* Trace Buffer size */
+static uint8_t TraceExternal = 0U;            /* Trace Buffer is in PSRAM */
 static volatile uint32_t TraceIn = 0U;      /* Incoming Trace Index */
 static volatile uint32_t TraceOut = 0U;     /* Outgoing Trace Index */
 static volatile uint32_t TracePending = 0U; /* Pending Trace Count */
 
+// Trace Watermarks
+static volatile uint8_t TraceHigh = 0U;     /* Above high watermark until below low */
+static volatile uint8_t TraceHighHit = 0U;  /* High watermark crossed since last read */
+static volatile uint32_t TracePeak = 0U;    /* Peak fill level since last read */
+
+#if (TIMESTAMP_CLOCK != 0U)
+// Trace Timestamp
+static volatile struct
+{
+  uint32_t index;
+  uint32_t tick;
+} TraceTimestamp;
+static volatile uint8_t TraceUpdate; /* Trace Update Flag */
+#endif
+
 // Trace Helper functions
 static void ClearTrace(void);
 static uint32_t GetTraceSpace(void);
 static uint32_t GetTraceCount(void);
 static uint8_t GetTraceStatus(void);
 static void SetTraceError(uint8_t flag);
+static uint32_t TraceStore(uint32_t in, uint8_t data);
+static void TraceLevel(void);
+static void ResumeTrace(void);
+static void NotifyStream(void);
 
 #if (SWO_UART != 0)
 
-// USART Driver Callback function
-//   event: event mask
-static void USART_Callback(uint32_t event)
+// UART SWO receive task: moves bytes from the UART driver into TraceBuf.
+// Only this task advances TraceIn while capture runs; it parks (and gives
+// UART_SWO_Parked) whenever UART_SWO_Run is cleared.
+static void UART_SWO_Task(void *arg)
 {
+  uart_event_t event;
   uint32_t count;
+  int n;
+
+  (void)arg;
 
-  if (event & ARM_USART_EVENT_RECEIVE_COMPLETE)
+  while (1)
   {
-    TracePending = 0U;
-    TraceIn += pUSART->GetRxCount();
+    if (!UART_SWO_Run)
+    {
+      xSemaphoreGive(UART_SWO_Parked);
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+
+    while (xQueueReceive(UART_SWO_Events, &event, 0) == pdTRUE)
+    {
+      switch (event.type)
+      {
+      case UART_FIFO_OVF:
+      case UART_BUFFER_FULL:
+        SetTraceError(DAP_SWO_BUFFER_OVERRUN);
+        break;
+      case UART_BREAK:
+      case UART_FRAME_ERR:
+      case UART_PARITY_ERR:
+        SetTraceError(DAP_SWO_STREAM_ERROR);
+        break;
+      default:
+        break;
+      }
+    }
+
     count = GetTraceSpace();
-    if (count != 0U)
+    if (count == 0U)
     {
-      pUSART->Receive(&TraceBuf[TraceIn & (SWO_BUFFER_SIZE - 1U)], count);
+      // Trace buffer full, wait for SWO_Data to make room
+      TraceStatus = DAP_SWO_CAPTURE_ACTIVE | DAP_SWO_CAPTURE_PAUSED;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SWO_UART_POLL_MS));
+      continue;
+    }
+    if (TraceStatus != DAP_SWO_CAPTURE_ACTIVE)
+    {
+      TraceStatus = DAP_SWO_CAPTURE_ACTIVE;
+    }
+
+    if (ITM_FilterEnabled())
+    {
+      // Packets are reassembled and filtered on the way into TraceBuf
+      if (count > SWO_UART_STAGE_SIZE)
+      {
+        count = SWO_UART_STAGE_SIZE;
+      }
+      n = uart_read_bytes(SWO_UART_PORT, UART_SWO_Stage, count, pdMS_TO_TICKS(SWO_UART_POLL_MS));
+      if (n > 0)
+      {
+        uint32_t in = TraceIn;
+        int i;
+
+        for (i = 0; i < n; i++)
+        {
+          in = TraceStore(in, UART_SWO_Stage[i]);
+        }
+        n = (int)(in - TraceIn);
+      }
     }
     else
     {
-      TraceStatus = DAP_SWO_CAPTURE_ACTIVE | DAP_SWO_CAPTURE_PAUSED;
+      n = uart_read_bytes(SWO_UART_PORT, &TraceBuf[TraceIn & (TraceSize - 1U)], count,
+                          pdMS_TO_TICKS(SWO_UART_POLL_MS));
+    }
+    if (n > 0)
+    {
+      TraceIn += (uint32_t)n;
+#if (TIMESTAMP_CLOCK != 0U)
+      TraceUpdate = 1U;
+      TraceTimestamp.index = TraceIn;
+      TraceTimestamp.tick = TIMESTAMP_GET();
+#endif
+      TraceLevel();
+      NotifyStream();
     }
   }
-  if (event & ARM_USART_EVENT_RX_OVERFLOW)
-  {
-    SetTraceError(DAP_SWO_BUFFER_OVERRUN);
-  }
-  if (event & (ARM_USART_EVENT_RX_BREAK |
-               ARM_USART_EVENT_RX_FRAMING_ERROR |
-               ARM_USART_EVENT_RX_PARITY_ERROR))
+}
+
+// Park the receive task and wait until it no longer touches TraceBuf
+static void UART_SWO_Stop(void)
+{
+  if ((UART_SWO_TaskHandle == NULL) || !UART_SWO_Run)
   {
-    SetTraceError(DAP_SWO_STREAM_ERROR);
+    UART_SWO_Run = 0U;
+    return;
   }
+
+  xSemaphoreTake(UART_SWO_Parked, 0);
+  UART_SWO_Run = 0U;
+  xTaskNotifyGive(UART_SWO_TaskHandle);
+  xSemaphoreTake(UART_SWO_Parked, pdMS_TO_TICKS(4U * SWO_UART_POLL_MS + 10U));
 }
 
 // Enable or disable UART SWO Mode
@@ -103,29 +271,56 @@ static void USART_Callback(uint32_t event)
 //   return: 1 - Success, 0 - Error
 __weak uint32_t UART_SWO_Mode(uint32_t enable)
 {
-  int32_t status;
+  uart_config_t config = {
+      .baud_rate = 115200,
+      .data_bits = UART_DATA_8_BITS,
+      .parity = UART_PARITY_DISABLE,
+      .stop_bits = UART_STOP_BITS_1,
+      .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+      .source_clk = UART_SCLK_DEFAULT,
+  };
 
   USART_Ready = 0U;
 
+  UART_SWO_Stop();
+  if (uart_is_driver_installed(SWO_UART_PORT))
+  {
+    uart_driver_delete(SWO_UART_PORT);
+  }
+
   if (enable)
   {
-    status = pUSART->Initialize(USART_Callback);
-    if (status != ARM_DRIVER_OK)
+    if (UART_SWO_Parked == NULL)
+    {
+      UART_SWO_Parked = xSemaphoreCreateBinary();
+      if (UART_SWO_Parked == NULL)
+      {
+        return (0U);
+      }
+    }
+    if (uart_driver_install(SWO_UART_PORT, SWO_UART_RX_BUF_SIZE, 0, SWO_UART_EVT_QUEUE,
+                            &UART_SWO_Events, 0) != ESP_OK)
     {
       return (0U);
     }
-    status = pUSART->PowerControl(ARM_POWER_FULL);
-    if (status != ARM_DRIVER_OK)
+    if ((uart_param_config(SWO_UART_PORT, &config) != ESP_OK) ||
+        (uart_set_pin(SWO_UART_PORT, UART_PIN_NO_CHANGE, PIN_SWO,
+                      UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK))
     {
-      pUSART->Uninitialize();
+      uart_driver_delete(SWO_UART_PORT);
       return (0U);
     }
-  }
-  else
-  {
-    pUSART->Control(ARM_USART_ABORT_RECEIVE, 0U);
-    pUSART->PowerControl(ARM_POWER_OFF);
-    pUSART->Uninitialize();
+    if (UART_SWO_TaskHandle == NULL)
+    {
+      if (xTaskCreatePinnedToCore(UART_SWO_Task, "swo_uart", SWO_UART_TASK_STACK, NULL,
+                                  SWO_UART_TASK_PRIO, &UART_SWO_TaskHandle,
+                                  SWO_UART_TASK_CORE) != pdPASS)
+      {
+        UART_SWO_TaskHandle = NULL;
+        uart_driver_delete(SWO_UART_PORT);
+        return (0U);
+      }
+    }
   }
   return (1U);
 }
@@ -135,56 +330,29 @@ __weak uint32_t UART_SWO_Mode(uint32_t enable)
 //   return:   actual baudrate or 0 when not configured
 __weak uint32_t UART_SWO_Baudrate(uint32_t baudrate)
 {
-  int32_t status;
-  uint32_t count;
+  uint32_t actual;
 
   if (baudrate > SWO_UART_MAX_BAUDRATE)
   {
     baudrate = SWO_UART_MAX_BAUDRATE;
   }
 
-  if (TraceStatus & DAP_SWO_CAPTURE_ACTIVE)
-  {
-    pUSART->Control(ARM_USART_CONTROL_RX, 0U);
-    if (pUSART->GetStatus().rx_busy)
-    {
-      TracePending = 0U;
-      TraceIn += pUSART->GetRxCount();
-      pUSART->Control(ARM_USART_ABORT_RECEIVE, 0U);
-    }
-  }
-
-  status = pUSART->Control(ARM_USART_MODE_ASYNCHRONOUS |
-                               ARM_USART_DATA_BITS_8 |
-                               ARM_USART_PARITY_NONE |
-                               ARM_USART_STOP_BITS_1,
-                           baudrate);
-
-  if (status == ARM_DRIVER_OK)
-  {
-    USART_Ready = 1U;
-  }
-  else
+  if (!uart_is_driver_installed(SWO_UART_PORT) ||
+      (uart_set_baudrate(SWO_UART_PORT, baudrate) != ESP_OK) ||
+      (uart_get_baudrate(SWO_UART_PORT, &actual) != ESP_OK))
   {
     USART_Ready = 0U;
-    baudrate = 0U;
+    return (0U);
   }
 
-  if ((TraceStatus & DAP_SWO_CAPTURE_ACTIVE) && USART_Ready)
+  // Bytes received at the old rate are garbage
+  if (TraceStatus & DAP_SWO_CAPTURE_ACTIVE)
   {
-    pUSART->Control(ARM_USART_CONTROL_RX, 1U);
-    count = GetTraceSpace();
-    if (count != 0U)
-    {
-      pUSART->Receive(&TraceBuf[TraceIn & (SWO_BUFFER_SIZE - 1U)], count);
-    }
-    else
-    {
-      TraceStatus = DAP_SWO_CAPTURE_ACTIVE | DAP_SWO_CAPTURE_PAUSED;
-    }
+    uart_flush_input(SWO_UART_PORT);
   }
 
-  return (baudrate);
+  USART_Ready = 1U;
+  return (actual);
 }
 
 // Control UART SWO Capture
@@ -192,34 +360,20 @@ __weak uint32_t UART_SWO_Baudrate(uint32_t baudrate)
 //   return: 1 - Success, 0 - Error
 __weak uint32_t UART_SWO_Control(uint32_t active)
 {
-  int32_t status;
-
   if (active)
   {
-    if (!USART_Ready)
-    {
-      return (0U);
-    }
-    status = pUSART->Control(ARM_USART_CONTROL_RX, 1U);
-    if (status != ARM_DRIVER_OK)
-    {
-      return (0U);
-    }
-    status = pUSART->Receive(TraceBuf, SWO_BUFFER_SIZE);
-    if (status != ARM_DRIVER_OK)
+    if (!USART_Ready || (UART_SWO_TaskHandle == NULL))
     {
       return (0U);
     }
+    uart_flush_input(SWO_UART_PORT);
+    xQueueReset(UART_SWO_Events);
+    UART_SWO_Run = 1U;
+    xTaskNotifyGive(UART_SWO_TaskHandle);
   }
   else
   {
-    pUSART->Control(ARM_USART_CONTROL_RX, 0U);
-    if (pUSART->GetStatus().rx_busy)
-    {
-      TracePending = 0U;
-      TraceIn += pUSART->GetRxCount();
-      pUSART->Control(ARM_USART_ABORT_RECEIVE, 0U);
-    }
+    UART_SWO_Stop();
   }
   return (1U);
 }
@@ -229,33 +383,409 @@ __weak uint32_t UART_SWO_Control(uint32_t active)
 //   count: number of bytes to capture
 __weak void UART_SWO_Capture(uint8_t *buf, uint32_t count)
 {
-  pUSART->Receive(buf, count);
+  (void)buf;
+  (void)count;
+
+  // The receive task picks up the free space itself
+  if (UART_SWO_TaskHandle != NULL)
+  {
+    xTaskNotifyGive(UART_SWO_TaskHandle);
+  }
 }
 
 // Update UART SWO Trace Info
 __weak void UART_SWO_Update(void)
 {
-  TracePending = pUSART->GetRxCount();
+  // Received bytes are committed to TraceIn as they are read
+  TracePending = 0U;
 }
 
 #endif /* (SWO_UART != 0) */
 
 #if (SWO_MANCHESTER != 0)
 
+// Manchester decoder state, valid within one frame
+typedef struct
+{
+  int8_t half;   /* First half of the current bit or -1 */
+  int8_t bits;   /* Data bits collected or -1 before the start bit */
+  uint8_t data;  /* Data byte being assembled */
+  uint32_t in;   /* Local copy of TraceIn */
+} Manchester_State_t;
+
+// Append one decoded bit (LSB first) and commit complete bytes
+static void Manchester_Bit(Manchester_State_t *state, uint32_t bit)
+{
+  if (state->bits < 0)
+  {
+    state->bits = 0; /* Start bit */
+    return;
+  }
+  state->data |= (uint8_t)(bit << state->bits);
+  if (++state->bits == 8)
+  {
+    state->in = TraceStore(state->in, state->data);
+    state->bits = 0;
+    state->data = 0U;
+  }
+}
+
+// Feed one half bit period into the decoder
+//   return: 0 - OK, 1 - missing mid-bit transition
+static uint32_t Manchester_Half(Manchester_State_t *state, uint32_t level)
+{
+  if (state->half < 0)
+  {
+    state->half = (int8_t)level;
+    return (0U);
+  }
+  if ((uint32_t)state->half == level)
+  {
+    return (1U);
+  }
+  Manchester_Bit(state, (uint32_t)state->half); /* Bit value is the first half */
+  state->half = -1;
+  return (0U);
+}
+
+// Decode one captured frame into TraceBuf.
+// A frame starts with the start bit (high half bit after idle low) and ends
+// when the line idles low. The start bit's high half sets the bit period,
+// so the decoder follows whatever rate the target actually uses.
+static void Manchester_Decode(const rmt_symbol_word_t *symbol, uint32_t count)
+{
+  Manchester_State_t state;
+  uint32_t unit;
+  uint32_t duration;
+  uint32_t level;
+  uint32_t halves;
+  uint32_t i;
+
+  if ((count == 0U) || (symbol[0].level0 == 0U) || (symbol[0].duration0 == 0U))
+  {
+    SetTraceError(DAP_SWO_STREAM_ERROR);
+    return;
+  }
+  unit = symbol[0].duration0;
+
+  state.half = -1;
+  state.bits = -1;
+  state.data = 0U;
+  state.in = TraceIn;
+
+  for (i = 0U; i < (2U * count); i++)
+  {
+    if (i & 1U)
+    {
+      duration = symbol[i >> 1].duration1;
+      level = symbol[i >> 1].level1;
+    }
+    else
+    {
+      duration = symbol[i >> 1].duration0;
+      level = symbol[i >> 1].level0;
+    }
+    if (duration == 0U)
+    {
+      break; /* End marker */
+    }
+    halves = ((2U * duration) + unit) / (2U * unit);
+    if (halves == 0U)
+    {
+      halves = 1U;
+    }
+    if (halves > 2U)
+    {
+      if (level != 0U)
+      {
+        SetTraceError(DAP_SWO_STREAM_ERROR);
+        break;
+      }
+      break; /* Idle low: the trailing half is completed below */
+    }
+    if (Manchester_Half(&state, level) || ((halves == 2U) && Manchester_Half(&state, level)))
+    {
+      SetTraceError(DAP_SWO_STREAM_ERROR);
+      break;
+    }
+  }
+
+  // Last bit ends with a low half that merges into idle
+  if (state.half == 1)
+  {
+    Manchester_Bit(&state, 1U);
+  }
+  if (state.bits > 0)
+  {
+    SetTraceError(DAP_SWO_STREAM_ERROR); /* Truncated byte */
+  }
+
+  if (state.in != TraceIn)
+  {
+    TraceIn = state.in;
+#if (TIMESTAMP_CLOCK != 0U)
+    TraceUpdate = 1U;
+    TraceTimestamp.index = TraceIn;
+    TraceTimestamp.tick = TIMESTAMP_GET();
+#endif
+    TraceLevel();
+    NotifyStream();
+  }
+}
+
+// RMT receive done: re-arm on a free buffer first, then hand the frame over
+static bool IRAM_ATTR RMT_SWO_Done(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata,
+                                   void *arg)
+{
+  Manchester_Frame_t frame;
+  BaseType_t woken = pdFALSE;
+  uint8_t next;
+
+  (void)arg;
+
+  portENTER_CRITICAL_ISR(&RMT_SWO_Lock);
+  frame.index = RMT_SWO_Next;
+  frame.count = edata->num_symbols;
+  RMT_SWO_Busy[frame.index] = 1U;
+  RMT_SWO_Armed = 0U;
+  next = (frame.index + 1U) % SWO_RMT_BUFFERS;
+  if (RMT_SWO_Run && !RMT_SWO_Busy[next])
+  {
+    if (rmt_receive(channel, RMT_SWO_Buf[next], sizeof(RMT_SWO_Buf[next]), &RMT_SWO_Config) == ESP_OK)
+    {
+      RMT_SWO_Next = next;
+      RMT_SWO_Armed = 1U;
+    }
+  }
+  portEXIT_CRITICAL_ISR(&RMT_SWO_Lock);
+
+  if (xQueueSendFromISR(RMT_SWO_Frames, &frame, &woken) != pdTRUE)
+  {
+    RMT_SWO_Busy[frame.index] = 0U;
+  }
+  return (woken == pdTRUE);
+}
+
+// Claim the first free buffer for the receiver (caller holds RMT_SWO_Lock)
+//   return: buffer index or SWO_RMT_BUFFERS when all are busy
+static uint32_t RMT_SWO_Claim(void)
+{
+  uint32_t n;
+  uint32_t index;
+
+  for (n = 0U; n < SWO_RMT_BUFFERS; n++)
+  {
+    index = (RMT_SWO_Next + n) % SWO_RMT_BUFFERS;
+    if (!RMT_SWO_Busy[index])
+    {
+      RMT_SWO_Next = (uint8_t)index;
+      RMT_SWO_Armed = 1U;
+      return (index);
+    }
+  }
+  return (SWO_RMT_BUFFERS);
+}
+
+// Start the receiver on a claimed buffer. No receive is pending, so the
+// done callback cannot run concurrently.
+static void RMT_SWO_Arm(uint32_t index)
+{
+  if (index >= SWO_RMT_BUFFERS)
+  {
+    return;
+  }
+  if (rmt_receive(RMT_SWO_Channel, RMT_SWO_Buf[index], sizeof(RMT_SWO_Buf[index]),
+                  &RMT_SWO_Config) != ESP_OK)
+  {
+    RMT_SWO_Armed = 0U;
+  }
+}
+
+// Manchester SWO decode task: the only writer of TraceIn while capture runs
+static void RMT_SWO_Task(void *arg)
+{
+  Manchester_Frame_t frame;
+  uint32_t index;
+
+  (void)arg;
+
+  while (1)
+  {
+    if (xQueueReceive(RMT_SWO_Frames, &frame, portMAX_DELAY) != pdTRUE)
+    {
+      continue;
+    }
+    if (frame.index == SWO_RMT_PARK)
+    {
+      // Every frame queued before the marker is finished
+      xSemaphoreGive(RMT_SWO_Parked);
+      continue;
+    }
+    if (RMT_SWO_Run)
+    {
+      if (frame.count >= SWO_RMT_SYMBOLS)
+      {
+        SetTraceError(DAP_SWO_BUFFER_OVERRUN); /* Frame longer than the capture buffer */
+      }
+      Manchester_Decode(RMT_SWO_Buf[frame.index], frame.count);
+    }
+
+    index = SWO_RMT_BUFFERS;
+    portENTER_CRITICAL(&RMT_SWO_Lock);
+    RMT_SWO_Busy[frame.index] = 0U;
+    if (RMT_SWO_Run && !RMT_SWO_Armed)
+    {
+      index = RMT_SWO_Claim();
+    }
+    portEXIT_CRITICAL(&RMT_SWO_Lock);
+    RMT_SWO_Arm(index);
+  }
+}
+
+// Stop the receiver and drop frames not yet decoded
+static void RMT_SWO_Stop(void)
+{
+  Manchester_Frame_t frame;
+  uint32_t n;
+
+  RMT_SWO_Run = 0U;
+  if (RMT_SWO_Channel == NULL)
+  {
+    return;
+  }
+
+  // Disabling the channel is the only way to abort a pending receive
+  rmt_disable(RMT_SWO_Channel);
+  while (xQueueReceive(RMT_SWO_Frames, &frame, 0) == pdTRUE)
+  {
+  }
+  // Wait until the task finished a frame it already dequeued
+  if (RMT_SWO_TaskHandle != NULL)
+  {
+    xSemaphoreTake(RMT_SWO_Parked, 0);
+    frame.index = SWO_RMT_PARK;
+    frame.count = 0U;
+    if (xQueueSend(RMT_SWO_Frames, &frame, 0) == pdTRUE)
+    {
+      xSemaphoreTake(RMT_SWO_Parked, pdMS_TO_TICKS(SWO_RMT_PARK_MS));
+    }
+  }
+  for (n = 0U; n < SWO_RMT_BUFFERS; n++)
+  {
+    RMT_SWO_Busy[n] = 0U;
+  }
+  RMT_SWO_Armed = 0U;
+  rmt_enable(RMT_SWO_Channel);
+}
+
 // Enable or disable Manchester SWO Mode
 //   enable: enable flag
 //   return: 1 - Success, 0 - Error
 __weak uint32_t Manchester_SWO_Mode(uint32_t enable)
 {
-  return (0U);
+  rmt_rx_channel_config_t config = {
+      .gpio_num = PIN_SWO,
+      .clk_src = RMT_CLK_SRC_DEFAULT,
+      .resolution_hz = SWO_RMT_RESOLUTION,
+      .mem_block_symbols = SWO_RMT_SYMBOLS,
+      .flags.with_dma = 1,
+  };
+  rmt_rx_event_callbacks_t callbacks = {
+      .on_recv_done = RMT_SWO_Done,
+  };
+
+  Manchester_Baudrate = 0U;
+
+  if (RMT_SWO_Channel != NULL)
+  {
+    RMT_SWO_Stop();
+    rmt_disable(RMT_SWO_Channel);
+    rmt_del_channel(RMT_SWO_Channel);
+    RMT_SWO_Channel = NULL;
+  }
+
+  if (enable)
+  {
+    if (RMT_SWO_Frames == NULL)
+    {
+      RMT_SWO_Frames = xQueueCreate(SWO_RMT_BUFFERS, sizeof(Manchester_Frame_t));
+      if (RMT_SWO_Frames == NULL)
+      {
+        return (0U);
+      }
+    }
+    if (RMT_SWO_Parked == NULL)
+    {
+      RMT_SWO_Parked = xSemaphoreCreateBinary();
+      if (RMT_SWO_Parked == NULL)
+      {
+        return (0U);
+      }
+    }
+    if (rmt_new_rx_channel(&config, &RMT_SWO_Channel) != ESP_OK)
+    {
+      RMT_SWO_Channel = NULL;
+      return (0U);
+    }
+    if ((rmt_rx_register_event_callbacks(RMT_SWO_Channel, &callbacks, NULL) != ESP_OK) ||
+        (rmt_enable(RMT_SWO_Channel) != ESP_OK))
+    {
+      rmt_del_channel(RMT_SWO_Channel);
+      RMT_SWO_Channel = NULL;
+      return (0U);
+    }
+    if (RMT_SWO_TaskHandle == NULL)
+    {
+      if (xTaskCreatePinnedToCore(RMT_SWO_Task, "swo_rmt", SWO_RMT_TASK_STACK, NULL,
+                                  SWO_RMT_TASK_PRIO, &RMT_SWO_TaskHandle,
+                                  SWO_RMT_TASK_CORE) != pdPASS)
+      {
+        RMT_SWO_TaskHandle = NULL;
+        rmt_disable(RMT_SWO_Channel);
+        rmt_del_channel(RMT_SWO_Channel);
+        RMT_SWO_Channel = NULL;
+        return (0U);
+      }
+    }
+  }
+  return (1U);
 }
 
 // Configure Manchester SWO Baudrate
 //   baudrate: requested baudrate
 //   return:   actual baudrate or 0 when not configured
+// The decoder measures the bit period from every start bit, so the
+// baudrate only sizes the glitch filter and the end-of-frame idle time.
 __weak uint32_t Manchester_SWO_Baudrate(uint32_t baudrate)
 {
-  return (0U);
+  uint32_t half_ns;
+  uint32_t idle_ns;
+
+  if (baudrate > SWO_MANCHESTER_MAX_BAUDRATE)
+  {
+    baudrate = SWO_MANCHESTER_MAX_BAUDRATE;
+  }
+  if ((baudrate == 0U) || (RMT_SWO_Channel == NULL) || RMT_SWO_Run)
+  {
+    return (0U);
+  }
+
+  half_ns = 500000000U / baudrate;
+  idle_ns = 4U * (1000000000U / baudrate); /* Longest in-frame run is one bit period */
+  if (idle_ns > SWO_RMT_MAX_IDLE_NS)
+  {
+    idle_ns = SWO_RMT_MAX_IDLE_NS;
+  }
+  // Below ~40 kbaud a quarter half-bit exceeds what the filter register holds
+  RMT_SWO_Config.signal_range_min_ns = half_ns / 4U;
+  if (RMT_SWO_Config.signal_range_min_ns > SWO_RMT_MAX_FILTER_NS)
+  {
+    RMT_SWO_Config.signal_range_min_ns = SWO_RMT_MAX_FILTER_NS;
+  }
+  RMT_SWO_Config.signal_range_max_ns = idle_ns;
+
+  Manchester_Baudrate = baudrate;
+  return (baudrate);
 }
 
 // Control Manchester SWO Capture
@@ -263,7 +793,30 @@ __weak uint32_t Manchester_SWO_Baudrate(uint32_t baudrate)
 //   return: 1 - Success, 0 - Error
 __weak uint32_t Manchester_SWO_Control(uint32_t active)
 {
-  return (0U);
+  uint32_t index;
+
+  if (active)
+  {
+    if ((Manchester_Baudrate == 0U) || (RMT_SWO_TaskHandle == NULL))
+    {
+      return (0U);
+    }
+    portENTER_CRITICAL(&RMT_SWO_Lock);
+    RMT_SWO_Run = 1U;
+    index = RMT_SWO_Claim();
+    portEXIT_CRITICAL(&RMT_SWO_Lock);
+    RMT_SWO_Arm(index);
+    if (!RMT_SWO_Armed)
+    {
+      RMT_SWO_Run = 0U;
+      return (0U);
+    }
+  }
+  else
+  {
+    RMT_SWO_Stop();
+  }
+  return (1U);
 }
 
 // Start Manchester SWO Capture
@@ -271,11 +824,16 @@ __weak uint32_t Manchester_SWO_Control(uint32_t active)
 //   count: number of bytes to capture
 __weak void Manchester_SWO_Capture(uint8_t *buf, uint32_t count)
 {
+  (void)buf;
+  (void)count;
+  // Frames are decoded straight into TraceBuf, overflow is reported as overrun
 }
 
 // Update Manchester SWO Trace Info
 __weak void Manchester_SWO_Update(void)
 {
+  // Decoded bytes are committed to TraceIn per frame
+  TracePending = 0U;
 }
 
 #endif /* (SWO_MANCHESTER != 0) */
@@ -289,6 +847,9 @@ static void ClearTrace(void)
   TraceIn = 0U;
   TraceOut = 0U;
   TracePending = 0U;
+  TraceHigh = 0U;
+  TraceHighHit = 0U;
+  TracePeak = 0U;
 }
 
 // Get Trace Space
@@ -299,9 +860,9 @@ static uint32_t GetTraceSpace(void)
   uint32_t limit;
   uint32_t count;
 
-  index = TraceIn & (SWO_BUFFER_SIZE - 1U);
-  limit = SWO_BUFFER_SIZE - index;
-  count = SWO_BUFFER_SIZE - (TraceIn - TraceOut);
+  index = TraceIn & (TraceSize - 1U);
+  limit = TraceSize - index;
+  count = TraceSize - (TraceIn - TraceOut);
   if (count > limit)
   {
     count = limit;
@@ -354,6 +915,241 @@ static void SetTraceError(uint8_t flag)
   TraceError[TraceError_n] |= flag;
 }
 
+// Store one received byte, through the ITM filter when enabled
+//   in:     index of the next free byte
+//   data:   received byte
+//   return: index after the stored bytes
+static uint32_t TraceStore(uint32_t in, uint8_t data)
+{
+  uint8_t out[ITM_FILTER_MAX_OUT];
+  uint32_t count;
+  uint32_t n;
+
+  if (ITM_FilterEnabled())
+  {
+    count = ITM_FilterByte(data, out);
+  }
+  else
+  {
+    out[0] = data;
+    count = 1U;
+  }
+
+  for (n = 0U; n < count; n++)
+  {
+    if ((in - TraceOut) >= TraceSize)
+    {
+      SetTraceError(DAP_SWO_BUFFER_OVERRUN);
+      break;
+    }
+    TraceBuf[in & (TraceSize - 1U)] = out[n];
+    in++;
+  }
+
+  return (in);
+}
+
+// Track the fill level against the watermarks after new data was stored
+static void TraceLevel(void)
+{
+  uint32_t level;
+
+  level = TraceIn - TraceOut;
+  if (level > TracePeak)
+  {
+    TracePeak = level;
+  }
+  if (level >= ((TraceSize / 100U) * SWO_WATERMARK_HIGH))
+  {
+    TraceHigh = 1U;
+    TraceHighHit = 1U;
+  }
+  else if (level <= ((TraceSize / 100U) * SWO_WATERMARK_LOW))
+  {
+    TraceHigh = 0U;
+  }
+}
+
+// Move the Trace Buffer to PSRAM when one is fitted (once, capture stopped)
+static void TraceAlloc(void)
+{
+#if (SWO_PSRAM_BUFFER_SIZE != 0U)
+  static uint8_t done = 0U;
+  uint32_t size;
+  uint8_t *buf;
+
+  if (done)
+  {
+    return;
+  }
+  done = 1U;
+
+  for (size = SWO_PSRAM_BUFFER_SIZE; size > SWO_BUFFER_SIZE; size >>= 1)
+  {
+    buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buf != NULL)
+    {
+      TraceBuf = buf;
+      TraceSize = size;
+      TraceExternal = 1U;
+      break;
+    }
+  }
+#endif
+}
+
+// Get Trace Buffer size (reported by DAP_Info)
+//   return: size of the trace buffer in bytes
+uint32_t SWO_BufferSize(void)
+{
+  TraceAlloc();
+  return (TraceSize);
+}
+
+// Resume Trace Capture after the buffer was drained
+static void ResumeTrace(void)
+{
+  uint32_t n;
+
+  if (TraceStatus == (DAP_SWO_CAPTURE_ACTIVE | DAP_SWO_CAPTURE_PAUSED))
+  {
+    n = GetTraceSpace();
+    if (n != 0U)
+    {
+      switch (TraceMode)
+      {
+#if (SWO_UART != 0)
+      case DAP_SWO_UART:
+        UART_SWO_Capture(&TraceBuf[TraceIn & (TraceSize - 1U)], n);
+        TraceStatus = DAP_SWO_CAPTURE_ACTIVE;
+        break;
+#endif
+#if (SWO_MANCHESTER != 0)
+      case DAP_SWO_MANCHESTER:
+        Manchester_SWO_Capture(&TraceBuf[TraceIn & (TraceSize - 1U)], n);
+        TraceStatus = DAP_SWO_CAPTURE_ACTIVE;
+        break;
+#endif
+      default:
+        break;
+      }
+    }
+  }
+}
+
+// Wake the streaming task once a full USB block is buffered
+static void NotifyStream(void)
+{
+#if (SWO_STREAM != 0)
+  if ((TraceTransport == 2U) && (SWO_StreamTaskHandle != NULL) &&
+      ((TraceIn - TraceOut) >= SWO_STREAM_BLOCK))
+  {
+    xTaskNotifyGive(SWO_StreamTaskHandle);
+  }
+#endif
+}
+
+#if (SWO_STREAM != 0)
+
+// SWO streaming task: queues TraceBuf chunks on the SWO endpoint in place.
+// Full blocks go out as soon as they are available, a partial block only
+// after SWO_STREAM_TIMEOUT_MS without new data.
+static void SWO_StreamTask(void *arg)
+{
+  TickType_t timeout;
+  uint32_t flags;
+  uint32_t count;
+  uint32_t index;
+  uint32_t i, n;
+
+  (void)arg;
+
+  timeout = portMAX_DELAY;
+
+  while (1)
+  {
+    flags = ulTaskNotifyTake(pdTRUE, timeout);
+    if (TraceStatus & DAP_SWO_CAPTURE_ACTIVE)
+    {
+      timeout = pdMS_TO_TICKS(SWO_STREAM_TIMEOUT_MS);
+    }
+    else
+    {
+      timeout = portMAX_DELAY;
+      flags = 0U;
+    }
+    if ((TraceTransport != 2U) || (TransferBusy != 0U))
+    {
+      continue;
+    }
+    count = GetTraceCount();
+    if (count == 0U)
+    {
+      continue;
+    }
+    index = TraceOut & (TraceSize - 1U);
+    n = TraceSize - index;
+    if (count > n)
+    {
+      count = n;
+    }
+    if (flags != 0U)
+    {
+      // Woken by new data: send whole blocks only
+      i = index & (SWO_STREAM_BLOCK - 1U);
+      if (i == 0U)
+      {
+        count &= ~(SWO_STREAM_BLOCK - 1U);
+      }
+      else
+      {
+        n = SWO_STREAM_BLOCK - i;
+        if (count >= n)
+        {
+          count = n;
+        }
+        else
+        {
+          count = 0U;
+        }
+      }
+    }
+    if (count != 0U)
+    {
+      TransferSize = count;
+      TransferBusy = 1U;
+      if (TraceExternal)
+      {
+        // USB may not read PSRAM directly; stage through internal RAM
+        if (count > SWO_STREAM_STAGE)
+        {
+          TransferSize = SWO_STREAM_STAGE;
+        }
+        memcpy(SWO_StreamStage, &TraceBuf[index], TransferSize);
+        SWO_QueueTransfer(SWO_StreamStage, TransferSize);
+      }
+      else
+      {
+        SWO_QueueTransfer(&TraceBuf[index], count);
+      }
+    }
+  }
+}
+
+// SWO Transfer complete
+void SWO_TransferComplete(void)
+{
+  TraceOut += TransferSize;
+  TransferBusy = 0U;
+  ResumeTrace();
+  if (SWO_StreamTaskHandle != NULL)
+  {
+    xTaskNotifyGive(SWO_StreamTaskHandle);
+  }
+}
+
+#endif /* (SWO_STREAM != 0) */
+
 // Process SWO Transport command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -374,6 +1170,23 @@ uint32_t SWO_Transport(const uint8_t *request, uint8_t *response)
       TraceTransport = transport;
       result = 1U;
       break;
+#if (SWO_STREAM != 0)
+    case 2:
+      if (SWO_StreamTaskHandle == NULL)
+      {
+        if (xTaskCreatePinnedToCore(SWO_StreamTask, "swo_stream", SWO_STREAM_TASK_STACK, NULL,
+                                    SWO_STREAM_TASK_PRIO, &SWO_StreamTaskHandle,
+                                    SWO_STREAM_TASK_CORE) != pdPASS)
+        {
+          SWO_StreamTaskHandle = NULL;
+          result = 0U;
+          break;
+        }
+      }
+      TraceTransport = transport;
+      result = 1U;
+      break;
+#endif
     default:
       result = 0U;
       break;
@@ -408,6 +1221,8 @@ uint32_t SWO_Mode(const uint8_t *request, uint8_t *response)
 
   mode = *request;
 
+  TraceAlloc();
+
   switch (TraceMode)
   {
 #if (SWO_UART != 0)
@@ -526,7 +1341,15 @@ uint32_t SWO_Control(const uint8_t *request, uint8_t *response)
     if (active)
     {
       ClearTrace();
+      ITM_FilterReset();
+    }
+#if (SWO_STREAM != 0)
+    else if (TransferBusy != 0U)
+    {
+      SWO_AbortTransfer();
+      TransferBusy = 0U;
     }
+#endif
     switch (TraceMode)
     {
 #if (SWO_UART != 0)
@@ -546,6 +1369,12 @@ uint32_t SWO_Control(const uint8_t *request, uint8_t *response)
     if (result != 0U)
     {
       TraceStatus = active;
+#if (SWO_STREAM != 0)
+      if (SWO_StreamTaskHandle != NULL)
+      {
+        xTaskNotifyGive(SWO_StreamTaskHandle);
+      }
+#endif
     }
   }
   else
@@ -604,6 +1433,90 @@ uint32_t SWO_Status(uint8_t *response)
   return (5U);
 }
 
+// Process SWO Extended Status command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t SWO_ExtendedStatus(const uint8_t *request, uint8_t *response)
+{
+  uint8_t cmd;
+  uint8_t status;
+  uint32_t count;
+#if (TIMESTAMP_CLOCK != 0U)
+  uint32_t index;
+  uint32_t tick;
+#endif
+  uint32_t num;
+
+  num = 0U;
+  cmd = *request;
+
+  if (cmd & 0x01U)
+  {
+    status = GetTraceStatus();
+    *response++ = status;
+    num += 1U;
+  }
+
+  if (cmd & 0x02U)
+  {
+    count = GetTraceCount();
+    *response++ = (uint8_t)(count >> 0);
+    *response++ = (uint8_t)(count >> 8);
+    *response++ = (uint8_t)(count >> 16);
+    *response++ = (uint8_t)(count >> 24);
+    num += 4U;
+  }
+
+#if (TIMESTAMP_CLOCK != 0U)
+  if (cmd & 0x04U)
+  {
+    do
+    {
+      TraceUpdate = 0U;
+      index = TraceTimestamp.index;
+      tick = TraceTimestamp.tick;
+    } while (TraceUpdate != 0U);
+    *response++ = (uint8_t)(index >> 0);
+    *response++ = (uint8_t)(index >> 8);
+    *response++ = (uint8_t)(index >> 16);
+    *response++ = (uint8_t)(index >> 24);
+    *response++ = (uint8_t)(tick >> 0);
+    *response++ = (uint8_t)(tick >> 8);
+    *response++ = (uint8_t)(tick >> 16);
+    *response++ = (uint8_t)(tick >> 24);
+    num += 8U;
+  }
+#endif
+
+  // Vendor extension: watermark flags, peak fill level and buffer size
+  if (cmd & 0x08U)
+  {
+    count = TraceIn - TraceOut;
+    if (TraceHigh && (count <= ((TraceSize / 100U) * SWO_WATERMARK_LOW)))
+    {
+      TraceHigh = 0U;
+    }
+    status = (uint8_t)(TraceHigh | (TraceHighHit << 1));
+    TraceHighHit = 0U;
+    count = TracePeak;
+    TracePeak = TraceIn - TraceOut;
+    *response++ = status;
+    *response++ = (uint8_t)(count >> 0);
+    *response++ = (uint8_t)(count >> 8);
+    *response++ = (uint8_t)(count >> 16);
+    *response++ = (uint8_t)(count >> 24);
+    *response++ = (uint8_t)(TraceSize >> 0);
+    *response++ = (uint8_t)(TraceSize >> 8);
+    *response++ = (uint8_t)(TraceSize >> 16);
+    *response++ = (uint8_t)(TraceSize >> 24);
+    num += 9U;
+  }
+
+  return ((1U << 16) | num);
+}
+
 // Process SWO Data command and prepare response
 //   request:  pointer to request data
 //   response: pointer to response data
@@ -657,33 +1570,10 @@ uint32_t SWO_Data(const uint8_t *request, uint8_t *response)
 
   for (n = count; n; n--)
   {
-    *response++ = TraceBuf[TraceOut++ & (SWO_BUFFER_SIZE - 1U)];
+    *response++ = TraceBuf[TraceOut++ & (TraceSize - 1U)];
   }
 
-  if (TraceStatus == (DAP_SWO_CAPTURE_ACTIVE | DAP_SWO_CAPTURE_PAUSED))
-  {
-    n = GetTraceSpace();
-    if (n != 0U)
-    {
-      switch (TraceMode)
-      {
-#if (SWO_UART != 0)
-      case DAP_SWO_UART:
-        UART_SWO_Capture(&TraceBuf[TraceIn & (SWO_BUFFER_SIZE - 1U)], n);
-        TraceStatus = DAP_SWO_CAPTURE_ACTIVE;
-        break;
-#endif
-#if (SWO_MANCHESTER != 0)
-      case DAP_SWO_MANCHESTER:
-        Manchester_SWO_Capture(&TraceBuf[TraceIn & (SWO_BUFFER_SIZE - 1U)], n);
-        TraceStatus = DAP_SWO_CAPTURE_ACTIVE;
-        break;
-#endif
-      default:
-        break;
-      }
-    }
-  }
+  ResumeTrace();
 
   return ((2U << 16) | (3U + count));
 }
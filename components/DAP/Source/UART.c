@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2021 ARM Limited. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----------------------------------------------------------------------
+ *
+ * Title:        UART.c CMSIS-DAP UART
+ *
+ *---------------------------------------------------------------------------*/
+
+/*
+ * ESP32-S3 port: the target UART is driven by the ESP-IDF UART driver.
+ * Its interrupt handler drains the hardware FIFO into a receive ring and
+ * refills it from a transmit ring, both sized to DAP_UART_RX/TX_BUFFER_SIZE,
+ * so DAP_UART_Transfer only copies between the rings and the DAP packet
+ * and never waits for the line.
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+
+#if (DAP_UART != 0)
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+
+#define DAP_UART_EVT_QUEUE      8U
+#define DAP_UART_TX_OVERHEAD    32U     // Ring item headers added by uart_write_bytes
+
+// UART Configure Control bits
+#define UART_CFG_DATA_BITS_Msk  (3U << 0)
+#define UART_CFG_DATA_BITS_8    (0U << 0)
+#define UART_CFG_DATA_BITS_7    (1U << 0)
+#define UART_CFG_DATA_BITS_6    (2U << 0)
+#define UART_CFG_DATA_BITS_5    (3U << 0)
+#define UART_CFG_PARITY_Msk     (3U << 2)
+#define UART_CFG_PARITY_NONE    (0U << 2)
+#define UART_CFG_PARITY_ODD     (1U << 2)
+#define UART_CFG_PARITY_EVEN    (2U << 2)
+#define UART_CFG_STOP_BITS_Msk  (3U << 4)
+#define UART_CFG_STOP_BITS_1    (0U << 4)
+#define UART_CFG_STOP_BITS_1_5  (1U << 4)
+#define UART_CFG_STOP_BITS_2    (2U << 4)
+
+static uint8_t       UartTransport = DAP_UART_TRANSPORT_NONE;
+static uint8_t       UartRxEnabled;
+static uint8_t       UartTxEnabled;
+static uint8_t       UartErrors;        // DAP_UART_STATUS_xxx error flags
+static uint32_t      UartBaudrate = 115200U;
+static uart_word_length_t UartDataBits = UART_DATA_8_BITS;
+static uart_parity_t      UartParity   = UART_PARITY_DISABLE;
+static uart_stop_bits_t   UartStopBits = UART_STOP_BITS_1;
+static QueueHandle_t UartEvents;
+
+
+// Install the UART driver once with the last configured settings (115200 8N1
+// until DAP_UART_Configure changes them)
+static uint32_t UART_Init(void) {
+  uart_config_t config = {
+    .baud_rate  = (int)UartBaudrate,
+    .data_bits  = UartDataBits,
+    .parity     = UartParity,
+    .stop_bits  = UartStopBits,
+    .flow_ctrl  = UART_HW_FLOWCTRL_DISABLE,
+    .source_clk = UART_SCLK_DEFAULT,
+  };
+
+  if (uart_is_driver_installed(DAP_UART_PORT)) {
+    return (1U);
+  }
+  if (uart_driver_install(DAP_UART_PORT, DAP_UART_RX_BUFFER_SIZE, DAP_UART_TX_BUFFER_SIZE,
+                          DAP_UART_EVT_QUEUE, &UartEvents, 0) != ESP_OK) {
+    return (0U);
+  }
+  if ((uart_param_config(DAP_UART_PORT, &config) != ESP_OK) ||
+      (uart_set_pin(DAP_UART_PORT, PIN_UART_TXD, PIN_UART_RXD,
+                    UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)) {
+    uart_driver_delete(DAP_UART_PORT);
+    return (0U);
+  }
+  return (1U);
+}
+
+// Collect line errors reported by the driver
+static void UART_PollEvents(void) {
+  uart_event_t event;
+
+  if (UartEvents == NULL) {
+    return;
+  }
+  while (xQueueReceive(UartEvents, &event, 0) == pdTRUE) {
+    switch (event.type) {
+      case UART_FIFO_OVF:
+      case UART_BUFFER_FULL:
+        UartErrors |= DAP_UART_STATUS_RX_DATA_LOST;
+        break;
+      case UART_FRAME_ERR:
+        UartErrors |= DAP_UART_STATUS_FRAMING_ERROR;
+        break;
+      case UART_PARITY_ERR:
+        UartErrors |= DAP_UART_STATUS_PARITY_ERROR;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Get UART status byte and clear the error flags
+static uint8_t UART_GetStatus(void) {
+  uint8_t status;
+
+  UART_PollEvents();
+  status  = UartErrors;
+  UartErrors = 0U;
+  if (UartRxEnabled) {
+    status |= DAP_UART_STATUS_RX_ENABLED;
+  }
+  if (UartTxEnabled) {
+    status |= DAP_UART_STATUS_TX_ENABLED;
+  }
+  return (status);
+}
+
+// Process UART Transport command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Transport(const uint8_t *request, uint8_t *response) {
+  uint8_t  transport;
+  uint8_t  result = DAP_ERROR;
+
+  transport = *request;
+
+#if (DAP_UART_USB_COM_PORT != 0)
+  // Stop the USB COM port bridge before handing the UART to another transport
+  if ((UartTransport == DAP_UART_TRANSPORT_USB_COM_PORT) &&
+      (transport != DAP_UART_TRANSPORT_USB_COM_PORT)) {
+    if (!USB_COM_PORT_Activate(0U)) {
+      *response = DAP_ERROR;
+      return ((1U << 16) | 1U);
+    }
+    UartTransport = DAP_UART_TRANSPORT_NONE;
+  }
+#endif
+
+  switch (transport) {
+    case DAP_UART_TRANSPORT_NONE:
+      UartRxEnabled = 0U;
+      UartTxEnabled = 0U;
+      UartTransport = transport;
+      result = DAP_OK;
+      break;
+#if (DAP_UART_USB_COM_PORT != 0)
+    case DAP_UART_TRANSPORT_USB_COM_PORT:
+      if (UartTransport == transport) {
+        result = DAP_OK;
+      } else if (UART_Init() && USB_COM_PORT_Activate(1U)) {
+        UartRxEnabled = 0U;
+        UartTxEnabled = 0U;
+        UartTransport = transport;
+        result = DAP_OK;
+      }
+      break;
+#endif
+    case DAP_UART_TRANSPORT_DAP_COMMAND:
+      if (UART_Init()) {
+        UartTransport = transport;
+        result = DAP_OK;
+      }
+      break;
+    default:
+      break;
+  }
+
+  *response = result;
+  return ((1U << 16) | 1U);
+}
+
+// Process UART Configure command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Configure(const uint8_t *request, uint8_t *response) {
+  uart_word_length_t data_bits = UART_DATA_8_BITS;
+  uart_parity_t      parity    = UART_PARITY_DISABLE;
+  uart_stop_bits_t   stop_bits = UART_STOP_BITS_1;
+  uint8_t  control, result = 0U;
+  uint32_t baudrate;
+
+  control  = *request;
+  baudrate = (uint32_t)(*(request+1) <<  0) |
+             (uint32_t)(*(request+2) <<  8) |
+             (uint32_t)(*(request+3) << 16) |
+             (uint32_t)(*(request+4) << 24);
+
+  switch (control & UART_CFG_DATA_BITS_Msk) {
+    case UART_CFG_DATA_BITS_8: data_bits = UART_DATA_8_BITS; break;
+    case UART_CFG_DATA_BITS_7: data_bits = UART_DATA_7_BITS; break;
+    case UART_CFG_DATA_BITS_6: data_bits = UART_DATA_6_BITS; break;
+    case UART_CFG_DATA_BITS_5: data_bits = UART_DATA_5_BITS; break;
+  }
+  switch (control & UART_CFG_PARITY_Msk) {
+    case UART_CFG_PARITY_NONE: parity = UART_PARITY_DISABLE; break;
+    case UART_CFG_PARITY_ODD:  parity = UART_PARITY_ODD;     break;
+    case UART_CFG_PARITY_EVEN: parity = UART_PARITY_EVEN;    break;
+    default: result |= DAP_UART_CFG_ERROR_PARITY; break;
+  }
+  switch (control & UART_CFG_STOP_BITS_Msk) {
+    case UART_CFG_STOP_BITS_1:   stop_bits = UART_STOP_BITS_1;   break;
+    case UART_CFG_STOP_BITS_1_5: stop_bits = UART_STOP_BITS_1_5; break;
+    case UART_CFG_STOP_BITS_2:   stop_bits = UART_STOP_BITS_2;   break;
+    default: result |= DAP_UART_CFG_ERROR_STOP_BITS; break;
+  }
+
+  if (!UART_Init()) {
+    result |= DAP_UART_CFG_ERROR_DATA_BITS | DAP_UART_CFG_ERROR_PARITY | DAP_UART_CFG_ERROR_STOP_BITS;
+    baudrate = 0U;
+  } else if (result == 0U) {
+    if ((uart_set_word_length(DAP_UART_PORT, data_bits) != ESP_OK)) {
+      result |= DAP_UART_CFG_ERROR_DATA_BITS;
+    } else {
+      UartDataBits = data_bits;
+    }
+    if ((uart_set_parity(DAP_UART_PORT, parity) != ESP_OK)) {
+      result |= DAP_UART_CFG_ERROR_PARITY;
+    } else {
+      UartParity = parity;
+    }
+    if ((uart_set_stop_bits(DAP_UART_PORT, stop_bits) != ESP_OK)) {
+      result |= DAP_UART_CFG_ERROR_STOP_BITS;
+    } else {
+      UartStopBits = stop_bits;
+    }
+    if ((baudrate == 0U) ||
+        (uart_set_baudrate(DAP_UART_PORT, baudrate) != ESP_OK) ||
+        (uart_get_baudrate(DAP_UART_PORT, &baudrate) != ESP_OK)) {
+      baudrate = 0U;
+    } else {
+      UartBaudrate = baudrate;
+    }
+  } else {
+    baudrate = 0U;
+  }
+
+  *response++ = result;
+  *response++ = (uint8_t)(baudrate >>  0);
+  *response++ = (uint8_t)(baudrate >>  8);
+  *response++ = (uint8_t)(baudrate >> 16);
+  *response   = (uint8_t)(baudrate >> 24);
+
+  return ((5U << 16) | 5U);
+}
+
+// Process UART Control command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Control(const uint8_t *request, uint8_t *response) {
+  uint8_t control;
+  uint8_t result = DAP_ERROR;
+
+  control = *request;
+
+  if (UartTransport == DAP_UART_TRANSPORT_DAP_COMMAND) {
+    result = DAP_OK;
+
+    if (control & DAP_UART_CONTROL_RX_DISABLE) {
+      UartRxEnabled = 0U;
+    }
+    if ((control & DAP_UART_CONTROL_RX_ENABLE) && !UartRxEnabled) {
+      // Start from an empty ring, data received while disabled is dropped
+      uart_flush_input(DAP_UART_PORT);
+      UART_PollEvents();
+      UartErrors = 0U;
+      UartRxEnabled = 1U;
+    }
+    if (control & DAP_UART_CONTROL_RX_BUF_FLUSH) {
+      uart_flush_input(DAP_UART_PORT);
+    }
+
+    if (control & DAP_UART_CONTROL_TX_DISABLE) {
+      UartTxEnabled = 0U;
+    }
+    if (control & DAP_UART_CONTROL_TX_ENABLE) {
+      UartTxEnabled = 1U;
+    }
+    if (control & DAP_UART_CONTROL_TX_BUF_FLUSH) {
+      // The driver cannot drop queued TX data; reinstall it, UART_Init
+      // restores the configured baudrate and framing
+      uart_driver_delete(DAP_UART_PORT);
+      if (!UART_Init()) {
+        result = DAP_ERROR;
+      }
+    }
+  }
+
+  *response = result;
+  return ((1U << 16) | 1U);
+}
+
+// Process UART Status command and prepare response
+//   response: pointer to response data
+//   return:   number of bytes in response
+uint32_t UART_Status(uint8_t *response) {
+  size_t  rx_cnt = 0U;
+  size_t  tx_free = DAP_UART_TX_BUFFER_SIZE;
+  uint32_t tx_cnt;
+  uint8_t status;
+
+  if (uart_is_driver_installed(DAP_UART_PORT)) {
+    uart_get_buffered_data_len(DAP_UART_PORT, &rx_cnt);
+    uart_get_tx_buffer_free_size(DAP_UART_PORT, &tx_free);
+  }
+  tx_cnt = (tx_free < DAP_UART_TX_BUFFER_SIZE) ? (DAP_UART_TX_BUFFER_SIZE - tx_free) : 0U;
+  status = UART_GetStatus();
+
+  *response++ = status;
+  *response++ = (uint8_t)(rx_cnt >>  0);
+  *response++ = (uint8_t)(rx_cnt >>  8);
+  *response++ = (uint8_t)(rx_cnt >> 16);
+  *response++ = (uint8_t)(rx_cnt >> 24);
+  *response++ = (uint8_t)(tx_cnt >>  0);
+  *response++ = (uint8_t)(tx_cnt >>  8);
+  *response++ = (uint8_t)(tx_cnt >> 16);
+  *response   = (uint8_t)(tx_cnt >> 24);
+
+  return (9U);
+}
+
+// Process UART Transfer command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t UART_Transfer(const uint8_t *request, uint8_t *response) {
+  uint32_t tx_req, tx_cnt = 0U, rx_cnt = 0U;
+  size_t   n;
+  int      len;
+
+  tx_req = (uint32_t)(*(request+0) << 0) |
+           (uint32_t)(*(request+1) << 8);
+  if (tx_req > (DAP_PACKET_SIZE - 3U)) {
+    tx_req = DAP_PACKET_SIZE - 3U;
+  }
+
+  if (UartTransport == DAP_UART_TRANSPORT_DAP_COMMAND) {
+    // Receive: as much as fits behind the 6 byte header
+    if (UartRxEnabled &&
+        (uart_get_buffered_data_len(DAP_UART_PORT, &n) == ESP_OK) && (n != 0U)) {
+      if (n > (DAP_PACKET_SIZE - 6U)) {
+        n = DAP_PACKET_SIZE - 6U;
+      }
+      len = uart_read_bytes(DAP_UART_PORT, response + 5, (uint32_t)n, 0);
+      if (len > 0) {
+        rx_cnt = (uint32_t)len;
+      }
+    }
+
+    // Transmit: uart_write_bytes has no non-blocking form, it waits for ring
+    // space for its item header and the data. Clamping to the free space less
+    // those headers keeps it from waiting unless the ring is fragmented.
+    if (UartTxEnabled && (tx_req != 0U) &&
+        (uart_get_tx_buffer_free_size(DAP_UART_PORT, &n) == ESP_OK)) {
+      n = (n > DAP_UART_TX_OVERHEAD) ? (n - DAP_UART_TX_OVERHEAD) : 0U;
+      tx_cnt = (tx_req < n) ? tx_req : (uint32_t)n;
+      if (tx_cnt != 0U) {
+        len = uart_write_bytes(DAP_UART_PORT, request + 2, tx_cnt);
+        tx_cnt = (len > 0) ? (uint32_t)len : 0U;
+      }
+    }
+  }
+
+  *(response+0) = UART_GetStatus();
+  *(response+1) = (uint8_t)(tx_cnt >> 0);
+  *(response+2) = (uint8_t)(tx_cnt >> 8);
+  *(response+3) = (uint8_t)(rx_cnt >> 0);
+  *(response+4) = (uint8_t)(rx_cnt >> 8);
+
+  return (((2U + tx_req) << 16) | (5U + rx_cnt));
+}
+
+#endif /* DAP_UART */
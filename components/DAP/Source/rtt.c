@@ -0,0 +1,375 @@
+/**
+ * @file    rtt.c
+ * @brief   SEGGER RTT compatible control block access through swd_host
+ *
+ * The control block is located by scanning target RAM for the "SEGGER RTT"
+ * identifier. Once found, the up/down buffer descriptors are cached and only
+ * the WrOff/RdOff words are polled, so each transfer costs one 8 byte read,
+ * one data block read/write and one offset update.
+ *
+ * All functions expect the debug port to be initialised (swd_init_debug) and
+ * must not run concurrently with other users of swd_host.
+ */
+
+#include <string.h>
+#include "swd_host.h"
+#include "rtt.h"
+
+#define RTT_ID_LEN              (16)    // acID[16]
+#define RTT_MATCH_LEN           (11)    // "SEGGER RTT" plus terminating zero
+#define RTT_HEADER_LEN          (RTT_ID_LEN + 8)
+#define RTT_DESC_LEN            (24)    // sName, pBuffer, SizeOfBuffer, WrOff, RdOff, Flags
+#define RTT_DESC_BUFFER         (4)
+#define RTT_DESC_WROFF          (12)
+#define RTT_DESC_RDOFF          (16)
+#define RTT_MAX_BUFFERS         (16)    // Sanity limit for MaxNumUp/DownBuffers
+#define RTT_MAX_CHANNELS        (4)     // Descriptors cached per direction
+#define RTT_SCAN_CHUNK          (256)
+
+typedef struct
+{
+	uint32_t desc;      // Descriptor address in target RAM
+	uint32_t buffer;    // pBuffer
+	uint32_t size;      // SizeOfBuffer
+} RTT_CHANNEL;
+
+typedef struct
+{
+	uint32_t search_start;
+	uint32_t search_size;
+	uint32_t scan_offset;
+	uint32_t cb;        // Control block address, 0 if not found
+	uint32_t num_up;
+	uint32_t num_down;
+	uint8_t enabled;
+	RTT_CHANNEL up[RTT_MAX_CHANNELS];
+	RTT_CHANNEL down[RTT_MAX_CHANNELS];
+} RTT_STATE;
+
+static RTT_STATE rtt_state = {
+	.search_start = RTT_DEFAULT_SEARCH_START,
+	.search_size = RTT_DEFAULT_SEARCH_SIZE,
+};
+
+static const uint8_t rtt_id[RTT_MATCH_LEN] = "SEGGER RTT";
+
+static uint32_t array2int(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint8_t rtt_channel_valid(const RTT_CHANNEL *ch)
+{
+	// Buffer pointer must be set and the size must be plausible
+	if ((ch->buffer == 0) || (ch->size < 2) || (ch->size > 0x100000))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint8_t rtt_load_channel(uint32_t desc, RTT_CHANNEL *ch)
+{
+	uint8_t buf[8];
+
+	if (!swd_read_memory(desc + RTT_DESC_BUFFER, buf, sizeof(buf)))
+	{
+		return 0;
+	}
+
+	ch->desc = desc;
+	ch->buffer = array2int(&buf[0]);
+	ch->size = array2int(&buf[4]);
+	return 1;
+}
+
+static uint8_t rtt_load_control_block(uint32_t cb)
+{
+	uint8_t buf[8];
+	uint32_t i, num_up, num_down;
+
+	if (!swd_read_memory(cb + RTT_ID_LEN, buf, sizeof(buf)))
+	{
+		return 0;
+	}
+
+	num_up = array2int(&buf[0]);
+	num_down = array2int(&buf[4]);
+
+	if ((num_up == 0) || (num_up > RTT_MAX_BUFFERS) || (num_down > RTT_MAX_BUFFERS))
+	{
+		return 0;
+	}
+
+	rtt_state.num_up = num_up < RTT_MAX_CHANNELS ? num_up : RTT_MAX_CHANNELS;
+	rtt_state.num_down = num_down < RTT_MAX_CHANNELS ? num_down : RTT_MAX_CHANNELS;
+
+	for (i = 0; i < rtt_state.num_up; i++)
+	{
+		if (!rtt_load_channel(cb + RTT_HEADER_LEN + i * RTT_DESC_LEN, &rtt_state.up[i]))
+		{
+			return 0;
+		}
+	}
+
+	for (i = 0; i < rtt_state.num_down; i++)
+	{
+		if (!rtt_load_channel(cb + RTT_HEADER_LEN + (num_up + i) * RTT_DESC_LEN, &rtt_state.down[i]))
+		{
+			return 0;
+		}
+	}
+
+	// Channel 0 up buffer is always present in a valid control block
+	if (!rtt_channel_valid(&rtt_state.up[0]))
+	{
+		return 0;
+	}
+
+	rtt_state.cb = cb;
+	return 1;
+}
+
+void rtt_configure(uint32_t start, uint32_t size)
+{
+	rtt_state.search_start = start;
+	rtt_state.search_size = size;
+	rtt_reset();
+}
+
+void rtt_enable(uint8_t enable)
+{
+	rtt_state.enabled = enable ? 1 : 0;
+
+	if (!enable)
+	{
+		rtt_reset();
+	}
+}
+
+uint8_t rtt_is_enabled(void)
+{
+	return rtt_state.enabled;
+}
+
+void rtt_reset(void)
+{
+	rtt_state.scan_offset = 0;
+	rtt_state.cb = 0;
+	rtt_state.num_up = 0;
+	rtt_state.num_down = 0;
+}
+
+uint32_t rtt_get_control_block(void)
+{
+	return rtt_state.cb;
+}
+
+// Scan one chunk of the search window. Consecutive chunks overlap so an
+// identifier straddling a chunk boundary is still matched.
+uint8_t rtt_scan(void)
+{
+	uint8_t buf[RTT_SCAN_CHUNK];
+	uint32_t addr, len, i;
+
+	if (rtt_state.cb != 0)
+	{
+		return RTT_SCAN_FOUND;
+	}
+
+	if (rtt_state.scan_offset + RTT_MATCH_LEN > rtt_state.search_size)
+	{
+		return RTT_SCAN_NOT_FOUND;
+	}
+
+	addr = rtt_state.search_start + rtt_state.scan_offset;
+	len = rtt_state.search_size - rtt_state.scan_offset;
+
+	if (len > RTT_SCAN_CHUNK)
+	{
+		len = RTT_SCAN_CHUNK;
+	}
+
+	if (!swd_read_memory(addr, buf, len))
+	{
+		return RTT_SCAN_ERROR;
+	}
+
+	for (i = 0; i + RTT_MATCH_LEN <= len; i++)
+	{
+		if ((buf[i] == 'S') && (memcmp(&buf[i], rtt_id, RTT_MATCH_LEN) == 0))
+		{
+			if (rtt_load_control_block(addr + i))
+			{
+				return RTT_SCAN_FOUND;
+			}
+		}
+	}
+
+	if (len == RTT_SCAN_CHUNK)
+	{
+		rtt_state.scan_offset += RTT_SCAN_CHUNK - (RTT_MATCH_LEN - 1);
+	}
+	else
+	{
+		rtt_state.scan_offset = rtt_state.search_size;
+	}
+
+	return RTT_SCAN_BUSY;
+}
+
+uint8_t rtt_read_up(uint32_t channel, uint8_t *data, uint32_t size, uint32_t *count)
+{
+	RTT_CHANNEL *ch;
+	uint8_t buf[8];
+	uint32_t wr, rd, n, first;
+
+	*count = 0;
+
+	if ((rtt_state.cb == 0) || (channel >= rtt_state.num_up))
+	{
+		return 0;
+	}
+
+	ch = &rtt_state.up[channel];
+
+	if (!swd_read_memory(ch->desc + RTT_DESC_WROFF, buf, sizeof(buf)))
+	{
+		return 0;
+	}
+
+	wr = array2int(&buf[0]);
+	rd = array2int(&buf[4]);
+
+	if ((wr >= ch->size) || (rd >= ch->size))
+	{
+		// Control block got overwritten (target reset or re-init), rescan
+		rtt_reset();
+		return 0;
+	}
+
+	n = (wr >= rd) ? (wr - rd) : (ch->size - rd + wr);
+
+	if (n > size)
+	{
+		n = size;
+	}
+
+	if (n == 0)
+	{
+		return 1;
+	}
+
+	first = ch->size - rd;
+
+	if (first > n)
+	{
+		first = n;
+	}
+
+	if (!swd_read_memory(ch->buffer + rd, data, first))
+	{
+		return 0;
+	}
+
+	if ((n > first) && !swd_read_memory(ch->buffer, data + first, n - first))
+	{
+		return 0;
+	}
+
+	rd += n;
+
+	if (rd >= ch->size)
+	{
+		rd -= ch->size;
+	}
+
+	if (!swd_write_word(ch->desc + RTT_DESC_RDOFF, rd))
+	{
+		return 0;
+	}
+
+	*count = n;
+	return 1;
+}
+
+uint8_t rtt_write_down(uint32_t channel, const uint8_t *data, uint32_t size, uint32_t *count)
+{
+	RTT_CHANNEL *ch;
+	uint8_t buf[8];
+	uint32_t wr, rd, n, first;
+
+	*count = 0;
+
+	if ((rtt_state.cb == 0) || (channel >= rtt_state.num_down))
+	{
+		return 0;
+	}
+
+	ch = &rtt_state.down[channel];
+
+	if (!rtt_channel_valid(ch))
+	{
+		return 0;
+	}
+
+	if (!swd_read_memory(ch->desc + RTT_DESC_WROFF, buf, sizeof(buf)))
+	{
+		return 0;
+	}
+
+	wr = array2int(&buf[0]);
+	rd = array2int(&buf[4]);
+
+	if ((wr >= ch->size) || (rd >= ch->size))
+	{
+		rtt_reset();
+		return 0;
+	}
+
+	// One slot is kept free to tell a full buffer from an empty one
+	n = (rd > wr) ? (rd - wr - 1) : (ch->size - wr + rd - 1);
+
+	if (n > size)
+	{
+		n = size;
+	}
+
+	if (n == 0)
+	{
+		return 1;
+	}
+
+	first = ch->size - wr;
+
+	if (first > n)
+	{
+		first = n;
+	}
+
+	if (!swd_write_memory(ch->buffer + wr, (uint8_t *)data, first))
+	{
+		return 0;
+	}
+
+	if ((n > first) && !swd_write_memory(ch->buffer, (uint8_t *)data + first, n - first))
+	{
+		return 0;
+	}
+
+	wr += n;
+
+	if (wr >= ch->size)
+	{
+		wr -= ch->size;
+	}
+
+	if (!swd_write_word(ch->desc + RTT_DESC_WROFF, wr))
+	{
+		return 0;
+	}
+
+	*count = n;
+	return 1;
+}
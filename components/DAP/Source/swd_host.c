@@ -3,10 +3,14 @@
  * @brief   Host driver for accessing the DAP
  */
 
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "swd_host.h"
 #include "DAP_config.h"
 #include "DAP.h"
 #include "debug_cm.h"
+#include "DAP_retry.h"
 // #include "cmsis_compiler.h"
 // #include "core_cm3.h"
 extern uint32_t Flash_Page_Size;
@@ -29,16 +33,44 @@ extern uint32_t Flash_Page_Size;
 #define DHCSR 0xE000EDF0
 #define REGWnR (1 << 16)
 
-#define MAX_SWD_RETRY 100
-#define MAX_TIMEOUT 100000 // Timeout for syscalls on target
-
-//! This can vary from target to target and should be in the structure or flash blob
+#define SWD_SYSCALL_TIMEOUT_US 10000000 // Budget for a flash algorithm call
+#define SWD_HALT_TIMEOUT_US 1000000     // Budget for a halt request or halt on reset
+#define SWD_HALT_POLL_MIN_US 1          // First pause between DHCSR polls
+#define SWD_HALT_POLL_TICK_US (portTICK_PERIOD_MS * 1000U)
+#define SWD_HALT_POLL_MAX_US SWD_HALT_POLL_TICK_US // Longest pause between DHCSR polls
+
+// Try to reattach to a powered-up SWD DP before the full connect sequence
+#ifndef SWD_FAST_CONNECT
+#define SWD_FAST_CONNECT 1
+#endif
+#define SWD_QUEUE_SIZE 64
+#define SWD_QUEUE_RESERVE 2 // slots kept for the RDBUFF reads swd_queue_flush() appends
+#define SWD_AP_CAPS_MAX 4
+#define SWD_MEM_AP 0 // AP behind swd_read_memory/swd_write_memory
+
+//! Architectural minimum TAR auto-increment range, used until the AP is probed
 #define TARGET_AUTO_INCREMENT_PAGE_SIZE    (1024)
+//! Largest auto-increment range swd_probe_ap() tries to detect
+#define TARGET_AUTO_INCREMENT_PAGE_MAX     (4096)
+
+typedef struct
+{
+	uint32_t idr;       // AP_IDR, 0 for an unused slot
+	uint32_t page;      // TAR auto-increment range in bytes
+	uint8_t apsel;
+	uint8_t packed;     // packed 8/16-bit transfers
+	uint8_t hnonsec;    // CSW.HNONSEC is implemented
+	uint8_t barrier;    // AXI-AP, barrier transactions
+	uint8_t large_addr; // CFG.LA, 64-bit addresses
+} SWD_AP_CAPS;
 
 typedef struct
 {
 	uint32_t select;
 	uint32_t csw;
+	uint32_t tar;       // TAR after the last DRW access, only if tar_valid
+	uint8_t tar_valid;
+	SWD_AP_CAPS ap[SWD_AP_CAPS_MAX];
 } DAP_STATE;
 
 typedef struct
@@ -49,17 +81,33 @@ typedef struct
 
 static DAP_STATE dap_state;
 
-static uint8_t swd_read_core_register(uint32_t n, uint32_t *val);
-static uint8_t swd_write_core_register(uint32_t n, uint32_t val);
+typedef struct
+{
+	uint8_t req;
+	uint32_t data;
+	uint32_t *result;   // receives read data, NULL to discard
+} SWD_QUEUE_ENTRY;
 
-void delaymS(uint32_t ms)
+typedef struct
 {
-	uint32_t cnt = CPU_CLOCK / 4 / 1000 * ms;
+	SWD_QUEUE_ENTRY entry[SWD_QUEUE_SIZE];
+	uint32_t count;
+	uint32_t *pending;  // destination of the posted AP read not yet collected
+	uint8_t overflow;
+	uint32_t error_index;
+	uint8_t error_ack;
+} SWD_QUEUE;
 
-	// To avoid being optimised by the compiler
-	for (volatile uint32_t i = 0; i < cnt; i++)
-	{
-	}
+static SWD_QUEUE swd_queue;
+static portMUX_TYPE swd_queue_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t swd_halt_wait_us;    // duration of the last swd_wait_until_halted
+static swd_syscall_stats_t swd_syscall_stats;
+
+// Reset pulse timing, yields to other tasks like Delayms()
+void delaymS(uint32_t ms)
+{
+	Delayms(ms);
 }
 
 static void int2array(uint8_t *res, uint32_t data, uint8_t len)
@@ -72,21 +120,15 @@ static void int2array(uint8_t *res, uint32_t data, uint8_t len)
 	}
 }
 
-static uint8_t swd_transfer_retry(uint32_t req, uint32_t *data)
+static uint32_t array2int(const uint8_t *res)
 {
-	uint8_t i, ack;
-
-	for (i = 0; i < MAX_SWD_RETRY; i++)
-	{
-		ack = SWD_Transfer(req, data);
-
-		if (ack != DAP_TRANSFER_WAIT)
-		{
-			return ack;
-		}
-	}
+	return ((uint32_t)res[3] << 24) | ((uint32_t)res[2] << 16) | ((uint32_t)res[1] << 8) | res[0];
+}
 
-	return ack;
+// WAIT handling is shared with DAP_Transfer, see DAP_retry.c
+static uint8_t swd_transfer_retry(uint32_t req, uint32_t *data)
+{
+	return SWD_TransferRetry(req, data);
 }
 
 uint8_t swd_init(void)
@@ -142,6 +184,11 @@ uint8_t swd_write_dp(uint8_t adr, uint32_t val)
 			return 1;
 		}
 
+		if ((dap_state.select ^ val) & 0xff000000)
+		{
+			dap_state.tar_valid = 0;
+		}
+
 		dap_state.select = val;
 		break;
 
@@ -156,36 +203,79 @@ uint8_t swd_write_dp(uint8_t adr, uint32_t val)
 	return (ack == 0x01);
 }
 
-// Read access port register.
-uint8_t swd_read_ap(uint32_t adr, uint32_t *val)
+// Read several access port registers back to back.
+// AP reads are posted: each read returns the result of the previous one and
+// RDBUFF collects the last, so count reads cost count + 1 transfers instead
+// of 2 * count. A pending read is drained before SELECT has to change.
+uint8_t swd_read_ap_multiple(const uint32_t *adr, uint32_t *val, uint32_t count)
 {
-	uint8_t tmp_in, ack;
+	uint8_t req;
 	uint8_t tmp_out[4];
-	uint32_t tmp;
-	uint32_t apsel = adr & 0xff000000;
-	uint32_t bank_sel = adr & APBANKSEL;
+	uint32_t i, sel;
+	uint8_t pending = 0;
 
-	if (!swd_write_dp(DP_SELECT, apsel | bank_sel))
+	for (i = 0; i < count; i++)
 	{
-		return 0;
+		sel = (adr[i] & 0xff000000) | (adr[i] & APBANKSEL);
+
+		if (pending && (dap_state.select != sel))
+		{
+			req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+			if (swd_transfer_retry(req, (uint32_t *)tmp_out) != DAP_TRANSFER_OK)
+			{
+				return 0;
+			}
+
+			val[i - 1] = array2int(tmp_out);
+			pending = 0;
+		}
+
+		if (!swd_write_dp(DP_SELECT, sel))
+		{
+			return 0;
+		}
+
+		// DRW reads move TAR behind our back
+		if ((adr[i] & 0xfc) == AP_DRW)
+		{
+			dap_state.tar_valid = 0;
+		}
+
+		req = SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(adr[i]);
+
+		if (swd_transfer_retry(req, (uint32_t *)tmp_out) != DAP_TRANSFER_OK)
+		{
+			return 0;
+		}
+
+		if (pending)
+		{
+			val[i - 1] = array2int(tmp_out);
+		}
+
+		pending = 1;
 	}
 
-	tmp_in = SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(adr);
-	// first dummy read
-	swd_transfer_retry(tmp_in, (uint32_t *)tmp_out);
-	ack = swd_transfer_retry(tmp_in, (uint32_t *)tmp_out);
+	if (pending)
+	{
+		req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
 
-	*val = 0;
-	tmp = tmp_out[3];
-	*val |= (tmp << 24);
-	tmp = tmp_out[2];
-	*val |= (tmp << 16);
-	tmp = tmp_out[1];
-	*val |= (tmp << 8);
-	tmp = tmp_out[0];
-	*val |= (tmp << 0);
+		if (swd_transfer_retry(req, (uint32_t *)tmp_out) != DAP_TRANSFER_OK)
+		{
+			return 0;
+		}
 
-	return (ack == 0x01);
+		val[count - 1] = array2int(tmp_out);
+	}
+
+	return 1;
+}
+
+// Read access port register.
+uint8_t swd_read_ap(uint32_t adr, uint32_t *val)
+{
+	return swd_read_ap_multiple(&adr, val, 1);
 }
 
 // Write access port register
@@ -216,6 +306,12 @@ uint8_t swd_write_ap(uint32_t adr, uint32_t val)
 		break;
 	}
 
+	// DRW writes move TAR behind our back, a TAR write sets it
+	if ((adr & 0xfc) == AP_DRW || (adr & 0xfc) == AP_TAR)
+	{
+		dap_state.tar_valid = 0;
+	}
+
 	req = SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(adr);
 	int2array(data, val, 4);
 
@@ -224,86 +320,397 @@ uint8_t swd_write_ap(uint32_t adr, uint32_t val)
 		return 0;
 	}
 
+	if ((adr & 0xfc) == AP_TAR)
+	{
+		dap_state.tar = val;
+		dap_state.tar_valid = 1;
+	}
+
 	req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
 	ack = swd_transfer_retry(req, NULL);
 
 	return (ack == 0x01);
 }
 
-// Write 32-bit word aligned values to target memory using address auto-increment.
-// size is in bytes.
-static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size)
+static void swd_queue_append(uint8_t req, uint32_t data, uint32_t *result, uint32_t limit)
+{
+	SWD_QUEUE_ENTRY *e;
+
+	if (swd_queue.count >= limit)
+	{
+		swd_queue.overflow = 1;
+		return;
+	}
+
+	e = &swd_queue.entry[swd_queue.count++];
+	e->req = req;
+	e->data = data;
+	e->result = result;
+}
+
+// Queue a raw transfer. Nothing is sent until swd_queue_flush().
+static void swd_queue_push(uint8_t req, uint32_t data, uint32_t *result)
+{
+	swd_queue_append(req, data, result, SWD_QUEUE_SIZE - SWD_QUEUE_RESERVE);
+}
+
+// Collect a posted AP read before a transfer that is not an AP read.
+static void swd_queue_drain(void)
+{
+	if (swd_queue.pending)
+	{
+		swd_queue_push(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), 0, swd_queue.pending);
+		swd_queue.pending = NULL;
+	}
+}
+
+static void swd_queue_select(uint32_t adr)
+{
+	uint32_t sel = (adr & 0xff000000) | (adr & APBANKSEL);
+
+	if (dap_state.select != sel)
+	{
+		swd_queue_drain();
+
+		if ((dap_state.select ^ sel) & 0xff000000)
+		{
+			dap_state.tar_valid = 0;
+		}
+
+		dap_state.select = sel;
+		swd_queue_push(SWD_REG_DP | SWD_REG_W | SWD_REG_ADR(DP_SELECT), sel, NULL);
+	}
+}
+
+void swd_queue_reset(void)
+{
+	swd_queue.count = 0;
+	swd_queue.pending = NULL;
+	swd_queue.overflow = 0;
+}
+
+void swd_queue_read_dp(uint8_t adr, uint32_t *val)
+{
+	swd_queue_drain();
+	swd_queue_push(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(adr), 0, val);
+}
+
+void swd_queue_write_dp(uint8_t adr, uint32_t val)
+{
+	if (adr == DP_SELECT)
+	{
+		swd_queue_select(val);
+		return;
+	}
+
+	swd_queue_drain();
+	swd_queue_push(SWD_REG_DP | SWD_REG_W | SWD_REG_ADR(adr), val, NULL);
+}
+
+// AP reads are posted: the data of this read arrives with the next AP read
+// or with the RDBUFF read inserted before the next other transfer.
+void swd_queue_read_ap(uint32_t adr, uint32_t *val)
+{
+	swd_queue_select(adr);
+
+	if ((adr & 0xfc) == AP_DRW)
+	{
+		dap_state.tar_valid = 0;
+	}
+
+	swd_queue_push(SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(adr), 0, swd_queue.pending);
+	swd_queue.pending = val;
+}
+
+void swd_queue_write_ap(uint32_t adr, uint32_t val)
+{
+	swd_queue_select(adr);
+
+	switch (adr & 0xfc)
+	{
+	case AP_CSW:
+		// only AP0's CSW is cached, as in swd_write_ap()
+		if (adr != AP_CSW)
+		{
+			break;
+		}
+
+		if (dap_state.csw == val)
+		{
+			return;
+		}
+
+		dap_state.csw = val;
+		break;
+
+	case AP_TAR:
+		if (dap_state.tar_valid && (dap_state.tar == val))
+		{
+			return;
+		}
+
+		dap_state.tar = val;
+		dap_state.tar_valid = 1;
+		break;
+
+	case AP_DRW:
+		dap_state.tar_valid = 0;
+		break;
+
+	default:
+		break;
+	}
+
+	swd_queue_drain();
+	swd_queue_push(SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(adr), val, NULL);
+}
+
+// Send the queued transfers back to back. Each transfer runs in its own
+// critical section so interrupts stay off for one transfer only, even at low
+// SWCLK. ACKs are not acted on per request: the first non-OK ACK ends the
+// batch and is kept for swd_queue_error(). A WAIT is resolved by the retry
+// engine before the rest of the batch continues.
+uint8_t swd_queue_flush(void)
+{
+	SWD_QUEUE_ENTRY *e;
+	uint32_t i = 0, value;
+	uint8_t ack = DAP_TRANSFER_OK;
+
+	// the tail reads use the reserved slots, a full queue still completes
+	if (swd_queue.pending)
+	{
+		swd_queue_append(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), 0, swd_queue.pending, SWD_QUEUE_SIZE);
+		swd_queue.pending = NULL;
+	}
+
+	// writes are posted too, make sure the last one completed
+	if (swd_queue.count && !(swd_queue.entry[swd_queue.count - 1].req & SWD_REG_R))
+	{
+		swd_queue_append(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), 0, NULL, SWD_QUEUE_SIZE);
+	}
+
+	if (swd_queue.overflow)
+	{
+		ack = DAP_TRANSFER_ERROR;
+		i = SWD_QUEUE_SIZE;
+	}
+
+	while ((ack == DAP_TRANSFER_OK) && (i < swd_queue.count))
+	{
+		e = &swd_queue.entry[i];
+		value = e->data;
+
+		portENTER_CRITICAL(&swd_queue_lock);
+		ack = SWD_Transfer(e->req, &value);
+		portEXIT_CRITICAL(&swd_queue_lock);
+
+		if (ack == DAP_TRANSFER_WAIT)
+		{
+			value = e->data;
+			ack = swd_transfer_retry(e->req, &value);
+		}
+
+		if (ack == DAP_TRANSFER_OK)
+		{
+			if (e->result)
+			{
+				*e->result = value;
+			}
+
+			i++;
+		}
+	}
+
+	swd_queue.error_index = i;
+	swd_queue.error_ack = ack;
+	swd_queue_reset();
+
+	if (ack != DAP_TRANSFER_OK)
+	{
+		// the caches were updated at enqueue time and can't be trusted now
+		dap_state.select = 0xffffffff;
+		dap_state.csw = 0xffffffff;
+		dap_state.tar_valid = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+// Index and ACK of the transfer that ended the last flush.
+void swd_queue_error(uint32_t *index, uint8_t *ack)
+{
+	*index = swd_queue.error_index;
+	*ack = swd_queue.error_ack;
+}
+
+// Write TAR unless address auto-increment already left it at addr.
+static uint8_t swd_write_tar(uint32_t addr)
 {
 	uint8_t tmp_in[4], req;
-	uint32_t size_in_words;
-	uint32_t i, ack;
 
-	if (size == 0)
+	if (dap_state.tar_valid && (dap_state.tar == addr))
+	{
+		return 1;
+	}
+
+	req = SWD_REG_AP | SWD_REG_W | AP_TAR;
+	int2array(tmp_in, addr, 4);
+
+	if (swd_transfer_retry(req, (uint32_t *)tmp_in) != DAP_TRANSFER_OK)
 	{
+		dap_state.tar_valid = 0;
 		return 0;
 	}
 
-	size_in_words = size / 4;
+	dap_state.tar = addr;
+	dap_state.tar_valid = 1;
+	return 1;
+}
+
+// Capabilities of an AP, NULL if it wasn't probed.
+static SWD_AP_CAPS *swd_ap_caps(uint8_t apsel)
+{
+	uint32_t i;
+
+	for (i = 0; i < SWD_AP_CAPS_MAX; i++)
+	{
+		if (dap_state.ap[i].idr && (dap_state.ap[i].apsel == apsel))
+		{
+			return &dap_state.ap[i];
+		}
+	}
+
+	return NULL;
+}
+
+// TAR auto-increment range of an AP.
+static uint32_t swd_tar_page(uint8_t apsel)
+{
+	const SWD_AP_CAPS *caps = swd_ap_caps(apsel);
+
+	return caps ? caps->page : TARGET_AUTO_INCREMENT_PAGE_SIZE;
+}
+
+// Bytes moved by one DRW access at address with the given CSW. A packed
+// access carries the byte or halfword transfers up to the next word boundary.
+static uint32_t swd_run_width(uint32_t csw, uint32_t address)
+{
+	if ((csw & CSW_ADDRINC) == CSW_PADDRINC)
+	{
+		return 4 - (address & 3);
+	}
+
+	return 1 << (csw & CSW_SIZE);
+}
+
+// Account for size bytes of DRW accesses. Auto-increment is only guaranteed
+// inside the AP's auto-increment page, so the cached TAR is dropped once it
+// leaves the page it started in.
+static void swd_advance_tar(uint32_t size)
+{
+	uint32_t tar;
+	uint32_t page = swd_tar_page(dap_state.select >> 24);
+
+	if (!dap_state.tar_valid || ((dap_state.csw & CSW_ADDRINC) == CSW_NADDRINC))
+	{
+		return;
+	}
+
+	tar = dap_state.tar + size;
+
+	if ((tar ^ dap_state.tar) & ~(page - 1))
+	{
+		dap_state.tar_valid = 0;
+	}
+
+	dap_state.tar = tar;
+}
+
+// Write size bytes as DRW accesses starting at address with CSW and TAR set
+// up once for the whole run. Byte and halfword data is shifted to its byte
+// lane. The run must not cross an auto-increment page.
+static uint8_t swd_write_run(uint32_t csw, uint32_t address, uint8_t *data, uint32_t size)
+{
+	uint8_t tmp[4];
+	uint8_t req, ack;
+	uint32_t n, left;
+
+	if (size == 0)
+	{
+		return 0;
+	}
 
 	// CSW register
-	if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+	if (!swd_write_ap(AP_CSW, csw))
 	{
 		return 0;
 	}
 
 	// TAR write
-	req = SWD_REG_AP | SWD_REG_W | (1 << 2);
-	int2array(tmp_in, address, 4);
-
-	if (swd_transfer_retry(req, (uint32_t *)tmp_in) != 0x01)
+	if (!swd_write_tar(address))
 	{
 		return 0;
 	}
 
 	// DRW write
-	req = SWD_REG_AP | SWD_REG_W | (3 << 2);
+	req = SWD_REG_AP | SWD_REG_W | AP_DRW;
 
-	for (i = 0; i < size_in_words; i++)
+	for (left = size; left > 0; left -= n)
 	{
-		if (swd_transfer_retry(req, (uint32_t *)data) != 0x01)
+		n = swd_run_width(csw, address);
+
+		if (n == 4)
 		{
+			ack = swd_transfer_retry(req, (uint32_t *)data);
+		}
+		else
+		{
+			memset(tmp, 0, sizeof(tmp));
+			memcpy(tmp + (address & 3), data, n);
+			ack = swd_transfer_retry(req, (uint32_t *)tmp);
+		}
+
+		if (ack != DAP_TRANSFER_OK)
+		{
+			dap_state.tar_valid = 0;
 			return 0;
 		}
 
-		data += 4;
+		address += n;
+		data += n;
 	}
 
+	swd_advance_tar(size);
+
 	// dummy read
 	req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
 	ack = swd_transfer_retry(req, NULL);
 	return (ack == 0x01);
 }
 
-// Read 32-bit word aligned values from target memory using address auto-increment.
-// size is in bytes.
-static uint8_t swd_read_block(uint32_t address, uint8_t *data, uint32_t size)
+// Read size bytes as DRW accesses starting at address with CSW and TAR set
+// up once for the whole run. AP reads are posted: every DRW read returns the
+// previous access and RDBUFF collects the last one. The run must not cross an
+// auto-increment page.
+static uint8_t swd_read_run(uint32_t csw, uint32_t address, uint8_t *data, uint32_t size)
 {
-	uint8_t tmp_in[4], req, ack;
-	uint32_t size_in_words;
-	uint32_t i;
+	uint8_t tmp[4];
+	uint8_t req, ack;
+	uint32_t n, left;
 
 	if (size == 0)
 	{
 		return 0;
 	}
 
-	size_in_words = size / 4;
-
-	if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
+	if (!swd_write_ap(AP_CSW, csw))
 	{
 		return 0;
 	}
 
 	// TAR write
-	req = SWD_REG_AP | SWD_REG_W | AP_TAR;
-	int2array(tmp_in, address, 4);
-
-	if (swd_transfer_retry(req, (uint32_t *)tmp_in) != DAP_TRANSFER_OK)
+	if (!swd_write_tar(address))
 	{
 		return 0;
 	}
@@ -314,37 +721,66 @@ static uint8_t swd_read_block(uint32_t address, uint8_t *data, uint32_t size)
 	// initiate first read, data comes back in next read
 	if (swd_transfer_retry(req, NULL) != 0x01)
 	{
+		dap_state.tar_valid = 0;
 		return 0;
 	}
 
-	for (i = 0; i < (size_in_words - 1); i++)
+	for (left = size; left > 0; left -= n)
 	{
-		if (swd_transfer_retry(req, (uint32_t *)data) != DAP_TRANSFER_OK)
+		n = swd_run_width(csw, address);
+
+		// read last access from RDBUFF
+		if (left == n)
+		{
+			req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+		}
+
+		if (n == 4)
+		{
+			ack = swd_transfer_retry(req, (uint32_t *)data);
+		}
+		else
+		{
+			ack = swd_transfer_retry(req, (uint32_t *)tmp);
+			memcpy(data, tmp + (address & 3), n);
+		}
+
+		if (ack != DAP_TRANSFER_OK)
 		{
+			dap_state.tar_valid = 0;
 			return 0;
 		}
 
-		data += 4;
+		address += n;
+		data += n;
 	}
 
-	// read last word
-	req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
-	ack = swd_transfer_retry(req, (uint32_t *)data);
-	return (ack == 0x01);
+	swd_advance_tar(size);
+	return 1;
+}
+
+// Write 32-bit word aligned values to target memory using address auto-increment.
+// size is in bytes.
+static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size)
+{
+	return swd_write_run(CSW_VALUE | CSW_SIZE32, address, data, size);
+}
+
+// Read 32-bit word aligned values from target memory using address auto-increment.
+// size is in bytes.
+static uint8_t swd_read_block(uint32_t address, uint8_t *data, uint32_t size)
+{
+	return swd_read_run(CSW_VALUE | CSW_SIZE32, address, data, size);
 }
 
 // Read target memory.
 static uint8_t swd_read_data(uint32_t addr, uint32_t *val)
 {
-	uint8_t tmp_in[4];
 	uint8_t tmp_out[4];
 	uint8_t req, ack;
 	uint32_t tmp;
-	// put addr in TAR register
-	int2array(tmp_in, addr, 4);
-	req = SWD_REG_AP | SWD_REG_W | (1 << 2);
-
-	if (swd_transfer_retry(req, (uint32_t *)tmp_in) != 0x01) {
+	// put addr in TAR register, skipped when auto-increment already did
+	if (!swd_write_tar(addr)) {
 		return 0;
 	}
 
@@ -352,9 +788,12 @@ static uint8_t swd_read_data(uint32_t addr, uint32_t *val)
 	req = SWD_REG_AP | SWD_REG_R | (3 << 2);
 
 	if (swd_transfer_retry(req, (uint32_t *)tmp_out) != 0x01) {
+		dap_state.tar_valid = 0;
 		return 0;
 	}
 
+	swd_advance_tar(4);
+
 	// dummy read
 	req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
 	ack = swd_transfer_retry(req, (uint32_t *)tmp_out);
@@ -375,11 +814,8 @@ static uint8_t swd_write_data(uint32_t address, uint32_t data)
 {
 	uint8_t tmp_in[4];
 	uint8_t req, ack;
-	// put addr in TAR register
-	int2array(tmp_in, address, 4);
-	req = SWD_REG_AP | SWD_REG_W | (1 << 2);
-
-	if (swd_transfer_retry(req, (uint32_t *)tmp_in) != 0x01)
+	// put addr in TAR register, skipped when auto-increment already did
+	if (!swd_write_tar(address))
 	{
 		return 0;
 	}
@@ -390,9 +826,12 @@ static uint8_t swd_write_data(uint32_t address, uint32_t data)
 
 	if (swd_transfer_retry(req, (uint32_t *)tmp_in) != 0x01)
 	{
+		dap_state.tar_valid = 0;
 		return 0;
 	}
 
+	swd_advance_tar(4);
+
 	// dummy read
 	req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
 	ack = swd_transfer_retry(req, NULL);
@@ -400,7 +839,7 @@ static uint8_t swd_write_data(uint32_t address, uint32_t data)
 }
 
 // Read 32-bit word from target memory.
-static uint8_t swd_read_word(uint32_t addr, uint32_t *val)
+uint8_t swd_read_word(uint32_t addr, uint32_t *val)
 {
 	if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
 	{
@@ -431,66 +870,164 @@ static uint8_t swd_read_word(uint32_t addr, uint32_t *val)
 	return 1;
 }
 
-// Read 8-bit byte from target memory.
-static uint8_t swd_read_byte(uint32_t addr, uint8_t *val)
+// Split the next chunk of a fixed width access. Chunks stay inside one
+// auto-increment page. When the MEM-AP supports packed transfers, the bytes or
+// halfwords up to each word boundary go out as one packed DRW access; a part
+// that ends inside a word uses single transfers, because a packed access
+// would touch the bytes behind it.
+static uint32_t swd_sized_chunk(uint32_t address, uint32_t size, uint32_t width, uint32_t *csw)
 {
-	uint32_t tmp;
+	const SWD_AP_CAPS *caps = swd_ap_caps(SWD_MEM_AP);
+	uint32_t page = swd_tar_page(SWD_MEM_AP);
+	uint32_t n, head;
+
+	n = page - (address & (page - 1));
 
-	if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE8))
+	if (size < n)
 	{
-		return 0;
+		n = size;
 	}
 
-	if (!swd_read_data(addr, &tmp))
+	*csw = CSW_VALUE | ((width == 1) ? CSW_SIZE8 : (width == 2) ? CSW_SIZE16 : CSW_SIZE32);
+
+	if (!caps || !caps->packed || (width == 4))
 	{
-		return 0;
+		return n;
 	}
 
-	*val = (uint8_t)(tmp >> ((addr & 0x03) << 3));
-	return 1;
+	head = (4 - (address & 3)) & 3;
+
+	if (head)
+	{
+		if (n < head)
+		{
+			return n;
+		}
+
+		n = head;
+	}
+	else if (n >= 4)
+	{
+		n &= ~3U;
+	}
+	else
+	{
+		return n;
+	}
+
+	*csw = (*csw & ~CSW_ADDRINC) | CSW_PADDRINC;
+	return n;
 }
 
-// Write 8-bit byte to target memory.
-static uint8_t swd_write_byte(uint32_t addr, uint8_t val)
+// Read target memory with every bus access exactly width bytes wide (1, 2 or
+// 4), for peripheral registers that must not see wider accesses.
+// address and size must be multiples of width.
+uint8_t swd_read_memory_sized(uint32_t address, uint8_t *data, uint32_t size, uint8_t width)
 {
-	uint32_t tmp;
+	uint32_t n, csw;
 
-	if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE8))
+	if (((width != 1) && (width != 2) && (width != 4)) || ((address | size) & (width - 1)))
 	{
 		return 0;
 	}
 
-	tmp = val << ((addr & 0x03) << 3);
+	while (size > 0)
+	{
+		n = swd_sized_chunk(address, size, width, &csw);
+
+		if (!swd_read_run(csw, address, data, n))
+		{
+			return 0;
+		}
+
+		address += n;
+		data += n;
+		size -= n;
+	}
+
+	return 1;
+}
+
+// Write target memory with every bus access exactly width bytes wide (1, 2 or
+// 4). address and size must be multiples of width.
+uint8_t swd_write_memory_sized(uint32_t address, uint8_t *data, uint32_t size, uint8_t width)
+{
+	uint32_t n, csw;
 
-	if (!swd_write_data(addr, tmp))
+	if (((width != 1) && (width != 2) && (width != 4)) || ((address | size) & (width - 1)))
 	{
 		return 0;
 	}
 
+	while (size > 0)
+	{
+		n = swd_sized_chunk(address, size, width, &csw);
+
+		if (!swd_write_run(csw, address, data, n))
+		{
+			return 0;
+		}
+
+		address += n;
+		data += n;
+		size -= n;
+	}
+
 	return 1;
 }
 
+// Access the bytes of an unaligned head or tail, which lie inside one word,
+// as a single run: one halfword access where alignment allows, bytes through
+// the fixed width path otherwise, so a head that reaches the word boundary is
+// a single packed access.
+static uint8_t swd_read_edge(uint32_t address, uint8_t *data, uint32_t size)
+{
+	if (!(address & 1) && !(size & 1))
+	{
+		return swd_read_run(CSW_VALUE | CSW_SIZE16, address, data, size);
+	}
+
+	return swd_read_memory_sized(address, data, size, 1);
+}
+
+static uint8_t swd_write_edge(uint32_t address, uint8_t *data, uint32_t size)
+{
+	if (!(address & 1) && !(size & 1))
+	{
+		return swd_write_run(CSW_VALUE | CSW_SIZE16, address, data, size);
+	}
+
+	return swd_write_memory_sized(address, data, size, 1);
+}
+
 // Read unaligned data from target memory.
 // size is in bytes.
 uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
 {
+	uint32_t page = swd_tar_page(SWD_MEM_AP);
 	uint32_t n;
 
-	// Read bytes until word aligned
-	while ((size > 0) && (address & 0x3)) {
-		if (!swd_read_byte(address, data)) {
+	// Read bytes until word aligned, as one run
+	n = (4 - (address & 0x3)) & 0x3;
+
+	if (n > size) {
+		n = size;
+	}
+
+	if (n > 0) {
+		if (!swd_read_edge(address, data, n)) {
 			return 0;
 		}
 
-		address++;
-		data++;
-		size--;
+		address += n;
+		data += n;
+		size -= n;
 	}
 
 	// Read word aligned blocks
 	while (size > 3) {
 		// Limit to auto increment page size
-		n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
+		n = page - (address & (page - 1));
 
 		if (size < n) {
 			n = size & 0xFFFFFFFC; // Only count complete words remaining
@@ -505,15 +1042,11 @@ uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
 		size -= n;
 	}
 
-	// Read remaining bytes
-	while (size > 0) {
-		if (!swd_read_byte(address, data)) {
+	// Read remaining bytes, as one run
+	if (size > 0) {
+		if (!swd_read_edge(address, data, size)) {
 			return 0;
 		}
-
-		address++;
-		data++;
-		size--;
 	}
 
 	return 1;
@@ -523,156 +1056,244 @@ uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
 // size is in bytes.
 uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size)
 {
+	uint32_t page = swd_tar_page(SWD_MEM_AP);
 	uint32_t n = 0;
 
-	// Write bytes until word aligned
-	while ((size > 0) && (address & 0x3)) {
-		if (!swd_write_byte(address, *data)) {
+	// Write bytes until word aligned, as one run
+	n = (4 - (address & 0x3)) & 0x3;
+
+	if (n > size) {
+		n = size;
+	}
+
+	if (n > 0) {
+		if (!swd_write_edge(address, data, n)) {
 			return 0;
 		}
 
-		address++;
-		data++;
-		size--;
+		address += n;
+		data += n;
+		size -= n;
 	}
 
-	    // Write word aligned blocks
-    while (size > 3) {
-        // Limit to auto increment page size
-        n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
-
-        if (size < n) {
-            n = size & 0xFFFFFFFC; // Only count complete words remaining
-        }
+	// Write word aligned blocks
+	while (size > 3) {
+		// Limit to auto increment page size
+		n = page - (address & (page - 1));
 
-        if (!swd_write_block(address, data, n)) {
-            return 0;
-        }
+		if (size < n) {
+			n = size & 0xFFFFFFFC; // Only count complete words remaining
+		}
 
-        address += n;
-        data += n;
-        size -= n;
-    }
+		if (!swd_write_block(address, data, n)) {
+			return 0;
+		}
 
-    // Write remaining bytes
-    while (size > 0) {
-        if (!swd_write_byte(address, *data)) {
-            return 0;
-        }
+		address += n;
+		data += n;
+		size -= n;
+	}
 
-        address++;
-        data++;
-        size--;
-    }
+	// Write remaining bytes, as one run
+	if (size > 0) {
+		if (!swd_write_edge(address, data, size)) {
+			return 0;
+		}
+	}
 
 	return 1;
 }
 
 // Execute system call.
+// All register writes go out as one queued burst through the banked data
+// registers; S_REGRDY and the sticky error flags are checked once at the end.
 static uint8_t swd_write_debug_state(DEBUG_STATE *state)
 {
-	uint32_t i, status;
+	uint32_t i, status, dhcsr;
 
-	if (!swd_write_dp(DP_SELECT, 0))
+	swd_queue_reset();
+	swd_queue_write_dp(DP_SELECT, 0);
+	swd_queue_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32);
+	swd_queue_write_ap(AP_TAR, DBG_HCSR);
+
+	// R0, R1, R2, R3, R9, R13, R14, R15
+	for (i = 0; i < 16; i++)
+	{
+		if ((i < 4) || (i == 9) || (i >= 13))
+		{
+			swd_queue_write_ap(AP_BD2, state->r[i]);
+			swd_queue_write_ap(AP_BD1, i | REGWnR);
+		}
+	}
+
+	// xPSR
+	swd_queue_write_ap(AP_BD2, state->xpsr);
+	swd_queue_write_ap(AP_BD1, 16 | REGWnR);
+
+	swd_queue_read_ap(AP_BD0, &dhcsr);
+	swd_queue_write_ap(AP_BD0, DBGKEY | C_DEBUGEN);
+	swd_queue_read_dp(DP_RDBUFF, NULL);
+
+	// check status
+	swd_queue_read_dp(DP_CTRL_STAT, &status);
+
+	if (!swd_queue_flush())
 	{
 		return 0;
 	}
 
-	// R0, R1, R2, R3
-	for (i = 0; i < 4; i++)
+	if (!(dhcsr & S_REGRDY))
+	{
+		return 0;
+	}
+
+	if (status & (STICKYERR | WDATAERR))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+// Point TAR at DHCSR so DHCSR, DCRSR and DCRDR are reachable through the
+// banked data registers BD0..BD2 without further TAR writes, then switch
+// SELECT to the BD bank.
+static uint8_t swd_select_debug_regs(void)
+{
+	if (!dap_state.tar_valid || (dap_state.tar != DBG_HCSR) || (dap_state.csw != (CSW_VALUE | CSW_SIZE32)))
 	{
-		if (!swd_write_core_register(i, state->r[i]))
+		if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32))
 		{
 			return 0;
 		}
-	}
-
-	// R9
-	if (!swd_write_core_register(9, state->r[9]))
-	{
-		return 0;
-	}
 
-	// R13, R14, R15
-	for (i = 13; i < 16; i++)
-	{
-		if (!swd_write_core_register(i, state->r[i]))
+		if (!swd_write_tar(DBG_HCSR))
 		{
 			return 0;
 		}
 	}
 
-	// xPSR
-	if (!swd_write_core_register(16, state->xpsr))
-	{
-		return 0;
-	}
+	return swd_write_dp(DP_SELECT, AP_BD0 & APBANKSEL);
+}
+
+// Write banked data register, SELECT must already point at the BD bank.
+static uint8_t swd_write_bd(uint32_t bd, uint32_t val)
+{
+	uint8_t data[4];
+	uint8_t req;
+
+	req = SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(bd);
+	int2array(data, val, 4);
+	return (swd_transfer_retry(req, (uint32_t *)data) == DAP_TRANSFER_OK);
+}
+
+// Post a banked data register read and return the previously posted result.
+static uint8_t swd_read_bd(uint32_t bd, uint32_t *prev)
+{
+	uint8_t tmp_out[4];
+	uint8_t req;
 
-	if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN))
+	req = SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(bd);
+
+	if (swd_transfer_retry(req, (uint32_t *)tmp_out) != DAP_TRANSFER_OK)
 	{
 		return 0;
 	}
 
-	// check status
-	if (!swd_read_dp(DP_CTRL_STAT, &status))
+	if (prev)
 	{
-		return 0;
+		*prev = array2int(tmp_out);
 	}
 
-	if (status & (STICKYERR | WDATAERR))
+	return 1;
+}
+
+// Collect the last posted AP read.
+static uint8_t swd_read_rdbuff(uint32_t *val)
+{
+	uint8_t tmp_out[4];
+	uint8_t req;
+
+	req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+
+	if (swd_transfer_retry(req, (uint32_t *)tmp_out) != DAP_TRANSFER_OK)
 	{
 		return 0;
 	}
 
+	*val = array2int(tmp_out);
 	return 1;
 }
 
-static uint8_t swd_read_core_register(uint32_t n, uint32_t *val)
+uint8_t swd_read_core_register(uint32_t n, uint32_t *val)
 {
 	int i = 0, timeout = 100;
+	uint32_t dhcsr;
 
-	if (!swd_write_word(DCRSR, n))
+	if (!swd_select_debug_regs())
 	{
 		return 0;
 	}
 
-	// wait for S_REGRDY
+	// DCRSR
+	if (!swd_write_bd(AP_BD1, n))
+	{
+		return 0;
+	}
+
+	// post DHCSR read
+	if (!swd_read_bd(AP_BD0, NULL))
+	{
+		return 0;
+	}
+
+	// wait for S_REGRDY, each DHCSR result arrives with the next posted read
 	for (i = 0; i < timeout; i++)
 	{
-		if (!swd_read_word(DHCSR, val))
+		// post DCRDR read, get DHCSR
+		if (!swd_read_bd(AP_BD2, &dhcsr))
 		{
 			return 0;
 		}
 
-		if (*val & S_REGRDY)
+		if (dhcsr & S_REGRDY)
 		{
-			break;
+			return swd_read_rdbuff(val);
+		}
+
+		// post DHCSR read again, DCRDR value is stale
+		if (!swd_read_bd(AP_BD0, NULL))
+		{
+			return 0;
 		}
 	}
 
-	if (i == timeout)
+	return 0;
+}
+
+uint8_t swd_write_core_register(uint32_t n, uint32_t val)
+{
+	int i = 0, timeout = 100;
+
+	if (!swd_select_debug_regs())
 	{
 		return 0;
 	}
 
-	if (!swd_read_word(DCRDR, val))
+	// DCRDR
+	if (!swd_write_bd(AP_BD2, val))
 	{
 		return 0;
 	}
 
-	return 1;
-}
-
-static uint8_t swd_write_core_register(uint32_t n, uint32_t val)
-{
-	int i = 0, timeout = 100;
-
-	if (!swd_write_word(DCRDR, val))
+	// DCRSR
+	if (!swd_write_bd(AP_BD1, n | REGWnR))
 	{
 		return 0;
 	}
 
-	if (!swd_write_word(DCRSR, n | REGWnR))
+	// post DHCSR read
+	if (!swd_read_bd(AP_BD0, NULL))
 	{
 		return 0;
 	}
@@ -680,7 +1301,7 @@ static uint8_t swd_write_core_register(uint32_t n, uint32_t val)
 	// wait for S_REGRDY
 	for (i = 0; i < timeout; i++)
 	{
-		if (!swd_read_word(DHCSR, &val))
+		if (!swd_read_bd(AP_BD0, &val))
 		{
 			return 0;
 		}
@@ -694,25 +1315,66 @@ static uint8_t swd_write_core_register(uint32_t n, uint32_t val)
 	return 0;
 }
 
-static uint8_t swd_wait_until_halted(void)
+// Wait for the core to halt. DHCSR is polled through BD0 (TAR stays on the
+// debug registers) and collected from RDBUFF right away, so every poll sees
+// the current state. The pause between polls doubles up to one tick,
+// keeping the SWD bus quiet during long flash algorithm runs. Pauses
+// shorter than a tick busy-wait, a full tick pause yields to other tasks.
+//   timeout_us: wall-clock budget
+uint8_t swd_wait_until_halted(uint32_t timeout_us)
 {
-	// Wait for target to stop
-	uint32_t val, i, timeout = MAX_TIMEOUT;
+	uint32_t val, pause_us = 0;
+	int64_t start, elapsed;
 
-	for (i = 0; i < timeout; i++)
+	if (!swd_select_debug_regs())
+	{
+		return 0;
+	}
+
+	start = esp_timer_get_time();
+
+	while (1)
 	{
-		if (!swd_read_word(DBG_HCSR, &val))
+		if (!swd_read_bd(AP_BD0, NULL) || !swd_read_rdbuff(&val))
 		{
 			return 0;
 		}
 
+		elapsed = esp_timer_get_time() - start;
+		swd_halt_wait_us = (uint32_t)elapsed;
+
 		if (val & S_HALT)
 		{
 			return 1;
 		}
+
+		if (elapsed >= timeout_us)
+		{
+			return 0;
+		}
+
+		if (pause_us >= SWD_HALT_POLL_TICK_US)
+		{
+			Delayms(portTICK_PERIOD_MS);
+		}
+		else if (pause_us)
+		{
+			esp_rom_delay_us(pause_us);
+		}
+
+		pause_us = pause_us ? pause_us * 2 : SWD_HALT_POLL_MIN_US;
+
+		if (pause_us > SWD_HALT_POLL_MAX_US)
+		{
+			pause_us = SWD_HALT_POLL_MAX_US;
+		}
 	}
+}
 
-	return 0;
+// Wall-clock statistics of flash algorithm calls.
+void swd_get_syscall_stats(swd_syscall_stats_t *stats)
+{
+	*stats = swd_syscall_stats;
 }
 
 uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4)
@@ -734,11 +1396,22 @@ uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t e
 		return 0;
 	}
 
-	if (!swd_wait_until_halted())
+	swd_syscall_stats.calls++;
+
+	if (!swd_wait_until_halted(SWD_SYSCALL_TIMEOUT_US))
 	{
+		swd_syscall_stats.timeouts++;
 		return 0;
 	}
 
+	swd_syscall_stats.last_us = swd_halt_wait_us;
+	swd_syscall_stats.total_us += swd_halt_wait_us;
+
+	if (swd_halt_wait_us > swd_syscall_stats.max_us)
+	{
+		swd_syscall_stats.max_us = swd_halt_wait_us;
+	}
+
 	if (!swd_read_core_register(0, &state.r[0]))
 	{
 		return 0;
@@ -822,16 +1495,274 @@ static uint8_t JTAG2SWD()
 	return 1;
 }
 
+// Forget the cached SELECT, CSW and TAR. Needed before using swd_host on a
+// connection the host has been driving with DAP_Transfer; DAP_Connect and
+// DAP_Disconnect do it for every host session.
+void swd_invalidate_state(void)
+{
+	dap_state.select = 0xffffffff;
+	dap_state.csw = 0xffffffff;
+	dap_state.tar_valid = 0;
+}
+
+// The host's view of the DP and APs, saved around a vendor command that
+// drives swd_host while the host owns the port. SELECT is write-only, the
+// value kept is the last one the host wrote through DAP_Transfer.
+#define SWD_HOST_SAVE_APS 8
+
+static struct
+{
+	uint32_t select;
+	uint8_t select_valid;
+	uint8_t count;
+	uint32_t ap[SWD_HOST_SAVE_APS]; // APSEL in SELECT position
+	uint32_t csw[SWD_HOST_SAVE_APS];
+	uint32_t tar[SWD_HOST_SAVE_APS];
+} swd_host_saved;
+
+// Start a vendor command on the host's connection: remember its SELECT and
+// forget the cached SELECT/CSW/TAR, which the host may have changed.
+void swd_host_save(void)
+{
+	swd_host_saved.count = 0;
+	swd_host_saved.select_valid = DAP_RetryLastSelect(&swd_host_saved.select);
+	swd_invalidate_state();
+}
+
+// Save the CSW and TAR of an AP before the command first changes them.
+// Returns 0 on an SWD error or when SWD_HOST_SAVE_APS APs are already saved.
+uint8_t swd_host_save_ap(uint32_t ap)
+{
+	uint32_t i;
+
+	ap &= 0xff000000;
+
+	for (i = 0; i < swd_host_saved.count; i++)
+	{
+		if (swd_host_saved.ap[i] == ap)
+		{
+			return 1;
+		}
+	}
+
+	if (swd_host_saved.count >= SWD_HOST_SAVE_APS)
+	{
+		return 0;
+	}
+
+	if (!swd_read_ap(ap | AP_CSW, &swd_host_saved.csw[i]) ||
+		!swd_read_ap(ap | AP_TAR, &swd_host_saved.tar[i]))
+	{
+		return 0;
+	}
+
+	swd_host_saved.ap[i] = ap;
+	swd_host_saved.count++;
+	return 1;
+}
+
+// End the vendor command: write back the saved CSW/TAR, then SELECT.
+// DRW/BDx reads and sticky flags are not restored.
+uint8_t swd_host_restore(void)
+{
+	uint32_t i;
+	uint8_t ok = 1;
+
+	for (i = 0; i < swd_host_saved.count; i++)
+	{
+		ok = swd_write_ap(swd_host_saved.ap[i] | AP_CSW, swd_host_saved.csw[i]) &&
+			 swd_write_ap(swd_host_saved.ap[i] | AP_TAR, swd_host_saved.tar[i]) && ok;
+	}
+
+	if (swd_host_saved.select_valid)
+	{
+		ok = swd_write_dp(DP_SELECT, swd_host_saved.select) && ok;
+	}
+
+	swd_host_saved.count = 0;
+	swd_host_saved.select_valid = 0;
+	return ok;
+}
+
+// Probe the capabilities of a MEM-AP and keep them for memory access.
+// Packed transfers and HNONSEC are detected by writing CSW and reading it
+// back, 64-bit addressing comes from CFG. The TAR auto-increment range is
+// CFG.TARINC where implemented, otherwise it is measured by reading the word
+// before a 1KB/2KB boundary inside the AP's ROM table and checking whether
+// TAR carried across the boundary.
+uint8_t swd_probe_ap(uint8_t apsel)
+{
+	uint32_t ap = (uint32_t)apsel << 24;
+	uint32_t adr[3] = { ap | AP_IDR, ap | AP_CFG, ap | AP_ROM };
+	uint32_t val[3];
+	uint32_t base, tmp, i;
+	SWD_AP_CAPS caps, *slot;
+
+	if (!swd_read_ap_multiple(adr, val, 3))
+	{
+		goto fail;
+	}
+
+	if ((val[0] & IDR_CLASS) != IDR_CLASS_MEM)
+	{
+		return 0;
+	}
+
+	memset(&caps, 0, sizeof(caps));
+	caps.idr = val[0];
+	caps.apsel = apsel;
+	caps.page = TARGET_AUTO_INCREMENT_PAGE_SIZE;
+	caps.large_addr = (val[1] & CFG_LA) ? 1 : 0;
+	caps.barrier = ((val[0] & IDR_TYPE) == IDR_TYPE_AXI) || ((val[0] & IDR_TYPE) == IDR_TYPE_AXI5);
+
+	// the CSW cache doesn't follow APSEL
+	dap_state.csw = 0xffffffff;
+
+	if (!swd_write_ap(ap | AP_CSW, (CSW_VALUE & ~CSW_ADDRINC) | CSW_PADDRINC | CSW_HNONSEC | CSW_SIZE8) ||
+		!swd_read_ap(ap | AP_CSW, &tmp))
+	{
+		goto fail;
+	}
+
+	caps.packed = ((tmp & CSW_ADDRINC) == CSW_PADDRINC);
+	caps.hnonsec = (tmp & CSW_HNONSEC) ? 1 : 0;
+
+	if (val[1] & CFG_TARINC)
+	{
+		caps.page = 1 << (((val[1] & CFG_TARINC) >> 16) + 9);
+	}
+	else if ((val[2] & (ROM_PRESENT | ROM_FORMAT)) == (ROM_PRESENT | ROM_FORMAT))
+	{
+		base = val[2] & ROM_ADDR;
+
+		if (!swd_write_ap(ap | AP_CSW, CSW_VALUE | CSW_SIZE32))
+		{
+			goto fail;
+		}
+
+		while (caps.page < TARGET_AUTO_INCREMENT_PAGE_MAX)
+		{
+			adr[0] = ap | AP_DRW;
+			adr[1] = ap | AP_TAR;
+
+			if (!swd_write_ap(ap | AP_TAR, base + caps.page - 4) || !swd_read_ap_multiple(adr, val, 2))
+			{
+				goto fail;
+			}
+
+			if (val[1] != (base + caps.page))
+			{
+				break;
+			}
+
+			caps.page <<= 1;
+		}
+	}
+
+	dap_state.csw = 0xffffffff;
+	dap_state.tar_valid = 0;
+
+	slot = swd_ap_caps(apsel);
+
+	// slot 0 always holds the memory AP; other APs take a free slot or
+	// replace another non-memory AP
+	if (!slot && (apsel == SWD_MEM_AP))
+	{
+		slot = &dap_state.ap[0];
+	}
+
+	for (i = 1; !slot && (i < SWD_AP_CAPS_MAX); i++)
+	{
+		if (!dap_state.ap[i].idr)
+		{
+			slot = &dap_state.ap[i];
+		}
+	}
+
+	if (!slot)
+	{
+		slot = &dap_state.ap[1 + (apsel % (SWD_AP_CAPS_MAX - 1))];
+	}
+
+	*slot = caps;
+
+	return 1;
+
+fail:
+	dap_state.csw = 0xffffffff;
+	dap_state.tar_valid = 0;
+	swd_write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR);
+	return 0;
+}
+
+#if (SWD_FAST_CONNECT != 0)
+// Reattach to a DP that is still powered up and in SWD mode. Such a DP
+// answers an IDCODE read without line resets or the JTAG-to-SWD switch.
+// Without a reset DP SELECT still holds what swd_host wrote last, so the
+// cached SELECT/CSW/TAR and AP capabilities stay in use.
+static uint8_t swd_fast_connect(void)
+{
+	uint32_t tmp;
+
+	if (!swd_read_idcode(&tmp))
+	{
+		return 0;
+	}
+
+	// CTRL/STAT needs DPBANKSEL 0, unknown SELECT is rewritten
+	if ((dap_state.select & 0x0f) && !swd_write_dp(DP_SELECT, 0))
+	{
+		return 0;
+	}
+
+	if (!swd_read_dp(DP_CTRL_STAT, &tmp))
+	{
+		return 0;
+	}
+
+	if ((tmp & (CSYSPWRUPREQ | CDBGPWRUPREQ | CSYSPWRUPACK | CDBGPWRUPACK)) !=
+		(CSYSPWRUPREQ | CDBGPWRUPREQ | CSYSPWRUPACK | CDBGPWRUPACK))
+	{
+		return 0;
+	}
+
+	if ((tmp & (STICKYORUN | STICKYCMP | STICKYERR | WDATAERR)) &&
+		!swd_write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR))
+	{
+		return 0;
+	}
+
+	if (!swd_ap_caps(0))
+	{
+		swd_probe_ap(0);
+	}
+
+	return 1;
+}
+#endif
+
+// Attach to the target DP. The fast path trusts the cached SELECT/CSW;
+// DAP_Connect and DAP_Disconnect call swd_invalidate_state(), so a host
+// session in between is already accounted for.
 uint8_t swd_init_debug(void)
 {
 	uint32_t tmp = 0;
 	int i = 0;
 	int timeout = 100;
-	// init dap state with fake values
-	dap_state.select = 0xffffffff;
-	dap_state.csw = 0xffffffff;
+
 	swd_init();
 
+#if (SWD_FAST_CONNECT != 0)
+	if (swd_fast_connect())
+	{
+		return 1;
+	}
+#endif
+
+	// init dap state with fake values
+	swd_invalidate_state();
+	memset(dap_state.ap, 0, sizeof(dap_state.ap));
+
 	// call a target dependant function
 	// this function can do several stuff before really initing the debug
 	// target_before_init_debug();
@@ -892,6 +1823,10 @@ uint8_t swd_init_debug(void)
 		return 0;
 	}
 
+	// Memory access falls back to the architectural minimum if AP 0
+	// can't be probed
+	swd_probe_ap(0);
+
 	return 1;
 }
 
@@ -912,7 +1847,6 @@ __attribute__((weak)) void swd_set_target_reset(uint8_t asserted)
 
 uint8_t swd_set_target_state_hw(target_state_t state)
 {
-	uint32_t val;
 	int8_t ap_retries = 2;
 
 	/* Calling swd_init prior to entering RUN state causes operations to fail. */
@@ -966,13 +1900,10 @@ uint8_t swd_set_target_state_hw(target_state_t state)
 		swd_set_target_reset(0);
 		delaymS(20);
 
-		do
+		if (!swd_wait_until_halted(SWD_HALT_TIMEOUT_US))
 		{
-			if (!swd_read_word(DBG_HCSR, &val))
-			{
-				return 0;
-			}
-		} while ((val & S_HALT) == 0);
+			return 0;
+		}
 
 		// Disable halt on reset
 		if (!swd_write_word(DBG_EMCR, 0))
@@ -1034,13 +1965,10 @@ uint8_t swd_set_target_state_hw(target_state_t state)
 		}
 
 		// Wait until core is halted
-		do
+		if (!swd_wait_until_halted(SWD_HALT_TIMEOUT_US))
 		{
-			if (!swd_read_word(DBG_HCSR, &val))
-			{
-				return 0;
-			}
-		} while ((val & S_HALT) == 0);
+			return 0;
+		}
 
 		break;
 
@@ -1086,13 +2014,10 @@ uint8_t swd_set_target_state_sw(target_state_t state)
 		}
 
 		// Wait until core is halted
-		do
+		if (!swd_wait_until_halted(SWD_HALT_TIMEOUT_US))
 		{
-			if (!swd_read_word(DBG_HCSR, &val))
-			{
-				return 0;
-			}
-		} while ((val & S_HALT) == 0);
+			return 0;
+		}
 
 		// Perform a soft reset
 		if (!swd_read_word(NVIC_AIRCR, &val))
@@ -1122,13 +2047,10 @@ uint8_t swd_set_target_state_sw(target_state_t state)
 		}
 
 		// Wait until core is halted
-		do
+		if (!swd_wait_until_halted(SWD_HALT_TIMEOUT_US))
 		{
-			if (!swd_read_word(DBG_HCSR, &val))
-			{
-				return 0;
-			}
-		} while ((val & S_HALT) == 0);
+			return 0;
+		}
 
 		// Enable halt on reset
 		if (!swd_write_word(DBG_EMCR, VC_CORERESET))
@@ -1151,13 +2073,10 @@ uint8_t swd_set_target_state_sw(target_state_t state)
 
 		delaymS(20);
 
-		do
+		if (!swd_wait_until_halted(SWD_HALT_TIMEOUT_US))
 		{
-			if (!swd_read_word(DBG_HCSR, &val))
-			{
-				return 0;
-			}
-		} while ((val & S_HALT) == 0);
+			return 0;
+		}
 
 		// Disable halt on reset
 		if (!swd_write_word(DBG_EMCR, 0))
@@ -1218,13 +2137,10 @@ uint8_t swd_set_target_state_sw(target_state_t state)
 		}
 
 		// Wait until core is halted
-		do
+		if (!swd_wait_until_halted(SWD_HALT_TIMEOUT_US))
 		{
-			if (!swd_read_word(DBG_HCSR, &val))
-			{
-				return 0;
-			}
-		} while ((val & S_HALT) == 0);
+			return 0;
+		}
 
 		break;
 
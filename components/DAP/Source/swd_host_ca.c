@@ -0,0 +1,634 @@
+/**
+ * @file    swd_host_ca.c
+ * @brief   Host driver for Cortex-A/R cores behind an APB-AP
+ *
+ * The v7 debug registers are reached through an APB-AP. TAR is parked on
+ * DBGDTRRX so DBGDTRRX, DBGITR, DBGDSCR and DBGDTRTX map to BD0..BD3 and
+ * the instruction/DCC traffic needs no TAR writes. Memory is moved with
+ * the DCC in fast mode: an LDC/STC latched in DBGITR is reissued by every
+ * DBGDTRTX read or DBGDTRRX write, so a block costs one AP access per word.
+ *
+ * Instructions are issued as ARM encodings. r0 and r1 are used as scratch
+ * and restored before returning.
+ */
+
+#include <string.h>
+#include "esp_timer.h"
+#include "swd_host.h"
+#include "swd_host_ca.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "debug_ca.h"
+
+// Debug register address for the attached core
+#define CA_REG(r) (ca_state.base + ((r) - DEBUG_REGSITER_BASE))
+
+// BD0..BD3 with TAR on DBGDTRRX
+#define CA_BD_DTRRX AP_BD0
+#define CA_BD_ITR AP_BD1
+#define CA_BD_DSCR AP_BD2
+#define CA_BD_DTRTX AP_BD3
+
+#define CA_TIMEOUT_US 100000 // Budget for an instruction, halt or restart
+#define CA_QUEUE_WORDS 56    // Fast mode words per swd_queue flush
+
+// ARM encodings executed through DBGITR
+#define CA_OP_MCR_DTRTX(rt) (0xEE000E15 | ((rt) << 12)) // MCR p14, 0, rt, c0, c5, 0
+#define CA_OP_MRC_DTRRX(rt) (0xEE100E15 | ((rt) << 12)) // MRC p14, 0, rt, c0, c5, 0
+#define CA_OP_MOV_R0_PC 0xE1A0000F                      // MOV r0, pc
+#define CA_OP_MOV_PC_R0 0xE1A0F000                      // MOV pc, r0
+#define CA_OP_MRS_R0_CPSR 0xE10F0000                    // MRS r0, CPSR
+#define CA_OP_MSR_CPSR_R0 0xE12FF000                    // MSR CPSR_fsxc, r0
+#define CA_OP_LDC_DTRTX 0xECB05E01                      // LDC p14, c5, [r0], #4
+#define CA_OP_STC_DTRRX 0xECA05E01                      // STC p14, c5, [r0], #4
+#define CA_OP_LDRB_R1 0xE5D01000                        // LDRB r1, [r0]
+#define CA_OP_STRB_R1 0xE5C01000                        // STRB r1, [r0]
+
+#define CPSR_T 0x00000020 // Thumb state
+
+typedef struct
+{
+	uint32_t ap;     // APSEL in SELECT position
+	uint32_t base;   // debug register base behind the APB-AP
+	uint32_t csw;    // APB-AP CSW, 32-bit, no increment
+	uint8_t attached;
+	uint8_t block;   // TAR points at DBGDTRRX
+} CA_STATE;
+
+static CA_STATE ca_state;
+
+// Point TAR at DBGDTRRX for the banked register accesses.
+static uint8_t ca_select_block(void)
+{
+	if (ca_state.block)
+	{
+		return 1;
+	}
+
+	if (!swd_write_ap(ca_state.ap | AP_TAR, CA_REG(DBGDTRRX)))
+	{
+		return 0;
+	}
+
+	ca_state.block = 1;
+	return 1;
+}
+
+// Start an operation. The host may have used the APB-AP since the last one.
+static uint8_t ca_begin(void)
+{
+	if (!ca_state.attached)
+	{
+		return 0;
+	}
+
+	ca_state.block = 0;
+
+	if (!swd_write_ap(ca_state.ap | AP_CSW, ca_state.csw))
+	{
+		return 0;
+	}
+
+	return ca_select_block();
+}
+
+static uint8_t ca_read_bd(uint32_t bd, uint32_t *val)
+{
+	if (!ca_select_block())
+	{
+		return 0;
+	}
+
+	return swd_read_ap(ca_state.ap | bd, val);
+}
+
+static uint8_t ca_write_bd(uint32_t bd, uint32_t val)
+{
+	if (!ca_select_block())
+	{
+		return 0;
+	}
+
+	return swd_write_ap(ca_state.ap | bd, val);
+}
+
+// Debug registers outside the DBGDTRRX..DBGDTRTX block
+static uint8_t ca_read_debug(uint32_t reg, uint32_t *val)
+{
+	ca_state.block = 0;
+
+	if (!swd_write_ap(ca_state.ap | AP_TAR, CA_REG(reg)))
+	{
+		return 0;
+	}
+
+	return swd_read_ap(ca_state.ap | AP_DRW, val);
+}
+
+static uint8_t ca_write_debug(uint32_t reg, uint32_t val)
+{
+	ca_state.block = 0;
+
+	if (!swd_write_ap(ca_state.ap | AP_TAR, CA_REG(reg)))
+	{
+		return 0;
+	}
+
+	return swd_write_ap(ca_state.ap | AP_DRW, val);
+}
+
+// Poll DBGDSCR until any bit of mask is set.
+static uint8_t ca_wait_dscr(uint32_t mask, uint32_t *dscr)
+{
+	uint32_t val;
+	int64_t start = esp_timer_get_time();
+
+	while (1)
+	{
+		if (!ca_read_bd(CA_BD_DSCR, &val))
+		{
+			return 0;
+		}
+
+		if (val & mask)
+		{
+			break;
+		}
+
+		if ((esp_timer_get_time() - start) > CA_TIMEOUT_US)
+		{
+			return 0;
+		}
+	}
+
+	if (dscr)
+	{
+		*dscr = val;
+	}
+
+	return 1;
+}
+
+// Switch the external DCC access mode.
+static uint8_t ca_set_dcc_mode(uint32_t mode)
+{
+	uint32_t dscr;
+
+	if (!ca_read_bd(CA_BD_DSCR, &dscr))
+	{
+		return 0;
+	}
+
+	if ((dscr & DSCR_EXTDCC) == mode)
+	{
+		return 1;
+	}
+
+	return ca_write_bd(CA_BD_DSCR, (dscr & ~DSCR_EXTDCC) | mode);
+}
+
+// Issue one instruction in non-blocking mode and wait for it to retire.
+static uint8_t ca_exec_op(uint32_t opcode)
+{
+	if (!ca_write_bd(CA_BD_ITR, opcode))
+	{
+		return 0;
+	}
+
+	return ca_wait_dscr(DSCR_INSTRCOMPL, NULL);
+}
+
+// Move rt to the host through DBGDTRTX.
+static uint8_t ca_read_rt(uint32_t rt, uint32_t *val)
+{
+	if (!ca_exec_op(CA_OP_MCR_DTRTX(rt)))
+	{
+		return 0;
+	}
+
+	if (!ca_wait_dscr(DSCR_TXFULL_L, NULL))
+	{
+		return 0;
+	}
+
+	return ca_read_bd(CA_BD_DTRTX, val);
+}
+
+// Load rt from the host through DBGDTRRX.
+static uint8_t ca_write_rt(uint32_t rt, uint32_t val)
+{
+	if (!ca_write_bd(CA_BD_DTRRX, val))
+	{
+		return 0;
+	}
+
+	return ca_exec_op(CA_OP_MRC_DTRRX(rt));
+}
+
+// Clear and report sticky aborts left by the instructions issued so far.
+static uint8_t ca_check_abort(void)
+{
+	uint32_t dscr;
+
+	if (!ca_read_bd(CA_BD_DSCR, &dscr))
+	{
+		return 0;
+	}
+
+	if (!(dscr & (DSCR_SDABORT_L | DSCR_ADABORT_L | DSCR_UND_L)))
+	{
+		return 1;
+	}
+
+	ca_write_debug(DBGDRCR, DRCR_CSE);
+	return 0;
+}
+
+// Read count words from an aligned address, r0 is clobbered.
+static uint8_t ca_read_words(uint32_t address, uint8_t *data, uint32_t count)
+{
+	uint32_t buf[CA_QUEUE_WORDS];
+	uint32_t i, dscr;
+
+	if (!ca_write_rt(0, address))
+	{
+		return 0;
+	}
+
+	// First LDC fills DBGDTRTX
+	if (!ca_exec_op(CA_OP_LDC_DTRTX))
+	{
+		return 0;
+	}
+
+	if (count > 1)
+	{
+		// Each DBGDTRTX read returns a word and reissues the latched LDC,
+		// so count - 1 reads leave the last word in DBGDTRTX.
+		if (!ca_set_dcc_mode(DSCR_EXTDCC_FA) || !ca_write_bd(CA_BD_ITR, CA_OP_LDC_DTRTX))
+		{
+			ca_set_dcc_mode(DSCR_EXTDCC_NB);
+			return 0;
+		}
+
+		swd_queue_reset();
+
+		for (i = 0; i < count - 1; i++)
+		{
+			swd_queue_read_ap(ca_state.ap | CA_BD_DTRTX, &buf[i]);
+		}
+
+		if (!swd_queue_flush())
+		{
+			ca_set_dcc_mode(DSCR_EXTDCC_NB);
+			return 0;
+		}
+
+		if (!ca_set_dcc_mode(DSCR_EXTDCC_NB))
+		{
+			return 0;
+		}
+	}
+
+	if (!ca_wait_dscr(DSCR_INSTRCOMPL, &dscr))
+	{
+		return 0;
+	}
+
+	if (dscr & (DSCR_SDABORT_L | DSCR_ADABORT_L))
+	{
+		return 0;
+	}
+
+	if (!ca_wait_dscr(DSCR_TXFULL_L, NULL) || !ca_read_bd(CA_BD_DTRTX, &buf[count - 1]))
+	{
+		return 0;
+	}
+
+	memcpy(data, buf, count * 4);
+	return 1;
+}
+
+// Write count words to an aligned address, r0 is clobbered.
+static uint8_t ca_write_words(uint32_t address, const uint8_t *data, uint32_t count)
+{
+	uint32_t i, val;
+
+	if (!ca_write_rt(0, address))
+	{
+		return 0;
+	}
+
+	// Each DBGDTRRX write issues the latched STC
+	if (!ca_set_dcc_mode(DSCR_EXTDCC_FA) || !ca_write_bd(CA_BD_ITR, CA_OP_STC_DTRRX))
+	{
+		ca_set_dcc_mode(DSCR_EXTDCC_NB);
+		return 0;
+	}
+
+	swd_queue_reset();
+
+	for (i = 0; i < count; i++)
+	{
+		memcpy(&val, data + i * 4, 4);
+		swd_queue_write_ap(ca_state.ap | CA_BD_DTRRX, val);
+	}
+
+	if (!swd_queue_flush())
+	{
+		ca_set_dcc_mode(DSCR_EXTDCC_NB);
+		return 0;
+	}
+
+	if (!ca_set_dcc_mode(DSCR_EXTDCC_NB))
+	{
+		return 0;
+	}
+
+	return ca_wait_dscr(DSCR_INSTRCOMPL, NULL);
+}
+
+// Byte accesses for unaligned edges, r0 and r1 are clobbered.
+static uint8_t ca_read_byte(uint32_t address, uint8_t *data)
+{
+	uint32_t val;
+
+	if (!ca_write_rt(0, address) || !ca_exec_op(CA_OP_LDRB_R1) || !ca_read_rt(1, &val))
+	{
+		return 0;
+	}
+
+	*data = (uint8_t)val;
+	return 1;
+}
+
+static uint8_t ca_write_byte(uint32_t address, uint8_t data)
+{
+	if (!ca_write_rt(0, address) || !ca_write_rt(1, data))
+	{
+		return 0;
+	}
+
+	return ca_exec_op(CA_OP_STRB_R1);
+}
+
+// Attach to the core whose debug registers are at debug_base behind APB-AP
+// apsel: unlock them and enable halting debug.
+uint8_t ca_attach(uint8_t apsel, uint32_t debug_base, uint32_t *didr)
+{
+	uint32_t csw, dscr;
+
+	ca_state.attached = 0;
+	ca_state.ap = (uint32_t)apsel << 24;
+	ca_state.base = debug_base;
+
+	if (!swd_read_ap(ca_state.ap | AP_CSW, &csw))
+	{
+		return 0;
+	}
+
+	ca_state.csw = (csw & ~(CSW_SIZE | CSW_ADDRINC)) | CSW_SIZE32 | CSW_NADDRINC;
+	ca_state.attached = 1;
+
+	if (!ca_begin())
+	{
+		ca_state.attached = 0;
+		return 0;
+	}
+
+	if (!ca_write_debug(DBGLAR, DBGLAR_KEY) ||
+		!ca_write_debug(DBGOSLAR, 0) ||
+		!ca_read_debug(DBGDIDR, didr))
+	{
+		ca_state.attached = 0;
+		return 0;
+	}
+
+	if (!ca_read_bd(CA_BD_DSCR, &dscr))
+	{
+		ca_state.attached = 0;
+		return 0;
+	}
+
+	dscr |= DSCR_HDBGEN;
+
+	if (dscr & DSCR_HALTED)
+	{
+		dscr |= DSCR_ITREN;
+	}
+
+	if (!ca_write_bd(CA_BD_DSCR, dscr & ~DSCR_EXTDCC))
+	{
+		ca_state.attached = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+uint8_t ca_halt(void)
+{
+	uint32_t dscr;
+
+	if (!ca_begin() || !ca_write_debug(DBGDRCR, DRCR_HRQ))
+	{
+		return 0;
+	}
+
+	if (!ca_wait_dscr(DSCR_HALTED, &dscr))
+	{
+		return 0;
+	}
+
+	return ca_write_bd(CA_BD_DSCR, (dscr & ~DSCR_EXTDCC) | DSCR_ITREN);
+}
+
+uint8_t ca_resume(void)
+{
+	uint32_t dscr;
+
+	if (!ca_begin() || !ca_read_bd(CA_BD_DSCR, &dscr))
+	{
+		return 0;
+	}
+
+	if (!ca_write_bd(CA_BD_DSCR, dscr & ~(DSCR_ITREN | DSCR_EXTDCC)))
+	{
+		return 0;
+	}
+
+	if (!ca_write_debug(DBGDRCR, DRCR_CSE | DRCR_RRQ))
+	{
+		return 0;
+	}
+
+	return ca_wait_dscr(DSCR_RESTARTED, NULL);
+}
+
+uint8_t ca_is_halted(uint8_t *halted)
+{
+	uint32_t dscr;
+
+	if (!ca_begin() || !ca_read_bd(CA_BD_DSCR, &dscr))
+	{
+		return 0;
+	}
+
+	*halted = (dscr & DSCR_HALTED) ? 1 : 0;
+	return 1;
+}
+
+// Execute one instruction on the halted core.
+uint8_t ca_exec(uint32_t opcode)
+{
+	if (!ca_begin())
+	{
+		return 0;
+	}
+
+	if (!ca_exec_op(opcode))
+	{
+		ca_check_abort();
+		return 0;
+	}
+
+	return ca_check_abort();
+}
+
+// r0..r14, CA_REG_PC or CA_REG_CPSR of the halted core
+uint8_t ca_read_core_register(uint32_t n, uint32_t *val)
+{
+	uint32_t r0, cpsr;
+	uint8_t ok;
+
+	if ((n > CA_REG_CPSR) || !ca_begin())
+	{
+		return 0;
+	}
+
+	if (n < CA_REG_PC)
+	{
+		return ca_read_rt(n, val);
+	}
+
+	if (!ca_read_rt(0, &r0))
+	{
+		return 0;
+	}
+
+	ok = ca_exec_op(CA_OP_MRS_R0_CPSR) && ca_read_rt(0, &cpsr);
+
+	if (ok && (n == CA_REG_PC))
+	{
+		// PC reads ahead by two instructions
+		ok = ca_exec_op(CA_OP_MOV_R0_PC) && ca_read_rt(0, val);
+		*val -= (cpsr & CPSR_T) ? 4 : 8;
+	}
+	else
+	{
+		*val = cpsr;
+	}
+
+	return ca_write_rt(0, r0) && ok;
+}
+
+uint8_t ca_write_core_register(uint32_t n, uint32_t val)
+{
+	uint32_t r0;
+	uint8_t ok;
+
+	if ((n > CA_REG_CPSR) || !ca_begin())
+	{
+		return 0;
+	}
+
+	if (n < CA_REG_PC)
+	{
+		return ca_write_rt(n, val);
+	}
+
+	if (!ca_read_rt(0, &r0))
+	{
+		return 0;
+	}
+
+	ok = ca_write_rt(0, val) &&
+		 ca_exec_op((n == CA_REG_PC) ? CA_OP_MOV_PC_R0 : CA_OP_MSR_CPSR_R0);
+
+	return ca_write_rt(0, r0) && ok;
+}
+
+// Read target memory through the halted core's view of the address space.
+uint8_t ca_read_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+	uint32_t r0, r1, n;
+	uint8_t ok = 1;
+
+	if (!ca_begin() || !ca_read_rt(0, &r0) || !ca_read_rt(1, &r1))
+	{
+		return 0;
+	}
+
+	while (ok && size && (address & 3))
+	{
+		ok = ca_read_byte(address++, data++);
+		size--;
+	}
+
+	while (ok && (size >= 4))
+	{
+		n = size / 4;
+		n = (n > CA_QUEUE_WORDS) ? CA_QUEUE_WORDS : n;
+		ok = ca_read_words(address, data, n);
+		address += n * 4;
+		data += n * 4;
+		size -= n * 4;
+	}
+
+	while (ok && size)
+	{
+		ok = ca_read_byte(address++, data++);
+		size--;
+	}
+
+	ok = ca_check_abort() && ok;
+
+	return ca_write_rt(0, r0) && ca_write_rt(1, r1) && ok;
+}
+
+uint8_t ca_write_memory(uint32_t address, const uint8_t *data, uint32_t size)
+{
+	uint32_t r0, r1, n;
+	uint8_t ok = 1;
+
+	if (!ca_begin() || !ca_read_rt(0, &r0) || !ca_read_rt(1, &r1))
+	{
+		return 0;
+	}
+
+	while (ok && size && (address & 3))
+	{
+		ok = ca_write_byte(address++, *data++);
+		size--;
+	}
+
+	while (ok && (size >= 4))
+	{
+		n = size / 4;
+		n = (n > CA_QUEUE_WORDS) ? CA_QUEUE_WORDS : n;
+		ok = ca_write_words(address, data, n);
+		address += n * 4;
+		data += n * 4;
+		size -= n * 4;
+	}
+
+	while (ok && size)
+	{
+		ok = ca_write_byte(address++, *data++);
+		size--;
+	}
+
+	ok = ca_check_abort() && ok;
+
+	return ca_write_rt(0, r0) && ca_write_rt(1, r1) && ok;
+}
@@ -0,0 +1,278 @@
+/**
+ * @file cdc_uart.c
+ * @brief CDC-ACM 虚拟串口 - 将 USB CDC 接口桥接到目标 UART
+ *
+ * 本文件实现 USB COM 端口方式的 DAP UART 通信：
+ * 1. 目标 UART 由 DAP 组件的 UART.c 安装和管理（UART2，中断驱动的收发环形缓冲区）
+ * 2. uart->usb 任务阻塞在 UART 接收缓冲区上，有数据即整块写入 CDC 发送 FIFO
+ * 3. usb->uart 任务由 tud_cdc_rx_cb 唤醒，将 CDC 接收 FIFO 中的数据写入 UART
+ * 4. 主机修改串口参数（波特率等）时，在 tud_cdc_line_coding_cb 中直接应用
+ *
+ * 两个方向各用一个任务，互不阻塞：UART 发送缓冲区满时 usb->uart 任务等待，
+ * 数据留在 CDC FIFO 中，主机端自然被 NAK 限流，不会丢数。
+ * 两个任务都运行在 Core 0，与 Core 1 上的 SWD 处理互不抢占。
+ *
+ * 主机通过 DAP_UART_Transport 选择 DAP 命令方式时，USB_COM_PORT_Activate(0)
+ * 让两个任务停在安全点，UART 交由 UART.c 的 DAP_UART_Transfer 使用。
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "tusb.h"
+#include "driver/uart.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "dap_handler.h"
+#include "cdc_uart.h"
+
+#if (DAP_UART != 0) && (DAP_UART_USB_COM_PORT != 0)
+
+/* 日志标签 */
+static const char *TAG = "CDC_UART";
+
+/* 桥接使用的 CDC 接口序号 */
+#define CDC_UART_ITF            0
+
+/* 单次搬运的最大字节数 */
+#define CDC_UART_CHUNK          512
+
+/* uart->usb 任务等待接收数据的超时（毫秒），决定停止桥接的响应时间 */
+#define CDC_UART_RX_WAIT_MS     10
+
+/* 等待两个任务停在安全点的最长时间（毫秒） */
+#define CDC_UART_PARK_MS        50
+
+/* 搬运缓冲区 */
+static uint8_t cdc_uart_rx_buf[CDC_UART_CHUNK];
+static uint8_t cdc_uart_tx_buf[CDC_UART_CHUNK];
+
+/* 桥接是否生效，以及两个任务是否已停在安全点 */
+static volatile uint8_t cdc_uart_active;
+static volatile uint8_t cdc_uart_rx_parked = 1;
+static volatile uint8_t cdc_uart_tx_parked = 1;
+
+static TaskHandle_t cdc_uart_rx_task_handle;
+static TaskHandle_t cdc_uart_tx_task_handle;
+
+/**
+ * @brief uart->usb 任务：目标 UART 接收数据写入 CDC
+ *
+ * @param pvParameters 任务参数（未使用）
+ */
+static void cdc_uart_rx_task(void *pvParameters)
+{
+    size_t avail;
+    uint32_t space;
+    int len;
+
+    while (1) {
+        if (!cdc_uart_active) {
+            cdc_uart_rx_parked = 1;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        cdc_uart_rx_parked = 0;
+
+        /* 阻塞等待第一个字节，随后把缓冲区中已有的数据一次取走 */
+        len = uart_read_bytes(DAP_UART_PORT, cdc_uart_rx_buf, 1, pdMS_TO_TICKS(CDC_UART_RX_WAIT_MS));
+        if (len <= 0) {
+            continue;
+        }
+        if (uart_get_buffered_data_len(DAP_UART_PORT, &avail) == ESP_OK && avail > 0) {
+            if (avail > CDC_UART_CHUNK - 1) {
+                avail = CDC_UART_CHUNK - 1;
+            }
+            int more = uart_read_bytes(DAP_UART_PORT, cdc_uart_rx_buf + 1, avail, 0);
+            if (more > 0) {
+                len += more;
+            }
+        }
+
+        /* 主机未打开串口时丢弃数据，避免 UART 接收缓冲区溢出 */
+        if (!tud_cdc_n_connected(CDC_UART_ITF)) {
+            continue;
+        }
+
+        /* CDC FIFO 空间不足时等待 USB 发送，不丢弃已读出的数据 */
+        uint32_t done = 0;
+        while (done < (uint32_t)len && cdc_uart_active && tud_cdc_n_connected(CDC_UART_ITF)) {
+            space = tud_cdc_n_write_available(CDC_UART_ITF);
+            if (space == 0) {
+                tud_cdc_n_write_flush(CDC_UART_ITF);
+                vTaskDelay(1);
+                continue;
+            }
+            if (space > (uint32_t)len - done) {
+                space = (uint32_t)len - done;
+            }
+            done += tud_cdc_n_write(CDC_UART_ITF, cdc_uart_rx_buf + done, space);
+        }
+        tud_cdc_n_write_flush(CDC_UART_ITF);
+    }
+}
+
+/**
+ * @brief usb->uart 任务：CDC 接收数据写入目标 UART
+ *
+ * @param pvParameters 任务参数（未使用）
+ */
+static void cdc_uart_tx_task(void *pvParameters)
+{
+    uint32_t count;
+
+    while (1) {
+        if (!cdc_uart_active) {
+            cdc_uart_tx_parked = 1;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        cdc_uart_tx_parked = 0;
+
+        if (!tud_cdc_n_available(CDC_UART_ITF)) {
+            /* 由 tud_cdc_rx_cb 唤醒，超时用于检查桥接状态 */
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CDC_UART_RX_WAIT_MS));
+            continue;
+        }
+
+        count = tud_cdc_n_read(CDC_UART_ITF, cdc_uart_tx_buf, sizeof(cdc_uart_tx_buf));
+        if (count > 0) {
+            /* UART 发送缓冲区满时阻塞，剩余数据留在 CDC FIFO 中对主机限流 */
+            uart_write_bytes(DAP_UART_PORT, cdc_uart_tx_buf, count);
+        }
+    }
+}
+
+/* ==================== TinyUSB CDC 回调 ==================== */
+
+/**
+ * @brief CDC 收到数据回调（TinyUSB 任务上下文）
+ */
+void tud_cdc_rx_cb(uint8_t itf)
+{
+    if (itf == CDC_UART_ITF && cdc_uart_tx_task_handle != NULL) {
+        xTaskNotifyGive(cdc_uart_tx_task_handle);
+    }
+}
+
+/**
+ * @brief 串口参数变化回调：主机设置波特率、数据位、校验位、停止位
+ */
+void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding)
+{
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+
+    if (itf != CDC_UART_ITF || !cdc_uart_active) {
+        return;
+    }
+
+    switch (p_line_coding->data_bits) {
+    case 5:  data_bits = UART_DATA_5_BITS; break;
+    case 6:  data_bits = UART_DATA_6_BITS; break;
+    case 7:  data_bits = UART_DATA_7_BITS; break;
+    default: data_bits = UART_DATA_8_BITS; break;
+    }
+
+    /* CDC: 0 = 无校验, 1 = 奇校验, 2 = 偶校验；Mark/Space 不支持，按无校验处理 */
+    switch (p_line_coding->parity) {
+    case 1:  parity = UART_PARITY_ODD; break;
+    case 2:  parity = UART_PARITY_EVEN; break;
+    default: parity = UART_PARITY_DISABLE; break;
+    }
+
+    /* CDC: 0 = 1 位, 1 = 1.5 位, 2 = 2 位 */
+    switch (p_line_coding->stop_bits) {
+    case 1:  stop_bits = UART_STOP_BITS_1_5; break;
+    case 2:  stop_bits = UART_STOP_BITS_2; break;
+    default: stop_bits = UART_STOP_BITS_1; break;
+    }
+
+    uart_set_word_length(DAP_UART_PORT, data_bits);
+    uart_set_parity(DAP_UART_PORT, parity);
+    uart_set_stop_bits(DAP_UART_PORT, stop_bits);
+    if (p_line_coding->bit_rate > 0) {
+        uart_set_baudrate(DAP_UART_PORT, p_line_coding->bit_rate);
+    }
+
+    ESP_LOGI(TAG, "line coding: %lu %u%c%u", (unsigned long)p_line_coding->bit_rate,
+             (unsigned)p_line_coding->data_bits, "NOEMS"[p_line_coding->parity % 5],
+             (unsigned)p_line_coding->stop_bits);
+}
+
+/* ==================== 公共接口函数 ==================== */
+
+/**
+ * @brief 启用或停用 USB COM 端口桥接（由 UART.c 的 DAP_UART_Transport 调用）
+ *
+ * @param cmd 1 启用，0 停用
+ * @return 1 成功，0 失败
+ */
+uint8_t USB_COM_PORT_Activate(uint32_t cmd)
+{
+    cdc_line_coding_t coding;
+    TickType_t waited;
+
+    if (cdc_uart_rx_task_handle == NULL || cdc_uart_tx_task_handle == NULL) {
+        return 0;
+    }
+
+    if (cmd) {
+        cdc_uart_active = 1;
+        /* 沿用主机此前设置的串口参数 */
+        tud_cdc_n_get_line_coding(CDC_UART_ITF, &coding);
+        tud_cdc_line_coding_cb(CDC_UART_ITF, &coding);
+        xTaskNotifyGive(cdc_uart_rx_task_handle);
+        xTaskNotifyGive(cdc_uart_tx_task_handle);
+        return 1;
+    }
+
+    cdc_uart_active = 0;
+    xTaskNotifyGive(cdc_uart_rx_task_handle);
+    xTaskNotifyGive(cdc_uart_tx_task_handle);
+    for (waited = 0; waited <= pdMS_TO_TICKS(CDC_UART_PARK_MS); waited++) {
+        if (cdc_uart_rx_parked && cdc_uart_tx_parked) {
+            return 1;
+        }
+        vTaskDelay(1);
+    }
+    return (cdc_uart_rx_parked && cdc_uart_tx_parked) ? 1 : 0;
+}
+
+/**
+ * @brief 初始化 CDC-UART 桥接模块
+ *
+ * 创建两个搬运任务，并把 DAP UART 传输方式设为 USB COM 端口，
+ * 上电后无需主机发送 DAP 命令即可使用虚拟串口。
+ * 应在 dap_handler_init() 之后调用。
+ */
+void cdc_uart_init(void)
+{
+    uint8_t request = DAP_UART_TRANSPORT_USB_COM_PORT;
+    uint8_t response;
+
+    ESP_LOGI(TAG, "正在初始化 CDC-UART 桥接模块...");
+
+    xTaskCreatePinnedToCore(cdc_uart_rx_task, "cdc_uart_rx", 3072, NULL, 5,
+                            &cdc_uart_rx_task_handle, 0);
+    xTaskCreatePinnedToCore(cdc_uart_tx_task, "cdc_uart_tx", 3072, NULL, 5,
+                            &cdc_uart_tx_task_handle, 0);
+
+    dap_handler_lock();
+    UART_Transport(&request, &response);
+    dap_handler_unlock();
+
+    if (response != DAP_OK) {
+        ESP_LOGE(TAG, "目标 UART 初始化失败");
+    }
+}
+
+#else
+
+void cdc_uart_init(void)
+{
+}
+
+#endif
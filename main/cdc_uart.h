@@ -0,0 +1,15 @@
+/**
+ * @file cdc_uart.h
+ * @brief CDC-ACM virtual COM port bridged to the target UART
+ */
+
+#ifndef __CDC_UART_H__
+#define __CDC_UART_H__
+
+/**
+ * @brief Initialize the CDC-UART bridge task and select the USB COM port
+ *        as the DAP UART transport
+ */
+void cdc_uart_init(void);
+
+#endif // __CDC_UART_H__
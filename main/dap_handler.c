@@ -17,10 +17,13 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "tusb.h"
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dap_handler.h"
+#include "swo_stream.h"
 
 /* 日志标签，用于 ESP_LOG 系列函数 */
 static const char *TAG = "DAP_HANDLER";
@@ -43,6 +46,14 @@ static uint8_t dap_request[DAP_PACKET_SIZE];
  */
 static uint8_t dap_response[DAP_PACKET_SIZE];
 
+/**
+ * @brief 调试接口互斥锁
+ * 
+ * SWD/JTAG 引脚和 swd_host 中的 SELECT/CSW 缓存是全局状态，
+ * DAP 命令处理与后台任务（如 RTT 桥接）必须持锁后才能访问目标
+ */
+static SemaphoreHandle_t dap_bus_mutex;
+
 /* ==================== DAP 处理任务 ==================== */
 
 /**
@@ -82,7 +93,9 @@ static void dap_handler_task(void *pvParameters)
                  * DAP_ProcessCommand() 会解析命令并执行相应操作
                  * 返回值为响应数据的长度
                  */
+                dap_handler_lock();
                 uint32_t response_len = DAP_ProcessCommand(dap_request, dap_response);
+                dap_handler_unlock();
 
                 /* 如果有响应数据，发送回 USB 主机 */
                 if (response_len > 0) {
@@ -104,6 +117,9 @@ static void dap_handler_task(void *pvParameters)
             }
         }
 
+        /* SWO 流：启动排队的传输，回收已完成的传输 */
+        swo_stream_poll();
+
         /* 
          * 仅在没有数据时短暂让出 CPU
          * 有数据时不延时，保证最大吞吐量
@@ -116,6 +132,24 @@ static void dap_handler_task(void *pvParameters)
 
 /* ==================== 公共接口函数 ==================== */
 
+/**
+ * @brief 获取调试接口互斥锁
+ * 
+ * 后台任务访问目标前调用，阻塞直到当前 DAP 命令处理完成
+ */
+void dap_handler_lock(void)
+{
+    xSemaphoreTake(dap_bus_mutex, portMAX_DELAY);
+}
+
+/**
+ * @brief 释放调试接口互斥锁
+ */
+void dap_handler_unlock(void)
+{
+    xSemaphoreGive(dap_bus_mutex);
+}
+
 /**
  * @brief 初始化 DAP 处理模块
  * 
@@ -131,6 +165,9 @@ void dap_handler_init(void)
 {
     ESP_LOGI(TAG, "正在初始化 DAP 处理模块...");
 
+    /* 创建调试接口互斥锁，必须先于任何访问目标的任务 */
+    dap_bus_mutex = xSemaphoreCreateMutex();
+
     /* 创建 DAP 处理任务并固定到 Core 0 */
     xTaskCreatePinnedToCore(
         dap_handler_task,
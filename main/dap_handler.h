@@ -11,4 +11,14 @@
  */
 void dap_handler_init(void);
 
+/**
+ * @brief Take the debug port lock shared with background target users
+ */
+void dap_handler_lock(void);
+
+/**
+ * @brief Release the debug port lock
+ */
+void dap_handler_unlock(void);
+
 #endif // __DAP_HANDLER_H__
@@ -0,0 +1,508 @@
+/**
+ * @file dap_tcp.c
+ * @brief DAP TCP 传输 - 通过网络接收 CMSIS-DAP 命令（elaphureLink 协议）
+ *
+ * 本文件实现了 USB 之外的第二条命令通道：
+ * 1. 监听 TCP 端口（默认 3240），同一时间只服务一个客户端
+ * 2. 连接建立后先完成 elaphureLink 握手（12 字节，大端序）
+ * 3. 之后的数据流即连续的 DAP 命令，交给 DAP_ExecuteCommand 处理，
+ *    与 USB 路径共用同一个命令引擎和调试接口互斥锁
+ *
+ * 性能相关：
+ * - 关闭 Nagle 算法（TCP_NODELAY），单条命令的响应立即发出
+ * - 主机可以连续发送多条命令而不等待响应（流水线），一次 recv 收到的
+ *   全部完整命令在一次持锁期间依次执行，响应合并后一次 send 发出
+ *
+ * 分帧：elaphureLink 在握手之后直接传输 DAP 命令，没有长度头。
+ * TCP 可能在任意位置切分命令，因此每条命令执行前先按 CMSIS-DAP 格式
+ * 算出完整长度（dap_tcp_command_length），数据不够时留在缓冲区等待后续分段，
+ * 不完整的标准命令不会交给 DAP_ExecuteCommand（厂商命令见 dap_tcp_serve）。
+ *
+ * 套接字部分只使用 POSIX 接口，可以与 DAP 核心一起在 Linux 上编译，
+ * 通过回环地址测试（见 test/host）。
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "dap_handler.h"
+#include "dap_tcp.h"
+
+#if CONFIG_XN_DAP_TCP
+
+/* 日志标签 */
+static const char *TAG = "DAP_TCP";
+
+/* elaphureLink 握手 */
+#define EL_LINK_IDENTIFIER      0x8a656c70U
+#define EL_COMMAND_HANDSHAKE    0x00000000U
+#define EL_DAP_VERSION          0x00000001U
+#define EL_HANDSHAKE_SIZE       12
+
+/* 收发缓冲区大小，一个以太网 MSS 可容纳二十余条 64 字节命令 */
+#define DAP_TCP_BUF_SIZE        1460
+
+/* 监听失败后的重试间隔（毫秒） */
+#define DAP_TCP_RETRY_DELAY_MS  1000
+
+/* dap_tcp_command_length 的特殊返回值 */
+#define DAP_TCP_LEN_MORE        0U              /* 数据不够，等待后续分段 */
+#define DAP_TCP_LEN_UNKNOWN     0xFFFFFFFFU     /* 厂商命令，长度由命令自身决定 */
+
+/*
+ * 请求缓冲区末尾多留一个 DAP 包的空间并清零：
+ * 长度未知的厂商命令即使越过有效数据，也只会读到零而不会越界
+ */
+static uint8_t dap_tcp_request[DAP_TCP_BUF_SIZE + DAP_PACKET_SIZE];
+static uint8_t dap_tcp_response[DAP_TCP_BUF_SIZE];
+
+static uint32_t get_be32(const uint8_t *buf)
+{
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+           ((uint32_t)buf[2] << 8) | ((uint32_t)buf[3] << 0);
+}
+
+static void put_be32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (uint8_t)(val >> 24);
+    buf[1] = (uint8_t)(val >> 16);
+    buf[2] = (uint8_t)(val >> 8);
+    buf[3] = (uint8_t)(val >> 0);
+}
+
+/**
+ * @brief 发送全部数据
+ * @return 0 成功，-1 连接已断开
+ */
+static int dap_tcp_send_all(int sock, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int n = send(sock, buf, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief 检查套接字中是否还有未读数据（不阻塞）
+ */
+static int dap_tcp_pending(int sock)
+{
+    uint8_t dummy;
+    return recv(sock, &dummy, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
+}
+
+/**
+ * @brief 完成 elaphureLink 握手
+ *
+ * 请求与响应均为三个大端 32 位字：标识 0x8a656c70、命令 0（握手）、版本号
+ *
+ * @return 0 成功，-1 失败
+ */
+static int dap_tcp_handshake(int sock)
+{
+    uint8_t buf[EL_HANDSHAKE_SIZE];
+    size_t len = 0;
+
+    while (len < sizeof(buf)) {
+        int n = recv(sock, buf + len, sizeof(buf) - len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        len += (size_t)n;
+    }
+
+    if (get_be32(&buf[0]) != EL_LINK_IDENTIFIER || get_be32(&buf[4]) != EL_COMMAND_HANDSHAKE) {
+        ESP_LOGW(TAG, "握手失败: 标识 0x%08lx", (unsigned long)get_be32(&buf[0]));
+        return -1;
+    }
+    ESP_LOGI(TAG, "客户端协议版本 %lu", (unsigned long)get_be32(&buf[8]));
+
+    put_be32(&buf[0], EL_LINK_IDENTIFIER);
+    put_be32(&buf[4], EL_COMMAND_HANDSHAKE);
+    put_be32(&buf[8], EL_DAP_VERSION);
+    return dap_tcp_send_all(sock, buf, sizeof(buf));
+}
+
+/**
+ * @brief 计算一条普通 DAP 命令（不含 ExecuteCommands）的请求长度
+ *
+ * 格式与 DAP.c 中各命令的解析一致
+ *
+ * @param buf 命令起始位置
+ * @param len 缓冲区中从 buf 开始的有效字节数
+ * @return 命令字节数；DAP_TCP_LEN_MORE 表示数据不够，
+ *         DAP_TCP_LEN_UNKNOWN 表示厂商命令
+ */
+static uint32_t dap_tcp_single_length(const uint8_t *buf, uint32_t len)
+{
+    uint32_t need;
+    uint32_t cnt;
+    uint32_t n;
+
+    if (len < 1) {
+        return DAP_TCP_LEN_MORE;
+    }
+
+    switch (buf[0]) {
+    case ID_DAP_Disconnect:
+    case ID_DAP_TransferAbort:
+    case ID_DAP_ResetTarget:
+    case ID_DAP_SWO_Status:
+    case ID_DAP_UART_Status:
+        need = 1;
+        break;
+
+    case ID_DAP_Info:
+    case ID_DAP_Connect:
+    case ID_DAP_SWD_Configure:
+    case ID_DAP_JTAG_IDCODE:
+    case ID_DAP_SWO_Transport:
+    case ID_DAP_SWO_Mode:
+    case ID_DAP_SWO_Control:
+    case ID_DAP_SWO_ExtendedStatus:
+    case ID_DAP_UART_Transport:
+    case ID_DAP_UART_Control:
+        need = 2;
+        break;
+
+    case ID_DAP_HostStatus:
+    case ID_DAP_Delay:
+    case ID_DAP_SWO_Data:
+        need = 3;
+        break;
+
+    case ID_DAP_SWJ_Clock:
+    case ID_DAP_SWO_Baudrate:
+        need = 5;
+        break;
+
+    case ID_DAP_TransferConfigure:
+    case ID_DAP_WriteABORT:
+    case ID_DAP_UART_Configure:
+        need = 6;
+        break;
+
+    case ID_DAP_SWJ_Pins:
+        need = 7;
+        break;
+
+    case ID_DAP_Transfer:
+        /* 命令、DAP 索引、传输数，之后每个传输一个请求字节，写和匹配读带 4 字节数据 */
+        need = 3;
+        if (len < need) {
+            return DAP_TCP_LEN_MORE;
+        }
+        for (cnt = buf[2]; cnt > 0; cnt--) {
+            if (len < need + 1) {
+                return DAP_TCP_LEN_MORE;
+            }
+            n = buf[need++];
+            if (!(n & DAP_TRANSFER_RnW) || (n & DAP_TRANSFER_MATCH_VALUE)) {
+                need += 4;
+            }
+        }
+        break;
+
+    case ID_DAP_TransferBlock:
+        /* 命令、DAP 索引、16 位传输数、请求字节，写操作带全部数据 */
+        need = 5;
+        if (len < need) {
+            return DAP_TCP_LEN_MORE;
+        }
+        if (!(buf[4] & DAP_TRANSFER_RnW)) {
+            need += 4 * ((uint32_t)buf[2] | ((uint32_t)buf[3] << 8));
+        }
+        break;
+
+    case ID_DAP_SWJ_Sequence:
+        /* 位数为 0 表示 256 位 */
+        if (len < 2) {
+            return DAP_TCP_LEN_MORE;
+        }
+        n = buf[1] ? buf[1] : 256;
+        need = 2 + (n + 7) / 8;
+        break;
+
+    case ID_DAP_SWD_Sequence:
+    case ID_DAP_JTAG_Sequence:
+        /* 每个序列一个信息字节，位数为 0 表示 64 位；SWD 输入序列不带数据 */
+        need = 2;
+        if (len < need) {
+            return DAP_TCP_LEN_MORE;
+        }
+        for (cnt = buf[1]; cnt > 0; cnt--) {
+            if (len < need + 1) {
+                return DAP_TCP_LEN_MORE;
+            }
+            n = buf[need++];
+            if (buf[0] == ID_DAP_SWD_Sequence && (n & SWD_SEQUENCE_DIN)) {
+                continue;
+            }
+            n &= JTAG_SEQUENCE_TCK;
+            need += ((n ? n : 64) + 7) / 8;
+        }
+        break;
+
+    case ID_DAP_JTAG_Configure:
+        if (len < 2) {
+            return DAP_TCP_LEN_MORE;
+        }
+        need = 2 + buf[1];
+        break;
+
+    case ID_DAP_UART_Transfer:
+        /* 与 UART_Transfer 相同，发送数据最多截断到一个包 */
+        if (len < 3) {
+            return DAP_TCP_LEN_MORE;
+        }
+        n = (uint32_t)buf[1] | ((uint32_t)buf[2] << 8);
+        if (n > DAP_PACKET_SIZE - 3) {
+            n = DAP_PACKET_SIZE - 3;
+        }
+        need = 3 + n;
+        break;
+
+    default:
+        if ((buf[0] >= ID_DAP_Vendor0 && buf[0] <= ID_DAP_Vendor31) ||
+            (buf[0] >= ID_DAP_VendorExFirst && buf[0] <= ID_DAP_VendorExLast)) {
+            return DAP_TCP_LEN_UNKNOWN;
+        }
+        /* 无效命令：DAP_ProcessCommand 只消耗命令字节 */
+        need = 1;
+        break;
+    }
+
+    return (len < need) ? DAP_TCP_LEN_MORE : need;
+}
+
+/**
+ * @brief 计算缓冲区开头一条 DAP 命令的请求长度
+ *
+ * ExecuteCommands 的长度是其中每条子命令长度之和，
+ * 子命令中有厂商命令时整体长度未知
+ *
+ * @return 同 dap_tcp_single_length
+ */
+static uint32_t dap_tcp_command_length(const uint8_t *buf, uint32_t len)
+{
+    uint32_t need;
+    uint32_t cnt;
+    uint32_t n;
+
+    if (len < 1 || buf[0] != ID_DAP_ExecuteCommands) {
+        return dap_tcp_single_length(buf, len);
+    }
+
+    need = 2;
+    if (len < need) {
+        return DAP_TCP_LEN_MORE;
+    }
+    for (cnt = buf[1]; cnt > 0; cnt--) {
+        n = dap_tcp_single_length(buf + need, len - need);
+        if (n == DAP_TCP_LEN_MORE || n == DAP_TCP_LEN_UNKNOWN) {
+            return n;
+        }
+        need += n;
+    }
+    return need;
+}
+
+/**
+ * @brief 处理一个已握手连接上的 DAP 命令流，直到连接断开
+ *
+ * 只执行已经完整收到的命令，被分段截断的命令留在缓冲区开头等待补齐。
+ * 厂商命令的格式由各自的处理函数决定，无法预先计算长度：
+ * 收满一个 DAP 包或者套接字中暂时没有后续数据时才执行，
+ * 消耗的字节数以 DAP_ExecuteCommand 的返回值为准。
+ */
+static void dap_tcp_serve(int sock)
+{
+    uint32_t len = 0;   /* 请求缓冲区中的有效字节数 */
+
+    while (1) {
+        int n = recv(sock, dap_tcp_request + len, DAP_TCP_BUF_SIZE - len, 0);
+        if (n <= 0) {
+            return;
+        }
+        len += (uint32_t)n;
+        memset(dap_tcp_request + len, 0, DAP_PACKET_SIZE);
+
+        uint32_t offset = 0;
+        uint32_t out = 0;
+        int locked = 0;
+
+        while (offset < len) {
+            uint32_t need = dap_tcp_command_length(dap_tcp_request + offset, len - offset);
+
+            if (need == DAP_TCP_LEN_MORE) {
+                break;
+            }
+            if (need == DAP_TCP_LEN_UNKNOWN) {
+                if (len - offset < DAP_PACKET_SIZE && dap_tcp_pending(sock)) {
+                    break;
+                }
+                need = 0;
+            } else if (need > DAP_PACKET_SIZE) {
+                /* 超过一个 DAP 包的命令不合法，也不可能在缓冲区中收齐 */
+                ESP_LOGW(TAG, "命令过长 (0x%02x, %lu 字节)",
+                         dap_tcp_request[offset], (unsigned long)need);
+                if (locked) {
+                    dap_handler_unlock();
+                }
+                return;
+            }
+
+            if (!locked) {
+                dap_handler_lock();
+                locked = 1;
+            }
+            uint32_t ret = DAP_ExecuteCommand(dap_tcp_request + offset, dap_tcp_response + out);
+            offset += need ? need : (ret >> 16);
+            out += ret & 0xFFFFU;
+
+            /* 响应缓冲区放不下下一条响应时先发出去 */
+            if (out > DAP_TCP_BUF_SIZE - DAP_PACKET_SIZE) {
+                dap_handler_unlock();
+                locked = 0;
+                if (dap_tcp_send_all(sock, dap_tcp_response, out) < 0) {
+                    return;
+                }
+                out = 0;
+            }
+        }
+        if (locked) {
+            dap_handler_unlock();
+        }
+
+        if (offset > len) {
+            ESP_LOGW(TAG, "厂商命令被截断 (%lu/%lu)", (unsigned long)len, (unsigned long)offset);
+            offset = len;
+        }
+
+        if (out > 0 && dap_tcp_send_all(sock, dap_tcp_response, out) < 0) {
+            return;
+        }
+
+        /* 未收齐的命令移到缓冲区开头 */
+        len -= offset;
+        memmove(dap_tcp_request, dap_tcp_request + offset, len);
+    }
+}
+
+/**
+ * @brief 设置连接的套接字选项
+ */
+static void dap_tcp_configure(int sock)
+{
+    int one = 1;
+
+    /* 关闭 Nagle：每条响应立即发出，不等待凑满分段 */
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    /* 客户端异常掉线时由保活探测回收连接，避免一直占用服务端 */
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+}
+
+/**
+ * @brief 创建监听套接字
+ * @return 套接字描述符，失败返回 -1
+ */
+static int dap_tcp_listen(void)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (sock < 0) {
+        return -1;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(CONFIG_XN_DAP_TCP_PORT);
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * @brief DAP TCP 服务任务
+ *
+ * @param pvParameters 任务参数（未使用）
+ */
+static void dap_tcp_task(void *pvParameters)
+{
+    int listen_sock;
+
+    while ((listen_sock = dap_tcp_listen()) < 0) {
+        ESP_LOGE(TAG, "监听端口 %d 失败 (errno %d)", CONFIG_XN_DAP_TCP_PORT, errno);
+        vTaskDelay(pdMS_TO_TICKS(DAP_TCP_RETRY_DELAY_MS));
+    }
+    ESP_LOGI(TAG, "DAP TCP 服务已启动，端口 %d", CONFIG_XN_DAP_TCP_PORT);
+
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        int sock = accept(listen_sock, (struct sockaddr *)&peer, &peer_len);
+
+        if (sock < 0) {
+            continue;
+        }
+
+        dap_tcp_configure(sock);
+        ESP_LOGI(TAG, "客户端已连接: %s", inet_ntoa(peer.sin_addr));
+
+        if (dap_tcp_handshake(sock) == 0) {
+            dap_tcp_serve(sock);
+        }
+
+        close(sock);
+        ESP_LOGI(TAG, "客户端已断开");
+    }
+}
+
+/* ==================== 公共接口函数 ==================== */
+
+/**
+ * @brief 初始化 DAP TCP 服务模块
+ *
+ * 应在 dap_handler_init() 和 wifi_init() 之后调用。
+ * 任务运行在 Core 0，与 USB 路径的 DAP 处理任务（Core 1）共用调试接口互斥锁。
+ */
+void dap_tcp_init(void)
+{
+    ESP_LOGI(TAG, "正在初始化 DAP TCP 服务模块...");
+
+    xTaskCreatePinnedToCore(dap_tcp_task, "dap_tcp", 4096, NULL, 5, NULL, 0);
+}
+
+#else
+
+void dap_tcp_init(void)
+{
+}
+
+#endif
@@ -0,0 +1,14 @@
+/**
+ * @file dap_tcp.h
+ * @brief CMSIS-DAP over TCP (elaphureLink protocol)
+ */
+
+#ifndef __DAP_TCP_H__
+#define __DAP_TCP_H__
+
+/**
+ * @brief Initialize DAP TCP server task
+ */
+void dap_tcp_init(void);
+
+#endif // __DAP_TCP_H__
@@ -0,0 +1,1027 @@
+/**
+ * @file gdb_server.c
+ * @brief GDB 远程串行协议（RSP）服务器 - 在探针上直接执行 GDB 操作
+ *
+ * 本文件实现了运行在探针上的 GDB 服务器：
+ * 1. 解析 RSP 数据包（$...#cs），支持 QStartNoAckMode 省去逐包应答
+ * 2. 寄存器、内存、运行控制、FPB 断点、DWT 观察点和 Flash 编程由 gdb_target.c 通过 SWD 完成
+ * 3. 可通过 TCP（默认端口 3333）或 CDC-ACM 串口连接，同一时间只服务一个会话
+ *
+ * 单步、查看内存等操作不再经过 主机→pyOCD/OpenOCD→USB→DAP 的多次往返，
+ * 只受 SWD 速度限制。
+ *
+ * 主机调试器已通过 CMSIS-DAP 连接调试端口时，目标操作返回错误，避免两者
+ * 同时改写内核状态。
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "tusb.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_break.h"
+#include "dap_handler.h"
+#include "gdb_target.h"
+#include "gdb_server.h"
+
+#if CONFIG_XN_GDB_SERVER
+
+/* 日志标签 */
+static const char *TAG = "GDB_SERVER";
+
+/* 最大数据包长度（不含 $、# 和校验和），通过 qSupported 告知 GDB */
+#define GDB_PKT_SIZE            2048
+
+/* 读取超时（毫秒），目标运行时也是查询停止状态的周期 */
+#define GDB_POLL_MS             10
+
+/* CDC 端口检测主机打开串口的间隔（毫秒） */
+#define GDB_CDC_IDLE_MS         100
+
+/* GDB 会话使用的 CDC 接口序号 */
+#define GDB_CDC_ITF             0
+
+/* 传输接口：read 返回读到的字节数，0 表示超时，负数表示连接断开 */
+typedef struct {
+    int (*read)(void *ctx, uint8_t *buf, uint32_t len);
+    int (*write)(void *ctx, const uint8_t *buf, uint32_t len);
+    void *ctx;
+} gdb_io_t;
+
+/* 数据包接收状态 */
+enum {
+    RX_IDLE,
+    RX_DATA,
+    RX_CS1,
+    RX_CS2,
+};
+
+/* 会话状态，同一时间只有一个会话，由 gdb_session_mutex 保护 */
+static const gdb_io_t *gdb_io;
+static uint8_t gdb_rx_state;
+static uint8_t gdb_rx_escape;
+static uint8_t gdb_rx_overflow;
+static uint8_t gdb_rx_sum;
+static uint8_t gdb_rx_cs;
+static uint32_t gdb_pkt_len;
+static uint8_t gdb_noack;
+static uint8_t gdb_running;
+static uint8_t gdb_attached;
+static const char *gdb_console;
+
+static uint8_t gdb_rx_chunk[256];
+static char gdb_pkt[GDB_PKT_SIZE + 1];
+static char gdb_out[GDB_PKT_SIZE + 1];
+static uint8_t gdb_tx[GDB_PKT_SIZE + 4];
+static uint32_t gdb_tx_len;
+static uint8_t gdb_mem[GDB_PKT_SIZE / 2];
+static char gdb_memory_map[512];
+
+static SemaphoreHandle_t gdb_session_mutex;
+
+/* 目标描述：r0-r12/sp/lr/pc/xpsr 为 'g' 包内容，系统寄存器通过 'p' 包读取 */
+static const char gdb_target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\"><architecture>arm</architecture>"
+    "<feature name=\"org.gnu.gdb.arm.m-profile\">"
+    "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/>"
+    "<reg name=\"r2\" bitsize=\"32\"/><reg name=\"r3\" bitsize=\"32\"/>"
+    "<reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"
+    "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/>"
+    "<reg name=\"r8\" bitsize=\"32\"/><reg name=\"r9\" bitsize=\"32\"/>"
+    "<reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>"
+    "<reg name=\"r12\" bitsize=\"32\"/>"
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"lr\" bitsize=\"32\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"xpsr\" bitsize=\"32\" regnum=\"16\"/>"
+    "</feature>"
+    "<feature name=\"org.gnu.gdb.arm.m-system\">"
+    "<reg name=\"msp\" bitsize=\"32\" regnum=\"17\" type=\"data_ptr\"/>"
+    "<reg name=\"psp\" bitsize=\"32\" regnum=\"18\" type=\"data_ptr\"/>"
+    "<reg name=\"primask\" bitsize=\"32\" regnum=\"19\"/>"
+    "<reg name=\"basepri\" bitsize=\"32\" regnum=\"20\"/>"
+    "<reg name=\"faultmask\" bitsize=\"32\" regnum=\"21\"/>"
+    "<reg name=\"control\" bitsize=\"32\" regnum=\"22\"/>"
+    "</feature></target>";
+
+/* ==================== 编码工具 ==================== */
+
+static const char gdb_hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief 解析十六进制数，指针移到第一个非十六进制字符
+ */
+static uint32_t parse_hex(const char **s)
+{
+    uint32_t val = 0;
+    int d;
+
+    while ((d = hex_value(**s)) >= 0) {
+        val = (val << 4) | (uint32_t)d;
+        (*s)++;
+    }
+    return val;
+}
+
+/**
+ * @brief 解析 "addr,len" 形式的参数
+ */
+static const char *parse_addr_len(const char *s, uint32_t *addr, uint32_t *len)
+{
+    *addr = parse_hex(&s);
+    if (*s == ',') {
+        s++;
+    }
+    *len = parse_hex(&s);
+    return s;
+}
+
+static uint32_t put_hex_bytes(char *out, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        out[2 * i] = gdb_hex_digits[data[i] >> 4];
+        out[2 * i + 1] = gdb_hex_digits[data[i] & 0x0F];
+    }
+    return 2 * len;
+}
+
+/**
+ * @brief 以目标字节序（小端）输出 32 位寄存器值
+ */
+static uint32_t put_hex_u32(char *out, uint32_t val)
+{
+    uint8_t b[4] = { (uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16), (uint8_t)(val >> 24) };
+    return put_hex_bytes(out, b, 4);
+}
+
+static uint32_t get_hex_u32(const char *s)
+{
+    uint32_t val = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        val |= (uint32_t)((hex_value(s[2 * i]) << 4) | hex_value(s[2 * i + 1])) << (8 * i);
+    }
+    return val;
+}
+
+/* ==================== 数据包收发 ==================== */
+
+/**
+ * @brief 发送一个数据包，保留副本以便收到 '-' 时重发
+ */
+static void gdb_send(const char *payload, uint32_t len)
+{
+    uint8_t sum = 0;
+    uint32_t i;
+
+    if (len > GDB_PKT_SIZE) {
+        len = GDB_PKT_SIZE;
+    }
+    gdb_tx[0] = '$';
+    for (i = 0; i < len; i++) {
+        gdb_tx[1 + i] = (uint8_t)payload[i];
+        sum += (uint8_t)payload[i];
+    }
+    gdb_tx[1 + len] = '#';
+    gdb_tx[2 + len] = (uint8_t)gdb_hex_digits[sum >> 4];
+    gdb_tx[3 + len] = (uint8_t)gdb_hex_digits[sum & 0x0F];
+    gdb_tx_len = len + 4;
+    gdb_io->write(gdb_io->ctx, gdb_tx, gdb_tx_len);
+}
+
+static void gdb_send_str(const char *s)
+{
+    gdb_send(s, strlen(s));
+}
+
+/**
+ * @brief 以 'O' 包向 GDB 控制台输出文本
+ */
+static void gdb_send_console(const char *text)
+{
+    uint32_t n = strlen(text);
+
+    if (n > (GDB_PKT_SIZE - 1) / 2) {
+        n = (GDB_PKT_SIZE - 1) / 2;
+    }
+    gdb_out[0] = 'O';
+    gdb_send(gdb_out, 1 + put_hex_bytes(gdb_out + 1, (const uint8_t *)text, n));
+}
+
+/* ==================== 目标访问 ==================== */
+
+/**
+ * @brief 目标操作前检查：主机调试器未占用调试端口，且已附着目标
+ *
+ * 主机调试器占用期间或使用过之后丢弃全部目标缓存，端口释放后的第一次操作重新附着
+ * 调用方持有调试接口锁
+ */
+static uint8_t gdb_ready(void)
+{
+    if (DAP_Data.debug_port != DAP_PORT_DISABLED) {
+        if (gdb_attached) {
+            ESP_LOGI(TAG, "主机调试器占用调试端口，释放后重新附着");
+            gdb_target_invalidate();
+            gdb_attached = 0;
+        }
+        return 0;
+    }
+    /* 两次 GDB 操作之间主机调试器连接过（DAP_Connect 取走了所有权），缓存同样作废 */
+    if (gdb_attached && !BRK_Claim(BRK_OWNER_GDB)) {
+        gdb_target_invalidate();
+        gdb_attached = 0;
+    }
+    if (!gdb_attached) {
+        gdb_attached = gdb_target_attach();
+    }
+    return gdb_attached;
+}
+
+/**
+ * @brief 结束附着：调试端口仍归 GDB 时清除断点并让目标继续运行，否则只丢弃缓存
+ *
+ * 主机调试器连接过（即使还没有 GDB 数据包发现）时目标归主机，
+ * 写 DHCSR 会清掉 C_DEBUGEN 让内核在主机调试器下跑起来，不能动目标
+ * 调用方持有调试接口锁
+ */
+static void gdb_detach(void)
+{
+    if (gdb_attached) {
+        if (DAP_Data.debug_port == DAP_PORT_DISABLED && BRK_Claim(BRK_OWNER_GDB)) {
+            gdb_target_detach();
+        } else {
+            gdb_target_invalidate();
+        }
+    }
+    gdb_attached = 0;
+}
+
+/**
+ * @brief 生成停止应答
+ */
+static int gdb_stop_reply(uint8_t signal)
+{
+    return snprintf(gdb_out, sizeof(gdb_out), "S%02x", signal);
+}
+
+/**
+ * @brief 处理 qXfer 读请求，返回文档中 "off,len" 指定的片段
+ */
+static int gdb_xfer(const char *doc, uint32_t doc_len, const char *args)
+{
+    uint32_t off, len;
+
+    parse_addr_len(args, &off, &len);
+    if (off >= doc_len) {
+        gdb_out[0] = 'l';
+        return 1;
+    }
+    if (len > GDB_PKT_SIZE - 1) {
+        len = GDB_PKT_SIZE - 1;
+    }
+    if (len > doc_len - off) {
+        len = doc_len - off;
+    }
+    gdb_out[0] = (off + len < doc_len) ? 'm' : 'l';
+    memcpy(gdb_out + 1, doc + off, len);
+    return 1 + len;
+}
+
+/**
+ * @brief 生成内存映射：Flash 区域之外按 RAM 处理
+ */
+static int gdb_build_memory_map(void)
+{
+    uint32_t start, size, sector;
+    int n;
+
+    if (!gdb_target_flash_region(&start, &size, &sector)) {
+        return 0;
+    }
+    n = snprintf(gdb_memory_map, sizeof(gdb_memory_map),
+                 "<?xml version=\"1.0\"?>"
+                 "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\" "
+                 "\"http://sourceware.org/gdb/gdb-memory-map.dtd\">"
+                 "<memory-map>");
+    if (start > 0) {
+        n += snprintf(gdb_memory_map + n, sizeof(gdb_memory_map) - n,
+                      "<memory type=\"ram\" start=\"0x0\" length=\"0x%lx\"/>", (unsigned long)start);
+    }
+    n += snprintf(gdb_memory_map + n, sizeof(gdb_memory_map) - n,
+                  "<memory type=\"flash\" start=\"0x%lx\" length=\"0x%lx\">"
+                  "<property name=\"blocksize\">0x%lx</property></memory>"
+                  "<memory type=\"ram\" start=\"0x%lx\" length=\"0x%llx\"/>"
+                  "</memory-map>",
+                  (unsigned long)start, (unsigned long)size, (unsigned long)sector,
+                  (unsigned long)(start + size), 0x100000000ULL - start - size);
+    return n;
+}
+
+/**
+ * @brief 处理 monitor 命令（qRcmd）
+ */
+static int gdb_monitor(const char *hex)
+{
+    char cmd[32];
+    uint32_t n = 0;
+    uint8_t ok;
+
+    while (hex[0] && hex[1] && n < sizeof(cmd) - 1) {
+        cmd[n++] = (char)((hex_value(hex[0]) << 4) | hex_value(hex[1]));
+        hex += 2;
+    }
+    cmd[n] = '\0';
+
+    if (!gdb_ready()) {
+        return snprintf(gdb_out, sizeof(gdb_out), "E01");
+    }
+    if (strcmp(cmd, "reset halt") == 0 || strcmp(cmd, "reset init") == 0) {
+        ok = gdb_target_reset(1);
+    } else if (strcmp(cmd, "reset") == 0 || strcmp(cmd, "reset run") == 0) {
+        ok = gdb_target_reset(0);
+    } else if (strcmp(cmd, "halt") == 0) {
+        ok = gdb_target_halt();
+    } else {
+        gdb_console = "unknown command, supported: reset [halt|run], halt\n";
+        ok = 1;
+    }
+    return snprintf(gdb_out, sizeof(gdb_out), ok ? "OK" : "E01");
+}
+
+/**
+ * @brief 处理 'q' 查询包
+ */
+static int gdb_query(const char *p)
+{
+    int n;
+
+    if (strncmp(p, "qSupported", 10) == 0) {
+        return snprintf(gdb_out, sizeof(gdb_out),
+                        "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+%s",
+                        GDB_PKT_SIZE, gdb_build_memory_map() ? ";qXfer:memory-map:read+" : "");
+    }
+    if (strncmp(p, "qXfer:features:read:target.xml:", 31) == 0) {
+        return gdb_xfer(gdb_target_xml, sizeof(gdb_target_xml) - 1, p + 31);
+    }
+    if (strncmp(p, "qXfer:memory-map:read::", 23) == 0) {
+        n = gdb_build_memory_map();
+        return gdb_xfer(gdb_memory_map, n, p + 23);
+    }
+    if (strncmp(p, "qRcmd,", 6) == 0) {
+        return gdb_monitor(p + 6);
+    }
+    if (strcmp(p, "qAttached") == 0) {
+        return snprintf(gdb_out, sizeof(gdb_out), "1");
+    }
+    if (strcmp(p, "qC") == 0) {
+        return snprintf(gdb_out, sizeof(gdb_out), "QC1");
+    }
+    if (strcmp(p, "qfThreadInfo") == 0) {
+        return snprintf(gdb_out, sizeof(gdb_out), "m1");
+    }
+    if (strcmp(p, "qsThreadInfo") == 0) {
+        return snprintf(gdb_out, sizeof(gdb_out), "l");
+    }
+    return 0;
+}
+
+/**
+ * @brief 恢复运行或单步
+ *
+ * @param step 1 单步，0 继续运行
+ * @param p    动作后的可选参数（恢复地址）
+ * @return 应答长度，继续运行时返回 -1（停止后再应答）
+ */
+static int gdb_resume(uint8_t step, const char *p)
+{
+    uint32_t addr;
+
+    if (!gdb_ready()) {
+        return snprintf(gdb_out, sizeof(gdb_out), "E01");
+    }
+    if (hex_value(*p) >= 0) {
+        addr = parse_hex(&p);
+        if (!gdb_target_write_reg(GDB_REG_PC, addr)) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+    }
+    if (step) {
+        if (!gdb_target_step()) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return gdb_stop_reply(5);
+    }
+    if (!gdb_target_resume()) {
+        return snprintf(gdb_out, sizeof(gdb_out), "E01");
+    }
+    gdb_running = 1;
+    return -1;
+}
+
+/**
+ * @brief 处理一个完整的数据包
+ *
+ * @param len 数据包长度（已去除转义），X/vFlashWrite 的二进制数据可能包含 0
+ * @return 应答长度，-1 表示不应答
+ */
+static int gdb_handle(uint32_t len)
+{
+    char *p = gdb_pkt;
+    char *data;
+    uint32_t addr, n, val, i;
+    int type;
+
+    switch (p[0]) {
+    case '?':
+        if (!gdb_ready() || !gdb_target_halt()) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        gdb_running = 0;
+        return gdb_stop_reply(5);
+
+    case 'q':
+        return gdb_query(p);
+
+    case 'Q':
+        if (strcmp(p, "QStartNoAckMode") == 0) {
+            gdb_send_str("OK");
+            gdb_noack = 1;
+            return -1;
+        }
+        return 0;
+
+    case 'H':
+    case 'T':
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'g':
+        if (!gdb_ready()) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        for (i = 0, n = 0; i < GDB_REG_GENERAL; i++) {
+            if (!gdb_target_read_reg(i, &val)) {
+                return snprintf(gdb_out, sizeof(gdb_out), "E01");
+            }
+            n += put_hex_u32(gdb_out + n, val);
+        }
+        return n;
+
+    case 'G':
+        if (!gdb_ready()) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        for (i = 0; i < GDB_REG_GENERAL && 1 + 8 * (i + 1) <= len; i++) {
+            if (!gdb_target_write_reg(i, get_hex_u32(p + 1 + 8 * i))) {
+                return snprintf(gdb_out, sizeof(gdb_out), "E01");
+            }
+        }
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'p':
+        p++;
+        n = parse_hex((const char **)&p);
+        if (!gdb_ready() || !gdb_target_read_reg(n, &val)) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return put_hex_u32(gdb_out, val);
+
+    case 'P':
+        p++;
+        n = parse_hex((const char **)&p);
+        if (*p != '=' || !gdb_ready() || !gdb_target_write_reg(n, get_hex_u32(p + 1))) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'm':
+        parse_addr_len(p + 1, &addr, &n);
+        if (n > sizeof(gdb_mem)) {
+            n = sizeof(gdb_mem);
+        }
+        if (!gdb_ready() || !gdb_target_read_mem(addr, gdb_mem, n)) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return put_hex_bytes(gdb_out, gdb_mem, n);
+
+    case 'M':
+        data = (char *)parse_addr_len(p + 1, &addr, &n);
+        if (*data != ':' || n > sizeof(gdb_mem) || (uint32_t)(data + 1 - gdb_pkt) + 2 * n > len) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        for (i = 0; i < n; i++) {
+            gdb_mem[i] = (uint8_t)((hex_value(data[1 + 2 * i]) << 4) | hex_value(data[2 + 2 * i]));
+        }
+        if (!gdb_ready() || !gdb_target_write_mem(addr, gdb_mem, n)) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'X':
+        data = (char *)parse_addr_len(p + 1, &addr, &n);
+        if (*data != ':' || (uint32_t)(data + 1 - gdb_pkt) + n > len) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        if (n > 0 && (!gdb_ready() || !gdb_target_write_mem(addr, (uint8_t *)data + 1, n))) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'c':
+    case 's':
+        return gdb_resume(p[0] == 's', p + 1);
+
+    case 'C':
+    case 'S':
+        /* 忽略信号编号 */
+        data = strchr(p, ';');
+        return gdb_resume(p[0] == 'S', data ? data + 1 : "");
+
+    case 'v':
+        if (strcmp(p, "vCont?") == 0) {
+            return snprintf(gdb_out, sizeof(gdb_out), "vCont;c;C;s;S");
+        }
+        if (strncmp(p, "vCont;", 6) == 0) {
+            /* 单线程目标：只执行第一个动作 */
+            return gdb_resume(p[6] == 's' || p[6] == 'S', "");
+        }
+        if (strncmp(p, "vFlashErase:", 12) == 0) {
+            parse_addr_len(p + 12, &addr, &n);
+            if (!gdb_ready() || !gdb_target_flash_erase(addr, n)) {
+                return snprintf(gdb_out, sizeof(gdb_out), "E01");
+            }
+            return snprintf(gdb_out, sizeof(gdb_out), "OK");
+        }
+        if (strncmp(p, "vFlashWrite:", 12) == 0) {
+            data = p + 12;
+            addr = parse_hex((const char **)&data);
+            if (*data != ':') {
+                return snprintf(gdb_out, sizeof(gdb_out), "E01");
+            }
+            data++;
+            n = len - (uint32_t)(data - gdb_pkt);
+            if (!gdb_ready() || !gdb_target_flash_write(addr, (const uint8_t *)data, n)) {
+                return snprintf(gdb_out, sizeof(gdb_out), "E01");
+            }
+            return snprintf(gdb_out, sizeof(gdb_out), "OK");
+        }
+        if (strcmp(p, "vFlashDone") == 0) {
+            if (!gdb_ready() || !gdb_target_flash_done()) {
+                return snprintf(gdb_out, sizeof(gdb_out), "E01");
+            }
+            return snprintf(gdb_out, sizeof(gdb_out), "OK");
+        }
+        if (strncmp(p, "vKill", 5) == 0) {
+            if (gdb_ready()) {
+                gdb_target_reset(0);
+            }
+            gdb_running = 0;
+            return snprintf(gdb_out, sizeof(gdb_out), "OK");
+        }
+        return 0;
+
+    case 'Z':
+    case 'z':
+        type = p[1] - '0';
+        p += 2;
+        if (*p == ',') {
+            p++;
+        }
+        parse_addr_len(p, &addr, &n);
+        /* 软件断点也使用 FPB：目标代码多在 Flash 中，无法写入 BKPT 指令；
+         * 观察点类型 2/3/4 = 写/读/访问，n 为观察长度 */
+        if (type < 0 || type > 4) {
+            return 0;
+        }
+        if (!gdb_ready()) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        if (type <= 1) {
+            val = (gdb_pkt[0] == 'Z') ? gdb_target_add_breakpoint(addr) : gdb_target_remove_breakpoint(addr);
+        } else {
+            i = (type == 2) ? BRK_WATCH_WRITE : (type == 3) ? BRK_WATCH_READ : BRK_WATCH_ACCESS;
+            val = (gdb_pkt[0] == 'Z') ? gdb_target_add_watchpoint(addr, n, (uint8_t)i) :
+                                        gdb_target_remove_watchpoint(addr, n, (uint8_t)i);
+        }
+        if (!val) {
+            return snprintf(gdb_out, sizeof(gdb_out), "E01");
+        }
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'D':
+        gdb_detach();
+        gdb_running = 0;
+        return snprintf(gdb_out, sizeof(gdb_out), "OK");
+
+    case 'k':
+        if (gdb_ready()) {
+            gdb_target_reset(0);
+        }
+        gdb_running = 0;
+        return -1;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief 处理目标运行时收到的中断请求（Ctrl-C）
+ */
+static void gdb_interrupt(void)
+{
+    uint8_t ok;
+
+    if (!gdb_running) {
+        return;
+    }
+    dap_handler_lock();
+    ok = gdb_ready() && gdb_target_halt();
+    dap_handler_unlock();
+
+    if (ok) {
+        gdb_running = 0;
+        gdb_stop_reply(2);
+        gdb_send_str(gdb_out);
+    }
+}
+
+/**
+ * @brief 执行一个完整的数据包并发送应答
+ */
+static void gdb_dispatch(void)
+{
+    int n;
+
+    gdb_console = NULL;
+
+    dap_handler_lock();
+    n = gdb_handle(gdb_pkt_len);
+    dap_handler_unlock();
+
+    if (gdb_console != NULL) {
+        gdb_send_console(gdb_console);
+    }
+    if (n >= 0) {
+        gdb_send(gdb_out, (uint32_t)n);
+    }
+}
+
+/**
+ * @brief 逐字节解析 RSP 数据流
+ */
+static void gdb_feed(uint8_t c)
+{
+    switch (gdb_rx_state) {
+    case RX_IDLE:
+        if (c == '$') {
+            gdb_rx_state = RX_DATA;
+            gdb_pkt_len = 0;
+            gdb_rx_sum = 0;
+            gdb_rx_escape = 0;
+            gdb_rx_overflow = 0;
+        } else if (c == 0x03) {
+            gdb_interrupt();
+        } else if (c == '-' && !gdb_noack && gdb_tx_len > 0) {
+            gdb_io->write(gdb_io->ctx, gdb_tx, gdb_tx_len);
+        }
+        break;
+
+    case RX_DATA:
+        if (c == '#') {
+            gdb_rx_state = RX_CS1;
+            break;
+        }
+        gdb_rx_sum += c;
+        if (gdb_rx_escape) {
+            c ^= 0x20;
+            gdb_rx_escape = 0;
+        } else if (c == '}') {
+            gdb_rx_escape = 1;
+            break;
+        }
+        if (gdb_pkt_len < GDB_PKT_SIZE) {
+            gdb_pkt[gdb_pkt_len++] = (char)c;
+        } else {
+            gdb_rx_overflow = 1;
+        }
+        break;
+
+    case RX_CS1:
+        gdb_rx_cs = (uint8_t)(hex_value((char)c) << 4);
+        gdb_rx_state = RX_CS2;
+        break;
+
+    case RX_CS2:
+        gdb_rx_cs |= (uint8_t)hex_value((char)c);
+        gdb_rx_state = RX_IDLE;
+        if (gdb_rx_overflow || (!gdb_noack && gdb_rx_cs != gdb_rx_sum)) {
+            if (!gdb_noack) {
+                gdb_io->write(gdb_io->ctx, (const uint8_t *)"-", 1);
+            }
+            break;
+        }
+        if (!gdb_noack) {
+            gdb_io->write(gdb_io->ctx, (const uint8_t *)"+", 1);
+        }
+        gdb_pkt[gdb_pkt_len] = '\0';
+        gdb_dispatch();
+        break;
+
+    default:
+        gdb_rx_state = RX_IDLE;
+        break;
+    }
+}
+
+/**
+ * @brief 目标运行时查询是否已停止，停止后发送停止应答
+ */
+static void gdb_poll_target(void)
+{
+    uint8_t halted = 0;
+    uint8_t reason = GDB_STOP_HALT;
+    uint8_t type = 0;
+    uint32_t addr = 0;
+
+    dap_handler_lock();
+    if (gdb_ready() && gdb_target_is_halted(&halted) && halted) {
+        gdb_target_stop_reason(&reason, &addr, &type);
+    }
+    dap_handler_unlock();
+
+    if (halted) {
+        gdb_running = 0;
+        if (reason == GDB_STOP_WATCH) {
+            /* 观察点命中：T05 附带观察类型和地址，GDB 据此显示新旧值 */
+            snprintf(gdb_out, sizeof(gdb_out), "T05%swatch:%08lx;",
+                     (type == BRK_WATCH_READ) ? "r" : (type == BRK_WATCH_ACCESS) ? "a" : "",
+                     (unsigned long)addr);
+        } else {
+            gdb_stop_reply(5);
+        }
+        gdb_send_str(gdb_out);
+    }
+}
+
+/**
+ * @brief 运行一个 GDB 会话，直到连接断开
+ */
+static void gdb_session(const gdb_io_t *io)
+{
+    int n, i;
+
+    gdb_io = io;
+    gdb_rx_state = RX_IDLE;
+    gdb_tx_len = 0;
+    gdb_noack = 0;
+    gdb_running = 0;
+    gdb_attached = 0;
+
+    while (1) {
+        n = io->read(io->ctx, gdb_rx_chunk, sizeof(gdb_rx_chunk));
+        if (n < 0) {
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            gdb_feed(gdb_rx_chunk[i]);
+        }
+        if (gdb_running) {
+            gdb_poll_target();
+        }
+    }
+
+    /* 连接断开：清除断点并让目标继续运行 */
+    dap_handler_lock();
+    gdb_detach();
+    dap_handler_unlock();
+    gdb_io = NULL;
+}
+
+/* ==================== TCP 传输 ==================== */
+
+#if CONFIG_XN_DAP_TCP
+
+static int gdb_tcp_read(void *ctx, uint8_t *buf, uint32_t len)
+{
+    int n = recv(*(int *)ctx, buf, len, 0);
+
+    if (n > 0) {
+        return n;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return -1;
+}
+
+static int gdb_tcp_write(void *ctx, const uint8_t *buf, uint32_t len)
+{
+    while (len > 0) {
+        int n = send(*(int *)ctx, buf, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (uint32_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief GDB TCP 服务任务
+ *
+ * @param pvParameters 任务参数（未使用）
+ */
+static void gdb_tcp_task(void *pvParameters)
+{
+    struct sockaddr_in addr;
+    struct timeval tv = { .tv_sec = 0, .tv_usec = GDB_POLL_MS * 1000 };
+    int one = 1;
+    int listen_sock;
+    int sock;
+    gdb_io_t io = { gdb_tcp_read, gdb_tcp_write, &sock };
+
+    listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(CONFIG_XN_GDB_TCP_PORT);
+
+    if (listen_sock < 0 || bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_sock, 1) < 0) {
+        ESP_LOGE(TAG, "监听端口 %d 失败 (errno %d)", CONFIG_XN_GDB_TCP_PORT, errno);
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "GDB TCP 服务已启动，端口 %d", CONFIG_XN_GDB_TCP_PORT);
+
+    while (1) {
+        sock = accept(listen_sock, NULL, NULL);
+        if (sock < 0) {
+            continue;
+        }
+        if (xSemaphoreTake(gdb_session_mutex, 0) != pdTRUE) {
+            ESP_LOGW(TAG, "已有 GDB 会话，拒绝新连接");
+            close(sock);
+            continue;
+        }
+
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        ESP_LOGI(TAG, "GDB 已通过 TCP 连接");
+        gdb_session(&io);
+        ESP_LOGI(TAG, "GDB TCP 会话结束");
+
+        close(sock);
+        xSemaphoreGive(gdb_session_mutex);
+    }
+}
+
+#endif
+
+/* ==================== CDC 传输 ==================== */
+
+#if CONFIG_XN_GDB_CDC
+
+static TaskHandle_t gdb_cdc_task_handle;
+
+/**
+ * @brief CDC 收到数据回调（TinyUSB 任务上下文）
+ */
+void tud_cdc_rx_cb(uint8_t itf)
+{
+    if (itf == GDB_CDC_ITF && gdb_cdc_task_handle != NULL) {
+        xTaskNotifyGive(gdb_cdc_task_handle);
+    }
+}
+
+static int gdb_cdc_read(void *ctx, uint8_t *buf, uint32_t len)
+{
+    if (!tud_cdc_n_connected(GDB_CDC_ITF)) {
+        return -1;
+    }
+    if (!tud_cdc_n_available(GDB_CDC_ITF)) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(GDB_POLL_MS));
+    }
+    return (int)tud_cdc_n_read(GDB_CDC_ITF, buf, len);
+}
+
+static int gdb_cdc_write(void *ctx, const uint8_t *buf, uint32_t len)
+{
+    uint32_t n;
+
+    while (len > 0) {
+        if (!tud_cdc_n_connected(GDB_CDC_ITF)) {
+            return -1;
+        }
+        n = tud_cdc_n_write(GDB_CDC_ITF, buf, len);
+        buf += n;
+        len -= n;
+        tud_cdc_n_write_flush(GDB_CDC_ITF);
+        if (len > 0) {
+            vTaskDelay(1);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief GDB CDC 服务任务：主机打开串口（DTR 置位）即开始会话
+ *
+ * @param pvParameters 任务参数（未使用）
+ */
+static void gdb_cdc_task(void *pvParameters)
+{
+    gdb_io_t io = { gdb_cdc_read, gdb_cdc_write, NULL };
+
+    ESP_LOGI(TAG, "GDB CDC 服务已启动");
+
+    while (1) {
+        if (!tud_cdc_n_connected(GDB_CDC_ITF) ||
+            xSemaphoreTake(gdb_session_mutex, 0) != pdTRUE) {
+            vTaskDelay(pdMS_TO_TICKS(GDB_CDC_IDLE_MS));
+            continue;
+        }
+
+        ESP_LOGI(TAG, "GDB 已通过 CDC 连接");
+        gdb_session(&io);
+        ESP_LOGI(TAG, "GDB CDC 会话结束");
+
+        xSemaphoreGive(gdb_session_mutex);
+    }
+}
+
+#endif
+
+/* ==================== 公共接口函数 ==================== */
+
+/**
+ * @brief 初始化 GDB 服务器模块
+ *
+ * 应在 dap_handler_init() 之后调用。服务任务运行在 Core 0，
+ * 每个数据包持有一次调试接口锁，与 DAP 命令处理和 RTT 桥接交替访问目标。
+ *
+ * @param network 非 0 时启动 TCP 监听（需要 Wi-Fi 已启动）
+ */
+void gdb_server_init(int network)
+{
+    ESP_LOGI(TAG, "正在初始化 GDB 服务器模块...");
+
+    gdb_session_mutex = xSemaphoreCreateMutex();
+
+#if CONFIG_XN_DAP_TCP
+    if (network) {
+        xTaskCreatePinnedToCore(gdb_tcp_task, "gdb_tcp", 4096, NULL, 5, NULL, 0);
+    }
+#endif
+
+#if CONFIG_XN_GDB_CDC
+    xTaskCreatePinnedToCore(gdb_cdc_task, "gdb_cdc", 4096, NULL, 5, &gdb_cdc_task_handle, 0);
+#endif
+}
+
+#else
+
+void gdb_server_init(int network)
+{
+}
+
+#endif
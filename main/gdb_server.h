@@ -0,0 +1,16 @@
+/**
+ * @file gdb_server.h
+ * @brief On-probe GDB remote serial protocol server
+ */
+
+#ifndef __GDB_SERVER_H__
+#define __GDB_SERVER_H__
+
+/**
+ * @brief Initialize GDB server tasks
+ *
+ * @param network non-zero when Wi-Fi is up and the TCP listener should start
+ */
+void gdb_server_init(int network);
+
+#endif // __GDB_SERVER_H__
@@ -0,0 +1,575 @@
+/**
+ * @file gdb_target.c
+ * @brief GDB 服务器的目标操作 - 基于 swd_host 访问 Cortex-M 目标
+ *
+ * 本文件把 GDB 远程协议需要的操作映射到 SWD 访问：
+ * 1. 停止/运行/单步：直接写 DHCSR，等待 S_HALT
+ * 2. 寄存器：通过 DCRSR/DCRDR 读写，停止期间缓存，恢复运行时失效，
+ *    'g' 包之后的 'p' 包和步进后的重复读取都不再访问 SWD
+ * 3. 断点/观察点：由 DAP_break 管理 FPB/DWT 比较器，增删只修改请求状态，
+ *    恢复运行或单步前统一提交，只写入有变化的比较器；
+ *    恢复运行或单步时自动跨过当前 PC 上的断点
+ * 4. Flash：加载 program_target_t 描述的 Flash 算法到目标 RAM，
+ *    通过 swd_flash_syscall_exec 调用擦除和编程函数
+ *
+ * 所有函数由 GDB 服务器在持有调试接口锁时调用。
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "swd_host.h"
+#include "DAP_break.h"
+#include "gdb_target.h"
+
+#define NVIC_Addr (0xe000e000)
+#define DBG_Addr (0xe000edf0)
+#include "debug_cm.h"
+
+/* 日志标签 */
+static const char *TAG = "GDB_TARGET";
+
+/* 停止请求和单步的等待时间（微秒） */
+#define GDB_HALT_TIMEOUT_US     100000
+
+/* Flash 算法函数编号（CMSIS Flash 算法 Init/UnInit 的 fnc 参数） */
+#define FLASH_FUNC_NONE         0
+#define FLASH_FUNC_ERASE        1
+#define FLASH_FUNC_PROGRAM      2
+
+/* 目标连接状态 */
+static uint8_t tgt_connected;
+
+/* 寄存器缓存，GDB 编号，停止期间有效 */
+static uint32_t reg_cache[GDB_REG_COUNT];
+static uint32_t reg_valid;
+
+/* Flash 算法与编程状态 */
+static const program_target_t *flash_algo;
+static uint32_t flash_start;
+static uint32_t flash_size;
+static uint32_t flash_sector;
+static uint8_t *flash_page;
+static uint32_t flash_page_addr;
+static uint8_t flash_page_dirty;
+static uint8_t flash_func;
+
+/* ==================== 连接与运行控制 ==================== */
+
+/**
+ * @brief 建立 SWD 连接并使能调试，不改变内核运行状态
+ */
+static uint8_t tgt_connect(void)
+{
+    uint32_t dhcsr;
+
+    if (tgt_connected) {
+        return 1;
+    }
+    /* swd_init_debug 先尝试快速连接，沿用缓存的 SELECT/CSW/TAR；
+     * 主机调试器连接过时 DAP_Connect/DAP_Disconnect 已将其作废 */
+    if (!swd_init_debug() || !swd_read_word(DBG_HCSR, &dhcsr)) {
+        return 0;
+    }
+    /* 内核已停止时必须保留 C_HALT，否则写 DHCSR 会让内核恢复运行 */
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | ((dhcsr & S_HALT) ? C_HALT : 0))) {
+        return 0;
+    }
+    tgt_connected = 1;
+    return 1;
+}
+
+/**
+ * @brief 查询 PC 上是否有断点
+ * @return PC 地址，没有断点时返回 0
+ */
+static uint32_t bp_at_pc(void)
+{
+    uint32_t pc;
+
+    if (!gdb_target_read_reg(GDB_REG_PC, &pc) || !BRK_IsBreakpoint(pc & ~1U)) {
+        return 0;
+    }
+    return pc & ~1U;
+}
+
+/**
+ * @brief 单步执行一条指令，期间屏蔽中断
+ *
+ * C_MASKINTS 只能在内核停止时修改，因此先带 C_HALT 设置，再发起单步
+ */
+static uint8_t tgt_step_raw(void)
+{
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT | C_MASKINTS) ||
+        !swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_MASKINTS | C_STEP) ||
+        !swd_wait_until_halted(GDB_HALT_TIMEOUT_US)) {
+        return 0;
+    }
+    return swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+}
+
+/**
+ * @brief 提交断点并单步，PC 上有断点时单步期间临时撤销
+ *
+ * 撤销只对这一次提交生效，单步后重新请求，下次提交时再写回
+ */
+static uint8_t tgt_step_over(void)
+{
+    uint32_t pc = bp_at_pc();
+
+    if (pc == 0) {
+        return BRK_Commit(NULL) && tgt_step_raw();
+    }
+    BRK_ClearBreakpoint(pc);
+    if (!BRK_Commit(NULL) || !tgt_step_raw()) {
+        BRK_SetBreakpoint(pc);
+        return 0;
+    }
+    return BRK_SetBreakpoint(pc);
+}
+
+/**
+ * @brief 附着目标：建立连接，重新发现 FPB/DWT，首次提交时清空所有比较器
+ */
+uint8_t gdb_target_attach(void)
+{
+    tgt_connected = 0;
+    reg_valid = 0;
+
+    BRK_Claim(BRK_OWNER_GDB);
+    BRK_Invalidate();
+    if (!tgt_connect() || !BRK_Init()) {
+        return 0;
+    }
+
+    ESP_LOGI(TAG, "目标已附着");
+    return 1;
+}
+
+/**
+ * @brief 丢弃全部缓存状态，不访问目标
+ *
+ * 主机调试器使用过调试端口后，SWD 访问状态和寄存器缓存都不再可信，
+ * 目标 RAM 中的 Flash 算法也可能已被覆盖；之后需要重新 gdb_target_attach。
+ * 断点状态此时归主机所有，不在这里清除，GDB 重新取得所有权时（BRK_Claim）作废
+ */
+void gdb_target_invalidate(void)
+{
+    tgt_connected = 0;
+    reg_valid = 0;
+    flash_func = FLASH_FUNC_NONE;
+    swd_invalidate_state();
+}
+
+/**
+ * @brief 脱离目标：清除断点和观察点，关闭调试并让内核运行
+ */
+void gdb_target_detach(void)
+{
+    if (!tgt_connected) {
+        return;
+    }
+    BRK_ClearAll();
+    swd_write_word(DBG_HCSR, DBGKEY);
+    tgt_connected = 0;
+    reg_valid = 0;
+}
+
+uint8_t gdb_target_halt(void)
+{
+    if (!tgt_connect()) {
+        return 0;
+    }
+    reg_valid = 0;
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT) ||
+        !swd_wait_until_halted(GDB_HALT_TIMEOUT_US)) {
+        tgt_connected = 0;
+        return 0;
+    }
+    return 1;
+}
+
+uint8_t gdb_target_resume(void)
+{
+    if (!tgt_connect()) {
+        return 0;
+    }
+    /* 停在断点上时先单步跨过，否则恢复后立即再次命中 */
+    if (bp_at_pc() != 0 && !tgt_step_over()) {
+        tgt_connected = 0;
+        return 0;
+    }
+    reg_valid = 0;
+    if (!BRK_Commit(NULL) || !swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN)) {
+        tgt_connected = 0;
+        return 0;
+    }
+    return 1;
+}
+
+uint8_t gdb_target_step(void)
+{
+    if (!tgt_connect()) {
+        return 0;
+    }
+    if (!tgt_step_over()) {
+        tgt_connected = 0;
+        reg_valid = 0;
+        return 0;
+    }
+    reg_valid = 0;
+    return 1;
+}
+
+/**
+ * @brief 查询内核是否已停止
+ */
+uint8_t gdb_target_is_halted(uint8_t *halted)
+{
+    uint32_t dhcsr;
+
+    if (!tgt_connect() || !swd_read_word(DBG_HCSR, &dhcsr)) {
+        tgt_connected = 0;
+        return 0;
+    }
+    *halted = (dhcsr & S_HALT) ? 1 : 0;
+    return 1;
+}
+
+/**
+ * @brief 读取并清除 DFSR，得到停止原因
+ *
+ * @param reason GDB_STOP_xxx
+ * @param addr   观察点命中时为被观察的地址
+ * @param type   观察点命中时为 BRK_WATCH_xxx
+ */
+uint8_t gdb_target_stop_reason(uint8_t *reason, uint32_t *addr, uint8_t *type)
+{
+    uint32_t dfsr;
+    uint8_t hit = 0;
+
+    if (!swd_read_word(NVIC_DFSR, &dfsr) || !swd_write_word(NVIC_DFSR, dfsr)) {
+        return 0;
+    }
+    if ((dfsr & DWTTRAP) && !BRK_WatchHit(&hit, addr, type)) {
+        return 0;
+    }
+    if (hit) {
+        *reason = GDB_STOP_WATCH;
+    } else {
+        *reason = (dfsr & BKPT) ? GDB_STOP_BREAK : GDB_STOP_HALT;
+    }
+    return 1;
+}
+
+/**
+ * @brief 复位目标
+ * @param halt 1 复位后停在复位向量，0 复位后运行
+ */
+uint8_t gdb_target_reset(uint8_t halt)
+{
+    uint8_t ok;
+
+    reg_valid = 0;
+    ok = swd_set_target_state_sw(halt ? RESET_PROGRAM : RESET_RUN);
+
+    /* RESET_RUN 会关闭 SWD，下次访问时重新连接；
+     * 复位序列改写了 DEMCR（TRCENA 被清除），下次提交时重写全部比较器 */
+    tgt_connected = 0;
+    BRK_Reapply();
+    if (ok && halt) {
+        ok = tgt_connect();
+    }
+    return ok;
+}
+
+/* ==================== 寄存器与内存 ==================== */
+
+/**
+ * @brief GDB 寄存器编号转换为 DCRSR.REGSEL
+ *
+ * 0-15 为 r0-r15，16 为 xPSR，17/18 为 MSP/PSP，
+ * 19-22 (PRIMASK/BASEPRI/FAULTMASK/CONTROL) 共用 REGSEL 20 的四个字节
+ */
+static uint32_t reg_select(uint32_t n)
+{
+    return (n < 19) ? n : 20;
+}
+
+uint8_t gdb_target_read_reg(uint32_t n, uint32_t *val)
+{
+    uint32_t raw;
+    uint32_t i;
+
+    if (n >= GDB_REG_COUNT) {
+        return 0;
+    }
+    if (!(reg_valid & (1U << n))) {
+        if (!tgt_connect() || !swd_read_core_register(reg_select(n), &raw)) {
+            return 0;
+        }
+        if (n < 19) {
+            reg_cache[n] = raw;
+            reg_valid |= 1U << n;
+        } else {
+            for (i = 19; i < GDB_REG_COUNT; i++) {
+                reg_cache[i] = (raw >> (8 * (i - 19))) & 0xFF;
+                reg_valid |= 1U << i;
+            }
+        }
+    }
+    *val = reg_cache[n];
+    return 1;
+}
+
+uint8_t gdb_target_write_reg(uint32_t n, uint32_t val)
+{
+    uint32_t raw = 0;
+    uint32_t cur;
+    uint32_t i;
+
+    if (n >= GDB_REG_COUNT || !tgt_connect()) {
+        return 0;
+    }
+    if (n < 19) {
+        raw = val;
+    } else {
+        for (i = 19; i < GDB_REG_COUNT; i++) {
+            if (i == n) {
+                cur = val & 0xFF;
+            } else if (!gdb_target_read_reg(i, &cur)) {
+                return 0;
+            }
+            raw |= cur << (8 * (i - 19));
+        }
+    }
+    if (!swd_write_core_register(reg_select(n), raw)) {
+        reg_valid &= ~(1U << n);
+        return 0;
+    }
+    reg_cache[n] = (n < 19) ? val : (val & 0xFF);
+    reg_valid |= 1U << n;
+    return 1;
+}
+
+uint8_t gdb_target_read_mem(uint32_t addr, uint8_t *data, uint32_t len)
+{
+    return tgt_connect() && swd_read_memory(addr, data, len);
+}
+
+uint8_t gdb_target_write_mem(uint32_t addr, uint8_t *data, uint32_t len)
+{
+    return tgt_connect() && swd_write_memory(addr, data, len);
+}
+
+/* ==================== 断点与观察点 ==================== */
+
+/* 增删只修改请求状态，由下一次恢复运行或单步统一写入目标 */
+
+uint8_t gdb_target_add_breakpoint(uint32_t addr)
+{
+    return BRK_SetBreakpoint(addr & ~1U);
+}
+
+uint8_t gdb_target_remove_breakpoint(uint32_t addr)
+{
+    return BRK_ClearBreakpoint(addr & ~1U);
+}
+
+/**
+ * @param len  观察长度，2 的幂且地址按长度对齐（ARMv8-M 最大 4 字节）
+ * @param type BRK_WATCH_xxx
+ */
+uint8_t gdb_target_add_watchpoint(uint32_t addr, uint32_t len, uint8_t type)
+{
+    return BRK_SetWatchpoint(addr, len, type);
+}
+
+uint8_t gdb_target_remove_watchpoint(uint32_t addr, uint32_t len, uint8_t type)
+{
+    return BRK_ClearWatchpoint(addr, len, type);
+}
+
+/* ==================== Flash 编程 ==================== */
+
+/**
+ * @brief 注册目标 Flash 算法
+ *
+ * @param algo        Flash 算法（入口地址为绝对地址，由 algo_blob 加载到 algo_start）
+ * @param start       Flash 起始地址
+ * @param size        Flash 大小
+ * @param sector_size 擦除扇区大小
+ *
+ * 未注册算法时 GDB 服务器不提供内存映射，load 命令按普通内存写入处理。
+ */
+void gdb_target_flash_register(const program_target_t *algo, uint32_t start, uint32_t size, uint32_t sector_size)
+{
+    free(flash_page);
+    flash_page = NULL;
+    flash_algo = NULL;
+
+    if (algo == NULL || algo->program_buffer_size == 0 || sector_size == 0) {
+        return;
+    }
+    flash_page = malloc(algo->program_buffer_size);
+    if (flash_page == NULL) {
+        ESP_LOGE(TAG, "Flash 页缓冲区分配失败");
+        return;
+    }
+    flash_algo = algo;
+    flash_start = start;
+    flash_size = size;
+    flash_sector = sector_size;
+    flash_page_dirty = 0;
+    flash_func = FLASH_FUNC_NONE;
+}
+
+uint8_t gdb_target_flash_region(uint32_t *start, uint32_t *size, uint32_t *sector_size)
+{
+    if (flash_algo == NULL) {
+        return 0;
+    }
+    *start = flash_start;
+    *size = flash_size;
+    *sector_size = flash_sector;
+    return 1;
+}
+
+/**
+ * @brief 调用 Flash 算法函数
+ */
+static uint8_t flash_call(uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    return swd_flash_syscall_exec(&flash_algo->sys_call_s, entry, arg1, arg2, arg3, 0);
+}
+
+/**
+ * @brief 切换 Flash 算法功能：首次使用时停止内核并加载算法，功能变化时重新 Init
+ */
+static uint8_t flash_init(uint8_t func)
+{
+    if (flash_func == func) {
+        return 1;
+    }
+    if (flash_func != FLASH_FUNC_NONE) {
+        if (!flash_call(flash_algo->uninit, flash_func, 0, 0)) {
+            return 0;
+        }
+    } else {
+        if (!gdb_target_halt() ||
+            !swd_write_memory(flash_algo->algo_start, (uint8_t *)flash_algo->algo_blob, flash_algo->algo_size)) {
+            return 0;
+        }
+    }
+    flash_func = FLASH_FUNC_NONE;
+    reg_valid = 0;
+    if (!flash_call(flash_algo->init, flash_start, 0, func)) {
+        return 0;
+    }
+    flash_func = func;
+    return 1;
+}
+
+/**
+ * @brief 编程页缓冲区中的数据
+ */
+static uint8_t flash_flush(void)
+{
+    uint32_t psize = flash_algo->program_buffer_size;
+
+    if (!flash_page_dirty) {
+        return 1;
+    }
+    flash_page_dirty = 0;
+    return swd_write_memory(flash_algo->program_buffer, flash_page, psize) &&
+           flash_call(flash_algo->program_page, flash_page_addr, psize, flash_algo->program_buffer);
+}
+
+uint8_t gdb_target_flash_erase(uint32_t addr, uint32_t len)
+{
+    uint32_t a;
+
+    if (flash_algo == NULL || addr < flash_start || addr + len > flash_start + flash_size) {
+        return 0;
+    }
+    if (!flash_init(FLASH_FUNC_ERASE)) {
+        return 0;
+    }
+    a = flash_start + ((addr - flash_start) / flash_sector) * flash_sector;
+    for (; a < addr + len; a += flash_sector) {
+        if (!flash_call(flash_algo->erase_sector, a, 0, 0)) {
+            ESP_LOGE(TAG, "扇区擦除失败: 0x%08lx", (unsigned long)a);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 写入 Flash 数据，凑满一页后编程，页内未写部分保持擦除值 0xFF
+ */
+uint8_t gdb_target_flash_write(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    uint32_t psize;
+    uint32_t page;
+    uint32_t n;
+
+    if (flash_algo == NULL || addr < flash_start || addr + len > flash_start + flash_size) {
+        return 0;
+    }
+    if (!flash_init(FLASH_FUNC_PROGRAM)) {
+        return 0;
+    }
+    psize = flash_algo->program_buffer_size;
+
+    while (len > 0) {
+        page = flash_start + ((addr - flash_start) / psize) * psize;
+        if (flash_page_dirty && page != flash_page_addr && !flash_flush()) {
+            return 0;
+        }
+        if (!flash_page_dirty) {
+            flash_page_addr = page;
+            memset(flash_page, 0xFF, psize);
+            flash_page_dirty = 1;
+        }
+        n = page + psize - addr;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(flash_page + (addr - page), data, n);
+        addr += n;
+        data += n;
+        len -= n;
+        if (addr == page + psize && !flash_flush()) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief 结束 Flash 操作：编程剩余数据并调用 UnInit
+ *
+ * 算法运行改写了内核寄存器和目标 RAM，调用方应随后复位目标
+ */
+uint8_t gdb_target_flash_done(void)
+{
+    uint8_t ok = 1;
+
+    if (flash_algo == NULL) {
+        return 0;
+    }
+    /* 作废状态后算法需要重新加载，剩余数据仍要写入 */
+    if (flash_page_dirty) {
+        ok = flash_init(FLASH_FUNC_PROGRAM) && flash_flush();
+    }
+    if (flash_func != FLASH_FUNC_NONE) {
+        ok = flash_call(flash_algo->uninit, flash_func, 0, 0) && ok;
+    }
+    flash_func = FLASH_FUNC_NONE;
+    flash_page_dirty = 0;
+    reg_valid = 0;
+    return ok;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file gdb_target.h
+ * @brief Cortex-M target operations for the on-probe GDB server
+ *
+ * All functions access the target over SWD; the caller must hold the debug
+ * port lock (dap_handler_lock). Functions returning uint8_t return 1 on
+ * success and 0 on failure.
+ */
+
+#ifndef __GDB_TARGET_H__
+#define __GDB_TARGET_H__
+
+#include <stdint.h>
+#include "flash_blob.h"
+
+/* GDB register numbers, matching the target description */
+#define GDB_REG_PC          15
+#define GDB_REG_XPSR        16
+#define GDB_REG_GENERAL     17      // r0-r12, sp, lr, pc, xpsr ('g' packet)
+#define GDB_REG_COUNT       23      // + msp, psp, primask, basepri, faultmask, control
+
+/* Reason for the last halt */
+#define GDB_STOP_HALT       0       // Halt request, step or vector catch
+#define GDB_STOP_BREAK      1       // Breakpoint
+#define GDB_STOP_WATCH      2       // Watchpoint, see BRK_WATCH_xxx
+
+uint8_t gdb_target_attach(void);
+void gdb_target_detach(void);
+void gdb_target_invalidate(void);
+uint8_t gdb_target_halt(void);
+uint8_t gdb_target_resume(void);
+uint8_t gdb_target_step(void);
+uint8_t gdb_target_is_halted(uint8_t *halted);
+uint8_t gdb_target_stop_reason(uint8_t *reason, uint32_t *addr, uint8_t *type);
+uint8_t gdb_target_reset(uint8_t halt);
+
+uint8_t gdb_target_read_reg(uint32_t n, uint32_t *val);
+uint8_t gdb_target_write_reg(uint32_t n, uint32_t val);
+uint8_t gdb_target_read_mem(uint32_t addr, uint8_t *data, uint32_t len);
+uint8_t gdb_target_write_mem(uint32_t addr, uint8_t *data, uint32_t len);
+
+uint8_t gdb_target_add_breakpoint(uint32_t addr);
+uint8_t gdb_target_remove_breakpoint(uint32_t addr);
+uint8_t gdb_target_add_watchpoint(uint32_t addr, uint32_t len, uint8_t type);
+uint8_t gdb_target_remove_watchpoint(uint32_t addr, uint32_t len, uint8_t type);
+
+void gdb_target_flash_register(const program_target_t *algo, uint32_t start, uint32_t size, uint32_t sector_size);
+uint8_t gdb_target_flash_region(uint32_t *start, uint32_t *size, uint32_t *sector_size);
+uint8_t gdb_target_flash_erase(uint32_t addr, uint32_t len);
+uint8_t gdb_target_flash_write(uint32_t addr, const uint8_t *data, uint32_t len);
+uint8_t gdb_target_flash_done(void);
+
+#endif // __GDB_TARGET_H__
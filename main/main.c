@@ -8,9 +8,14 @@
  * CMSIS-DAP 处理器，使 ESP32-S3 成为一个功能完整的调试探针。
  * 
  * 系统启动流程：
- * 1. 初始化 USB 设备协议栈（TinyUSB）
- * 2. 启动 DAP 命令处理任务
- * 3. 进入主循环等待调试主机连接
+ * 1. 初始化 NVS（ROM 表缓存等持久化数据）
+ * 2. 初始化 USB 设备协议栈（TinyUSB）
+ * 3. 启动 DAP 命令处理任务
+ * 4. 启动 RTT 桥接任务
+ * 5. 启动 CDC-UART 虚拟串口桥接
+ * 6. 接入 Wi-Fi 并启动 DAP TCP 服务
+ * 7. 启动 GDB 服务器
+ * 8. 进入主循环等待调试主机连接
  * 
  * Copyright (c) 2025 by 星年, All Rights Reserved.
  */
@@ -19,8 +24,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
 #include "usb_init.h"
 #include "dap_handler.h"
+#include "rtt_bridge.h"
+#include "cdc_uart.h"
+#include "wifi_init.h"
+#include "dap_tcp.h"
+#include "gdb_server.h"
 
 /* 日志标签 - 用于标识本模块的日志输出 */
 static const char *TAG = "S3_DAPLINK_USB";
@@ -42,7 +53,22 @@ void app_main(void)
     ESP_LOGI(TAG, "s3_daplink_usb: app_main start");
 
     /*
-     * 步骤 1: 初始化 USB 设备
+     * 步骤 1: 初始化 NVS
+     *
+     * NVS 分区已满或版本不匹配时擦除后重新初始化。
+     * NVS 只用于缓存，初始化失败时探针仍可正常工作
+     */
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "nvs_flash_init failed: %s", esp_err_to_name(err));
+    }
+
+    /*
+     * 步骤 2: 初始化 USB 设备
      * 
      * usb_init() 会配置 TinyUSB 协议栈，包括：
      * - 设置 USB 物理层参数
@@ -59,7 +85,7 @@ void app_main(void)
     ESP_LOGI(TAG, "USB initialized, starting DAP handler...");
 
     /*
-     * 步骤 2: 初始化 DAP 命令处理器
+     * 步骤 3: 初始化 DAP 命令处理器
      * 
      * dap_handler_init() 会创建一个 FreeRTOS 任务，负责：
      * - 监听 USB Vendor 类接口的数据
@@ -69,10 +95,45 @@ void app_main(void)
      */
     dap_handler_init();
 
+    /*
+     * 步骤 4: 初始化 RTT 桥接
+     * 
+     * rtt_bridge_init() 创建后台任务，在主机未连接调试端口时
+     * 轮询目标 RTT 缓冲区并通过 USB Vendor 接口 1 转发
+     */
+    rtt_bridge_init();
+
+    /*
+     * 步骤 5: 初始化 CDC-UART 桥接
+     * 
+     * cdc_uart_init() 将 USB CDC 虚拟串口桥接到目标 UART（UART2），
+     * 主机可直接用串口终端访问目标的串口输出
+     */
+    cdc_uart_init();
+
+    /*
+     * 步骤 6: 初始化 Wi-Fi 和 DAP TCP 服务
+     * 
+     * 在 menuconfig 中配置了 SSID 时，探针接入 Wi-Fi 并在 TCP 端口上
+     * 接受 elaphureLink 协议的 DAP 命令，与 USB 共用同一命令引擎
+     */
+    int network = (wifi_init() == 0);
+    if (network) {
+        dap_tcp_init();
+    }
+
+    /*
+     * 步骤 7: 初始化 GDB 服务器
+     * 
+     * gdb_server_init() 在探针上运行 GDB 远程协议服务器，
+     * GDB 可通过 TCP 或 CDC 串口直接连接，无需 pyOCD/OpenOCD
+     */
+    gdb_server_init(network);
+
     ESP_LOGI(TAG, "DAP handler started, waiting for host...");
 
     /*
-     * 步骤 3: 主循环
+     * 步骤 8: 主循环
      * 
      * 主任务进入空闲循环，定期让出 CPU 时间。
      * 实际的 DAP 处理工作由 dap_handler_task 完成。
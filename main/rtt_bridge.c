@@ -0,0 +1,222 @@
+/**
+ * @file rtt_bridge.c
+ * @brief RTT 桥接模块 - 在探针上轮询目标 SEGGER RTT 缓冲区
+ *
+ * 本文件实现了 RTT 数据的后台搬运：
+ * 1. 通过 SWD 扫描目标 RAM，定位 "SEGGER RTT" 控制块
+ * 2. 轮询通道 0 的 up 缓冲区，将数据写入 USB Vendor 接口 1
+ * 3. 将主机从 Vendor 接口 1 发来的数据写入通道 0 的 down 缓冲区
+ *
+ * 吞吐量只受 SWD 带宽限制，不再受 USB 命令往返延迟限制。
+ *
+ * 注意：仅当主机未连接调试端口（DAP_Connect 之前或 DAP_Disconnect 之后）
+ * 时才访问目标，避免破坏主机侧的 SELECT/CSW 状态。
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "tusb.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "swd_host.h"
+#include "rtt.h"
+#include "dap_handler.h"
+#include "rtt_bridge.h"
+
+/* 日志标签 */
+static const char *TAG = "RTT_BRIDGE";
+
+/* RTT 数据所在的 USB Vendor 接口序号（0 为 CMSIS-DAP） */
+#define RTT_VENDOR_ITF          1
+
+/* 桥接的 RTT 通道号 */
+#define RTT_CHANNEL             0
+
+/* 单次搬运的最大字节数，限制每次持锁时间 */
+#define RTT_CHUNK_SIZE          256
+
+/* 空闲时的轮询间隔上限（毫秒） */
+#define RTT_IDLE_DELAY_MAX_MS   10
+
+/* 目标未连接或控制块未找到时的重试间隔（毫秒） */
+#define RTT_RETRY_DELAY_MS      500
+
+/* up 方向搬运缓冲区 */
+static uint8_t rtt_up_buf[RTT_CHUNK_SIZE];
+
+/* down 方向缓冲区，保存已从 USB 读出但尚未写入目标的数据 */
+static uint8_t rtt_down_buf[RTT_CHUNK_SIZE];
+static uint32_t rtt_down_len;
+
+/**
+ * @brief 执行一次 up/down 数据搬运
+ *
+ * @param moved 返回本次搬运的字节数
+ * @return 1 成功，0 SWD 访问失败
+ */
+static uint8_t rtt_bridge_pump(uint32_t *moved)
+{
+    uint32_t count, space;
+
+    *moved = 0;
+
+    /* up：目标 -> 主机，只读取 USB 发送缓冲区能容纳的数据量 */
+    space = tud_vendor_n_write_available(RTT_VENDOR_ITF);
+    if (space > sizeof(rtt_up_buf)) {
+        space = sizeof(rtt_up_buf);
+    }
+
+    if (space > 0) {
+        if (!rtt_read_up(RTT_CHANNEL, rtt_up_buf, space, &count)) {
+            return 0;
+        }
+
+        if (count > 0) {
+            tud_vendor_n_write(RTT_VENDOR_ITF, rtt_up_buf, count);
+            tud_vendor_n_flush(RTT_VENDOR_ITF);
+            *moved += count;
+        }
+    }
+
+    /* down：主机 -> 目标，目标缓冲区满时保留剩余数据到下一轮 */
+    if (rtt_down_len == 0 && tud_vendor_n_available(RTT_VENDOR_ITF)) {
+        rtt_down_len = tud_vendor_n_read(RTT_VENDOR_ITF, rtt_down_buf, sizeof(rtt_down_buf));
+    }
+
+    if (rtt_down_len > 0) {
+        if (!rtt_write_down(RTT_CHANNEL, rtt_down_buf, rtt_down_len, &count)) {
+            return 0;
+        }
+
+        if (count > 0) {
+            memmove(rtt_down_buf, rtt_down_buf + count, rtt_down_len - count);
+            rtt_down_len -= count;
+            *moved += count;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief RTT 桥接任务
+ *
+ * 每轮循环持有调试接口锁，完成一次扫描或搬运后立即释放，
+ * 保证 DAP 命令处理任务可以随时插入。
+ *
+ * @param pvParameters 任务参数（未使用）
+ */
+static void rtt_bridge_task(void *pvParameters)
+{
+    uint8_t attached = 0;
+    uint32_t idle_ms = 1;
+    uint32_t moved;
+    uint8_t ret;
+
+    ESP_LOGI(TAG, "RTT 桥接任务已启动");
+
+    while (1) {
+        /* RTT 未启用或 USB 接口未打开时不访问目标 */
+        if (!rtt_is_enabled() || !tud_vendor_n_mounted(RTT_VENDOR_ITF)) {
+            if (attached) {
+                dap_handler_lock();
+                if (DAP_Data.debug_port == DAP_PORT_DISABLED) {
+                    swd_off();
+                }
+                dap_handler_unlock();
+                attached = 0;
+            }
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        dap_handler_lock();
+
+        /* 主机已连接调试端口，让出目标，主机断开后重新附着。
+         * swd_host 的 SELECT/CSW 缓存已由 DAP_Connect/DAP_Disconnect 作废 */
+        if (DAP_Data.debug_port != DAP_PORT_DISABLED) {
+            dap_handler_unlock();
+            attached = 0;
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        if (!attached) {
+            if (!swd_init_debug()) {
+                swd_off();
+                dap_handler_unlock();
+                vTaskDelay(pdMS_TO_TICKS(RTT_RETRY_DELAY_MS));
+                continue;
+            }
+            attached = 1;
+            rtt_reset();
+        }
+
+        moved = 0;
+        ret = rtt_scan();
+
+        if (ret == RTT_SCAN_FOUND) {
+            if (!rtt_bridge_pump(&moved)) {
+                attached = 0;
+            }
+        }
+
+        dap_handler_unlock();
+
+        switch (ret) {
+        case RTT_SCAN_ERROR:
+            attached = 0;
+            vTaskDelay(pdMS_TO_TICKS(RTT_RETRY_DELAY_MS));
+            break;
+
+        case RTT_SCAN_NOT_FOUND:
+            /* 目标可能尚未初始化 RTT，稍后从头重新扫描 */
+            vTaskDelay(pdMS_TO_TICKS(RTT_RETRY_DELAY_MS));
+            rtt_reset();
+            break;
+
+        case RTT_SCAN_BUSY:
+            taskYIELD();
+            break;
+
+        default:
+            /* 有数据时立即继续，空闲时逐步加长轮询间隔 */
+            if (moved > 0) {
+                idle_ms = 1;
+                taskYIELD();
+            } else {
+                vTaskDelay(pdMS_TO_TICKS(idle_ms));
+                if (idle_ms < RTT_IDLE_DELAY_MAX_MS) {
+                    idle_ms <<= 1;
+                }
+            }
+            break;
+        }
+    }
+}
+
+/* ==================== 公共接口函数 ==================== */
+
+/**
+ * @brief 初始化 RTT 桥接模块
+ *
+ * 创建 RTT 桥接任务，应在 dap_handler_init() 之后调用。
+ * DAP 处理任务空闲时只调用 taskYIELD()，因此桥接任务与其同优先级、
+ * 同核心运行，否则会被饿死。RTT 默认关闭，由主机通过厂商命令打开。
+ */
+void rtt_bridge_init(void)
+{
+    ESP_LOGI(TAG, "正在初始化 RTT 桥接模块...");
+
+    xTaskCreatePinnedToCore(
+        rtt_bridge_task,
+        "rtt_bridge",
+        4096,
+        NULL,
+        5,
+        NULL,
+        1
+    );
+}
@@ -0,0 +1,14 @@
+/**
+ * @file rtt_bridge.h
+ * @brief SEGGER RTT bridge between target RAM and a USB Vendor interface
+ */
+
+#ifndef __RTT_BRIDGE_H__
+#define __RTT_BRIDGE_H__
+
+/**
+ * @brief Initialize RTT bridge task
+ */
+void rtt_bridge_init(void);
+
+#endif // __RTT_BRIDGE_H__
@@ -0,0 +1,121 @@
+/**
+ * @file swo_stream.c
+ * @brief SWO 流式传输 - CMSIS-DAP v2 接口的 SWO Bulk IN 端点
+ *
+ * 本文件实现 SWO.c 所需的 USB 传输接口：
+ * 1. SWO_QueueTransfer() 登记一段 TraceBuf 数据，直接从 TraceBuf 发送（零拷贝）
+ * 2. swo_stream_poll() 在 DAP 处理任务中启动传输，并在端点空闲后
+ *    调用 SWO_TransferComplete() 释放 TraceBuf 空间
+ *
+ * SWO 端点属于 CMSIS-DAP Vendor 接口，由 TinyUSB Vendor 类随接口一起打开，
+ * 但 Vendor 类只处理第一对 OUT/IN 端点，因此这里直接使用 usbd_edpt_* 接口
+ * 操作该端点，传输完成通过 usbd_edpt_busy() 轮询得到。
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "tusb.h"
+#include "device/usbd_pvt.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "swo_stream.h"
+
+#if (SWO_STREAM != 0)
+
+/* 传输状态，SWO 流任务与 DAP 处理任务共享 */
+static portMUX_TYPE swo_stream_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t *swo_pending_buf;        /* 等待启动的传输 */
+static uint32_t swo_pending_len;
+static uint8_t swo_inflight;            /* 端点上有传输进行中 */
+static uint8_t swo_aborted;             /* 进行中的传输已被放弃，完成时不上报 */
+
+/**
+ * @brief 登记一次 SWO 传输（由 SWO.c 的流任务调用）
+ *
+ * @param buf TraceBuf 中的数据起始地址
+ * @param num 字节数
+ */
+void SWO_QueueTransfer(uint8_t *buf, uint32_t num)
+{
+    portENTER_CRITICAL(&swo_stream_lock);
+    swo_pending_buf = buf;
+    swo_pending_len = num;
+    portEXIT_CRITICAL(&swo_stream_lock);
+}
+
+/**
+ * @brief 放弃当前 SWO 传输（停止捕获时由 SWO_Control 调用）
+ *
+ * TinyUSB 无法撤回已提交的传输，只能丢弃其完成通知
+ */
+void SWO_AbortTransfer(void)
+{
+    portENTER_CRITICAL(&swo_stream_lock);
+    swo_pending_len = 0;
+    if (swo_inflight) {
+        swo_aborted = 1;
+    }
+    portEXIT_CRITICAL(&swo_stream_lock);
+}
+
+/**
+ * @brief 提交失败时在锁内清除进行中标志
+ * @return 需要通知完成时返回 1，传输已被放弃时返回 0
+ */
+static uint8_t swo_stream_failed(void)
+{
+    uint8_t notify;
+
+    portENTER_CRITICAL(&swo_stream_lock);
+    swo_inflight = 0;
+    notify = !swo_aborted;
+    swo_aborted = 0;
+    portEXIT_CRITICAL(&swo_stream_lock);
+    return notify;
+}
+
+void swo_stream_poll(void)
+{
+    uint8_t *buf = NULL;
+    uint32_t len = 0;
+    uint8_t done = 0;
+
+    portENTER_CRITICAL(&swo_stream_lock);
+    if (swo_inflight && !usbd_edpt_busy(BOARD_TUD_RHPORT, SWO_STREAM_EP_IN)) {
+        swo_inflight = 0;
+        done = !swo_aborted;
+        swo_aborted = 0;
+    }
+    if (!swo_inflight && swo_pending_len > 0) {
+        buf = swo_pending_buf;
+        len = swo_pending_len;
+        swo_pending_len = 0;
+        swo_inflight = 1;
+    }
+    portEXIT_CRITICAL(&swo_stream_lock);
+
+    if (len > 0) {
+        /* 主机未连接时直接丢弃，避免 TraceBuf 永远得不到释放 */
+        if (!tud_mounted() || !usbd_edpt_claim(BOARD_TUD_RHPORT, SWO_STREAM_EP_IN)) {
+            if (swo_stream_failed()) {
+                SWO_TransferComplete();
+            }
+        } else if (!usbd_edpt_xfer(BOARD_TUD_RHPORT, SWO_STREAM_EP_IN, buf, (uint16_t)len)) {
+            usbd_edpt_release(BOARD_TUD_RHPORT, SWO_STREAM_EP_IN);
+            if (swo_stream_failed()) {
+                SWO_TransferComplete();
+            }
+        }
+    }
+
+    if (done) {
+        SWO_TransferComplete();
+    }
+}
+
+#else
+
+void swo_stream_poll(void)
+{
+}
+
+#endif /* (SWO_STREAM != 0) */
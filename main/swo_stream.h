@@ -0,0 +1,21 @@
+/**
+ * @file swo_stream.h
+ * @brief SWO trace streaming over the CMSIS-DAP v2 SWO bulk IN endpoint
+ */
+
+#ifndef __SWO_STREAM_H__
+#define __SWO_STREAM_H__
+
+/**
+ * @brief SWO endpoint address (third endpoint of the CMSIS-DAP interface)
+ */
+#define SWO_STREAM_EP_IN    0x82
+
+/**
+ * @brief Start queued transfers and report completed ones to SWO.c
+ *
+ * Called from the DAP handler loop.
+ */
+void swo_stream_poll(void);
+
+#endif // __SWO_STREAM_H__
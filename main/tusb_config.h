@@ -122,16 +122,15 @@ extern "C" {
 // ==========================================================================
 // USB 设备类配置
 // 
-// CMSIS-DAP v2 只需要 Vendor 类，其他类全部禁用
+// CMSIS-DAP v2 使用 Vendor 类，另启用 CDC 作为目标串口，其他类全部禁用
 // 这样可以减少代码大小和内存占用
 // ==========================================================================
 
 /**
  * CDC 类（虚拟串口）
- * 0 = 禁用
- * 如需串口功能，可在后续阶段启用
+ * 1 = 启用一个 CDC-ACM 接口，桥接到目标 UART
  */
-#define CFG_TUD_CDC              0
+#define CFG_TUD_CDC              1
 
 /**
  * MSC 类（大容量存储）
@@ -163,11 +162,12 @@ extern "C" {
 
 /**
  * Vendor 类（厂商自定义）
- * 1 = 启用
- * CMSIS-DAP v2 使用 Vendor 类进行 Bulk 传输
- * 相比 HID 类，Bulk 传输无 64KB/s 带宽限制
+ * 2 = 启用两个 Vendor 接口
+ * 接口 0: CMSIS-DAP v2 使用 Vendor 类进行 Bulk 传输
+ *         相比 HID 类，Bulk 传输无 64KB/s 带宽限制
+ * 接口 1: RTT 数据通道
  */
-#define CFG_TUD_VENDOR           1
+#define CFG_TUD_VENDOR           2
 
 // ==========================================================================
 // Vendor 类缓冲区配置
@@ -194,6 +194,24 @@ extern "C" {
  */
 #define CFG_TUD_VENDOR_EPSIZE       64
 
+// ==========================================================================
+// CDC 类缓冲区配置
+// ==========================================================================
+
+/**
+ * CDC 接收/发送 FIFO 大小（字节）
+ * 多 Mbaud 串口下 USB 帧间隔 1ms 内约有数百字节数据，
+ * FIFO 需能容纳若干帧，避免 USB 调度抖动造成丢数
+ */
+#define CFG_TUD_CDC_RX_BUFSIZE      2048
+#define CFG_TUD_CDC_TX_BUFSIZE      2048
+
+/**
+ * CDC 端点大小（字节）
+ * Full-Speed USB Bulk 端点最大为 64 字节
+ */
+#define CFG_TUD_CDC_EP_BUFSIZE      64
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,9 +19,11 @@
 
 #include <string.h>
 #include <stdio.h>
+#include "sdkconfig.h"
 #include "tusb.h"
 #include "esp_log.h"
 #include "esp_mac.h"
+#include "swo_stream.h"
 
 static const char *TAG = "USB_DESC";
 
@@ -51,11 +53,15 @@ static char serial_number[17];  // "XXXXXXXXXXXX" + '\0'
 
 /**
  * USB 接口编号枚举
- * CMSIS-DAP v2 只需要一个 Vendor 类接口
+ * 接口 0 为 CMSIS-DAP v2，接口 1 为 RTT 数据通道，
+ * 接口 2/3 为 CDC-ACM 虚拟串口（通信接口 + 数据接口）
  */
 enum {
-    ITF_NUM_VENDOR = 0,  // Vendor 接口编号
-    ITF_NUM_TOTAL        // 接口总数 = 1
+    ITF_NUM_VENDOR = 0,  // CMSIS-DAP Vendor 接口编号
+    ITF_NUM_RTT,         // RTT Vendor 接口编号
+    ITF_NUM_CDC,         // CDC 通信接口编号
+    ITF_NUM_CDC_DATA,    // CDC 数据接口编号
+    ITF_NUM_TOTAL        // 接口总数 = 4
 };
 
 /**
@@ -64,15 +70,51 @@ enum {
  * USB 端点地址格式：bit[7]=方向(0=OUT,1=IN), bit[3:0]=端点号
  * - 0x01: 端点1 OUT (主机->设备) - 接收 DAP 命令
  * - 0x81: 端点1 IN  (设备->主机) - 发送 DAP 响应
+ * - 0x82: 端点2 IN  (设备->主机) - SWO 跟踪数据流
+ * - 0x03: 端点3 OUT (主机->设备) - RTT down 通道数据
+ * - 0x83: 端点3 IN  (设备->主机) - RTT up 通道数据
+ * - 0x84: 端点4 IN  (设备->主机) - CDC 通知（串口状态）
+ * - 0x05: 端点5 OUT (主机->设备) - CDC 数据（发往目标 UART）
+ * - 0x85: 端点5 IN  (设备->主机) - CDC 数据（来自目标 UART）
+ *
+ * ESP32-S3 除端点 0 外只有 5 个 IN 端点，以上已全部占用
  */
 #define EPNUM_VENDOR_OUT   0x01  // Bulk OUT 端点
 #define EPNUM_VENDOR_IN    0x81  // Bulk IN 端点
+#define EPNUM_SWO_IN       SWO_STREAM_EP_IN  // SWO 流 Bulk IN 端点
+#define EPNUM_RTT_OUT      0x03  // RTT Bulk OUT 端点
+#define EPNUM_RTT_IN       0x83  // RTT Bulk IN 端点
+#define EPNUM_CDC_NOTIF    0x84  // CDC Interrupt IN 端点
+#define EPNUM_CDC_OUT      0x05  // CDC Bulk OUT 端点
+#define EPNUM_CDC_IN       0x85  // CDC Bulk IN 端点
+
+/**
+ * CMSIS-DAP v2 接口描述符长度
+ * = 接口描述符(9字节) + OUT/IN/SWO 三个端点描述符(3x7字节) = 30字节
+ */
+#define TUD_DAP_DESC_LEN  (TUD_VENDOR_DESC_LEN + 7)
+
+/**
+ * CMSIS-DAP v2 接口描述符
+ * CMSIS-DAP v2 规定端点顺序为：命令 OUT、响应 IN、SWO IN（可选）
+ */
+#define TUD_DAP_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epswo, _epsize) \
+    /* Interface */ \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 3, TUSB_CLASS_VENDOR_SPECIFIC, 0x00, 0x00, _stridx, \
+    /* Endpoint Out */ \
+    7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0, \
+    /* Endpoint In */ \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0, \
+    /* Endpoint SWO In */ \
+    7, TUSB_DESC_ENDPOINT, _epswo, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
 
 /**
  * 配置描述符总长度
- * = 配置描述符头(9字节) + Vendor接口描述符(9+7+7=23字节) = 32字节
+ * = 配置描述符头(9字节) + CMSIS-DAP 接口(30字节) + RTT 接口(23字节)
+ *   + CDC-ACM(IAD + 两个接口，66字节) = 128字节
  */
-#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_VENDOR_DESC_LEN)
+#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_DAP_DESC_LEN + TUD_VENDOR_DESC_LEN + \
+                           TUD_CDC_DESC_LEN)
 
 // ==========================================================================
 // 设备描述符 (Device Descriptor)
@@ -85,9 +127,9 @@ const tusb_desc_device_t desc_device = {
     .bLength            = sizeof(tusb_desc_device_t),  // 描述符长度 = 18
     .bDescriptorType    = TUSB_DESC_DEVICE,            // 描述符类型 = 0x01 (设备)
     .bcdUSB             = 0x0210,  // USB 版本 2.1 (支持 BOS 描述符)
-    .bDeviceClass       = 0x00,    // 设备类在接口中定义
-    .bDeviceSubClass    = 0x00,    // 子类
-    .bDeviceProtocol    = 0x00,    // 协议
+    .bDeviceClass       = TUSB_CLASS_MISC,          // 复合设备，CDC 使用 IAD
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,     // 子类
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,        // 协议 = IAD
     .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,  // 端点0最大包大小 (64字节)
     .idVendor           = USB_VID,   // 厂商 ID
     .idProduct          = USB_PID,   // 产品 ID
@@ -115,16 +157,36 @@ const uint8_t desc_fs_configuration[] = {
                           TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
     /**
-     * Vendor 类接口描述符 (23 字节)
-     * 参数：接口号, 字符串索引, OUT端点, IN端点, 最大包大小
+     * CMSIS-DAP Vendor 接口描述符 (30 字节)
+     * 参数：接口号, 字符串索引, OUT端点, IN端点, SWO端点, 最大包大小
      * 
      * 展开后包含：
      * - 接口描述符 (9字节): bInterfaceClass = 0xFF (Vendor)
      * - Bulk OUT 端点描述符 (7字节)
      * - Bulk IN 端点描述符 (7字节)
+     * - SWO Bulk IN 端点描述符 (7字节)
+     * 
+     * 存在多个 Vendor 接口时，调试软件通过接口字符串中的 "CMSIS-DAP"
+     * 区分 DAP 接口，因此这里引用产品名字符串
      */
-    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, 0, EPNUM_VENDOR_OUT,
-                          EPNUM_VENDOR_IN, 64),
+    TUD_DAP_DESCRIPTOR(ITF_NUM_VENDOR, 2, EPNUM_VENDOR_OUT,
+                       EPNUM_VENDOR_IN, EPNUM_SWO_IN, 64),
+
+    /**
+     * RTT Vendor 接口描述符 (23 字节)
+     * 接口字符串不得包含 "CMSIS-DAP"，避免调试软件误选
+     */
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_RTT, 4, EPNUM_RTT_OUT,
+                          EPNUM_RTT_IN, 64),
+
+    /**
+     * CDC-ACM 描述符 (66 字节)
+     * 参数：通信接口号, 字符串索引, 通知端点, 通知包大小, OUT端点, IN端点, 最大包大小
+     * 由 IAD 将通信接口和数据接口组合为一个功能，Windows 自动加载 usbser 驱动，
+     * 因此无需在 MS OS 2.0 描述符中声明
+     */
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 5, EPNUM_CDC_NOTIF, 8,
+                       EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
 };
 
 // ==========================================================================
@@ -135,11 +197,12 @@ const uint8_t desc_fs_configuration[] = {
 // 工作原理：
 // 1. 设备在 BOS 描述符中声明支持 MS OS 2.0
 // 2. Windows 检测到后，发送 Vendor Request 请求 MS OS 2.0 描述符
-// 3. 设备返回 desc_ms_os_20，其中声明兼容 "WINUSB"
-// 4. Windows 自动加载 WinUSB 驱动
+// 3. 设备返回 desc_ms_os_20，其中为每个接口声明兼容 "WINUSB"
+// 4. Windows 自动为每个接口加载 WinUSB 驱动
 // ==========================================================================
 
-#define MS_OS_20_DESC_LEN   0xA2  // MS OS 2.0 描述符总长度 = 162 字节
+#define MS_OS_20_DESC_LEN   0x152 // MS OS 2.0 描述符总长度 = 338 字节
+#define MS_OS_20_FUNC_LEN   0xA0  // 单个功能子集长度 = 160 字节
 #define BOS_TOTAL_LEN       0x21  // BOS 描述符总长度 = 33 字节
 #define MS_VENDOR_CODE      0x01  // Vendor Request 代码，Windows 用此代码请求描述符
 #define MS_OS_20_WINDEX     7     // wIndex = 7 表示请求 MS OS 2.0 描述符
@@ -150,27 +213,42 @@ const uint8_t desc_fs_configuration[] = {
 /**
  * Microsoft OS 2.0 描述符集
  * 
- * 包含三部分：
+ * 复合设备需要为每个接口单独声明，结构如下：
  * 1. 描述符集头部 (10 字节) - 声明 Windows 版本和总长度
- * 2. 兼容 ID 描述符 (20 字节) - 声明兼容 "WINUSB" 驱动
- * 3. 注册表属性描述符 (132 字节) - 设置设备接口 GUID
+ * 2. 配置子集头部 (8 字节)
+ * 3. 每个接口一个功能子集 (160 字节)：
+ *    - 功能子集头部 (8 字节) - 指定接口号
+ *    - 兼容 ID 描述符 (20 字节) - 声明兼容 "WINUSB" 驱动
+ *    - 注册表属性描述符 (132 字节) - 设置设备接口 GUID
  */
 const uint8_t desc_ms_os_20[MS_OS_20_DESC_LEN] = {
     // ========== 描述符集头部 (10 字节) ==========
     0x0A, 0x00,                  // wLength = 10
     0x00, 0x00,                  // wDescriptorType = MS_OS_20_SET_HEADER_DESCRIPTOR
     0x00, 0x00, 0x03, 0x06,      // dwWindowsVersion = 0x06030000 (Windows 8.1+)
-    USBShort(MS_OS_20_DESC_LEN), // wTotalLength = 162
-
-    // ========== 兼容 ID 描述符 (20 字节) ==========
-    // 告诉 Windows 此设备兼容 WinUSB 驱动
+    USBShort(MS_OS_20_DESC_LEN), // wTotalLength = 338
+
+    // ========== 配置子集头部 (8 字节) ==========
+    0x08, 0x00,                  // wLength = 8
+    USBShort(0x0001),            // wDescriptorType = MS_OS_20_SUBSET_HEADER_CONFIGURATION
+    0x00,                        // bConfigurationValue = 0 (第一个配置)
+    0x00,                        // bReserved
+    USBShort(MS_OS_20_DESC_LEN - 0x0A),  // wTotalLength = 328
+
+    // ========== 功能子集头部：CMSIS-DAP 接口 (8 字节) ==========
+    0x08, 0x00,                  // wLength = 8
+    USBShort(0x0002),            // wDescriptorType = MS_OS_20_SUBSET_HEADER_FUNCTION
+    ITF_NUM_VENDOR,              // bFirstInterface
+    0x00,                        // bReserved
+    USBShort(MS_OS_20_FUNC_LEN), // wSubsetLength = 160
+
+    // 兼容 ID 描述符 (20 字节)，告诉 Windows 此接口兼容 WinUSB 驱动
     0x14, 0x00,                  // wLength = 20
     USBShort(0x0003),            // wDescriptorType = MS_OS_20_FEATURE_COMPATIBLE_ID
     'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00,  // compatibleID = "WINUSB"
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // subCompatibleID (空)
 
-    // ========== 注册表属性描述符 (132 字节) ==========
-    // 设置设备接口 GUID，应用程序通过此 GUID 打开设备
+    // 注册表属性描述符 (132 字节)，应用程序通过此 GUID 打开接口
     0x84, 0x00,                  // wLength = 132
     USBShort(0x0004),            // wDescriptorType = MS_OS_20_FEATURE_REG_PROPERTY
     0x07, 0x00,                  // wPropertyDataType = REG_MULTI_SZ
@@ -184,7 +262,36 @@ const uint8_t desc_ms_os_20[MS_OS_20_DESC_LEN] = {
     '{',0,'C',0,'D',0,'B',0,'3',0,'B',0,'5',0,'A',0,'D',0,'-',0,
     '2',0,'9',0,'3',0,'B',0,'-',0,'4',0,'6',0,'6',0,'3',0,'-',0,
     'A',0,'A',0,'3',0,'6',0,'-',0,'1',0,'A',0,'A',0,'E',0,'4',0,
-    '6',0,'4',0,'6',0,'3',0,'7',0,'7',0,'6',0,'}',0,0,0,0,0
+    '6',0,'4',0,'6',0,'3',0,'7',0,'7',0,'6',0,'}',0,0,0,0,0,
+
+    // ========== 功能子集头部：RTT 接口 (8 字节) ==========
+    0x08, 0x00,                  // wLength = 8
+    USBShort(0x0002),            // wDescriptorType = MS_OS_20_SUBSET_HEADER_FUNCTION
+    ITF_NUM_RTT,                 // bFirstInterface
+    0x00,                        // bReserved
+    USBShort(MS_OS_20_FUNC_LEN), // wSubsetLength = 160
+
+    // 兼容 ID 描述符 (20 字节)
+    0x14, 0x00,                  // wLength = 20
+    USBShort(0x0003),            // wDescriptorType = MS_OS_20_FEATURE_COMPATIBLE_ID
+    'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00,  // compatibleID = "WINUSB"
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // subCompatibleID (空)
+
+    // 注册表属性描述符 (132 字节)
+    0x84, 0x00,                  // wLength = 132
+    USBShort(0x0004),            // wDescriptorType = MS_OS_20_FEATURE_REG_PROPERTY
+    0x07, 0x00,                  // wPropertyDataType = REG_MULTI_SZ
+    0x2A, 0x00,                  // wPropertyNameLength = 42
+    // 属性名: "DeviceInterfaceGUIDs" (UTF-16LE)
+    'D',0,'e',0,'v',0,'i',0,'c',0,'e',0,'I',0,'n',0,'t',0,'e',0,'r',0,
+    'f',0,'a',0,'c',0,'e',0,'G',0,'U',0,'I',0,'D',0,'s',0,0,0,
+    0x50, 0x00,                  // wPropertyDataLength = 80
+    // 属性值: GUID "{4F6C2A9E-7B13-4D58-A1C0-3E9B5D2F8A64}" (UTF-16LE)
+    // RTT 接口专用 GUID，与 CMSIS-DAP 接口区分
+    '{',0,'4',0,'F',0,'6',0,'C',0,'2',0,'A',0,'9',0,'E',0,'-',0,
+    '7',0,'B',0,'1',0,'3',0,'-',0,'4',0,'D',0,'5',0,'8',0,'-',0,
+    'A',0,'1',0,'C',0,'0',0,'-',0,'3',0,'E',0,'9',0,'B',0,'5',0,
+    'D',0,'2',0,'F',0,'8',0,'A',0,'6',0,'4',0,'}',0,0,0,0,0
 };
 
 // ==========================================================================
@@ -212,7 +319,7 @@ const uint8_t desc_bos[BOS_TOTAL_LEN] = {
     0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C,
     0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F,
     0x00, 0x00, 0x03, 0x06,       // dwWindowsVersion = Windows 8.1+
-    USBShort(MS_OS_20_DESC_LEN),  // wMSOSDescriptorSetTotalLength = 162
+    USBShort(MS_OS_20_DESC_LEN),  // wMSOSDescriptorSetTotalLength = 338
     MS_VENDOR_CODE,               // bMS_VendorCode = 0x01 (Vendor Request 代码)
     0x00                          // bAltEnumCode = 0 (不使用备用枚举)
 };
@@ -284,6 +391,8 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
  * 索引 1: 厂商名称 (对应 desc_device.iManufacturer)
  * 索引 2: 产品名称 (对应 desc_device.iProduct) - 必须包含 "CMSIS-DAP"
  * 索引 3: 序列号 (对应 desc_device.iSerialNumber)
+ * 索引 4: RTT 接口名称 (不能包含 "CMSIS-DAP")
+ * 索引 5: CDC 接口名称 (不能包含 "CMSIS-DAP")
  * 
  * 注意：esp_tinyusb 会自动处理索引 0（语言 ID），所以数组从索引 1 开始
  */
@@ -292,9 +401,15 @@ const char *desc_string_arr[] = {
     "XingNian",                   // 1: 厂商名
     "CMSIS-DAP v2",              // 2: 产品名 (必须包含 "CMSIS-DAP"!)
     NULL,                         // 3: 序列号 (动态生成)
+    "XingNian RTT",               // 4: RTT 接口名
+#if CONFIG_XN_GDB_CDC
+    "XingNian GDB",               // 5: CDC 接口名（GDB 服务器）
+#else
+    "XingNian UART",              // 5: CDC 接口名
+#endif
 };
 
-#define DESC_STRING_COUNT 4
+#define DESC_STRING_COUNT 6
 
 /**
  * @brief 初始化 USB 序列号
@@ -0,0 +1,91 @@
+/**
+ * @file wifi_init.c
+ * @brief Wi-Fi 初始化 - 以 STA 模式接入网络，供 DAP TCP 传输使用
+ *
+ * SSID 和密码由 menuconfig 中的 "XN DAPLink" 菜单配置，
+ * SSID 为空时不启动 Wi-Fi。断线后在事件回调中自动重连。
+ */
+#include "wifi_init.h"
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+
+#if CONFIG_XN_DAP_TCP
+
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+static const char *TAG = "WIFI_INIT";
+
+/**
+ * @brief Wi-Fi / IP 事件回调：启动后连接，断线后重连，获得地址后打印
+ */
+static void wifi_event_handler(void *arg, esp_event_base_t event_base,
+                               int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        ESP_LOGW(TAG, "Wi-Fi 断开，正在重连...");
+        esp_wifi_connect();
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        ESP_LOGI(TAG, "已获得 IP: " IPSTR, IP2STR(&event->ip_info.ip));
+    }
+}
+
+/**
+ * @brief 初始化 Wi-Fi STA 模式
+ * @return 0 成功，-1 失败或未配置 SSID
+ *
+ * 需在 nvs_flash_init() 之后调用（Wi-Fi 驱动使用 NVS 保存校准数据）。
+ * 关闭 Wi-Fi 省电模式：省电模式下 AP 缓存下行帧，单条 DAP 命令往返会增加
+ * 上百毫秒延迟。
+ */
+int wifi_init(void)
+{
+    wifi_init_config_t init_cfg = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t wifi_cfg = { 0 };
+
+    if (strlen(CONFIG_XN_WIFI_SSID) == 0) {
+        ESP_LOGI(TAG, "未配置 Wi-Fi SSID，跳过 Wi-Fi 初始化");
+        return -1;
+    }
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_create_default_wifi_sta();
+
+    if (esp_wifi_init(&init_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_init failed");
+        return -1;
+    }
+
+    esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL);
+
+    strncpy((char *)wifi_cfg.sta.ssid, CONFIG_XN_WIFI_SSID, sizeof(wifi_cfg.sta.ssid));
+    strncpy((char *)wifi_cfg.sta.password, CONFIG_XN_WIFI_PASSWORD, sizeof(wifi_cfg.sta.password));
+
+    esp_wifi_set_mode(WIFI_MODE_STA);
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_cfg);
+    if (esp_wifi_start() != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_start failed");
+        return -1;
+    }
+    esp_wifi_set_ps(WIFI_PS_NONE);
+
+    ESP_LOGI(TAG, "正在连接 Wi-Fi: %s", CONFIG_XN_WIFI_SSID);
+    return 0;
+}
+
+#else
+
+int wifi_init(void)
+{
+    return -1;
+}
+
+#endif
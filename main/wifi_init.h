@@ -0,0 +1,3 @@
+#pragma once
+
+int wifi_init(void);
@@ -0,0 +1,326 @@
+/**
+ * @file dap_engine_test.c
+ * @brief DAP 命令引擎主机端测试（模拟 SWD 目标）
+ *
+ * 1. WAIT 重试：按 DP SELECT 的 APSEL 记录每个 AP 的退避级别，
+ *    TARGETSEL 写入不影响 APSEL
+ * 2. 断点管理命令：执行前后主机写入的 SELECT 和 AP0 CSW/TAR 不变；
+ *    COMMIT 发现 FPB 使能被复位清掉后重写比较器
+ * 3. 主机会话（DAP_Connect ... DAP_Disconnect）之后 swd_host 不沿用
+ *    缓存的 CSW/TAR
+ * 4. swd_host_save/swd_host_restore：厂商命令改动的每个 AP 的 CSW/TAR
+ *    和主机的 SELECT 被写回
+ * 5. 微程序：被拒绝的 LOAD 仍消耗全部程序字节（ExecuteCommands 中后续命令
+ *    解析正确）；DELAY 死循环在时间预算内结束
+ * 6. ITM 过滤：全局时间戳 GTS2 总是 4 个载荷字节（48 位格式）
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_retry.h"
+#include "DAP_break.h"
+#include "DAP_program.h"
+#include "DAP_itm.h"
+#include "swd_host.h"
+#include "debug_cm.h"
+#include "esp_timer.h"
+#include "swd_target.h"
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+static uint8_t response[DAP_PACKET_SIZE * 4];
+
+/* DAP_vendor.c 依赖 NVS，不在主机上编译；这里只转发测试用到的厂商命令 */
+uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response)
+{
+    uint32_t num = (1U << 16) | 1U;
+
+    *response++ = *request;
+    switch (*request++) {
+    case ID_DAP_Vendor2:
+        num += DAP_Program(request, response);
+        break;
+    default:
+        *(response - 1) = ID_DAP_Invalid;
+        break;
+    }
+    return num;
+}
+
+/**
+ * @brief 执行一条命令，检查请求长度，返回响应长度（response[0] 为命令 ID）
+ */
+static uint32_t run(const uint8_t *cmd, uint32_t len)
+{
+    uint8_t request[DAP_PACKET_SIZE * 2] = { 0 };
+    uint32_t ret;
+
+    memcpy(request, cmd, len);
+    ret = DAP_ExecuteCommand(request, response);
+    CHECK((ret >> 16) == len);
+    return ret & 0xFFFFU;
+}
+
+/**
+ * @brief 复位模拟目标和 DAP，连接 SWD
+ */
+static void connect_swd(void)
+{
+    static const uint8_t connect[] = { ID_DAP_Connect, DAP_PORT_SWD };
+
+    swd_target_reset();
+    DAP_Setup();
+    run(connect, sizeof(connect));
+    CHECK(response[1] == DAP_PORT_SWD);
+}
+
+/**
+ * @brief 查找 AP 的 WAIT 学习记录
+ *
+ * @return 1 = 找到，level/acks 为记录的值
+ */
+static int retry_profile(uint8_t apsel, uint8_t *level, uint32_t *acks)
+{
+    static const uint8_t req[] = { DAP_RETRY_CMD_PROFILES };
+    uint8_t rsp[64];
+    uint32_t i;
+
+    CHECK((DAP_RetryCommand(req, rsp) >> 16) == 1);
+    CHECK(rsp[0] == DAP_OK);
+    for (i = 0; i < rsp[1]; i++) {
+        const uint8_t *p = &rsp[2 + i * 6];
+
+        if (p[0] == apsel) {
+            *level = p[1];
+            *acks = p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t)p[5] << 24);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_retry_apsel(void)
+{
+    /* 写 SELECT（APSEL = 1），之后读 AP1 DRW 和 RDBUFF */
+    static const uint8_t select_ap1[] = {
+        ID_DAP_Transfer, 0, 3,
+        DP_SELECT, 0x00, 0x00, 0x00, 0x01,
+        DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW,
+        DP_RDBUFF | DAP_TRANSFER_RnW,
+    };
+    /* 写 TARGETSEL（地址同 RDBUFF），再读 AP1 DRW */
+    static const uint8_t targetsel[] = {
+        ID_DAP_Transfer, 0, 2,
+        DP_RDBUFF, 0x77, 0x14, 0x00, 0x00,
+        DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW,
+    };
+    uint8_t level;
+    uint32_t acks;
+
+    connect_swd();
+    swd_target.wait_count = 5;
+    run(select_ap1, sizeof(select_ap1));
+    CHECK(response[1] == 3 && response[2] == DAP_TRANSFER_OK);
+    CHECK(swd_target.select == 0x01000000U);
+    CHECK(swd_target.ap_waits[1] == 5 && swd_target.ap_waits[0] == 0);
+
+    CHECK(retry_profile(1, &level, &acks));
+    CHECK(acks == 5 && level > 0);
+    CHECK(!retry_profile(0, &level, &acks));
+
+    swd_target.wait_count = 2;
+    run(targetsel, sizeof(targetsel));
+    CHECK(response[1] == 2 && response[2] == DAP_TRANSFER_OK);
+    CHECK(swd_target.targetsel == 0x00001477U);
+    CHECK(retry_profile(1, &level, &acks) && acks == 7);
+    CHECK(!retry_profile(0, &level, &acks));
+    printf("WAIT 重试按 AP 学习: 通过\n");
+}
+
+#define FP_CTRL     0xE0002000U
+#define FP_COMP0    0xE0002008U
+#define DWT_CTRL    0xE0001000U
+
+/**
+ * @brief 执行一条断点管理子命令，返回状态
+ */
+static uint8_t brk(uint8_t cmd, uint32_t addr)
+{
+    uint8_t req[8] = { cmd, (uint8_t)addr, (uint8_t)(addr >> 8),
+                       (uint8_t)(addr >> 16), (uint8_t)(addr >> 24) };
+
+    DAP_BRK_Command(req, response);
+    return response[0];
+}
+
+static void test_brk_host_state(void)
+{
+    /* 主机设置 AP0 CSW/TAR，然后把 SELECT 指向 AP1 的 bank 0xF */
+    static const uint8_t host_setup[] = {
+        ID_DAP_Transfer, 0, 4,
+        DP_SELECT, 0x00, 0x00, 0x00, 0x00,
+        DAP_TRANSFER_APnDP | AP_CSW, 0x10, 0x00, 0x00, 0x23,
+        DAP_TRANSFER_APnDP | AP_TAR, 0x00, 0x10, 0x00, 0x20,
+        DP_SELECT, 0xF0, 0x00, 0x00, 0x01,
+    };
+
+    connect_swd();
+    swd_target_write(FP_CTRL, 0x10000060U);     /* FPBv2，6 个代码比较器 */
+    swd_target_write(DWT_CTRL, 0x40000000U);
+    run(host_setup, sizeof(host_setup));
+    CHECK(response[1] == 4 && response[2] == DAP_TRANSFER_OK);
+
+    CHECK(brk(DAP_BRK_CMD_INFO, 0) == DAP_OK && response[2] == 6);
+    CHECK(brk(DAP_BRK_CMD_SET_BP, 0x08000100U) == DAP_OK);
+    CHECK(brk(DAP_BRK_CMD_COMMIT, 0) == DAP_OK && response[1] > 0);
+    CHECK(swd_target_read(FP_COMP0) == 0x08000101U);
+    CHECK(swd_target.select == 0x010000F0U);
+    CHECK(swd_target.csw[0] == 0x23000010U && swd_target.tar[0] == 0x20001000U);
+
+    /* 没有变化时 COMMIT 不写 */
+    CHECK(brk(DAP_BRK_CMD_COMMIT, 0) == DAP_OK && response[1] == 0);
+
+    /* 主机经 DAP_Transfer 复位了目标：FPB 使能和比较器被清掉 */
+    swd_target_write(FP_CTRL, 0x10000060U);
+    swd_target_write(FP_COMP0, 0);
+    CHECK(brk(DAP_BRK_CMD_COMMIT, 0) == DAP_OK && response[1] > 0);
+    CHECK(swd_target_read(FP_COMP0) == 0x08000101U);
+    CHECK(swd_target_read(FP_CTRL) & 1U);
+    CHECK(swd_target.select == 0x010000F0U);
+    CHECK(swd_target.csw[0] == 0x23000010U && swd_target.tar[0] == 0x20001000U);
+    printf("断点命令保持主机 DP/AP 状态: 通过\n");
+}
+
+static void test_swd_host_cold(void)
+{
+    /* 主机把 AP0 CSW 改成 8 位访问、TAR 指向别处后断开 */
+    static const uint8_t host_session[] = {
+        ID_DAP_Transfer, 0, 3,
+        DP_SELECT, 0x00, 0x00, 0x00, 0x00,
+        DAP_TRANSFER_APnDP | AP_CSW, 0x00, 0x00, 0x00, 0x23,
+        DAP_TRANSFER_APnDP | AP_TAR, 0x00, 0x00, 0x00, 0x20,
+    };
+    static const uint8_t disconnect[] = { ID_DAP_Disconnect };
+    uint32_t val;
+
+    swd_target_reset();
+    DAP_Setup();
+    swd_target_write(0x20000100U, 0x11223344U);
+    swd_target_write(0x20000104U, 0x55667788U);
+    CHECK(swd_read_word(0x20000100U, &val) && val == 0x11223344U);
+
+    connect_swd();
+    swd_target_write(0x20000100U, 0x11223344U);
+    swd_target_write(0x20000104U, 0x55667788U);
+    run(host_session, sizeof(host_session));
+    CHECK(response[1] == 3 && response[2] == DAP_TRANSFER_OK);
+    run(disconnect, sizeof(disconnect));
+
+    CHECK(swd_read_word(0x20000104U, &val) && val == 0x55667788U);
+    CHECK((swd_target.csw[0] & CSW_SIZE) == CSW_SIZE32);
+    CHECK(swd_target.tar[0] == 0x20000104U || swd_target.tar[0] == 0x20000108U);
+    printf("主机会话后 swd_host 重新写 CSW/TAR: 通过\n");
+}
+
+static void test_swd_host_save(void)
+{
+    static const uint8_t host_setup[] = {
+        ID_DAP_Transfer, 0, 5,
+        DP_SELECT, 0x00, 0x00, 0x00, 0x01,
+        DAP_TRANSFER_APnDP | AP_CSW, 0x12, 0x00, 0x00, 0x23,
+        DAP_TRANSFER_APnDP | AP_TAR, 0x00, 0x40, 0x00, 0x80,
+        DP_SELECT, 0x00, 0x00, 0x00, 0x00,
+        DP_SELECT, 0x10, 0x00, 0x00, 0x02,
+    };
+
+    connect_swd();
+    run(host_setup, sizeof(host_setup));
+    CHECK(response[1] == 5 && response[2] == DAP_TRANSFER_OK);
+
+    /* 厂商命令改写 AP1 和 AP3，AP1 保存两次只算一次 */
+    swd_host_save();
+    CHECK(swd_host_save_ap(0x01000000U) && swd_host_save_ap(0x03000000U));
+    CHECK(swd_write_ap(0x01000000U | AP_CSW, 0x23000002U));
+    CHECK(swd_write_ap(0x01000000U | AP_TAR, 0x80001000U));
+    CHECK(swd_host_save_ap(0x01000000U));
+    CHECK(swd_write_ap(0x03000000U | AP_TAR, 0x1234U));
+    CHECK(swd_host_restore());
+
+    CHECK(swd_target.csw[1] == 0x23000012U && swd_target.tar[1] == 0x80004000U);
+    CHECK(swd_target.tar[3] == 0);
+    CHECK(swd_target.select == 0x02000010U);
+    printf("厂商命令前后保存/写回主机 DP/AP 状态: 通过\n");
+}
+
+static void test_program(void)
+{
+    /* 超出程序缓冲区的 LOAD，程序字节本身是合法的命令 ID */
+    static const uint8_t exec_load[] = {
+        ID_DAP_ExecuteCommands, 2,
+        ID_DAP_Vendor2, DAP_PROG_CMD_LOAD, 0xFF, 0x03, 4,
+            ID_DAP_Info, DAP_ID_PACKET_COUNT, ID_DAP_Info, DAP_ID_PACKET_COUNT,
+        ID_DAP_HostStatus, 0, 1,
+    };
+    /* DELAY 60 ms; JMP 0 */
+    static const uint8_t load_spin[] = {
+        ID_DAP_Vendor2, DAP_PROG_CMD_LOAD, 0, 0, 6,
+            DAP_PROG_DELAY, 0x60, 0xEA, DAP_PROG_JMP, 0, 0,
+    };
+    static const uint8_t run_prog[] = { ID_DAP_Vendor2, DAP_PROG_CMD_RUN, 0, 0, 0, 0 };
+    int64_t start;
+
+    connect_swd();
+    CHECK(run(exec_load, sizeof(exec_load)) == 6);
+    CHECK(response[1] == 2);
+    CHECK(response[2] == ID_DAP_Vendor2 && response[3] == DAP_ERROR);
+    CHECK(response[4] == ID_DAP_HostStatus && response[5] == DAP_OK);
+
+    run(load_spin, sizeof(load_spin));
+    CHECK(response[1] == DAP_OK);
+    start = esp_timer_get_time();
+    run(run_prog, sizeof(run_prog));
+    CHECK(response[1] == DAP_OK && response[2] == DAP_PROG_ERR_TIME);
+    CHECK(esp_timer_get_time() - start < DAP_PROGRAM_TIME_US + 200000);
+    printf("微程序 LOAD 长度和时间预算: 通过\n");
+}
+
+static void test_itm_gts2(void)
+{
+    /* 本地时间戳格式 1，增量 1 << 26：TS[26] 置位 */
+    static const uint8_t lts[] = { 0xC0, 0x80, 0x80, 0x80, 0x20 };
+    static const uint8_t gts2[] = { 0xB4, 0x81, 0x80, 0x80, 0x00 };
+    uint8_t config[10] = { DAP_ITM_CMD_CONFIG, DAP_ITM_FILTER | DAP_ITM_ABS_TIMESTAMP,
+                           0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    uint8_t out[ITM_FILTER_MAX_OUT];
+    uint32_t i, n = 0;
+
+    DAP_ITM_Command(config, response);
+    CHECK(response[0] == DAP_OK);
+    ITM_FilterReset();
+    for (i = 0; i < sizeof(lts); i++) {
+        n = ITM_FilterByte(lts[i], out);
+    }
+    CHECK(n == 10);
+    CHECK(out[0] == 0x94 && out[4] == 0x40);    /* GTS1，TS[25:0] = 0，高位已变 */
+    CHECK(memcmp(&out[5], gts2, sizeof(gts2)) == 0);
+    printf("ITM 全局时间戳 GTS2 格式: 通过\n");
+}
+
+int main(void)
+{
+    test_retry_apsel();
+    test_brk_host_state();
+    test_swd_host_cold();
+    test_swd_host_save();
+    test_program();
+    test_itm_gts2();
+    return 0;
+}
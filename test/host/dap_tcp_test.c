@@ -0,0 +1,271 @@
+/**
+ * @file dap_tcp_test.c
+ * @brief DAP TCP 主机端测试
+ *
+ * 1. 命令长度：dap_tcp_command_length 算出的长度与 DAP_ExecuteCommand
+ *    实际消耗的字节数一致，任何前缀都被判为“数据不够”
+ * 2. 回环：同一串命令整段发送、逐字节发送、按不规则分段发送，
+ *    服务端返回的响应流完全一致，且等于本地直接执行的结果
+ *
+ * 直接包含 dap_tcp.c 以访问其中的静态函数。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../main/dap_tcp.c"
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+/* 测试命令，每条以长度开头 */
+static const uint8_t test_commands[] = {
+    /* 连接 SWD，之后的传输走 SWD（引脚为空操作，ACK 无效） */
+    2, ID_DAP_Connect, DAP_PORT_SWD,
+    2, ID_DAP_Info, DAP_ID_PACKET_SIZE,
+    2, ID_DAP_Info, DAP_ID_CAPABILITIES,
+    3, ID_DAP_HostStatus, 0, 1,
+    6, ID_DAP_TransferConfigure, 0, 2, 0, 0, 0,
+    5, ID_DAP_SWJ_Clock, 0x40, 0x42, 0x0F, 0x00,
+    2, ID_DAP_SWD_Configure, 0,
+    7, ID_DAP_SWJ_Pins, 0x80, 0x80, 0, 0, 0, 0,
+    /* 8 位、51 位、256 位（位数 0）的 SWJ 序列 */
+    3, ID_DAP_SWJ_Sequence, 8, 0x9E,
+    9, ID_DAP_SWJ_Sequence, 51, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07,
+    34, ID_DAP_SWJ_Sequence, 0,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    /* 读 DPIDR、写 SELECT、带匹配值的读、读 RDBUFF */
+    15, ID_DAP_Transfer, 0, 4,
+        0x02,
+        0x08, 0x00, 0x00, 0x00, 0x00,
+        0x12, 0x77, 0x00, 0x00, 0x00,
+        0x0E,
+    /* 块读和块写 */
+    5, ID_DAP_TransferBlock, 0, 3, 0, 0x0F,
+    13, ID_DAP_TransferBlock, 0, 2, 0, 0x0D,
+        0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+    6, ID_DAP_WriteABORT, 0, 0x1E, 0, 0, 0,
+    1, ID_DAP_TransferAbort,
+    /* SWD 序列：输出 8 位、输入 33 位、输出 64 位（位数 0） */
+    14, ID_DAP_SWD_Sequence, 3,
+        0x08, 0xA5,
+        0xA1,
+        0x00, 1, 2, 3, 4, 5, 6, 7, 8,
+    3, ID_DAP_Delay, 10, 0,
+    1, ID_DAP_ResetTarget,
+    /* 嵌套在 ExecuteCommands 中的两条命令 */
+    12, ID_DAP_ExecuteCommands, 2,
+        ID_DAP_Info, DAP_ID_DAP_FW_VER,
+        ID_DAP_Transfer, 0, 1, 0x04, 0xAA, 0xBB, 0xCC, 0xDD,
+    /* JTAG：配置两个设备、读 IDCODE、两段序列 */
+    2, ID_DAP_Connect, DAP_PORT_JTAG,
+    4, ID_DAP_JTAG_Configure, 2, 4, 5,
+    2, ID_DAP_JTAG_IDCODE, 0,
+    7, ID_DAP_JTAG_Sequence, 2,
+        0x43, 0x00,
+        0x8A, 0x12, 0x03,
+    9, ID_DAP_Transfer, 1, 2,
+        0x02,
+        0x04, 0, 0, 0, 0x20,
+    /* 未实现的命令只消耗一个字节；厂商命令长度未知，由执行结果决定 */
+    1, 0x42,
+    1, ID_DAP_Vendor5,
+    1, ID_DAP_Disconnect,
+};
+
+/* 本构建未编译 SWO/UART，只检查长度解析 */
+static const uint8_t parse_only_commands[] = {
+    5, ID_DAP_SWO_Baudrate, 0x00, 0x09, 0x3D, 0x00,
+    3, ID_DAP_SWO_Data, 0x40, 0x00,
+    6, ID_DAP_UART_Configure, 0, 0x00, 0xC2, 0x01, 0x00,
+    7, ID_DAP_UART_Transfer, 4, 0, 'p', 'i', 'n', 'g',
+};
+
+static uint8_t stream[1024];
+static uint32_t stream_len;
+static uint8_t expected[4096];
+static uint32_t expected_len;
+
+/**
+ * @brief 检查一条命令的长度解析（厂商命令只检查执行结果）
+ *
+ * @param exec 是否与 DAP_ExecuteCommand 的返回值比对
+ */
+static void check_length(const uint8_t *cmd, uint32_t len, int exec)
+{
+    uint8_t request[DAP_PACKET_SIZE * 2];
+    uint8_t response[DAP_PACKET_SIZE * 4];
+    uint32_t i;
+
+    CHECK(len <= DAP_PACKET_SIZE);
+    if (dap_tcp_command_length(cmd, len) != DAP_TCP_LEN_UNKNOWN) {
+        for (i = 0; i < len; i++) {
+            CHECK(dap_tcp_command_length(cmd, i) == DAP_TCP_LEN_MORE);
+        }
+        CHECK(dap_tcp_command_length(cmd, len) == len);
+    }
+
+    if (exec) {
+        memset(request, 0, sizeof(request));
+        memcpy(request, cmd, len);
+        uint32_t ret = DAP_ExecuteCommand(request, response);
+        if ((ret >> 16) != len) {
+            fprintf(stderr, "命令 0x%02x: 解析 %u 字节, 执行 %u 字节\n",
+                    cmd[0], (unsigned)len, (unsigned)(ret >> 16));
+        }
+        CHECK((ret >> 16) == len);
+    }
+}
+
+/**
+ * @brief 检查所有测试命令的长度，并生成发送流和期望的响应流
+ */
+static void test_lengths(void)
+{
+    uint8_t response[DAP_PACKET_SIZE * 4];
+    uint32_t i;
+
+    DAP_Setup();
+    for (i = 0; i < sizeof(test_commands); i += 1 + test_commands[i]) {
+        check_length(&test_commands[i + 1], test_commands[i], 1);
+    }
+    for (i = 0; i < sizeof(parse_only_commands); i += 1 + parse_only_commands[i]) {
+        check_length(&parse_only_commands[i + 1], parse_only_commands[i], 0);
+    }
+
+    /* 长度未知的厂商命令和超长命令 */
+    uint8_t vendor[] = { ID_DAP_Vendor8, 0x01 };
+    CHECK(dap_tcp_command_length(vendor, sizeof(vendor)) == DAP_TCP_LEN_UNKNOWN);
+    uint8_t nested[] = { ID_DAP_ExecuteCommands, 2, ID_DAP_Disconnect, ID_DAP_Vendor0 };
+    CHECK(dap_tcp_command_length(nested, sizeof(nested)) == DAP_TCP_LEN_UNKNOWN);
+    static uint8_t block[5 + 256 * 4] = { ID_DAP_TransferBlock, 0, 0x00, 0x01, 0x01 };
+    CHECK(dap_tcp_command_length(block, 5) == DAP_TCP_LEN_MORE);
+    CHECK(dap_tcp_command_length(block, sizeof(block)) == sizeof(block));
+
+    /* 从同样的初始状态本地执行一遍，得到期望的响应流 */
+    DAP_Setup();
+    stream_len = 0;
+    expected_len = 0;
+    for (i = 0; i < sizeof(test_commands); i += 1 + test_commands[i]) {
+        memcpy(stream + stream_len, &test_commands[i + 1], test_commands[i]);
+        stream_len += test_commands[i];
+    }
+    for (i = 0; i < sizeof(test_commands); i += 1 + test_commands[i]) {
+        uint8_t request[DAP_PACKET_SIZE * 2] = { 0 };
+
+        memcpy(request, &test_commands[i + 1], test_commands[i]);
+        uint32_t ret = DAP_ExecuteCommand(request, response);
+        memcpy(expected + expected_len, response, ret & 0xFFFFU);
+        expected_len += ret & 0xFFFFU;
+    }
+    printf("长度解析: 通过 (%u 字节命令, %u 字节响应)\n",
+           (unsigned)stream_len, (unsigned)expected_len);
+}
+
+/**
+ * @brief 连接服务端并完成 elaphureLink 握手
+ */
+static int test_connect(void)
+{
+    struct sockaddr_in addr;
+    uint8_t buf[EL_HANDSHAKE_SIZE];
+    int one = 1;
+    int sock;
+    int retry;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(CONFIG_XN_DAP_TCP_PORT);
+
+    for (retry = 0; ; retry++) {
+        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        CHECK(sock >= 0);
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            break;
+        }
+        close(sock);
+        CHECK(retry < 100);
+        usleep(10000);
+    }
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    put_be32(&buf[0], EL_LINK_IDENTIFIER);
+    put_be32(&buf[4], EL_COMMAND_HANDSHAKE);
+    put_be32(&buf[8], EL_DAP_VERSION);
+    CHECK(send(sock, buf, sizeof(buf), 0) == sizeof(buf));
+    CHECK(recv(sock, buf, sizeof(buf), MSG_WAITALL) == sizeof(buf));
+    CHECK(get_be32(&buf[0]) == EL_LINK_IDENTIFIER);
+    CHECK(get_be32(&buf[4]) == EL_COMMAND_HANDSHAKE);
+    return sock;
+}
+
+/**
+ * @brief 按给定的分段方式发送整个命令流，检查响应流
+ *
+ * @param chunk 返回第 n 段的长度
+ * @param gap_us 段间等待时间，让每段成为独立的 TCP 分段
+ */
+static void test_stream(const char *name, uint32_t (*chunk)(uint32_t n), useconds_t gap_us)
+{
+    static uint8_t got[sizeof(expected)];
+    int sock = test_connect();
+    uint32_t off = 0;
+    uint32_t n;
+
+    for (n = 0; off < stream_len; n++) {
+        uint32_t size = chunk(n);
+
+        if (size > stream_len - off) {
+            size = stream_len - off;
+        }
+        CHECK(send(sock, stream + off, size, 0) == (ssize_t)size);
+        off += size;
+        if (gap_us) {
+            usleep(gap_us);
+        }
+    }
+
+    CHECK(recv(sock, got, expected_len, MSG_WAITALL) == (ssize_t)expected_len);
+    CHECK(memcmp(got, expected, expected_len) == 0);
+    close(sock);
+    printf("回环 %s: 通过 (%u 段)\n", name, (unsigned)n);
+}
+
+static uint32_t chunk_whole(uint32_t n)
+{
+    (void)n;
+    return sizeof(stream);
+}
+
+static uint32_t chunk_byte(uint32_t n)
+{
+    (void)n;
+    return 1;
+}
+
+static uint32_t chunk_odd(uint32_t n)
+{
+    static const uint8_t sizes[] = { 3, 7, 1, 13, 2, 31, 5, 64, 11 };
+    return sizes[n % sizeof(sizes)];
+}
+
+int main(void)
+{
+    test_lengths();
+
+    DAP_Setup();
+    dap_tcp_init();
+
+    /* 每次连接都从 DAP_Connect 开始，状态与本地执行一致 */
+    test_stream("整段", chunk_whole, 0);
+    test_stream("逐字节", chunk_byte, 500);
+    test_stream("不规则分段", chunk_odd, 1000);
+    return 0;
+}
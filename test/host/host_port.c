@@ -0,0 +1,86 @@
+/**
+ * @file host_port.c
+ * @brief 主机测试用的 FreeRTOS 任务接口和调试接口互斥锁（pthread 实现）
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "dap_handler.h"
+
+static pthread_mutex_t dap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct host_task {
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static void *host_task_entry(void *param)
+{
+    struct host_task task = *(struct host_task *)param;
+
+    free(param);
+    task.fn(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle,
+                                   BaseType_t core)
+{
+    struct host_task *task = malloc(sizeof(*task));
+    pthread_t thread;
+
+    (void)name;
+    (void)stack;
+    (void)prio;
+    (void)core;
+
+    if (task == NULL) {
+        return pdFALSE;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&thread, NULL, host_task_entry, task) != 0) {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(thread);
+    if (handle != NULL) {
+        *handle = (TaskHandle_t)thread;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+    return taskSCHEDULER_RUNNING;
+}
+
+BaseType_t xPortInIsrContext(void)
+{
+    return pdFALSE;
+}
+
+BaseType_t xPortCanYield(void)
+{
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000U);
+}
+
+void dap_handler_lock(void)
+{
+    pthread_mutex_lock(&dap_lock);
+}
+
+void dap_handler_unlock(void)
+{
+    pthread_mutex_unlock(&dap_lock);
+}
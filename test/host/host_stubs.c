@@ -0,0 +1,34 @@
+/**
+ * @file host_stubs.c
+ * @brief dap_tcp_test 用的空接口
+ *
+ * dap_tcp_test 不编译 swd_host.c、DAP_break.c，这里提供 DAP_retry.c 引用的
+ * swd_host 统计接口，以及 DAP.c 引用的断点管理接口和 swd_host 状态接口
+ */
+
+#include <string.h>
+#include "swd_host.h"
+#include "DAP_break.h"
+
+void swd_get_syscall_stats(swd_syscall_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+uint8_t BRK_Claim(uint8_t owner)
+{
+    (void)owner;
+    return 1U;
+}
+
+void BRK_Invalidate(void)
+{
+}
+
+void BRK_Reapply(void)
+{
+}
+
+void swd_invalidate_state(void)
+{
+}
@@ -0,0 +1,84 @@
+/**
+ * @file DAP_config.h
+ * @brief 主机测试用的 DAP 配置
+ *
+ * 与 components/DAP/Include/DAP_config.h 使用同一个头文件保护宏，
+ * 由 CMake 放在包含路径最前面，代替真实配置。
+ * 引脚访问全部为空操作：输入恒为高电平，SWD 传输得到无效 ACK，
+ * 命令的格式解析和响应长度与硬件上一致。
+ * SWO 与 UART 依赖 ESP-IDF 驱动，这里不编译。
+ */
+
+#ifndef __DAP_CONFIG_H__
+#define __DAP_CONFIG_H__
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#define __STATIC_FORCEINLINE    static inline __attribute__((always_inline))
+#define __STATIC_INLINE         static inline
+#define __weak                  __attribute__((weak))
+
+#define CPU_CLOCK               240000000U
+#define IO_PORT_WRITE_CYCLES    1U
+#define DAP_SWD                 1
+#define DAP_JTAG                1
+#define DAP_JTAG_DEV_CNT        8
+#define DAP_DEFAULT_PORT        1
+#define DAP_DEFAULT_SWJ_CLOCK   4000000U
+#define DAP_PACKET_SIZE         64
+#define DAP_PACKET_COUNT        4
+
+#define SWO_UART                0
+#define SWO_MANCHESTER          0
+#define SWO_STREAM              0
+#define TIMESTAMP_CLOCK         1000000U
+
+#define DAP_UART                0
+#define DAP_UART_USB_COM_PORT   0
+
+#define TARGET_FIXED            0
+#define DAP_RESET_SETTLE_MS     1U
+#define DAP_RESET_DEFERRED      0
+
+__STATIC_INLINE void PORT_JTAG_SETUP(void) { }
+__STATIC_INLINE void PORT_SWD_SETUP(void) { }
+__STATIC_INLINE void PORT_OFF(void) { }
+
+__STATIC_FORCEINLINE uint32_t PIN_SWCLK_TCK_IN(void) { return 1U; }
+__STATIC_FORCEINLINE void     PIN_SWCLK_TCK_SET(void) { }
+__STATIC_FORCEINLINE void     PIN_SWCLK_TCK_CLR(void) { }
+__STATIC_FORCEINLINE uint32_t PIN_SWDIO_TMS_IN(void) { return 1U; }
+__STATIC_FORCEINLINE void     PIN_SWDIO_TMS_SET(void) { }
+__STATIC_FORCEINLINE void     PIN_SWDIO_TMS_CLR(void) { }
+__STATIC_FORCEINLINE uint32_t PIN_SWDIO_IN(void) { return 1U; }
+__STATIC_FORCEINLINE void     PIN_SWDIO_OUT(uint32_t bit) { (void)bit; }
+__STATIC_FORCEINLINE void     PIN_SWDIO_OUT_ENABLE(void) { }
+__STATIC_FORCEINLINE void     PIN_SWDIO_OUT_DISABLE(void) { }
+__STATIC_FORCEINLINE uint32_t PIN_TDI_IN(void) { return 1U; }
+__STATIC_FORCEINLINE void     PIN_TDI_OUT(uint32_t bit) { (void)bit; }
+__STATIC_FORCEINLINE uint32_t PIN_TDO_IN(void) { return 1U; }
+__STATIC_FORCEINLINE uint32_t PIN_nTRST_IN(void) { return 1U; }
+__STATIC_FORCEINLINE void     PIN_nTRST_OUT(uint32_t bit) { (void)bit; }
+__STATIC_FORCEINLINE uint32_t PIN_nRESET_IN(void) { return 1U; }
+__STATIC_FORCEINLINE void     PIN_nRESET_OUT(uint32_t bit) { (void)bit; }
+
+__STATIC_INLINE void LED_CONNECTED_OUT(uint32_t bit) { (void)bit; }
+__STATIC_INLINE void LED_RUNNING_OUT(uint32_t bit) { (void)bit; }
+
+__STATIC_INLINE uint32_t TIMESTAMP_GET(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+__STATIC_INLINE void DAP_SETUP(void) { }
+
+__STATIC_INLINE uint32_t RESET_TARGET(void)
+{
+    return 0U;
+}
+
+#endif /* __DAP_CONFIG_H__ */
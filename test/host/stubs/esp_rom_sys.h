@@ -0,0 +1,17 @@
+/**
+ * @file esp_rom_sys.h
+ * @brief 主机测试用的忙等延时
+ */
+
+#ifndef __HOST_ESP_ROM_SYS_H__
+#define __HOST_ESP_ROM_SYS_H__
+
+#include <stdint.h>
+#include <unistd.h>
+
+static inline void esp_rom_delay_us(uint32_t us)
+{
+    usleep(us);
+}
+
+#endif /* __HOST_ESP_ROM_SYS_H__ */
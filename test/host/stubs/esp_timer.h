@@ -0,0 +1,20 @@
+/**
+ * @file esp_timer.h
+ * @brief 主机测试用的 esp_timer，基于 CLOCK_MONOTONIC
+ */
+
+#ifndef __HOST_ESP_TIMER_H__
+#define __HOST_ESP_TIMER_H__
+
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /* __HOST_ESP_TIMER_H__ */
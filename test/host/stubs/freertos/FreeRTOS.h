@@ -0,0 +1,31 @@
+/**
+ * @file FreeRTOS.h
+ * @brief 主机测试用的 FreeRTOS 类型和临界区（单线程执行 DAP 命令，临界区为空操作）
+ */
+
+#ifndef __HOST_FREERTOS_H__
+#define __HOST_FREERTOS_H__
+
+#include <stdint.h>
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void    *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          pdTRUE
+#define portTICK_PERIOD_MS              1U
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(ms))
+
+#endif /* __HOST_FREERTOS_H__ */
@@ -0,0 +1,21 @@
+/**
+ * @file task.h
+ * @brief 主机测试用的任务接口，由 host_port.c 用 pthread 实现
+ */
+
+#ifndef __HOST_FREERTOS_TASK_H__
+#define __HOST_FREERTOS_TASK_H__
+
+#include "freertos/FreeRTOS.h"
+
+#define taskSCHEDULER_RUNNING   2
+
+BaseType_t xTaskGetSchedulerState(void);
+BaseType_t xPortInIsrContext(void);
+BaseType_t xPortCanYield(void);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle,
+                                   BaseType_t core);
+
+#endif /* __HOST_FREERTOS_TASK_H__ */
@@ -0,0 +1,12 @@
+/**
+ * @file sdkconfig.h
+ * @brief 主机测试用的配置项，对应 menuconfig 中与 DAP TCP 相关的部分
+ */
+
+#ifndef __HOST_SDKCONFIG_H__
+#define __HOST_SDKCONFIG_H__
+
+#define CONFIG_XN_DAP_TCP       1
+#define CONFIG_XN_DAP_TCP_PORT  13240
+
+#endif /* __HOST_SDKCONFIG_H__ */
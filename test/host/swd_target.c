@@ -0,0 +1,201 @@
+/**
+ * @file swd_target.c
+ * @brief 主机测试用的模拟 SWD 目标（传输层）
+ */
+
+#include <string.h>
+#include "DAP_config.h"
+#include "DAP.h"
+#include "debug_cm.h"
+#include "swd_target.h"
+
+#define SWD_TARGET_DPIDR    0x2BA01477U     /* Cortex-M4 SW-DP */
+#define SWD_TARGET_APIDR    0x24770011U     /* AHB-AP */
+
+swd_target_t swd_target;
+
+void swd_target_reset(void)
+{
+    memset(&swd_target, 0, sizeof(swd_target));
+}
+
+static uint32_t *swd_target_slot(uint32_t addr, int create)
+{
+    uint32_t i;
+
+    for (i = 0; i < swd_target.mem_count; i++) {
+        if (swd_target.mem_addr[i] == addr) {
+            return &swd_target.mem_data[i];
+        }
+    }
+    if (!create || swd_target.mem_count >= SWD_TARGET_WORDS) {
+        return NULL;
+    }
+    swd_target.mem_addr[swd_target.mem_count] = addr;
+    swd_target.mem_data[swd_target.mem_count] = 0;
+    return &swd_target.mem_data[swd_target.mem_count++];
+}
+
+uint32_t swd_target_read(uint32_t addr)
+{
+    uint32_t *slot = swd_target_slot(addr & ~3U, 0);
+
+    return slot ? *slot : 0;
+}
+
+void swd_target_write(uint32_t addr, uint32_t value)
+{
+    uint32_t *slot = swd_target_slot(addr & ~3U, 1);
+
+    if (slot) {
+        *slot = value;
+    }
+}
+
+/**
+ * @brief MEM-AP 寄存器访问
+ *
+ * @param ap AP 编号
+ * @param reg 寄存器地址（SELECT 的 APBANKSEL 与 A[3:2] 合成）
+ * @param rnw 1 = 读
+ * @param value 写入的值 / 读出的值
+ */
+static void swd_target_ap(uint32_t ap, uint32_t reg, int rnw, uint32_t *value)
+{
+    uint32_t addr;
+
+    switch (reg) {
+    case AP_CSW:
+        if (rnw) {
+            *value = swd_target.csw[ap];
+        } else {
+            swd_target.csw[ap] = *value;
+        }
+        break;
+    case AP_TAR:
+        if (rnw) {
+            *value = swd_target.tar[ap];
+        } else {
+            swd_target.tar[ap] = *value;
+        }
+        break;
+    case AP_DRW:
+        if (rnw) {
+            *value = swd_target_read(swd_target.tar[ap]);
+        } else {
+            swd_target_write(swd_target.tar[ap], *value);
+        }
+        if ((swd_target.csw[ap] & CSW_ADDRINC) == CSW_SADDRINC) {
+            swd_target.tar[ap] += 4U;
+        }
+        break;
+    case AP_BD0:
+    case AP_BD1:
+    case AP_BD2:
+    case AP_BD3:
+        addr = (swd_target.tar[ap] & ~0xFU) | (reg & 0xCU);
+        if (rnw) {
+            *value = swd_target_read(addr);
+        } else {
+            swd_target_write(addr, *value);
+        }
+        break;
+    case AP_IDR:
+        if (rnw) {
+            *value = SWD_TARGET_APIDR;
+        }
+        break;
+    default:
+        if (rnw) {
+            *value = 0;
+        }
+        break;
+    }
+}
+
+uint8_t SWD_Transfer(uint32_t request, uint32_t *data)
+{
+    uint32_t addr = request & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3);
+    int rnw = (request & DAP_TRANSFER_RnW) != 0;
+    uint32_t value = 0;
+
+    if (request & DAP_TRANSFER_APnDP) {
+        uint32_t ap = swd_target.select >> 24;
+
+        if (ap >= SWD_TARGET_APS) {
+            return DAP_TRANSFER_FAULT;
+        }
+        if (swd_target.wait_count) {
+            swd_target.wait_count--;
+            swd_target.ap_waits[ap]++;
+            return DAP_TRANSFER_WAIT;
+        }
+        swd_target.ap_access[ap]++;
+        if (rnw) {
+            /* 读数据延后一次返回 */
+            swd_target_ap(ap, (swd_target.select & 0xF0U) | addr, 1, &value);
+            if (data) {
+                *data = swd_target.rdbuff;
+            }
+            swd_target.rdbuff = value;
+        } else {
+            swd_target_ap(ap, (swd_target.select & 0xF0U) | addr, 0, data);
+        }
+    } else if (rnw) {
+        switch (addr) {
+        case DP_IDCODE:
+            value = SWD_TARGET_DPIDR;
+            break;
+        case DP_CTRL_STAT:
+            /* 上电请求立即应答 */
+            value = swd_target.ctrl_stat |
+                    ((swd_target.ctrl_stat & CDBGPWRUPREQ) << 1) |
+                    ((swd_target.ctrl_stat & CSYSPWRUPREQ) << 1);
+            break;
+        default:    /* RESEND / RDBUFF */
+            value = swd_target.rdbuff;
+            break;
+        }
+        if (data) {
+            *data = value;
+        }
+    } else {
+        switch (addr) {
+        case DP_CTRL_STAT:
+            swd_target.ctrl_stat = *data;
+            break;
+        case DP_SELECT:
+            swd_target.select = *data;
+            break;
+        case DP_RDBUFF:     /* 写入时是 TARGETSEL */
+            swd_target.targetsel = *data;
+            break;
+        default:            /* ABORT */
+            break;
+        }
+    }
+
+    if (request & DAP_TRANSFER_TIMESTAMP) {
+        DAP_Data.timestamp = TIMESTAMP_GET();
+    }
+    return DAP_TRANSFER_OK;
+}
+
+void SWJ_Sequence(uint32_t count, const uint8_t *data)
+{
+    (void)count;
+    (void)data;
+}
+
+void SWD_Sequence(uint32_t info, const uint8_t *swdo, uint8_t *swdi)
+{
+    uint32_t n = info & SWD_SEQUENCE_CLK;
+
+    (void)swdo;
+    if (n == 0) {
+        n = 64;
+    }
+    if ((info & SWD_SEQUENCE_DIN) && swdi) {
+        memset(swdi, 0, (n + 7) / 8);
+    }
+}
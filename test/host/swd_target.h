@@ -0,0 +1,46 @@
+/**
+ * @file swd_target.h
+ * @brief 主机测试用的模拟 SWD 目标（传输层）
+ *
+ * 代替 SW_DP.c 提供 SWD_Transfer / SWJ_Sequence / SWD_Sequence。
+ * 模拟一个 ADIv5 SW-DP 和若干 MEM-AP，所有 AP 共用一块稀疏内存，
+ * AP 读按规范延后一次返回（数据在下一次 AP 读或 RDBUFF 读时给出）。
+ */
+
+#ifndef SWD_TARGET_H
+#define SWD_TARGET_H
+
+#include <stdint.h>
+
+#define SWD_TARGET_APS      4U      /* 模拟的 MEM-AP 个数 */
+#define SWD_TARGET_WORDS    128U    /* 稀疏内存最多保存的字数 */
+
+typedef struct {
+    uint32_t select;                        /* DP SELECT */
+    uint32_t ctrl_stat;                     /* DP CTRL/STAT */
+    uint32_t rdbuff;                        /* 上一次 AP 读的结果 */
+    uint32_t targetsel;                     /* 最后写入的 TARGETSEL */
+    uint32_t csw[SWD_TARGET_APS];
+    uint32_t tar[SWD_TARGET_APS];
+    uint32_t wait_count;                    /* 之后这么多次 AP 访问回答 WAIT */
+    uint32_t ap_waits[SWD_TARGET_APS];      /* 每个 AP 回答过的 WAIT 次数 */
+    uint32_t ap_access[SWD_TARGET_APS];     /* 每个 AP 成功的访问次数 */
+    uint32_t mem_addr[SWD_TARGET_WORDS];
+    uint32_t mem_data[SWD_TARGET_WORDS];
+    uint32_t mem_count;
+} swd_target_t;
+
+extern swd_target_t swd_target;
+
+/**
+ * @brief 复位模拟目标：清空寄存器、内存和计数
+ */
+void swd_target_reset(void);
+
+/**
+ * @brief 直接读写模拟内存（不经过 SWD，不计数）
+ */
+uint32_t swd_target_read(uint32_t addr);
+void swd_target_write(uint32_t addr, uint32_t value);
+
+#endif /* SWD_TARGET_H */